@@ -30,6 +30,7 @@
 #include "jsonrpc_structs.h"
 #include "storages/portable_storage.h"
 #include "storages/portable_storage_template_helper.h"
+#include "traffic_metrics.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "net.http"
@@ -56,6 +57,8 @@
 
 #define MAP_URI2(pattern, callback)  else if(std::string::npos != query_info.m_URI.find(pattern)) return callback(query_info, response_info, m_conn_context);
 
+#define MAP_URI_EXACT2(uri, callback)  else if(query_info.m_URI == uri) return callback(query_info, response_info, m_conn_context);
+
 #define MAP_URI_AUTO_XML2(s_pattern, callback_f, command_type) //TODO: don't think i ever again will use xml - ambiguous and "overtagged" format
 
 #define MAP_URI_AUTO_JON2_IF(s_pattern, callback_f, command_type, cond) \
@@ -63,10 +66,12 @@
     { \
       handled = true; \
       uint64_t ticks = misc_utils::get_tick_count(); \
+      epee::net_utils::rpc_call_metrics call_metrics(s_pattern, query_info.m_body.size(), epee::net_utils::rpc_traffic_metrics::clock::now()); \
       boost::value_initialized<command_type::request> req; \
       bool parse_res = epee::serialization::load_t_from_json(static_cast<command_type::request&>(req), query_info.m_body); \
       CHECK_AND_ASSERT_MES(parse_res, false, "Failed to parse json: \r\n" << query_info.m_body); \
       uint64_t ticks1 = epee::misc_utils::get_tick_count(); \
+      call_metrics.start_handler(); \
       boost::value_initialized<command_type::response> resp;\
       if(!callback_f(static_cast<command_type::request&>(req), static_cast<command_type::response&>(resp))) \
       { \
@@ -77,6 +82,7 @@
       } \
       uint64_t ticks2 = epee::misc_utils::get_tick_count(); \
       epee::serialization::store_t_to_json(static_cast<command_type::response&>(resp), response_info.m_body); \
+      call_metrics.finish(response_info.m_body.size()); \
       uint64_t ticks3 = epee::misc_utils::get_tick_count(); \
       response_info.m_mime_tipe = "application/json"; \
       response_info.m_header_info.m_content_type = " application/json"; \
@@ -90,10 +96,12 @@
     { \
       handled = true; \
       uint64_t ticks = misc_utils::get_tick_count(); \
+      epee::net_utils::rpc_call_metrics call_metrics(s_pattern, query_info.m_body.size(), epee::net_utils::rpc_traffic_metrics::clock::now()); \
       boost::value_initialized<command_type::request> req; \
       bool parse_res = epee::serialization::load_t_from_binary(static_cast<command_type::request&>(req), query_info.m_body); \
       CHECK_AND_ASSERT_MES(parse_res, false, "Failed to parse bin body data, body size=" << query_info.m_body.size()); \
       uint64_t ticks1 = misc_utils::get_tick_count(); \
+      call_metrics.start_handler(); \
       boost::value_initialized<command_type::response> resp;\
       if(!callback_f(static_cast<command_type::request&>(req), static_cast<command_type::response&>(resp))) \
       { \
@@ -104,6 +112,7 @@
       } \
       uint64_t ticks2 = misc_utils::get_tick_count(); \
       epee::serialization::store_t_to_binary(static_cast<command_type::response&>(resp), response_info.m_body); \
+      call_metrics.finish(response_info.m_body.size()); \
       uint64_t ticks3 = epee::misc_utils::get_tick_count(); \
       response_info.m_mime_tipe = " application/octet-stream"; \
       response_info.m_header_info.m_content_type = " application/octet-stream"; \
@@ -118,6 +127,7 @@
 #define BEGIN_JSON_RPC_MAP(uri)    else if(query_info.m_URI == uri) \
     { \
     uint64_t ticks = epee::misc_utils::get_tick_count(); \
+    const epee::net_utils::rpc_traffic_metrics::clock::time_point metrics_received = epee::net_utils::rpc_traffic_metrics::clock::now(); \
     epee::serialization::portable_storage ps; \
     if(!ps.load_from_json(query_info.m_body)) \
     { \
@@ -145,6 +155,7 @@
 
 #define PREPARE_OBJECTS_FROM_JSON(command_type) \
   handled = true; \
+  epee::net_utils::rpc_call_metrics call_metrics(callback_name, query_info.m_body.size(), metrics_received); \
   boost::value_initialized<epee::json_rpc::request<command_type::request> > req_; \
   epee::json_rpc::request<command_type::request>& req = static_cast<epee::json_rpc::request<command_type::request>&>(req_);\
   if(!req.load(ps)) \
@@ -158,6 +169,7 @@
     return true; \
   } \
   uint64_t ticks1 = epee::misc_utils::get_tick_count(); \
+  call_metrics.start_handler(); \
   boost::value_initialized<epee::json_rpc::response<command_type::response, epee::json_rpc::dummy_error> > resp_; \
   epee::json_rpc::response<command_type::response, epee::json_rpc::dummy_error>& resp =  static_cast<epee::json_rpc::response<command_type::response, epee::json_rpc::dummy_error> &>(resp_); \
   resp.jsonrpc = "2.0"; \
@@ -166,6 +178,7 @@
 #define FINALIZE_OBJECTS_TO_JSON(method_name) \
   uint64_t ticks2 = epee::misc_utils::get_tick_count(); \
   epee::serialization::store_t_to_json(resp, response_info.m_body); \
+  call_metrics.finish(response_info.m_body.size()); \
   uint64_t ticks3 = epee::misc_utils::get_tick_count(); \
   response_info.m_mime_tipe = "application/json"; \
   response_info.m_header_info.m_content_type = " application/json"; \
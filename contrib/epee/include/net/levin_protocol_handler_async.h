@@ -35,6 +35,7 @@
 
 #include "levin_base.h"
 #include "misc_language.h"
+#include "traffic_metrics.h"
 #include "async_state_machine.h"
 
 #include <random>
@@ -375,6 +376,8 @@ public:
 
     m_cache_in_buffer.append((const char*)ptr, cb);
 
+    // messages handled later in this loop have waited for the ones before them
+    const net_utils::levin_traffic_metrics::clock::time_point received = net_utils::levin_traffic_metrics::clock::now();
     bool is_continue = true;
     while(is_continue)
     {
@@ -404,6 +407,9 @@ public:
           }
 
           bool is_response = (m_oponent_protocol_ver == LEVIN_PROTOCOL_VER_1 && m_current_head.m_flags&LEVIN_PACKET_RESPONSE);
+          const int command = m_current_head.m_command;
+          net_utils::levin_traffic_metrics &metrics = net_utils::get_levin_metrics();
+          metrics.on_in(command, sizeof(bucket_head2) + buff_to_invoke.size());
 
           MDEBUG(m_connection_context << "LEVIN_PACKET_RECIEVED. [len=" << m_current_head.m_cb
             << ", flags" << m_current_head.m_flags 
@@ -450,11 +456,13 @@ public:
             if(m_current_head.m_have_to_return_data)
             {
               std::string return_buff;
+              const net_utils::levin_traffic_metrics::clock::time_point started = net_utils::levin_traffic_metrics::clock::now();
               m_current_head.m_return_code = m_config.m_pcommands_handler->invoke(
                                                                   m_current_head.m_command, 
                                                                   buff_to_invoke, 
                                                                   return_buff, 
                                                                   m_connection_context);
+              metrics.on_handled(command, received, started, net_utils::levin_traffic_metrics::clock::now(), m_current_head.m_return_code >= 0);
               m_current_head.m_cb = return_buff.size();
               m_current_head.m_have_to_return_data = false;
               m_current_head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
@@ -465,6 +473,7 @@ public:
               if(!m_pservice_endpoint->do_send(send_buff.data(), send_buff.size()))
                 return false;
               CRITICAL_REGION_END();
+              metrics.on_out(command, send_buff.size());
               MDEBUG(m_connection_context << "LEVIN_PACKET_SENT. [len=" << m_current_head.m_cb
                 << ", flags" << m_current_head.m_flags 
                 << ", r?=" << m_current_head.m_have_to_return_data 
@@ -472,7 +481,11 @@ public:
                 << ", ver=" << m_current_head.m_protocol_version);
             }
             else
-              m_config.m_pcommands_handler->notify(m_current_head.m_command, buff_to_invoke, m_connection_context);
+            {
+              const net_utils::levin_traffic_metrics::clock::time_point started = net_utils::levin_traffic_metrics::clock::now();
+              int r = m_config.m_pcommands_handler->notify(m_current_head.m_command, buff_to_invoke, m_connection_context);
+              metrics.on_handled(command, received, started, net_utils::levin_traffic_metrics::clock::now(), r >= 0);
+            }
           }
         }
         m_state = stream_state_head;
@@ -588,6 +601,7 @@ public:
       }
 
       CRITICAL_REGION_END();
+      net_utils::get_levin_metrics().on_out(command, sizeof(head) + in_buff.size());
     } while (false);
 
     if (LEVIN_OK != err_code)
@@ -637,6 +651,7 @@ public:
       return LEVIN_ERROR_CONNECTION;
     }
     CRITICAL_REGION_END();
+    net_utils::get_levin_metrics().on_out(command, sizeof(head) + in_buff.size());
 
     MDEBUG(m_connection_context << "LEVIN_PACKET_SENT. [len=" << head.m_cb
                             << ", f=" << head.m_flags 
@@ -709,6 +724,7 @@ public:
       return -1;
     }
     CRITICAL_REGION_END();
+    net_utils::get_levin_metrics().on_out(command, sizeof(head) + in_buff.size());
     LOG_DEBUG_CC(m_connection_context, "LEVIN_PACKET_SENT. [len=" << head.m_cb <<
       ", f=" << head.m_flags << 
       ", r?=" << head.m_have_to_return_data <<
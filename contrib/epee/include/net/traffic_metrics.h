@@ -0,0 +1,353 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace epee
+{
+namespace net_utils
+{
+  /**
+   * \brief traffic_metrics - per command message, byte and handler time counters
+   *
+   * Every thread updates its own shard, so the only lock taken on the hot path is
+   * the thread's own and it is contended only while a snapshot is being taken.
+   * "wait" is the time a received message spent before its handler started: for
+   * levin the time queued behind earlier messages of the same read, for RPC the
+   * time spent parsing the request.
+   * Keys taken from the wire (levin commands) should be bounded: with the other_key
+   * constructor only keys registered with set_name get their own counters, the rest
+   * are counted together under other_key.
+   */
+  template<class t_key>
+  class traffic_metrics
+  {
+  public:
+    typedef std::chrono::steady_clock clock;
+
+    static constexpr size_t HISTOGRAM_BUCKETS = 12;
+
+    // upper bounds of the handler time buckets in microseconds, last bucket is unbounded
+    static const uint64_t *histogram_bounds()
+    {
+      static const uint64_t bounds[HISTOGRAM_BUCKETS - 1] = {50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 100000, 1000000};
+      return bounds;
+    }
+
+    struct counters
+    {
+      uint64_t messages_in = 0;
+      uint64_t bytes_in = 0;
+      uint64_t messages_out = 0;
+      uint64_t bytes_out = 0;
+      uint64_t handled = 0;
+      uint64_t errors = 0;
+      uint64_t exec_us_total = 0;
+      uint64_t exec_us_max = 0;
+      uint64_t wait_us_total = 0;
+      uint64_t wait_us_max = 0;
+      uint64_t exec_histogram[HISTOGRAM_BUCKETS] = {};
+
+      void merge(const counters &other)
+      {
+        messages_in += other.messages_in;
+        bytes_in += other.bytes_in;
+        messages_out += other.messages_out;
+        bytes_out += other.bytes_out;
+        handled += other.handled;
+        errors += other.errors;
+        exec_us_total += other.exec_us_total;
+        exec_us_max = std::max(exec_us_max, other.exec_us_max);
+        wait_us_total += other.wait_us_total;
+        wait_us_max = std::max(wait_us_max, other.wait_us_max);
+        for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i)
+          exec_histogram[i] += other.exec_histogram[i];
+      }
+    };
+
+    traffic_metrics() : m_id(next_id()), m_bounded(false), m_other_key() {}
+
+    traffic_metrics(const t_key &other_key, const std::string &other_name)
+      : m_id(next_id()), m_bounded(true), m_other_key(other_key)
+    {
+      set_name(other_key, other_name);
+    }
+
+    traffic_metrics(const traffic_metrics&) = delete;
+    traffic_metrics& operator=(const traffic_metrics&) = delete;
+
+    void on_in(const t_key &key, size_t bytes)
+    {
+      shard &s = local_shard();
+      boost::lock_guard<boost::mutex> guard(s.lock);
+      counters &c = get_counters(s, key);
+      ++c.messages_in;
+      c.bytes_in += bytes;
+    }
+
+    void on_out(const t_key &key, size_t bytes)
+    {
+      shard &s = local_shard();
+      boost::lock_guard<boost::mutex> guard(s.lock);
+      counters &c = get_counters(s, key);
+      ++c.messages_out;
+      c.bytes_out += bytes;
+    }
+
+    void on_handled(const t_key &key, uint64_t wait_us, uint64_t exec_us, bool ok)
+    {
+      const uint64_t *bounds = histogram_bounds();
+      size_t bucket = std::lower_bound(bounds, bounds + HISTOGRAM_BUCKETS - 1, exec_us) - bounds;
+
+      shard &s = local_shard();
+      boost::lock_guard<boost::mutex> guard(s.lock);
+      counters &c = get_counters(s, key);
+      ++c.handled;
+      if (!ok)
+        ++c.errors;
+      c.exec_us_total += exec_us;
+      c.exec_us_max = std::max(c.exec_us_max, exec_us);
+      c.wait_us_total += wait_us;
+      c.wait_us_max = std::max(c.wait_us_max, wait_us);
+      ++c.exec_histogram[bucket];
+    }
+
+    void on_handled(const t_key &key, clock::time_point received, clock::time_point started, clock::time_point finished, bool ok)
+    {
+      on_handled(key, to_us(started - received), to_us(finished - started), ok);
+    }
+
+    // human readable name of the key used in reports instead of the key itself
+    void set_name(const t_key &key, const std::string &name)
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      m_names[key] = name;
+    }
+
+    std::string get_name(const t_key &key) const
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      auto it = m_names.find(key);
+      if (it != m_names.end())
+        return it->second;
+      std::ostringstream ss;
+      ss << key;
+      return ss.str();
+    }
+
+    std::map<t_key, counters> snapshot() const
+    {
+      std::vector<std::shared_ptr<shard>> shards;
+      {
+        boost::lock_guard<boost::mutex> guard(m_lock);
+        shards = m_shards;
+      }
+      std::map<t_key, counters> result;
+      for (const auto &s : shards)
+      {
+        boost::lock_guard<boost::mutex> guard(s->lock);
+        for (const auto &c : s->values)
+          result[c.first].merge(c.second);
+      }
+      return result;
+    }
+
+    /**
+     * \brief to_text - counters in the Prometheus text exposition format
+     * \param prefix - metric names prefix
+     * \param label - name of the label carrying the command name
+     */
+    std::string to_text(const std::string &prefix, const std::string &label) const
+    {
+      std::ostringstream ss;
+      std::map<t_key, counters> data = snapshot();
+      std::vector<std::pair<std::string, counters>> named;
+      for (const auto &c : data)
+        named.emplace_back(get_name(c.first), c.second);
+
+      auto counter = [&](const char *name, const char *type, uint64_t counters::*field, double scale) {
+        ss << "# TYPE " << prefix << "_" << name << " " << type << "\n";
+        for (const auto &c : named)
+          ss << prefix << "_" << name << "{" << label << "=\"" << c.first << "\"} " << (c.second.*field) * scale << "\n";
+      };
+      counter("messages_in_total", "counter", &counters::messages_in, 1);
+      counter("bytes_in_total", "counter", &counters::bytes_in, 1);
+      counter("messages_out_total", "counter", &counters::messages_out, 1);
+      counter("bytes_out_total", "counter", &counters::bytes_out, 1);
+      counter("errors_total", "counter", &counters::errors, 1);
+      counter("wait_seconds_sum", "counter", &counters::wait_us_total, 1e-6);
+      counter("wait_seconds_max", "gauge", &counters::wait_us_max, 1e-6);
+      counter("handler_seconds_max", "gauge", &counters::exec_us_max, 1e-6);
+
+      const uint64_t *bounds = histogram_bounds();
+      ss << "# TYPE " << prefix << "_handler_seconds histogram\n";
+      for (const auto &c : named)
+      {
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i)
+        {
+          cumulative += c.second.exec_histogram[i];
+          ss << prefix << "_handler_seconds_bucket{" << label << "=\"" << c.first << "\",le=\"";
+          if (i + 1 < HISTOGRAM_BUCKETS)
+            ss << bounds[i] * 1e-6;
+          else
+            ss << "+Inf";
+          ss << "\"} " << cumulative << "\n";
+        }
+        ss << prefix << "_handler_seconds_sum{" << label << "=\"" << c.first << "\"} " << c.second.exec_us_total * 1e-6 << "\n";
+        ss << prefix << "_handler_seconds_count{" << label << "=\"" << c.first << "\"} " << c.second.handled << "\n";
+      }
+      return ss.str();
+    }
+
+    static uint64_t to_us(clock::duration d)
+    {
+      return d.count() <= 0 ? 0 : std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    }
+
+  private:
+    struct shard
+    {
+      boost::mutex lock;
+      std::unordered_map<t_key, counters> values;
+    };
+
+    // called with the shard locked; names are looked up only for keys the shard has not seen yet
+    counters &get_counters(shard &s, const t_key &key)
+    {
+      auto it = s.values.find(key);
+      if (it != s.values.end())
+        return it->second;
+      if (m_bounded)
+      {
+        boost::lock_guard<boost::mutex> guard(m_lock);
+        if (m_names.find(key) == m_names.end())
+          return s.values[m_other_key];
+      }
+      return s.values[key];
+    }
+
+    static uint64_t next_id()
+    {
+      static std::atomic<uint64_t> id{0};
+      return ++id;
+    }
+
+    shard &local_shard()
+    {
+      // one entry per metrics object the thread has touched, usually one or two
+      thread_local std::vector<std::pair<uint64_t, std::shared_ptr<shard>>> t_shards;
+      for (const auto &s : t_shards)
+        if (s.first == m_id)
+          return *s.second;
+      std::shared_ptr<shard> s = std::make_shared<shard>();
+      {
+        boost::lock_guard<boost::mutex> guard(m_lock);
+        m_shards.push_back(s);
+      }
+      t_shards.emplace_back(m_id, s);
+      return *s;
+    }
+
+    const uint64_t m_id;
+    const bool m_bounded;
+    const t_key m_other_key;
+    mutable boost::mutex m_lock;
+    std::vector<std::shared_ptr<shard>> m_shards;
+    std::map<t_key, std::string> m_names;
+  };
+
+  typedef traffic_metrics<int> levin_traffic_metrics;
+  typedef traffic_metrics<std::string> rpc_traffic_metrics;
+
+  inline levin_traffic_metrics &get_levin_metrics()
+  {
+    // command ids come from the wire, unregistered ones are counted as "other"
+    static levin_traffic_metrics metrics(-1, "other");
+    return metrics;
+  }
+
+  inline rpc_traffic_metrics &get_rpc_metrics()
+  {
+    static rpc_traffic_metrics metrics;
+    return metrics;
+  }
+
+  /**
+   * \brief rpc_call_metrics - records one RPC call, calls not reaching finish() are counted as errors
+   */
+  class rpc_call_metrics
+  {
+  public:
+    rpc_call_metrics(const std::string &method, size_t bytes_in, rpc_traffic_metrics::clock::time_point received)
+      : m_method(method), m_received(received), m_started(received), m_finished(false)
+    {
+      get_rpc_metrics().on_in(m_method, bytes_in);
+    }
+
+    ~rpc_call_metrics()
+    {
+      if (!m_finished)
+        get_rpc_metrics().on_handled(m_method, m_received, m_started, rpc_traffic_metrics::clock::now(), false);
+    }
+
+    void start_handler()
+    {
+      m_started = rpc_traffic_metrics::clock::now();
+    }
+
+    void finish(size_t bytes_out)
+    {
+      m_finished = true;
+      get_rpc_metrics().on_handled(m_method, m_received, m_started, rpc_traffic_metrics::clock::now(), true);
+      get_rpc_metrics().on_out(m_method, bytes_out);
+    }
+
+  private:
+    const std::string m_method;
+    const rpc_traffic_metrics::clock::time_point m_received;
+    rpc_traffic_metrics::clock::time_point m_started;
+    bool m_finished;
+  };
+}
+}
@@ -226,6 +226,9 @@ uint64_t BlockchainDB::add_block( const block& blk
 
   m_hardfork->add(blk, prev_height);
 
+  if (m_extension)
+    m_extension->on_block_added(prev_height, blk, blk_hash, txs);
+
   block_txn_stop();
 
   ++num_calls;
@@ -238,10 +241,18 @@ void BlockchainDB::set_hard_fork(HardFork* hf)
   m_hardfork = hf;
 }
 
+void BlockchainDB::set_extension(BlockchainDBExtension* extension)
+{
+  m_extension = extension;
+}
+
 void BlockchainDB::pop_block(block& blk, std::vector<transaction>& txs)
 {
   blk = get_top_block();
 
+  if (m_extension)
+    m_extension->on_block_removed(height() - 1, blk);
+
   remove_block();
 
   for (const auto& h : boost::adaptors::reverse(blk.tx_hashes))
@@ -151,6 +151,51 @@ struct txpool_tx_meta_t
   uint8_t padding[77]; // till 192 bytes
 };
 
+/**
+ * @brief kinds of RTA state stored per block height
+ *
+ * RTA state is derived from blocks (stake transactions and blockchain based
+ * lists); it is written and removed together with the blocks it was derived
+ * from. Supernode stakes are not stored, they are rebuilt from stake
+ * transactions.
+ */
+enum rta_state_type
+{
+  RTA_STAKE_TXS,  //!< stake transactions found in the block
+  RTA_TIERS       //!< blockchain based list tiers of the block, for the recent blocks only
+};
+
+/**
+ * @brief an extension which keeps its state in step with the blockchain
+ *
+ * Callbacks are invoked from BlockchainDB::add_block and BlockchainDB::pop_block
+ * inside the block's write transaction, so anything the extension writes to the
+ * BlockchainDB is committed or aborted atomically with the block itself.
+ */
+class BlockchainDBExtension
+{
+public:
+  virtual ~BlockchainDBExtension() { }
+
+  /**
+   * @brief called after a block and its transactions have been added
+   *
+   * @param height the height of the block
+   * @param blk the block
+   * @param blk_hash the hash of the block
+   * @param txs the transactions of the block (without the miner transaction)
+   */
+  virtual void on_block_added(uint64_t height, const block& blk, const crypto::hash& blk_hash, const std::vector<transaction>& txs) = 0;
+
+  /**
+   * @brief called before the top block is removed
+   *
+   * @param height the height of the block
+   * @param blk the block
+   */
+  virtual void on_block_removed(uint64_t height, const block& blk) = 0;
+};
+
 #define DBF_SAFE       1
 #define DBF_FAST       2
 #define DBF_FASTEST    4
@@ -534,6 +579,8 @@ protected:
 
   HardFork* m_hardfork;
 
+  BlockchainDBExtension* m_extension = nullptr;  //!< optional extension notified about added and removed blocks
+
 public:
 
   /**
@@ -751,6 +798,13 @@ public:
 
   virtual void set_hard_fork(HardFork* hf);
 
+  /**
+   * @brief sets the extension which is notified about added and removed blocks
+   *
+   * @param extension the extension, or nullptr to detach the current one
+   */
+  virtual void set_extension(BlockchainDBExtension* extension);
+
   // adds a block with the given metadata to the top of the blockchain, returns the new height
   /**
    * @brief handles the addition of a new block to BlockchainDB
@@ -1475,6 +1529,66 @@ public:
    */
   virtual void drop_hard_fork_info() = 0;
 
+  //
+  // RTA state related storage
+  //
+
+  /**
+   * @brief stores RTA state for a height, replacing the existing one
+   *
+   * @param type the kind of state
+   * @param height the height
+   * @param blob the serialized state
+   */
+  virtual void add_rta_state(rta_state_type type, uint64_t height, const std::string& blob) = 0;
+
+  /**
+   * @brief removes RTA state for a height, if any
+   *
+   * @param type the kind of state
+   * @param height the height
+   */
+  virtual void remove_rta_state(rta_state_type type, uint64_t height) = 0;
+
+  /**
+   * @brief gets the RTA state with the greatest height not above max_height
+   *
+   * @param type the kind of state
+   * @param max_height the maximum height to look at
+   * @param height return-by-reference the height of the state found
+   * @param blob return-by-reference the serialized state
+   *
+   * @return true if the state was found, otherwise false
+   */
+  virtual bool get_latest_rta_state(rta_state_type type, uint64_t max_height, uint64_t& height, std::string& blob) const = 0;
+
+  /**
+   * @brief runs a function over RTA states in a range of heights, in order of height
+   *
+   * The function should return true to continue, false to stop.
+   *
+   * @param type the kind of state
+   * @param h1 the first height
+   * @param h2 the last height
+   * @param std::function f the function to run
+   *
+   * @return false if the function returns false for any state, otherwise true
+   */
+  virtual bool for_rta_states_range(rta_state_type type, uint64_t h1, uint64_t h2, std::function<bool(uint64_t height, const std::string& blob)> f) const = 0;
+
+  /**
+   * @brief removes RTA states below a height
+   *
+   * @param type the kind of state
+   * @param height the lowest height to keep
+   */
+  virtual void prune_rta_state(rta_state_type type, uint64_t height) = 0;
+
+  /**
+   * @brief delete all RTA state from database
+   */
+  virtual void drop_rta_state() = 0;
+
   /**
    * @brief return a histogram of outputs on the blockchain
    *
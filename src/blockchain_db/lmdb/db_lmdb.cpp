@@ -173,6 +173,9 @@ int compare_string(const MDB_val *a, const MDB_val *b)
  * txpool_meta      txn hash     txn metadata
  * txpool_blob      txn hash     txn blob
  *
+ * rta_stake_txs    block ID     [stake transactions of the block]
+ * rta_tiers        block ID     {blockchain based list tiers}
+ *
  * Note: where the data items are of uniform size, DUPFIXED tables have
  * been used to save space. In most of these cases, a dummy "zerokval"
  * key is used when accessing the table; the Key listed above will be
@@ -199,6 +202,9 @@ const char* const LMDB_TXPOOL_BLOB = "txpool_blob";
 const char* const LMDB_HF_STARTING_HEIGHTS = "hf_starting_heights";
 const char* const LMDB_HF_VERSIONS = "hf_versions";
 
+const char* const LMDB_RTA_STAKE_TXS = "rta_stake_txs";
+const char* const LMDB_RTA_TIERS = "rta_tiers";
+
 const char* const LMDB_PROPERTIES = "properties";
 
 const char zerokey[8] = {0};
@@ -1079,6 +1085,7 @@ BlockchainLMDB::BlockchainLMDB(bool batch_transactions)
   m_batch_active = false;
   m_cum_size = 0;
   m_cum_count = 0;
+  m_rta_state_open = false;
 
   m_hardfork = nullptr;
 }
@@ -1192,6 +1199,19 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
 
   lmdb_db_open(txn, LMDB_HF_VERSIONS, MDB_INTEGERKEY | MDB_CREATE, m_hf_versions, "Failed to open db handle for m_hf_versions");
 
+  // RTA state subdbs are new, an older DB opened read-only does not have them yet
+  if (!(mdb_flags & MDB_RDONLY))
+  {
+    lmdb_db_open(txn, LMDB_RTA_STAKE_TXS, MDB_INTEGERKEY | MDB_CREATE, m_rta_stake_txs, "Failed to open db handle for m_rta_stake_txs");
+    lmdb_db_open(txn, LMDB_RTA_TIERS, MDB_INTEGERKEY | MDB_CREATE, m_rta_tiers, "Failed to open db handle for m_rta_tiers");
+    m_rta_state_open = true;
+  }
+  else
+  {
+    m_rta_state_open = !mdb_dbi_open(txn, LMDB_RTA_STAKE_TXS, MDB_INTEGERKEY, &m_rta_stake_txs) &&
+      !mdb_dbi_open(txn, LMDB_RTA_TIERS, MDB_INTEGERKEY, &m_rta_tiers);
+  }
+
   lmdb_db_open(txn, LMDB_PROPERTIES, MDB_CREATE, m_properties, "Failed to open db handle for m_properties");
 
   mdb_set_dupsort(txn, m_spent_keys, compare_hash32);
@@ -1353,6 +1373,10 @@ void BlockchainLMDB::reset()
   (void)mdb_drop(txn, m_hf_starting_heights, 0); // this one is dropped in new code
   if (auto result = mdb_drop(txn, m_hf_versions, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_hf_versions: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_rta_stake_txs, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_rta_stake_txs: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_rta_tiers, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_rta_tiers: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_properties, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_properties: ", result).c_str()));
 
@@ -3133,6 +3157,179 @@ uint8_t BlockchainLMDB::get_hard_fork_version(uint64_t height) const
   return ret;
 }
 
+MDB_dbi BlockchainLMDB::get_rta_state_dbi(rta_state_type type) const
+{
+  if (!m_rta_state_open)
+    throw0(DB_ERROR("RTA state is not available in this database"));
+
+  MDB_dbi dbi = 0;
+  switch (type)
+  {
+    case RTA_STAKE_TXS: dbi = m_rta_stake_txs; break;
+    case RTA_TIERS:     dbi = m_rta_tiers; break;
+    default:            throw0(DB_ERROR("Unknown RTA state type"));
+  }
+  return dbi;
+}
+
+void BlockchainLMDB::add_rta_state(rta_state_type type, uint64_t height, const std::string& blob)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  MDB_dbi dbi = get_rta_state_dbi(type);
+
+  TXN_BLOCK_PREFIX(0);
+
+  MDB_val_copy<uint64_t> val_key(height);
+  MDB_val val_value = {blob.size(), (void *)blob.data()};
+  int result = mdb_put(*txn_ptr, dbi, &val_key, &val_value, MDB_APPEND);
+  if (result == MDB_KEYEXIST)
+    result = mdb_put(*txn_ptr, dbi, &val_key, &val_value, 0);
+  if (result)
+    throw1(DB_ERROR(lmdb_error("Error adding RTA state to db transaction: ", result).c_str()));
+
+  TXN_BLOCK_POSTFIX_SUCCESS();
+}
+
+void BlockchainLMDB::remove_rta_state(rta_state_type type, uint64_t height)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  MDB_dbi dbi = get_rta_state_dbi(type);
+
+  TXN_BLOCK_PREFIX(0);
+
+  MDB_val_copy<uint64_t> val_key(height);
+  int result = mdb_del(*txn_ptr, dbi, &val_key, NULL);
+  if (result && result != MDB_NOTFOUND)
+    throw1(DB_ERROR(lmdb_error("Error removing RTA state from db transaction: ", result).c_str()));
+
+  TXN_BLOCK_POSTFIX_SUCCESS();
+}
+
+bool BlockchainLMDB::get_latest_rta_state(rta_state_type type, uint64_t max_height, uint64_t& height, std::string& blob) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  if (!m_rta_state_open)
+    return false;
+  MDB_dbi dbi = get_rta_state_dbi(type);
+
+  TXN_PREFIX_RDONLY();
+
+  MDB_cursor *cur;
+  int result = mdb_cursor_open(m_txn, dbi, &cur);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to open cursor: ", result).c_str()));
+
+  // position on the first key not below max_height, then step back if it is above
+  MDB_val_copy<uint64_t> val_key(max_height);
+  MDB_val k = val_key, v;
+  result = mdb_cursor_get(cur, &k, &v, MDB_SET_RANGE);
+  if (result == MDB_NOTFOUND)
+    result = mdb_cursor_get(cur, &k, &v, MDB_LAST);
+  else if (!result && *(const uint64_t*)k.mv_data > max_height)
+    result = mdb_cursor_get(cur, &k, &v, MDB_PREV);
+
+  bool found = !result;
+  if (found)
+  {
+    height = *(const uint64_t*)k.mv_data;
+    blob.assign((const char*)v.mv_data, v.mv_size);
+  }
+  mdb_cursor_close(cur);
+
+  if (result && result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to get RTA state: ", result).c_str()));
+
+  TXN_POSTFIX_RDONLY();
+  return found;
+}
+
+bool BlockchainLMDB::for_rta_states_range(rta_state_type type, uint64_t h1, uint64_t h2, std::function<bool(uint64_t height, const std::string& blob)> f) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  if (!m_rta_state_open)
+    return true;
+  MDB_dbi dbi = get_rta_state_dbi(type);
+
+  TXN_PREFIX_RDONLY();
+
+  MDB_cursor *cur;
+  int result = mdb_cursor_open(m_txn, dbi, &cur);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to open cursor: ", result).c_str()));
+
+  MDB_val_copy<uint64_t> val_key(h1);
+  MDB_val k = val_key, v;
+  bool fret = true;
+  MDB_cursor_op op = MDB_SET_RANGE;
+  while (1)
+  {
+    result = mdb_cursor_get(cur, &k, &v, op);
+    op = MDB_NEXT;
+    if (result)
+      break;
+    const uint64_t height = *(const uint64_t*)k.mv_data;
+    if (height > h2)
+      break;
+    if (!f(height, std::string((const char*)v.mv_data, v.mv_size))) {
+      fret = false;
+      break;
+    }
+  }
+  mdb_cursor_close(cur);
+
+  if (result && result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to enumerate RTA states: ", result).c_str()));
+
+  TXN_POSTFIX_RDONLY();
+  return fret;
+}
+
+void BlockchainLMDB::prune_rta_state(rta_state_type type, uint64_t height)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  MDB_dbi dbi = get_rta_state_dbi(type);
+
+  TXN_BLOCK_PREFIX(0);
+
+  MDB_cursor *cur;
+  int result = mdb_cursor_open(*txn_ptr, dbi, &cur);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to open cursor: ", result).c_str()));
+
+  MDB_val k, v;
+  while (!(result = mdb_cursor_get(cur, &k, &v, MDB_FIRST)) && *(const uint64_t*)k.mv_data < height)
+  {
+    result = mdb_cursor_del(cur, 0);
+    if (result)
+      break;
+  }
+  mdb_cursor_close(cur);
+
+  if (result && result != MDB_NOTFOUND)
+    throw1(DB_ERROR(lmdb_error("Failed to prune RTA state: ", result).c_str()));
+
+  TXN_BLOCK_POSTFIX_SUCCESS();
+}
+
+void BlockchainLMDB::drop_rta_state()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_BLOCK_PREFIX(0);
+
+  for (rta_state_type type : {RTA_STAKE_TXS, RTA_TIERS})
+    if (auto result = mdb_drop(*txn_ptr, get_rta_state_dbi(type), 0))
+      throw1(DB_ERROR(lmdb_error("Failed to drop RTA state: ", result).c_str()));
+
+  TXN_BLOCK_POSTFIX_SUCCESS();
+}
+
 bool BlockchainLMDB::is_read_only() const
 {
   unsigned int flags;
@@ -337,6 +337,16 @@ private:
   virtual void check_hard_fork_info();
   virtual void drop_hard_fork_info();
 
+  // RTA state
+  virtual void add_rta_state(rta_state_type type, uint64_t height, const std::string& blob);
+  virtual void remove_rta_state(rta_state_type type, uint64_t height);
+  virtual bool get_latest_rta_state(rta_state_type type, uint64_t max_height, uint64_t& height, std::string& blob) const;
+  virtual bool for_rta_states_range(rta_state_type type, uint64_t h1, uint64_t h2, std::function<bool(uint64_t height, const std::string& blob)> f) const;
+  virtual void prune_rta_state(rta_state_type type, uint64_t height);
+  virtual void drop_rta_state();
+
+  MDB_dbi get_rta_state_dbi(rta_state_type type) const;
+
   /**
    * @brief convert a tx output to a blob for storage
    *
@@ -392,6 +402,10 @@ private:
   MDB_dbi m_hf_starting_heights;
   MDB_dbi m_hf_versions;
 
+  MDB_dbi m_rta_stake_txs;
+  MDB_dbi m_rta_tiers;
+  bool m_rta_state_open; // RTA subdbs are missing in an older DB opened read-only
+
   MDB_dbi m_properties;
 
   mutable uint64_t m_cum_size;	// used in batch size estimation
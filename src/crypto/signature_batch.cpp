@@ -0,0 +1,132 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <unordered_map>
+
+#include "signature_batch.h"
+
+namespace crypto {
+
+  extern "C" {
+#include "crypto-ops.h"
+  }
+
+  // as in crypto.cpp, so points and scalars go to crypto-ops as is
+  static inline unsigned char *operator &(ec_point &point) {
+    return &reinterpret_cast<unsigned char &>(point);
+  }
+
+  static inline const unsigned char *operator &(const ec_point &point) {
+    return &reinterpret_cast<const unsigned char &>(point);
+  }
+
+  static inline unsigned char *operator &(ec_scalar &scalar) {
+    return &reinterpret_cast<unsigned char &>(scalar);
+  }
+
+  static inline const unsigned char *operator &(const ec_scalar &scalar) {
+    return &reinterpret_cast<const unsigned char &>(scalar);
+  }
+
+  namespace {
+    // as in crypto.cpp, hashed to get c
+    struct s_comm {
+      hash h;
+      ec_point key;
+      ec_point comm;
+    };
+
+    struct key_precomp {
+      bool valid;
+      ge_dsmp precomp;
+    };
+  }
+
+  size_t signature_batch::add(const hash &prefix_hash, const public_key &pub, const signature &sig) {
+    item i;
+    i.prefix_hash = prefix_hash;
+    i.pub = pub;
+    i.sig = sig;
+    m_items.push_back(i);
+    return m_items.size() - 1;
+  }
+
+  bool signature_batch::verify(std::vector<bool> &results) const {
+    results.assign(m_items.size(), false);
+    return verify(&results);
+  }
+
+  bool signature_batch::verify() const {
+    return verify(nullptr);
+  }
+
+  bool signature_batch::verify(std::vector<bool> *results) const {
+    std::unordered_map<public_key, size_t> key_index;
+    std::vector<key_precomp> keys;
+    keys.reserve(m_items.size());
+
+    bool all = true;
+    for (size_t n = 0; n < m_items.size(); ++n) {
+      const item &i = m_items[n];
+
+      auto it = key_index.find(i.pub);
+      if (it == key_index.end()) {
+        keys.emplace_back();
+        key_precomp &k = keys.back();
+        ge_p3 p3;
+        k.valid = ge_frombytes_vartime(&p3, &i.pub) == 0;
+        if (k.valid)
+          ge_dsm_precomp(k.precomp, &p3);
+        it = key_index.emplace(i.pub, keys.size() - 1).first;
+      }
+      const key_precomp &k = keys[it->second];
+
+      bool ok = k.valid && sc_check(&i.sig.c) == 0 && sc_check(&i.sig.r) == 0;
+      if (ok) {
+        ge_p2 tmp2;
+        s_comm buf;
+        ec_scalar c;
+        buf.h = i.prefix_hash;
+        buf.key = i.pub;
+        ge_double_scalarmult_base_precomp_vartime(&tmp2, &i.sig.c, k.precomp, &i.sig.r);
+        ge_tobytes(&buf.comm, &tmp2);
+        cn_fast_hash(&buf, sizeof(s_comm), reinterpret_cast<hash &>(c));
+        sc_reduce32(&c);
+        sc_sub(&c, &c, &i.sig.c);
+        ok = sc_isnonzero(&c) == 0;
+      }
+
+      if (results)
+        (*results)[n] = ok;
+      all = all && ok;
+      if (!all && !results)
+        return false;
+    }
+    return all;
+  }
+}
@@ -0,0 +1,70 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "crypto.h"
+#include "hash.h"
+
+namespace crypto {
+
+  /* Checks many signatures (as made by generate_signature) at once, results are
+   * exactly those of check_signature.
+   * These signatures carry (c, r) and the commitment r*G + c*P is rebuilt and
+   * hashed for each of them, so unlike ed25519 they can't be merged into one
+   * multi-scalar check. What a batch saves is the per key work: every distinct
+   * public key is decompressed and precomputed once per batch, which is most
+   * of the time when one auth sample or one supernode signs many messages.
+   */
+  class signature_batch {
+  public:
+    // returns index of the signature in results
+    size_t add(const hash &prefix_hash, const public_key &pub, const signature &sig);
+    size_t size() const { return m_items.size(); }
+    void clear() { m_items.clear(); }
+
+    // true if all are valid, results[i] - result of i-th added signature
+    bool verify(std::vector<bool> &results) const;
+    // stops on first invalid one
+    bool verify() const;
+
+  private:
+    struct item {
+      hash prefix_hash;
+      public_key pub;
+      signature sig;
+    };
+
+    bool verify(std::vector<bool> *results) const;
+
+    std::vector<item> m_items;
+  };
+}
@@ -1,5 +1,4 @@
 #include "blockchain_based_list.h"
-#include "file_io_utils.h"
 #include "serialization/binary_utils.h"
 #include "stake_transaction_processor.h"
 #include "graft_rta_config.h"
@@ -15,29 +14,155 @@ const size_t BLOCKCHAIN_BASED_LISTS_HISTORY_DEPTH   = 1000;
 
 }
 
-BlockchainBasedList::BlockchainBasedList(const std::string& m_storage_file_name, uint64_t first_block_number)
-  : m_storage_file_name(m_storage_file_name)
+BlockchainBasedList::BlockchainBasedList(uint64_t first_block_number)
+  : m_history(BLOCKCHAIN_BASED_LISTS_HISTORY_DEPTH)
+  , m_history_begin()
   , m_block_height(first_block_number)
   , m_history_depth()
   , m_first_block_number(first_block_number)
-  , m_need_store()
 {
-  load();
 }
 
-const BlockchainBasedList::supernode_tier_array& BlockchainBasedList::tiers(size_t depth) const
+const BlockchainBasedList::tier_index_array& BlockchainBasedList::history_tiers(size_t depth) const
+{
+  return m_history[(m_history_begin + m_history_depth - 1 - depth) % m_history.size()];
+}
+
+BlockchainBasedList::supernode_tier_array BlockchainBasedList::tiers(size_t depth) const
 {
   if (depth >= m_history_depth)
     throw std::runtime_error("internal error: attempt to get tier which is not present in a blockchain based list");
 
-  if (!depth)
-    return m_history.back();
+  const tier_index_array& indexes = history_tiers(depth);
+
+  supernode_tier_array result(indexes.size());
+
+  for (size_t i=0; i<indexes.size(); i++)
+  {
+    result[i].reserve(indexes[i]->size());
+
+    for (supernode_index index : *indexes[i])
+      result[i].push_back(m_supernodes[index].value);
+  }
+
+  return result;
+}
+
+BlockchainBasedList::supernode_index BlockchainBasedList::intern_supernode(const supernode& sn)
+{
+  std::vector<supernode_index>& indexes = m_supernode_indexes[sn.supernode_public_id];
+
+  for (supernode_index index : indexes)
+  {
+    interned_supernode& interned = m_supernodes[index];
+
+    if (interned.value.amount == sn.amount && interned.value.block_height == sn.block_height && interned.value.unlock_time == sn.unlock_time &&
+        !memcmp(&interned.value.supernode_public_address, &sn.supernode_public_address, sizeof(sn.supernode_public_address)))
+    {
+      interned.refs++;
+      return index;
+    }
+  }
+
+  supernode_index index;
+
+  if (!m_free_supernodes.empty())
+  {
+    index = m_free_supernodes.back();
+    m_free_supernodes.pop_back();
+  }
+  else
+  {
+    index = static_cast<supernode_index>(m_supernodes.size());
+    m_supernodes.emplace_back();
+  }
+
+  m_supernodes[index].value = sn;
+  m_supernodes[index].refs  = 1;
+
+  indexes.push_back(index);
 
-  list_history::const_reverse_iterator it = m_history.rbegin();
+  return index;
+}
+
+void BlockchainBasedList::release_supernode(supernode_index index)
+{
+  interned_supernode& interned = m_supernodes[index];
+
+  if (--interned.refs)
+    return;
+
+  auto it = m_supernode_indexes.find(interned.value.supernode_public_id);
+
+  if (it != m_supernode_indexes.end())
+  {
+    it->second.erase(std::remove(it->second.begin(), it->second.end(), index), it->second.end());
+
+    if (it->second.empty())
+      m_supernode_indexes.erase(it);
+  }
 
-  std::advance(it, depth);
+  interned.value = supernode();
 
-  return *it;
+  m_free_supernodes.push_back(index);
+}
+
+void BlockchainBasedList::release_tiers(tier_index_array& tiers)
+{
+  for (supernode_index_array_ptr& tier : tiers)
+  {
+      //supernodes are referenced once per distinct array, the array may still be used by a neighbour block
+
+    if (tier.use_count() == 1)
+      for (supernode_index index : *tier)
+        release_supernode(index);
+  }
+
+  tiers.clear();
+}
+
+void BlockchainBasedList::push_history(const supernode_tier_array& tiers)
+{
+  tier_index_array new_tiers;
+
+  new_tiers.reserve(tiers.size());
+
+  const tier_index_array* prev_tiers = m_history_depth ? &history_tiers(0) : nullptr;
+
+  for (size_t i=0; i<tiers.size(); i++)
+  {
+    supernode_index_array indexes;
+
+    indexes.reserve(tiers[i].size());
+
+    for (const supernode& sn : tiers[i])
+      indexes.push_back(intern_supernode(sn));
+
+      //share tier with the previous block if it has not been changed
+
+    if (prev_tiers && i < prev_tiers->size() && *(*prev_tiers)[i] == indexes)
+    {
+      for (supernode_index index : indexes)
+        release_supernode(index);
+
+      new_tiers.push_back((*prev_tiers)[i]);
+      continue;
+    }
+
+    new_tiers.push_back(std::make_shared<const supernode_index_array>(std::move(indexes)));
+  }
+
+  if (m_history_depth == m_history.size())
+  {
+    release_tiers(m_history[m_history_begin]);
+
+    m_history_begin = (m_history_begin + 1) % m_history.size();
+    m_history_depth--;
+  }
+
+  m_history[(m_history_begin + m_history_depth) % m_history.size()].swap(new_tiers);
+
+  m_history_depth++;
 }
 
 void BlockchainBasedList::select_supernodes(size_t items_count, const supernode_array& src_list, supernode_array& dst_list)
@@ -82,14 +207,15 @@ void BlockchainBasedList::apply_block(uint64_t block_height, const crypto::hash&
 
       //prepare lists of valid supernodes for this tier
 
-    if (!m_history.empty())
+    if (m_history_depth && i < history_tiers(0).size())
     {
-      const supernode_array& full_prev_supernodes = m_history.back()[i];
+      const supernode_index_array& full_prev_supernodes = *history_tiers(0)[i];
 
       prev_supernodes.reserve(full_prev_supernodes.size());
 
-      for (const supernode& sn : full_prev_supernodes)
+      for (supernode_index index : full_prev_supernodes)
       {
+        const supernode& sn = m_supernodes[index].value;
         const supernode_stake* stake = stake_txs_storage.find_supernode_stake(block_height, sn.supernode_public_id);
 
         if (!stake || !stake->amount)
@@ -170,19 +296,9 @@ void BlockchainBasedList::apply_block(uint64_t block_height, const crypto::hash&
 
     //update history
 
-  m_history.emplace_back(std::move(new_tier));
-
-  if (m_history_depth < BLOCKCHAIN_BASED_LISTS_HISTORY_DEPTH)
-  {
-    m_history_depth++;
-  }
-  else
-  {
-    m_history.pop_front();
-  }
+  push_history(new_tier);
 
   m_block_height = block_height;
-  m_need_store = true;
 }
 
 void BlockchainBasedList::remove_latest_block()
@@ -190,87 +306,30 @@ void BlockchainBasedList::remove_latest_block()
   if (!m_history_depth)
     return;
 
-  m_need_store = true;
-
   m_block_height--;
-  m_history_depth--;
 
-  m_history.pop_back();
-
-  if (m_history.empty())
-    m_block_height = m_first_block_number;
-}
-
-namespace
-{
+  release_tiers(m_history[(m_history_begin + m_history_depth - 1) % m_history.size()]);
 
-struct blockchain_based_list_container
-{
-  uint64_t block_height;
-  size_t history_depth;
-  BlockchainBasedList::list_history& history;
-
-  blockchain_based_list_container(uint64_t block_height, size_t history_depth, BlockchainBasedList::list_history& history)
-    : block_height(block_height), history_depth(history_depth), history(history) {}
-
-  BEGIN_SERIALIZE_OBJECT()
-    FIELD(block_height)
-    FIELD(history_depth)
-    FIELD(history)
-  END_SERIALIZE()
-};
-
-}
-
-void BlockchainBasedList::store() const
-{
-  blockchain_based_list_container data(m_block_height, m_history_depth, const_cast<list_history&>(m_history));
-
-  std::ofstream ostr;
-  ostr.open(m_storage_file_name, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
-
-  binary_archive<true> oar(ostr);
-
-  bool success = ::serialization::serialize(oar, data);
-
-  ostr.close();
-
-  CHECK_AND_ASSERT_THROW_MES(success && ostr.good(), "Error at save blockchain based list file '" << m_storage_file_name << "'");
+  m_history_depth--;
 
-  m_need_store = false;
+  if (!m_history_depth)
+    m_block_height = m_first_block_number;
 }
 
-void BlockchainBasedList::load()
+void BlockchainBasedList::reset(uint64_t block_height, const list_history& history)
 {
-  if (!boost::filesystem::exists(m_storage_file_name))
-    return;
-
-  std::string buffer;
-  bool r = epee::file_io_utils::load_file_to_string(m_storage_file_name, buffer);
-
-  CHECK_AND_ASSERT_THROW_MES(r, "blockchain based list file '" << m_storage_file_name << "' is not found");
-
-  try
-  {
-    LOG_PRINT_L0("Trying to parse blockchain based list");
+  for (tier_index_array& tiers : m_history)
+    tiers.clear();
 
-    list_history new_history;
-    blockchain_based_list_container data(0, 0, new_history);
+  m_history_begin = 0;
+  m_history_depth = 0;
 
-    r = ::serialization::parse_binary(buffer, data);
+  m_supernodes.clear();
+  m_free_supernodes.clear();
+  m_supernode_indexes.clear();
 
-    CHECK_AND_ASSERT_THROW_MES(r, "internal error: failed to deserialize blockchain based list file '" << m_storage_file_name << "'");
+  for (const supernode_tier_array& tiers : history)
+    push_history(tiers);
 
-    m_block_height  = data.block_height;
-    m_history_depth = data.history_depth;
-
-    std::swap(m_history, data.history);
-
-    m_need_store = false;
-  }
-  catch (...)
-  {
-    LOG_PRINT_L0("Can't parse blockchain based list file '" << m_storage_file_name << "'");
-    throw;
-  }
+  m_block_height = block_height;
 }
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <memory>
 #include <random>
+#include <unordered_map>
 
 #include "blockchain.h"
 #include "cryptonote_core/stake_transaction_storage.h"
@@ -30,13 +32,13 @@ public:
 
   typedef std::vector<supernode>           supernode_array;
   typedef std::vector<supernode_array>     supernode_tier_array;
-  typedef std::list<supernode_tier_array>  list_history;
+  typedef std::list<supernode_tier_array>  list_history; //oldest block first
 
-  /// Constructors
-  BlockchainBasedList(const std::string& file_name, uint64_t first_block_number);
+  /// Constructors (list is kept in memory only, its history is restored with reset)
+  BlockchainBasedList(uint64_t first_block_number);
 
   /// List of tiers
-  const supernode_tier_array& tiers(size_t depth = 0) const;
+  supernode_tier_array tiers(size_t depth = 0) const;
 
   /// Height of the corresponding block
   uint64_t block_height() const { return m_block_height; }
@@ -44,33 +46,58 @@ public:
   /// Number of blocks in history
   uint64_t history_depth() const { return m_history_depth; }
 
+  /// Maximum number of blocks in history
+  size_t max_history_depth() const { return m_history.size(); }
+
   /// Apply new block on top of the list
   void apply_block(uint64_t block_height, const crypto::hash& block_hash, StakeTransactionStorage& stake_txs);
 
   /// Remove latest block
   void remove_latest_block();
 
-  /// Save list to file
-  void store() const;
-
-  /// Is the list requires store
-  bool need_store() const { return m_need_store; }
+  /// Replace content of the list with history restored from elsewhere (oldest block first)
+  void reset(uint64_t block_height, const list_history& history);
 
 private:
-  /// Load list from file
-  void load();
-
   /// Select supernodes from a list
   void select_supernodes(size_t max_items_count, const supernode_array& src_list, supernode_array& dst_list);
 
+  typedef uint32_t                                     supernode_index;
+  typedef std::vector<supernode_index>                 supernode_index_array;
+  typedef std::shared_ptr<const supernode_index_array> supernode_index_array_ptr; //shared between blocks with the same tier
+  typedef std::vector<supernode_index_array_ptr>       tier_index_array;
+
+  struct interned_supernode
+  {
+    supernode value;
+    size_t refs; //number of distinct index arrays with this supernode
+  };
+
+  /// Tiers of the block at the given depth
+  const tier_index_array& history_tiers(size_t depth) const;
+
+  /// Add tiers of the new block to history
+  void push_history(const supernode_tier_array& tiers);
+
+  /// Release tiers of the block removed from history
+  void release_tiers(tier_index_array& tiers);
+
+  /// Find or add supernode to the supernode table
+  supernode_index intern_supernode(const supernode& sn);
+
+  /// Release a reference to supernode in the supernode table
+  void release_supernode(supernode_index index);
+
 private:
-  std::string m_storage_file_name;
-  list_history m_history;
+  std::vector<tier_index_array> m_history; //ring buffer, oldest block at m_history_begin
+  size_t m_history_begin;
+  std::vector<interned_supernode> m_supernodes;
+  std::vector<supernode_index> m_free_supernodes;
+  std::unordered_map<std::string, std::vector<supernode_index> > m_supernode_indexes; //supernode id -> all values with this id
   uint64_t m_block_height;
   size_t m_history_depth;
   std::mt19937_64 m_rng;
   uint64_t m_first_block_number;
-  mutable bool m_need_store;
 };
 
 }
@@ -312,8 +312,13 @@ namespace cryptonote
     // folder might not be a directory, etc, etc
     catch (...) { }
 
-    MGINFO("Initialize stake transaction processor");
-    m_graft_stake_transaction_processor.init_storages(folder.string());
+    // stake processing state is kept in the blockchain database, files of older versions are left unread
+    for (const char* name : {"stake_transactions.v2.bin", "blockchain_based_list.v5.bin"})
+    {
+      boost::system::error_code ec;
+      if (boost::filesystem::exists(folder / name, ec))
+        MGINFO("Stake processing file " << (folder / name).string() << " is not used any more and may be removed");
+    }
 
     BlockchainDB* db = new_db(db_type);
     if (db == NULL)
@@ -1,6 +1,11 @@
+#include <limits>
 #include <string_tools.h>
 
 #include "stake_transaction_processor.h"
+#include "crypto/signature_batch.h"
+#include "common/task_region.h"
+#include "common/thread_group.h"
+#include "serialization/binary_utils.h"
 #include "../graft_rta_config.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
@@ -8,14 +13,6 @@
 
 using namespace cryptonote;
 
-namespace
-{
-
-const char* STAKE_TRANSACTION_STORAGE_FILE_NAME = "stake_transactions.v2.bin";
-const char* BLOCKCHAIN_BASED_LIST_FILE_NAME     = "blockchain_based_list.v5.bin";
-
-}
-
 bool stake_transaction::is_valid(uint64_t block_index) const
 {
   uint64_t stake_first_valid_block = block_height + config::graft::STAKE_VALIDATION_PERIOD,
@@ -34,6 +31,7 @@ StakeTransactionProcessor::StakeTransactionProcessor(Blockchain& blockchain)
   : m_blockchain(blockchain)
   , m_stakes_need_update(true)
   , m_blockchain_based_list_need_update(true)
+  , m_blockchain_based_list_update_depth()
 {
 }
 
@@ -115,16 +113,185 @@ uint64_t get_transaction_amount(const transaction& tx, const account_public_addr
   return received;
 }
 
+/// Parse stake transactions of a block and check them (supernode signatures, unlock time, amount)
+/// Does not touch storages, so blocks may be checked in parallel and out of order
+void get_block_stake_transactions(uint64_t block_index, const std::vector<transaction>& txs, bool testnet,
+  StakeTransactionStorage::stake_transaction_array& block_stake_txs)
+{
+    //supernode signatures of the whole block are checked at once
+
+  struct stake_candidate
+  {
+    const transaction* tx;
+    crypto::hash tx_hash;
+    stake_transaction stake_tx;
+  };
+
+  std::vector<stake_candidate> candidates;
+  crypto::signature_batch signatures;
+
+  for (const transaction& tx : txs)
+  {
+    const crypto::hash tx_hash = get_transaction_prefix_hash(tx);
+
+    try
+    {
+      stake_transaction stake_tx;
+
+      if (!get_graft_stake_tx_extra_from_extra(tx, stake_tx.supernode_public_id, stake_tx.supernode_public_address, stake_tx.supernode_signature, stake_tx.tx_secret_key))
+        continue;
+
+      crypto::public_key W;
+      if (!epee::string_tools::hex_to_pod(stake_tx.supernode_public_id, W) || !check_key(W))
+      {
+        MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash
+          << " because of invalid supernode public identifier '" << stake_tx.supernode_public_id << "'");
+        continue;
+      }
+
+      std::string supernode_public_address_str = cryptonote::get_account_address_as_str(testnet, stake_tx.supernode_public_address);
+      std::string data = supernode_public_address_str + ":" + stake_tx.supernode_public_id;
+      crypto::hash hash;
+      crypto::cn_fast_hash(data.data(), data.size(), hash);
+
+      signatures.add(hash, W, stake_tx.supernode_signature);
+      candidates.push_back({&tx, tx_hash, stake_tx});
+    }
+    catch (std::exception& e)
+    {
+      MWARNING("Ignore transaction at block #" << block_index << ", tx_hash=" << tx_hash << " because of error at parsing: " << e.what());
+    }
+    catch (...)
+    {
+      MWARNING("Ignore transaction at block #" << block_index << ", tx_hash=" << tx_hash << " because of unknown error at parsing");
+    }
+  }
+
+  std::vector<bool> valid_signatures;
+  signatures.verify(valid_signatures);
+
+  for (size_t i = 0; i < candidates.size(); ++i)
+  {
+    const transaction& tx = *candidates[i].tx;
+    const crypto::hash& tx_hash = candidates[i].tx_hash;
+    stake_transaction& stake_tx = candidates[i].stake_tx;
+
+    try
+    {
+      if (!valid_signatures[i])
+      {
+        MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
+          << " because of invalid supernode signature (mismatch)");
+        continue;
+      }
+
+      uint64_t unlock_time = tx.unlock_time - block_index;
+
+      if (unlock_time < config::graft::STAKE_MIN_UNLOCK_TIME)
+      {
+        MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
+          << " because unlock time " << unlock_time << " is less than minimum allowed " << config::graft::STAKE_MIN_UNLOCK_TIME);
+        continue;
+      }
+
+      if (unlock_time > config::graft::STAKE_MAX_UNLOCK_TIME)
+      {
+        MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
+          << " because unlock time " << unlock_time << " is greater than maximum allowed " << config::graft::STAKE_MAX_UNLOCK_TIME);
+        continue;
+      }
+
+      uint64_t amount = get_transaction_amount(tx, stake_tx.supernode_public_address, stake_tx.tx_secret_key);
+
+      if (!amount)
+      {
+        MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
+          << " because of error at parsing amount");
+        continue;
+      }
+
+      stake_tx.amount = amount;
+      stake_tx.block_height = block_index;
+      stake_tx.hash = tx_hash;
+      stake_tx.unlock_time = unlock_time;
+
+      block_stake_txs.push_back(stake_tx);
+
+      MDEBUG("New stake transaction found at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id
+        << "', amount=" << amount / double(COIN));
+    }
+    catch (std::exception& e)
+    {
+      MWARNING("Ignore transaction at block #" << block_index << ", tx_hash=" << tx_hash << " because of error at parsing: " << e.what());
+    }
+    catch (...)
+    {
+      MWARNING("Ignore transaction at block #" << block_index << ", tx_hash=" << tx_hash << " because of unknown error at parsing");
+    }
+  }
 }
 
-void StakeTransactionProcessor::init_storages(const std::string& config_dir)
+/// Block of synchronization which goes through the worker stage of the pipeline
+struct sync_block
 {
-  CRITICAL_REGION_LOCAL1(m_storage_lock);
+  uint64_t block_index;
+  crypto::hash block_hash;
+  bool stake_processing_enabled;
+  std::list<blobdata> tx_blobs;
+  StakeTransactionStorage::stake_transaction_array stake_txs;
+  std::string error;
+};
+
+void prepare_sync_block(sync_block& block, bool testnet)
+{
+  try
+  {
+    std::vector<transaction> txs(block.tx_blobs.size());
+    size_t i = 0;
 
-  if (m_storage || m_blockchain_based_list)
-    throw std::runtime_error("StakeTransactionProcessor storages have been already initialized");
+    for (const blobdata& tx_blob : block.tx_blobs)
+    {
+      if (!parse_and_validate_tx_from_blob(tx_blob, txs[i++]))
+        throw std::runtime_error("Unable to parse transactions for block #" + std::to_string(block.block_index));
+    }
+
+    block.tx_blobs.clear();
+
+    if (block.stake_processing_enabled)
+      get_block_stake_transactions(block.block_index, txs, testnet, block.stake_txs);
+  }
+  catch (const std::exception& e)
+  {
+    block.error = e.what();
+  }
+  catch (...)
+  {
+    block.error = "Unknown error at parsing block #" + std::to_string(block.block_index);
+  }
+}
+
+struct blockchain_based_list_db_record
+{
+  crypto::hash block_hash;
+  BlockchainBasedList::supernode_tier_array tiers;
+
+  BEGIN_SERIALIZE_OBJECT()
+    FIELD(block_hash)
+    FIELD(tiers)
+  END_SERIALIZE()
+};
+
+template <class T> std::string to_blob(const T& value, const char* name)
+{
+  std::string blob;
+
+  bool r = ::serialization::dump_binary(const_cast<T&>(value), blob);
+
+  CHECK_AND_ASSERT_THROW_MES(r, "internal error: failed to serialize " << name);
+
+  return blob;
+}
 
-  m_config_dir = config_dir;
 }
 
 void StakeTransactionProcessor::init_storages_impl()
@@ -139,111 +306,117 @@ void StakeTransactionProcessor::init_storages_impl()
 
   MDEBUG("Initialize stake processing storages. First block height is " << first_block_number);
 
-  m_storage.reset(new StakeTransactionStorage(m_config_dir + "/" + STAKE_TRANSACTION_STORAGE_FILE_NAME, first_block_number));
-  m_blockchain_based_list.reset(new BlockchainBasedList(m_config_dir + "/" + BLOCKCHAIN_BASED_LIST_FILE_NAME, first_block_number));
+  m_storage.reset(new StakeTransactionStorage(first_block_number));
+  m_blockchain_based_list.reset(new BlockchainBasedList(first_block_number));
+
+  if (!load_storages(first_block_number))
+  {
+      //state is missing or does not match the chain, it is rebuilt from the first block
+
+    m_blockchain.get_db().drop_rta_state();
+  }
+
+  m_blockchain.get_db().set_extension(this);
 }
 
-void StakeTransactionProcessor::process_block_stake_transaction(uint64_t block_index, const block& block, const crypto::hash& block_hash, bool update_storage)
+bool StakeTransactionProcessor::load_storages(uint64_t first_block_number)
 {
-  if (block_index <= m_storage->get_last_processed_block_index())
-    return;
+  BlockchainDB& db = m_blockchain.get_db();
+
+    //tiers are stored for the latest processed block, so they tell how far the stored state goes
 
-  if (m_blockchain.get_hard_fork_version(block_index) >= config::graft::STAKE_TRANSACTION_PROCESSING_DB_VERSION)
+  uint64_t last_block_index = 0;
+  std::string last_blob;
+
+  if (!db.get_latest_rta_state(RTA_TIERS, std::numeric_limits<uint64_t>::max(), last_block_index, last_blob))
+    return false;
+
+  if (last_block_index <= first_block_number || last_block_index >= db.height())
   {
-      //analyze block transactions and add new stake transactions if exist
+    MWARNING("Stake processing state at block " << last_block_index << " does not match blockchain with height " << db.height());
+    return false;
+  }
 
-    stake_transaction stake_tx;
+    //blockchain based list history is the run of consecutive blocks ending at the latest block
 
-    std::list<transaction> txs;
-    std::list<crypto::hash> missed_txs;
-    
-    if (!m_blockchain.get_transactions(block.tx_hashes, txs, missed_txs))
-    {
-      MWARNING("Unable to get transactions for block #" << block_index);
-      return;
-    }
+  BlockchainBasedList::list_history history;
+  crypto::hash last_block_hash = null_hash;
+  uint64_t next_block_index = 0;
+  size_t max_history_depth = m_blockchain_based_list->max_history_depth();
+  bool r = true;
 
-    if (!missed_txs.empty())
-    {
-      MWARNING("Some transactions for block #" << block_index << " have been missed:");
+  db.for_rta_states_range(RTA_TIERS, last_block_index - std::min<uint64_t>(last_block_index, max_history_depth - 1), last_block_index, [&](uint64_t block_index, const std::string& blob) {
+    blockchain_based_list_db_record record;
 
-      for (const crypto::hash& tx_hash : missed_txs)
-        MWARNING("  " << tx_hash);
-    }
+    if (!::serialization::parse_binary(blob, record))
+      return r = false;
 
-    for (const transaction& tx : txs)
-    {
-      const crypto::hash tx_hash = get_transaction_prefix_hash(tx);
+    if (next_block_index && block_index != next_block_index)
+      history.clear();
 
-      try
-      {
-        if (!get_graft_stake_tx_extra_from_extra(tx, stake_tx.supernode_public_id, stake_tx.supernode_public_address, stake_tx.supernode_signature, stake_tx.tx_secret_key))
-          continue;
+    history.emplace_back(std::move(record.tiers));
 
-        crypto::public_key W;
-        if (!epee::string_tools::hex_to_pod(stake_tx.supernode_public_id, W) || !check_key(W))
-        {
-          MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash
-            << " because of invalid supernode public identifier '" << stake_tx.supernode_public_id << "'");
-          continue;
-        }
+    last_block_hash  = record.block_hash;
+    next_block_index = block_index + 1;
 
-        std::string supernode_public_address_str = cryptonote::get_account_address_as_str(m_blockchain.testnet(), stake_tx.supernode_public_address);
-        std::string data = supernode_public_address_str + ":" + stake_tx.supernode_public_id;
-        crypto::hash hash;
-        crypto::cn_fast_hash(data.data(), data.size(), hash);
+    return true;
+  });
 
-        if (!crypto::check_signature(hash, W, stake_tx.supernode_signature))
-        {
-          MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
-            << " because of invalid supernode signature (mismatch)");
-          continue;
-        }
+  if (!r || next_block_index != last_block_index + 1 || last_block_hash != db.get_block_hash_from_height(last_block_index))
+  {
+    MWARNING("Stake processing state at block " << last_block_index << " is damaged or belongs to another chain");
+    return false;
+  }
 
-        uint64_t unlock_time = tx.unlock_time - block_index;
+  StakeTransactionStorage::stake_transaction_array stake_txs;
 
-        if (unlock_time < config::graft::STAKE_MIN_UNLOCK_TIME)
-        {
-          MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
-            << " because unlock time " << unlock_time << " is less than minimum allowed " << config::graft::STAKE_MIN_UNLOCK_TIME);
-          continue;
-        }
+  db.for_rta_states_range(RTA_STAKE_TXS, 0, last_block_index, [&](uint64_t block_index, const std::string& blob) {
+    StakeTransactionStorage::stake_transaction_array block_stake_txs;
 
-        if (unlock_time > config::graft::STAKE_MAX_UNLOCK_TIME)
-        {
-          MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
-            << " because unlock time " << unlock_time << " is greater than maximum allowed " << config::graft::STAKE_MAX_UNLOCK_TIME);
-          continue;
-        }
+    if (!::serialization::parse_binary(blob, block_stake_txs))
+      return r = false;
 
-        uint64_t amount = get_transaction_amount(tx, stake_tx.supernode_public_address, stake_tx.tx_secret_key);
+    stake_txs.insert(stake_txs.end(), block_stake_txs.begin(), block_stake_txs.end());
 
-        if (!amount)
-        {
-          MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
-            << " because of error at parsing amount");
-          continue;
-        }
+    return true;
+  });
 
-        stake_tx.amount = amount;
-        stake_tx.block_height = block_index;
-        stake_tx.hash = tx_hash;
-        stake_tx.unlock_time = unlock_time;
+  if (!r)
+  {
+    MWARNING("Stake transactions of stake processing state are damaged");
+    return false;
+  }
 
-        m_storage->add_tx(stake_tx);
+  StakeTransactionStorage::block_hash_list block_hashes;
 
-        MDEBUG("New stake transaction found at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id
-          << "', amount=" << amount / double(COIN));
-      }
-      catch (std::exception& e)
-      {
-        MWARNING("Ignore transaction at block #" << block_index << ", tx_hash=" << tx_hash << " because of error at parsing: " << e.what());
-      }
-      catch (...)
-      {
-        MWARNING("Ignore transaction at block #" << block_index << ", tx_hash=" << tx_hash << " because of unknown error at parsing");
-      }
-    }
+  for (uint64_t i=last_block_index + 1 - history.size(); i<=last_block_index; i++)
+    block_hashes.push_back(db.get_block_hash_from_height(i));
+
+  m_storage->reset(last_block_index, stake_txs, block_hashes);
+  m_blockchain_based_list->reset(last_block_index, history);
+
+  MDEBUG("Stake processing state has been loaded for block " << last_block_index);
+
+  return true;
+}
+
+bool StakeTransactionProcessor::is_stake_processing_enabled(uint64_t block_index) const
+{
+  return m_blockchain.get_hard_fork_version(block_index) >= config::graft::STAKE_TRANSACTION_PROCESSING_DB_VERSION;
+}
+
+void StakeTransactionProcessor::process_block_stake_transaction(uint64_t block_index, const crypto::hash& block_hash, const stake_transaction_array& block_stake_txs)
+{
+  if (block_index <= m_storage->get_last_processed_block_index())
+    return;
+
+  if (is_stake_processing_enabled(block_index))
+  {
+    for (const stake_transaction& stake_tx : block_stake_txs)
+      m_storage->add_tx(stake_tx);
+
+    if (!block_stake_txs.empty())
+      m_blockchain.get_db().add_rta_state(RTA_STAKE_TXS, block_index, to_blob(block_stake_txs, "stake transactions"));
 
     m_stakes_need_update = true; //TODO: cache for stakes
 
@@ -252,96 +425,271 @@ void StakeTransactionProcessor::process_block_stake_transaction(uint64_t block_i
     m_storage->update_supernode_stakes(block_index);
   }
 
-    //update cache entries and save storage
-
   m_storage->add_last_processed_block(block_index, block_hash);
-
-  if (update_storage)
-    m_storage->store();
 }
 
-void StakeTransactionProcessor::process_block_blockchain_based_list(uint64_t block_index, const block& block, const crypto::hash& block_hash, bool update_storage)
+void StakeTransactionProcessor::process_block_blockchain_based_list(uint64_t block_index, const crypto::hash& block_hash, uint64_t top_block_index)
 {
   uint64_t prev_block_height = m_blockchain_based_list->block_height();
 
   m_blockchain_based_list->apply_block(block_index, block_hash, *m_storage);
 
-  if (m_blockchain_based_list->need_store() || prev_block_height != m_blockchain_based_list->block_height())
+  if (prev_block_height == m_blockchain_based_list->block_height())
+    return;
+
+  m_blockchain_based_list_need_update = true;
+  m_blockchain_based_list_update_depth++;
+
+    //only the history which fits to the list is stored, the latest block is always stored as it marks how far the state goes
+
+  size_t max_history_depth = m_blockchain_based_list->max_history_depth();
+
+  if (block_index + max_history_depth > top_block_index)
   {
-    m_blockchain_based_list_need_update = true;
+    BlockchainDB& db = m_blockchain.get_db();
+
+    blockchain_based_list_db_record record;
+
+    record.block_hash = block_hash;
+    record.tiers      = m_blockchain_based_list->tiers();
+
+    db.add_rta_state(RTA_TIERS, block_index, to_blob(record, "blockchain based list"));
 
-    if (update_storage)
-      m_blockchain_based_list->store();
+    if (block_index >= max_history_depth)
+      db.prune_rta_state(RTA_TIERS, block_index + 1 - max_history_depth);
   }
 }
 
-void StakeTransactionProcessor::process_block(uint64_t block_index, const block& block, const crypto::hash& block_hash, bool update_storage)
+void StakeTransactionProcessor::process_block(uint64_t block_index, const crypto::hash& block_hash, const stake_transaction_array& block_stake_txs, uint64_t top_block_index)
 {
-  process_block_stake_transaction(block_index, block, block_hash, update_storage);
-  process_block_blockchain_based_list(block_index, block, block_hash, update_storage);
+  process_block_stake_transaction(block_index, block_hash, block_stake_txs);
+  process_block_blockchain_based_list(block_index, block_hash, top_block_index);
 }
 
-void StakeTransactionProcessor::synchronize()
+void StakeTransactionProcessor::rollback_block(uint64_t block_index)
 {
-  std::unique_lock<epee::critical_section> storage_lock{m_storage_lock, std::defer_lock};
-  std::unique_lock<Blockchain> blockchain_lock{m_blockchain, std::defer_lock};
-  std::lock(storage_lock, blockchain_lock);
+    //drop state which has been partially written for the block, storages are reloaded on the next synchronization
 
-  uint64_t height = m_blockchain.get_current_blockchain_height();
+  try
+  {
+    BlockchainDB& db = m_blockchain.get_db();
 
-  if (!height || m_blockchain.get_hard_fork_version(height - 1) < config::graft::STAKE_TRANSACTION_PROCESSING_DB_VERSION)
-    return;
+    db.remove_rta_state(RTA_STAKE_TXS, block_index);
+    db.remove_rta_state(RTA_TIERS, block_index);
+  }
+  catch (const std::exception& e)
+  {
+    MERROR("Can't remove stake processing state of block " << block_index << ": " << e.what());
+  }
+
+  m_storage.reset();
+  m_blockchain_based_list.reset();
+}
+
+void StakeTransactionProcessor::on_block_added(uint64_t height, const block& blk, const crypto::hash& blk_hash, const std::vector<transaction>& txs)
+{
+  CRITICAL_REGION_LOCAL1(m_storage_lock);
 
   if (!m_storage || !m_blockchain_based_list)
+    return; //storages are not loaded, the block is processed at synchronization
+
+  if (m_storage->get_last_processed_block_index() + 1 != height || m_blockchain_based_list->block_height() + 1 != height)
+    return; //processor is behind the chain, the block is processed at synchronization
+
+  try
   {
-    init_storages_impl();
+    stake_transaction_array block_stake_txs;
+
+    if (is_stake_processing_enabled(height))
+      get_block_stake_transactions(height, txs, m_blockchain.testnet(), block_stake_txs);
+
+    process_block(height, blk_hash, block_stake_txs, height);
+  }
+  catch (const std::exception& e)
+  {
+    MWARNING("Stake transactions processing failed at block " << height << ": " << e.what());
+    rollback_block(height);
   }
+}
 
-    //unroll already processed blocks for alternative chains
-  
-  try
+void StakeTransactionProcessor::on_block_removed(uint64_t height, const block& blk)
+{
+  CRITICAL_REGION_LOCAL1(m_storage_lock);
+
+    //state of the block is removed even if storages are not loaded, so the stored state never goes ahead of the chain
+
+  BlockchainDB& db = m_blockchain.get_db();
+
+  db.remove_rta_state(RTA_STAKE_TXS, height);
+  db.remove_rta_state(RTA_TIERS, height);
+
+  if (!m_storage || !m_blockchain_based_list || m_storage->get_last_processed_block_index() != height)
+    return;
+
+  MWARNING("Stake transactions processing: unroll block " << height);
+
+  m_storage->remove_last_processed_block();
+  m_blockchain_based_list->remove_latest_block();
+
+  m_stakes_need_update = true;
+  m_blockchain_based_list_need_update = true;
+
+  if (m_storage->get_last_processed_block_index() + 1 != height || m_blockchain_based_list->block_height() + 1 != height)
   {
-    while (m_storage->has_last_processed_block())
+      //in-memory history is exhausted, reload storages from database
+
+    m_storage.reset();
+    m_blockchain_based_list.reset();
+  }
+}
+
+uint64_t StakeTransactionProcessor::synchronize_blocks(uint64_t first_block_index, uint64_t end_block_index, uint64_t blockchain_height)
+{
+  static const size_t   SYNC_BATCH_SIZE          = 256;
+  static const uint64_t SYNC_PROGRESS_LOG_PERIOD = 5000; //ms
+
+  const bool testnet = m_blockchain.testnet();
+  const uint64_t top_block_index = end_block_index - 1;
+  uint64_t next_block_index = first_block_index, next_fetch_block_index = first_block_index;
+  size_t stake_txs_count = 0;
+  bool failed = false;
+
+    //blocks are read on this thread only as it owns the database write transaction
+
+  auto fetch_blocks = [&](std::vector<sync_block>& blocks) {
+    blocks.clear();
+
+    for (; next_fetch_block_index < end_block_index && blocks.size() < SYNC_BATCH_SIZE; next_fetch_block_index++)
     {
-      size_t   stake_tx_count = m_storage->get_tx_count();
-      uint64_t last_processed_block_index = m_storage->get_last_processed_block_index();
+      sync_block sync_blk = AUTO_VAL_INIT(sync_blk);
+      block blk;
 
-      if (last_processed_block_index < height)
+      try
       {
-        try
+        sync_blk.block_hash = m_blockchain.get_block_id_by_height(next_fetch_block_index);
+      }
+      catch (BLOCK_DNE&)
+      {
+        //block does not exist, waiting until it will be received
+        end_block_index = next_fetch_block_index;
+        break;
+      }
+
+      if (!m_blockchain.get_block_by_hash(sync_blk.block_hash, blk))
+      {
+        MWARNING("Block with hash " << sync_blk.block_hash << " has not been found");
+        throw std::runtime_error("Error at parsing blockchain. Block hash has not been found");
+      }
+
+      sync_blk.block_index              = next_fetch_block_index;
+      sync_blk.stake_processing_enabled = is_stake_processing_enabled(next_fetch_block_index);
+
+      if (sync_blk.stake_processing_enabled)
+      {
+        std::list<crypto::hash> missed_txs;
+
+        if (!m_blockchain.get_transactions_blobs(blk.tx_hashes, sync_blk.tx_blobs, missed_txs))
+          throw std::runtime_error("Unable to get transactions for block #" + std::to_string(next_fetch_block_index));
+
+        if (!missed_txs.empty())
         {
-          const crypto::hash& last_processed_block_hash  = m_storage->get_last_processed_block_hash();
-          crypto::hash        last_blockchain_block_hash = m_blockchain.get_block_id_by_height(last_processed_block_index);
+          MWARNING("Some transactions for block #" << next_fetch_block_index << " have been missed:");
 
-          if (!memcmp(&last_processed_block_hash.data[0], &last_blockchain_block_hash.data[0], sizeof(last_blockchain_block_hash.data)))
-            break; //latest block hash is the same as processed
+          for (const crypto::hash& tx_hash : missed_txs)
+            MWARNING("  " << tx_hash);
         }
-        catch (BLOCK_DNE&)
+      }
+
+      blocks.emplace_back(std::move(sync_blk));
+    }
+  };
+
+  tools::thread_group workers;
+  std::vector<sync_block> fetched_blocks, prepared_blocks, next_blocks;
+  uint64_t start_time = epee::misc_utils::get_tick_count(), log_time = start_time;
+
+  MDEBUG("RTA block sync " << first_block_index << "/" << blockchain_height << " up to block " << top_block_index << " with " << (workers.count() + 1) << " thread(s)");
+
+  fetch_blocks(fetched_blocks);
+
+  while (!failed && (!fetched_blocks.empty() || !prepared_blocks.empty()))
+  {
+      //workers parse and check the fetched batch while this thread applies the previous batch in order and reads the next one
+
+    tools::task_region(workers, [&](tools::task_region_handle& region) {
+      for (sync_block& sync_blk : fetched_blocks)
+        region.run([&sync_blk, testnet] { prepare_sync_block(sync_blk, testnet); });
+
+      for (const sync_block& sync_blk : prepared_blocks)
+      {
+        if (!sync_blk.error.empty())
+          throw std::runtime_error(sync_blk.error);
+
+        try
+        {
+          process_block(sync_blk.block_index, sync_blk.block_hash, sync_blk.stake_txs, top_block_index);
+        }
+        catch (const std::exception& e)
         {
-          //block does not exist, waiting until it will be received
+          MWARNING("Stake transactions processing failed at block " << sync_blk.block_index << ": " << e.what());
+          rollback_block(sync_blk.block_index);
+          failed = true;
           return;
         }
+
+        stake_txs_count += sync_blk.stake_txs.size();
+        next_block_index = sync_blk.block_index + 1;
       }
-      
-      MWARNING("Stake transactions processing: unroll block " << last_processed_block_index << " (height=" << height << ")");
 
-      m_storage->remove_last_processed_block();
+      fetch_blocks(next_blocks);
+    });
+
+    prepared_blocks.swap(fetched_blocks);
+    fetched_blocks.swap(next_blocks);
 
-      if (stake_tx_count != m_storage->get_tx_count())
-        m_storage->clear_supernode_stakes();
+    uint64_t now = epee::misc_utils::get_tick_count();
 
-      if (m_blockchain_based_list->block_height() == last_processed_block_index)
-        m_blockchain_based_list->remove_latest_block();
+    if (now - log_time >= SYNC_PROGRESS_LOG_PERIOD)
+    {
+      MDEBUG("RTA block sync " << next_block_index << "/" << blockchain_height);
+      log_time = now;
     }
+  }
 
-    //apply new blocks
+  uint64_t blocks_count = next_block_index - first_block_index, duration = epee::misc_utils::get_tick_count() - start_time;
+
+  MINFO("RTA block sync " << next_block_index << "/" << blockchain_height << " (" << (next_block_index * 100 / blockchain_height) << "%): "
+    << blocks_count << " block(s), " << stake_txs_count << " stake transaction(s) in " << duration << " ms, "
+    << (blocks_count * 1000 / (duration + 1)) << " blocks/s");
+
+  return next_block_index;
+}
+
+void StakeTransactionProcessor::synchronize()
+{
+  std::unique_lock<epee::critical_section> storage_lock{m_storage_lock, std::defer_lock};
+  std::unique_lock<Blockchain> blockchain_lock{m_blockchain, std::defer_lock};
+  std::lock(storage_lock, blockchain_lock);
+
+  uint64_t height = m_blockchain.get_current_blockchain_height();
+
+  if (!height || m_blockchain.get_hard_fork_version(height - 1) < config::graft::STAKE_TRANSACTION_PROCESSING_DB_VERSION)
+    return;
+
+  try
+  {
+    if (!m_storage || !m_blockchain_based_list)
+    {
+      init_storages_impl();
+    }
+
+      //apply blocks which have been added before the processor caught up with the chain
 
     uint64_t first_block_index = m_storage->get_last_processed_block_index() + 1;
 
     if (first_block_index > m_blockchain_based_list->block_height() + 1)
       first_block_index = m_blockchain_based_list->block_height() + 1;
 
-    static const uint64_t SYNC_DEBUG_LOG_STEP  = 10000;
     static const uint64_t MAX_ITERATIONS_COUNT = 10000;
 
     uint64_t last_block_index = first_block_index,
@@ -350,36 +698,28 @@ void StakeTransactionProcessor::synchronize()
     if (last_block_index_for_sync - last_block_index > MAX_ITERATIONS_COUNT)
       last_block_index_for_sync = first_block_index + MAX_ITERATIONS_COUNT;
 
-    for (; last_block_index<last_block_index_for_sync; last_block_index++)
+    if (first_block_index < last_block_index_for_sync)
     {
-      if (last_block_index % SYNC_DEBUG_LOG_STEP == 0 || last_block_index == height - 1)
-        MDEBUG("RTA block sync " << last_block_index << "/" << (height - 1));
+      BlockchainDB& db = m_blockchain.get_db();
+
+      db.block_txn_start(false);
 
       try
       {
-        crypto::hash block_hash = m_blockchain.get_block_id_by_height(last_block_index);
-        block block;
-
-        if (!m_blockchain.get_block_by_hash(block_hash, block))
-        {
-          MWARNING("Block with hash " << block_hash << " has not been found");
-          throw std::runtime_error("Error at parsing blockchain. Block hash has not been found");
-        }
+        last_block_index = synchronize_blocks(first_block_index, last_block_index_for_sync, height);
 
-        process_block(last_block_index, block, block_hash, false);
+        db.block_txn_stop();
       }
-      catch (BLOCK_DNE&)
+      catch (...)
       {
-        //block does not exist, waiting until it will be received
-        break;
-      }
-    }
+        db.block_txn_abort();
 
-    if (m_blockchain_based_list->need_store())
-      m_blockchain_based_list->store();
+        m_storage.reset();
+        m_blockchain_based_list.reset();
 
-    if (m_storage->need_store())
-      m_storage->store();
+        throw;
+      }
+    }
 
     if (last_block_index == height)
     {
@@ -387,7 +727,7 @@ void StakeTransactionProcessor::synchronize()
         invoke_update_stakes_handler_impl(last_block_index - 1);
 
       if (m_blockchain_based_list_need_update && m_on_blockchain_based_list_update)
-        invoke_update_blockchain_based_list_handler_impl(last_block_index - first_block_index);
+        invoke_update_blockchain_based_list_handler_impl(m_blockchain_based_list_update_depth);
 
       if (first_block_index != last_block_index)
         MDEBUG("Stake transactions sync OK");
@@ -463,6 +803,7 @@ void StakeTransactionProcessor::invoke_update_blockchain_based_list_handler_impl
       m_on_blockchain_based_list_update(height - i, m_blockchain_based_list->tiers(i));
 
     m_blockchain_based_list_need_update = false;
+    m_blockchain_based_list_update_depth = 0;
   }
   catch (std::exception& e)
   {
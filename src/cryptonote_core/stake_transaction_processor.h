@@ -10,20 +10,24 @@
 namespace cryptonote
 {
 
-class StakeTransactionProcessor
+/// Keeps stake transactions, supernode stakes and blockchain based lists in step with the blockchain
+///
+/// State is stored in the blockchain database in the same write transaction as the block it is derived from,
+/// so restarts and reorganizations do not need a resync pass. Blocks added before the processor caught up
+/// with the chain (for example, after upgrade of an existing database) are processed by synchronize.
+class StakeTransactionProcessor: public BlockchainDBExtension
 {
 public:
   typedef StakeTransactionStorage::supernode_stake_array supernode_stake_array;
 
   StakeTransactionProcessor(Blockchain& blockchain);
 
-  /// Initialize storages
-  void init_storages(const std::string& config_dir);
-
   /// Search supernode stake by supernode public id (returns nullptr if no stake is found)
   const supernode_stake* find_supernode_stake(uint64_t block_number, const std::string& supernode_public_id) const;
 
   /// Synchronize with blockchain
+  /// Blocks behind the chain are parsed and their stake transactions are checked by worker threads out of order,
+  /// while the results are applied to storages in block order on the calling thread
   void synchronize();
 
   typedef std::function<void(uint64_t block_number, const supernode_stake_array&)> supernode_stakes_update_handler;
@@ -43,16 +47,25 @@ public:
   /// Force invoke update handler for blockchain based list
   void invoke_update_blockchain_based_list_handler(bool force = true, size_t depth = 1);
 
+  /// BlockchainDBExtension callbacks, invoked inside the block write transaction
+  void on_block_added(uint64_t height, const block& blk, const crypto::hash& blk_hash, const std::vector<transaction>& txs) override;
+  void on_block_removed(uint64_t height, const block& blk) override;
+
 private:
+  typedef StakeTransactionStorage::stake_transaction_array stake_transaction_array;
+
   void init_storages_impl();
-  void process_block(uint64_t block_index, const block& block, const crypto::hash& block_hash, bool update_storage = true);
+  bool load_storages(uint64_t first_block_number);
+  bool is_stake_processing_enabled(uint64_t block_index) const;
+  uint64_t synchronize_blocks(uint64_t first_block_index, uint64_t last_block_index, uint64_t blockchain_height);
+  void process_block(uint64_t block_index, const crypto::hash& block_hash, const stake_transaction_array& block_stake_txs, uint64_t top_block_index);
+  void rollback_block(uint64_t block_index);
   void invoke_update_stakes_handler_impl(uint64_t block_index);
   void invoke_update_blockchain_based_list_handler_impl(size_t depth);
-  void process_block_stake_transaction(uint64_t block_index, const block& block, const crypto::hash& block_hash, bool update_storage = true);
-  void process_block_blockchain_based_list(uint64_t block_index, const block& block, const crypto::hash& block_hash, bool update_storage = true);
+  void process_block_stake_transaction(uint64_t block_index, const crypto::hash& block_hash, const stake_transaction_array& block_stake_txs);
+  void process_block_blockchain_based_list(uint64_t block_index, const crypto::hash& block_hash, uint64_t top_block_index);
 
 private:
-  std::string m_config_dir;
   Blockchain& m_blockchain;
   std::unique_ptr<StakeTransactionStorage> m_storage;
   std::unique_ptr<BlockchainBasedList> m_blockchain_based_list;
@@ -61,6 +74,7 @@ private:
   blockchain_based_list_update_handler m_on_blockchain_based_list_update;
   bool m_stakes_need_update;
   bool m_blockchain_based_list_need_update;
+  size_t m_blockchain_based_list_update_depth; //number of blocks applied since the last update handler call
 };
 
 }
@@ -1,6 +1,5 @@
 #include "blockchain.h"
 #include "stake_transaction_storage.h"
-#include "file_io_utils.h"
 #include "serialization/binary_utils.h"
 #include "cryptonote_basic/account_boost_serialization.h"
 #include "../graft_rta_config.h"
@@ -16,48 +15,23 @@ namespace
 const uint64_t BLOCK_HASHES_HISTORY_DEPTH       = 1000;
 const uint64_t STAKE_TRANSACTIONS_HISTORY_DEPTH = BLOCK_HASHES_HISTORY_DEPTH + config::graft::STAKE_VALIDATION_PERIOD + config::graft::TRUSTED_RESTAKING_PERIOD;
 
-struct stake_transaction_file_data
-{
-  uint64_t last_processed_block_index;
-  size_t last_processed_block_hashes_count;
-  StakeTransactionStorage::stake_transaction_array& stake_txs;
-  StakeTransactionStorage::block_hash_list& block_hashes;
-
-  stake_transaction_file_data(uint64_t in_last_processed_block_index, StakeTransactionStorage::stake_transaction_array& in_stake_txs,
-    size_t in_last_processed_block_hashes_count, StakeTransactionStorage::block_hash_list& in_block_hashes)
-    : last_processed_block_index(in_last_processed_block_index)
-    , last_processed_block_hashes_count(in_last_processed_block_hashes_count)
-    , stake_txs(in_stake_txs)
-    , block_hashes(in_block_hashes)
-  {
-  }
-
-  BEGIN_SERIALIZE_OBJECT()
-    FIELD(last_processed_block_index)
-    FIELD(last_processed_block_hashes_count)
-    FIELD(block_hashes)
-    FIELD(stake_txs)
-  END_SERIALIZE()
-};
-
 }
 
-StakeTransactionStorage::StakeTransactionStorage(const std::string& storage_file_name, uint64_t first_block_number)
-  : m_storage_file_name(storage_file_name)
-  , m_last_processed_block_index(first_block_number)
+StakeTransactionStorage::StakeTransactionStorage(uint64_t first_block_number)
+  : m_last_processed_block_index(first_block_number)
   , m_last_processed_block_hashes_count()
-  , m_need_store()
   , m_supernode_stakes_update_block_number()
+  , m_stake_index_valid()
   , m_first_block_number(first_block_number)
 {
-  load();
 }
 
 void StakeTransactionStorage::add_tx(const stake_transaction& tx)
 {
   m_stake_txs.push_back(tx);
 
-  m_need_store = true;
+  if (m_stake_index_valid)
+    index_tx(m_stake_txs.size() - 1);
 }
 
 const crypto::hash& StakeTransactionStorage::get_last_processed_block_hash() const
@@ -73,8 +47,6 @@ void StakeTransactionStorage::add_last_processed_block(uint64_t index, const cry
   if (index != m_last_processed_block_index + 1)
     throw std::runtime_error("internal error: new block index must be compared to the already processed block index");
 
-  m_need_store = true;
-
   m_last_processed_block_hashes.push_back(hash);
 
   if (m_last_processed_block_hashes_count < BLOCK_HASHES_HISTORY_DEPTH)
@@ -94,12 +66,15 @@ void StakeTransactionStorage::remove_last_processed_block()
   if (!m_last_processed_block_hashes_count)
     return;
 
-  m_need_store = true;
+  size_t stake_tx_count = m_stake_txs.size();
 
   m_stake_txs.erase(std::remove_if(m_stake_txs.begin(), m_stake_txs.end(), [&](const stake_transaction& tx) {
     return tx.block_height == m_last_processed_block_index;
   }), m_stake_txs.end());
 
+  if (stake_tx_count != m_stake_txs.size())
+    clear_stake_index();
+
   m_last_processed_block_hashes_count--;
   m_last_processed_block_index--;
 
@@ -111,6 +86,8 @@ void StakeTransactionStorage::remove_last_processed_block()
 
     m_stake_txs.clear();
 
+    clear_stake_index();
+
     m_last_processed_block_index = m_first_block_number;
   }
 }
@@ -129,6 +106,18 @@ void StakeTransactionStorage::clear_supernode_stakes()
   m_supernode_stakes_update_block_number = 0;
 }
 
+void StakeTransactionStorage::clear_stake_index()
+{
+  clear_supernode_stakes();
+
+  m_supernode_stake_records.clear();
+  m_supernode_stake_record_indexes.clear();
+  m_stake_events.clear();
+  m_changed_stake_records.clear();
+
+  m_stake_index_valid = false;
+}
+
 namespace
 {
 
@@ -143,206 +132,324 @@ unsigned int get_tier(uint64_t stake)
 
 }
 
-void StakeTransactionStorage::update_supernode_stakes(uint64_t block_number)
+void StakeTransactionStorage::index_tx(size_t tx_index)
 {
-  if (block_number == m_supernode_stakes_update_block_number)
-    return;
+  const stake_transaction& tx = m_stake_txs[tx_index];
 
-  MDEBUG("Build stakes for block " << block_number);
+  supernode_stake_index_map::iterator it = m_supernode_stake_record_indexes.find(tx.supernode_public_id);
 
-  m_supernode_stakes.clear();
-  m_supernode_stake_indexes.clear();
-
-  try
+  if (it == m_supernode_stake_record_indexes.end())
   {
-    m_supernode_stakes.reserve(m_stake_txs.size());
-
-    for (const stake_transaction& tx : m_stake_txs)
-    {
-      bool obsolete_stake = false;
-
-      if (!tx.is_valid(block_number))
-      {
-        uint64_t first_history_block = block_number - config::graft::SUPERNODE_HISTORY_SIZE;
+    supernode_stake_record record;
 
-        if (tx.block_height + tx.unlock_time < first_history_block)
-          continue;
+    record.supernode_public_id = tx.supernode_public_id;
+    record.stake_index         = NO_STAKE_INDEX;
 
-          //add stake transaction with zero amount to indicate correspondent node presense for search in supernode
+    m_supernode_stake_records.emplace_back(std::move(record));
 
-        obsolete_stake = true;
-      }
+    it = m_supernode_stake_record_indexes.emplace(tx.supernode_public_id, m_supernode_stake_records.size() - 1).first;
+  }
 
-      MDEBUG("...use stake transaction " << tx.hash << " as " << (obsolete_stake ? "obsolete" : "normal") << " stake transaction ");
+  size_t record_index = it->second;
 
-        //compute stake validity period
+  m_supernode_stake_records[record_index].tx_indexes.push_back(tx_index);
 
-      uint64_t min_tx_block_height = tx.block_height + config::graft::STAKE_VALIDATION_PERIOD,
-               max_tx_block_height = tx.block_height + tx.unlock_time + config::graft::TRUSTED_RESTAKING_PERIOD;
+    //blocks where the transaction becomes valid, becomes obsolete and leaves supernode history (same arithmetic as in compute_supernode_stake)
 
-        //search for a stake of the corresponding supernode
+  m_stake_events[tx.block_height + config::graft::STAKE_VALIDATION_PERIOD].push_back(record_index);
+  m_stake_events[tx.block_height + tx.unlock_time + config::graft::TRUSTED_RESTAKING_PERIOD].push_back(record_index);
+  m_stake_events[tx.block_height + tx.unlock_time + config::graft::SUPERNODE_HISTORY_SIZE + 1].push_back(record_index);
 
-      supernode_stake_index_map::iterator it = m_supernode_stake_indexes.find(tx.supernode_public_id);
+  m_changed_stake_records.push_back(record_index);
+}
 
-      if (it == m_supernode_stake_indexes.end())
-      {
-          //add new supernode stake
+void StakeTransactionStorage::build_stake_index()
+{
+  m_supernode_stake_records.clear();
+  m_supernode_stake_record_indexes.clear();
+  m_stake_events.clear();
+  m_changed_stake_records.clear();
 
-        supernode_stake new_stake;
+  for (size_t i=0, count=m_stake_txs.size(); i<count; i++)
+    index_tx(i);
 
-        if (obsolete_stake)
-        {
-          new_stake.amount       = 0;
-          new_stake.tier         = 0;
-          new_stake.block_height = 0;
-          new_stake.unlock_time  = 0;
-        }
-        else
-        {
-          new_stake.amount       = tx.amount;
-          new_stake.tier         = get_tier(new_stake.amount);
-          new_stake.block_height = min_tx_block_height;
-          new_stake.unlock_time  = max_tx_block_height - min_tx_block_height;
+  m_changed_stake_records.clear();
 
-          MDEBUG("...first stake transaction for supernode " << tx.supernode_public_id << ": amount=" << tx.amount << ", tier=" <<
-            new_stake.tier << ", validity=[" << min_tx_block_height << ";" << max_tx_block_height << ")");
-        }
+  m_stake_index_valid = true;
+}
 
-        new_stake.supernode_public_id      = tx.supernode_public_id;
-        new_stake.supernode_public_address = tx.supernode_public_address;
+bool StakeTransactionStorage::compute_supernode_stake(const supernode_stake_record& record, uint64_t block_number, supernode_stake& stake) const
+{
+  bool has_stake = false;
 
-        m_supernode_stakes.emplace_back(std::move(new_stake));
+  for (size_t tx_index : record.tx_indexes)
+  {
+    const stake_transaction& tx = m_stake_txs[tx_index];
+    bool obsolete_stake = false;
 
-        m_supernode_stake_indexes[tx.supernode_public_id] = m_supernode_stakes.size() - 1;
+    if (!tx.is_valid(block_number))
+    {
+      uint64_t first_history_block = block_number - config::graft::SUPERNODE_HISTORY_SIZE;
 
+      if (tx.block_height + tx.unlock_time < first_history_block)
         continue;
-      }
 
-        //update existing supernode's stake
+        //add stake transaction with zero amount to indicate correspondent node presense for search in supernode
 
-      if (obsolete_stake)
-        continue; //no need to aggregate fields from obsolete stake
+      obsolete_stake = true;
+    }
 
-      MDEBUG("...accumulate stake transaction for supernode " << tx.supernode_public_id << ": amount=" << tx.amount <<
-        ", validity=[" << min_tx_block_height << ";" << max_tx_block_height << ")");
+      //compute stake validity period
 
-      supernode_stake& stake = m_supernode_stakes[it->second];
+    uint64_t min_tx_block_height = tx.block_height + config::graft::STAKE_VALIDATION_PERIOD,
+             max_tx_block_height = tx.block_height + tx.unlock_time + config::graft::TRUSTED_RESTAKING_PERIOD;
 
-      if (!stake.amount)
-      {
-          //set fields for supernode which has been constructed for obsolete stake
+    if (!has_stake)
+    {
+        //first stake transaction of the supernode
 
+      if (obsolete_stake)
+      {
+        stake.amount       = 0;
+        stake.tier         = 0;
+        stake.block_height = 0;
+        stake.unlock_time  = 0;
+      }
+      else
+      {
         stake.amount       = tx.amount;
         stake.tier         = get_tier(stake.amount);
         stake.block_height = min_tx_block_height;
         stake.unlock_time  = max_tx_block_height - min_tx_block_height;
-
-        continue;
       }
 
-        //aggregate fields for existing stake
+      stake.supernode_public_id      = tx.supernode_public_id;
+      stake.supernode_public_address = tx.supernode_public_address;
+
+      has_stake = true;
+
+      continue;
+    }
+
+    if (obsolete_stake)
+      continue; //no need to aggregate fields from obsolete stake
 
-      stake.amount += tx.amount;
-      stake.tier    = get_tier(stake.amount);
+    if (!stake.amount)
+    {
+        //set fields for supernode which has been constructed for obsolete stake
 
-        //find intersection of stake transaction intervals
+      stake.amount       = tx.amount;
+      stake.tier         = get_tier(stake.amount);
+      stake.block_height = min_tx_block_height;
+      stake.unlock_time  = max_tx_block_height - min_tx_block_height;
 
-      uint64_t min_block_height = stake.block_height,
-               max_block_height = min_block_height + stake.unlock_time;
+      continue;
+    }
 
-      if (min_tx_block_height > min_block_height)
-        min_block_height = min_tx_block_height;
+      //aggregate fields for existing stake
 
-      if (max_tx_block_height < max_block_height)
-        max_block_height = max_tx_block_height;
+    stake.amount += tx.amount;
+    stake.tier    = get_tier(stake.amount);
 
-      if (max_block_height <= min_block_height)
-        max_block_height = min_block_height;
+      //find intersection of stake transaction intervals
 
-      stake.block_height = min_block_height;
-      stake.unlock_time  = max_block_height - min_block_height;
+    uint64_t min_block_height = stake.block_height,
+             max_block_height = min_block_height + stake.unlock_time;
 
-      MDEBUG("...stake for supernode " << tx.supernode_public_id << ": amount=" << stake.amount << ", tier=" << stake.tier <<
-        ", validity=[" << min_block_height << ";" << max_block_height << ")");
+    if (min_tx_block_height > min_block_height)
+      min_block_height = min_tx_block_height;
+
+    if (max_tx_block_height < max_block_height)
+      max_block_height = max_tx_block_height;
+
+    if (max_block_height <= min_block_height)
+      max_block_height = min_block_height;
+
+    stake.block_height = min_block_height;
+    stake.unlock_time  = max_block_height - min_block_height;
+  }
+
+  return has_stake;
+}
+
+void StakeTransactionStorage::update_supernode_stake(supernode_stake_record& record, uint64_t block_number)
+{
+  supernode_stake stake;
+
+  if (compute_supernode_stake(record, block_number, stake))
+  {
+    MDEBUG("...stake for supernode " << record.supernode_public_id << ": amount=" << stake.amount << ", tier=" << stake.tier <<
+      ", validity=[" << stake.block_height << ";" << (stake.block_height + stake.unlock_time) << ")");
+
+    if (record.stake_index != NO_STAKE_INDEX)
+    {
+      m_supernode_stakes[record.stake_index] = std::move(stake);
+      return;
     }
+
+    m_supernode_stakes.emplace_back(std::move(stake));
+
+    record.stake_index = m_supernode_stakes.size() - 1;
+
+    m_supernode_stake_indexes[record.supernode_public_id] = record.stake_index;
+
+    return;
   }
-  catch (...)
+
+  if (record.stake_index == NO_STAKE_INDEX)
+    return;
+
+  MDEBUG("...no stake for supernode " << record.supernode_public_id);
+
+    //move the last stake to the place of removed one
+
+  size_t stake_index = record.stake_index;
+
+  if (stake_index != m_supernode_stakes.size() - 1)
   {
-    m_supernode_stakes.clear();
-    m_supernode_stake_indexes.clear();
+    supernode_stake& last_stake = m_supernode_stakes.back();
 
-    m_supernode_stakes_update_block_number = 0;
+    m_supernode_stake_records[m_supernode_stake_record_indexes[last_stake.supernode_public_id]].stake_index = stake_index;
+    m_supernode_stake_indexes[last_stake.supernode_public_id] = stake_index;
 
-    throw;
+    m_supernode_stakes[stake_index] = std::move(last_stake);
   }
 
-  m_supernode_stakes_update_block_number = block_number;
+  m_supernode_stakes.pop_back();
+  m_supernode_stake_indexes.erase(record.supernode_public_id);
+
+  record.stake_index = NO_STAKE_INDEX;
 }
 
-const supernode_stake* StakeTransactionStorage::find_supernode_stake(uint64_t block_number, const std::string& supernode_public_id)
+void StakeTransactionStorage::rebuild_supernode_stakes(uint64_t block_number)
 {
-  update_supernode_stakes(block_number);
+  MDEBUG("Build stakes for block " << block_number);
 
-  supernode_stake_index_map::const_iterator it = m_supernode_stake_indexes.find(supernode_public_id);
+  m_supernode_stakes.clear();
+  m_supernode_stake_indexes.clear();
 
-  if (it == m_supernode_stake_indexes.end())
-    return nullptr;
+  m_supernode_stakes.reserve(m_supernode_stake_records.size());
+
+  for (supernode_stake_record& record : m_supernode_stake_records)
+  {
+    record.stake_index = NO_STAKE_INDEX;
 
-  return &m_supernode_stakes[it->second];
+    update_supernode_stake(record, block_number);
+  }
 }
 
-void StakeTransactionStorage::load()
+void StakeTransactionStorage::update_supernode_stakes(uint64_t block_number)
 {
-  if (!boost::filesystem::exists(m_storage_file_name))
+  if (block_number == m_supernode_stakes_update_block_number && m_changed_stake_records.empty())
     return;
 
-  std::string buffer;
-  bool r = epee::file_io_utils::load_file_to_string(m_storage_file_name, buffer);
-
-  CHECK_AND_ASSERT_THROW_MES(r, "stake transaction storage file '" << m_storage_file_name << "' is not found");
-
   try
   {
-    LOG_PRINT_L0("Trying to parse stake transaction file");
+    if (!m_stake_index_valid)
+    {
+      build_stake_index();
 
-    StakeTransactionStorage::stake_transaction_array tmp_stake_txs;
-    StakeTransactionStorage::block_hash_list tmp_block_hashes;
-    stake_transaction_file_data data(0, tmp_stake_txs, 0, tmp_block_hashes);
+      m_supernode_stakes_update_block_number = 0;
+    }
+
+    uint64_t prev_block_number = m_supernode_stakes_update_block_number;
+
+    if (!prev_block_number)
+    {
+      rebuild_supernode_stakes(block_number);
+    }
+    else
+    {
+        //only stakes with events between the previous and the new block may change
 
-    r = ::serialization::parse_binary(buffer, data);
+      uint64_t first_block_number = std::min(prev_block_number, block_number),
+               last_block_number  = std::max(prev_block_number, block_number);
 
-    CHECK_AND_ASSERT_THROW_MES(r, "internal error: failed to deserialize stake transaction storage file '" << m_storage_file_name << "'");
+        //obsolete stakes are not counted before the supernode history is filled (see compute_supernode_stake)
 
-    m_last_processed_block_index        = data.last_processed_block_index;
-    m_last_processed_block_hashes_count = data.last_processed_block_hashes_count;
+      bool rebuild = first_block_number < config::graft::SUPERNODE_HISTORY_SIZE && last_block_number >= config::graft::SUPERNODE_HISTORY_SIZE;
 
-    std::swap(m_stake_txs, data.stake_txs);
-    std::swap(m_last_processed_block_hashes, data.block_hashes);
+      for (stake_event_map::const_iterator it=m_stake_events.upper_bound(first_block_number), end=m_stake_events.end(); !rebuild && it!=end && it->first<=last_block_number; ++it)
+      {
+        m_changed_stake_records.insert(m_changed_stake_records.end(), it->second.begin(), it->second.end());
 
-    m_need_store = false;
+        if (m_changed_stake_records.size() >= m_supernode_stake_records.size())
+          rebuild = true;
+      }
+
+      if (rebuild)
+      {
+        rebuild_supernode_stakes(block_number);
+      }
+      else
+      {
+        MDEBUG("Update stakes for block " << block_number << " from block " << prev_block_number);
+
+        std::sort(m_changed_stake_records.begin(), m_changed_stake_records.end());
+
+        m_changed_stake_records.erase(std::unique(m_changed_stake_records.begin(), m_changed_stake_records.end()), m_changed_stake_records.end());
+
+        for (size_t record_index : m_changed_stake_records)
+          update_supernode_stake(m_supernode_stake_records[record_index], block_number);
+      }
+    }
+
+    m_changed_stake_records.clear();
   }
   catch (...)
   {
-    LOG_PRINT_L0("Can't parse stake transaction storage file '" << m_storage_file_name << "'");
+    clear_stake_index();
+
     throw;
   }
+
+  m_supernode_stakes_update_block_number = block_number;
 }
 
-void StakeTransactionStorage::store() const
+const supernode_stake* StakeTransactionStorage::find_supernode_stake(uint64_t block_number, const std::string& supernode_public_id)
 {
-  stake_transaction_file_data data(m_last_processed_block_index, const_cast<stake_transaction_array&>(m_stake_txs),
-    m_last_processed_block_hashes_count, const_cast<block_hash_list&>(m_last_processed_block_hashes));
+  if (block_number == m_supernode_stakes_update_block_number && m_stake_index_valid)
+  {
+    update_supernode_stakes(block_number);
+
+    supernode_stake_index_map::const_iterator it = m_supernode_stake_indexes.find(supernode_public_id);
 
-  std::ofstream ostr;
-  ostr.open(m_storage_file_name, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+    if (it == m_supernode_stake_indexes.end())
+      return nullptr;
 
-  binary_archive<true> oar(ostr);
+    return &m_supernode_stakes[it->second];
+  }
+
+    //stake for another block is computed from transactions of the supernode, current stakes are kept
+
+  if (!m_stake_index_valid)
+  {
+    build_stake_index();
+
+    m_supernode_stakes_update_block_number = 0;
+  }
+
+  supernode_stake_index_map::const_iterator it = m_supernode_stake_record_indexes.find(supernode_public_id);
+
+  if (it == m_supernode_stake_record_indexes.end())
+    return nullptr;
+
+  if (!compute_supernode_stake(m_supernode_stake_records[it->second], block_number, m_found_stake))
+    return nullptr;
+
+  return &m_found_stake;
+}
+
+void StakeTransactionStorage::reset(uint64_t last_processed_block_index, stake_transaction_array& stake_txs, block_hash_list& block_hashes)
+{
+  while (block_hashes.size() > BLOCK_HASHES_HISTORY_DEPTH)
+    block_hashes.pop_front();
 
-  bool success = ::serialization::serialize(oar, data);
+  m_last_processed_block_index        = last_processed_block_index;
+  m_last_processed_block_hashes_count = block_hashes.size();
 
-  ostr.close();
-  
-  CHECK_AND_ASSERT_THROW_MES(success && ostr.good(), "Error at save stake transaction storage file '" << m_storage_file_name << "'");
+  std::swap(m_stake_txs, stake_txs);
+  std::swap(m_last_processed_block_hashes, block_hashes);
 
-  m_need_store = false;
+  clear_stake_index();
 }
@@ -2,6 +2,7 @@
 
 #include <cryptonote_config.h>
 #include <list>
+#include <map>
 #include <unordered_map>
 
 #include "crypto/hash.h"
@@ -44,6 +45,15 @@ struct supernode_stake
   uint64_t unlock_time;
   std::string supernode_public_id;
   cryptonote::account_public_address supernode_public_address;
+
+  BEGIN_SERIALIZE_OBJECT()
+    FIELD(amount)
+    VARINT_FIELD(tier)
+    FIELD(block_height)
+    FIELD(unlock_time)
+    FIELD(supernode_public_id)
+    FIELD(supernode_public_address)
+  END_SERIALIZE()
 };
 
 class StakeTransactionStorage
@@ -53,7 +63,8 @@ public:
   typedef std::list<crypto::hash>        block_hash_list;
   typedef std::vector<supernode_stake>   supernode_stake_array;
 
-  StakeTransactionStorage(const std::string& storage_file_name, uint64_t first_block_number);
+  /// Storage is kept in memory only, its state is restored with reset
+  StakeTransactionStorage(uint64_t first_block_number);
 
   /// Get number of transactions
   size_t get_tx_count() const { return m_stake_txs.size(); }
@@ -83,6 +94,7 @@ public:
   const supernode_stake_array& get_supernode_stakes(uint64_t block_number);
 
   /// Search supernode stake by supernode public id (returns nullptr if no stake is found)
+  /// Result is valid until the next call of find_supernode_stake or update_supernode_stakes
   const supernode_stake* find_supernode_stake(uint64_t block_number, const std::string& supernode_public_id);
 
   /// Update supernode stakes
@@ -91,20 +103,44 @@ public:
   /// Clear supernode stakes
   void clear_supernode_stakes();
 
-  /// Save storage to file
-  void store() const;
-
-  /// Is the list requires store
-  bool need_store() const { return m_need_store; }
+  /// Replace content of the storage with state restored from elsewhere (arguments are moved from)
+  void reset(uint64_t last_processed_block_index, stake_transaction_array& stake_txs, block_hash_list& block_hashes);
 
 private:
-  /// Load storage from file
-  void load();
-
   typedef std::unordered_map<std::string, size_t> supernode_stake_index_map;
 
+  /// Stake transactions of one supernode
+  struct supernode_stake_record
+  {
+    std::string supernode_public_id;
+    std::vector<size_t> tx_indexes; //indexes in m_stake_txs in order of addition
+    size_t stake_index; //index in m_supernode_stakes or NO_STAKE_INDEX
+  };
+
+  typedef std::vector<supernode_stake_record>          supernode_stake_record_array;
+  typedef std::map<uint64_t, std::vector<size_t> >      stake_event_map; //block number -> records which stake may change at this block
+
+  static const size_t NO_STAKE_INDEX = size_t(-1);
+
+  /// Clear supernode stakes with records and events (after stake transactions are removed)
+  void clear_stake_index();
+
+  /// Rebuild records and events from stake transactions
+  void build_stake_index();
+
+  /// Add stake transaction to records and events
+  void index_tx(size_t tx_index);
+
+  /// Compute stake of the supernode for the block (returns false if supernode has no stake for this block)
+  bool compute_supernode_stake(const supernode_stake_record& record, uint64_t block_number, supernode_stake& stake) const;
+
+  /// Recompute stake of the supernode and update m_supernode_stakes
+  void update_supernode_stake(supernode_stake_record& record, uint64_t block_number);
+
+  /// Recompute stakes of all supernodes
+  void rebuild_supernode_stakes(uint64_t block_number);
+
 private:
-  std::string m_storage_file_name;
   uint64_t m_last_processed_block_index;
   block_hash_list m_last_processed_block_hashes;
   size_t m_last_processed_block_hashes_count;
@@ -112,8 +148,13 @@ private:
   uint64_t m_supernode_stakes_update_block_number;
   supernode_stake_array m_supernode_stakes;
   supernode_stake_index_map m_supernode_stake_indexes;
+  supernode_stake_record_array m_supernode_stake_records;
+  supernode_stake_index_map m_supernode_stake_record_indexes;
+  stake_event_map m_stake_events;
+  std::vector<size_t> m_changed_stake_records;
+  bool m_stake_index_valid;
+  supernode_stake m_found_stake;
   uint64_t m_first_block_number;
-  mutable bool m_need_store;
 };
 
 }
@@ -40,6 +40,7 @@
 
 #include "math_helper.h"
 #include "storages/levin_abstract_invoke2.h"
+#include "net/traffic_metrics.h"
 #include "warnings.h"
 #include "cryptonote_protocol_defs.h"
 #include "cryptonote_protocol_handler_common.h"
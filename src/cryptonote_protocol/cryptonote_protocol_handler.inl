@@ -74,6 +74,15 @@ namespace cryptonote
   template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::init(const boost::program_options::variables_map& vm)
   {
+    epee::net_utils::levin_traffic_metrics &metrics = epee::net_utils::get_levin_metrics();
+    metrics.set_name(int(NOTIFY_NEW_BLOCK::ID), "new_block");
+    metrics.set_name(int(NOTIFY_NEW_TRANSACTIONS::ID), "new_transactions");
+    metrics.set_name(int(NOTIFY_REQUEST_GET_OBJECTS::ID), "request_get_objects");
+    metrics.set_name(int(NOTIFY_RESPONSE_GET_OBJECTS::ID), "response_get_objects");
+    metrics.set_name(int(NOTIFY_REQUEST_CHAIN::ID), "request_chain");
+    metrics.set_name(int(NOTIFY_RESPONSE_CHAIN_ENTRY::ID), "response_chain_entry");
+    metrics.set_name(int(NOTIFY_NEW_FLUFFY_BLOCK::ID), "new_fluffy_block");
+    metrics.set_name(int(NOTIFY_REQUEST_FLUFFY_MISSING_TX::ID), "request_fluffy_missing_tx");
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------
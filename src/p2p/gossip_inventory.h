@@ -0,0 +1,180 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace nodetool
+{
+  /**
+   * \brief gossip_inventory - bodies of relayed RTA messages for inventory-first gossip
+   *
+   * A relayed message is serialized once and the buffer is shared by every peer
+   * pulling it. Bodies are kept for ttl and at most max_bytes in total, oldest
+   * first out. Also tracks bodies requested from peers so an id offered by several
+   * peers is pulled once, unless the pull doesn't complete within pull_timeout.
+   */
+  class gossip_inventory
+  {
+  public:
+    typedef std::chrono::steady_clock clock;
+    typedef std::shared_ptr<const std::string> blob_ptr;
+
+    gossip_inventory(std::chrono::milliseconds ttl, size_t max_bytes, std::chrono::milliseconds pull_timeout)
+      : m_ttl(ttl), m_max_bytes(max_bytes), m_pull_timeout(pull_timeout), m_bytes(0)
+    {
+    }
+
+    void put(const std::string &message_id, int command, const blob_ptr &blob)
+    {
+      put(message_id, command, blob, clock::now());
+    }
+
+    void put(const std::string &message_id, int command, const blob_ptr &blob, clock::time_point now)
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      expire(now);
+      m_pulls.erase(message_id);
+      if (!m_bodies.emplace(message_id, body{command, blob}).second)
+        return;
+      m_order.push_back(entry{message_id, now});
+      m_bytes += blob->size();
+      while (m_bytes > m_max_bytes && !m_order.empty())
+        pop_oldest();
+    }
+
+    bool get(const std::string &message_id, int &command, blob_ptr &blob)
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      auto it = m_bodies.find(message_id);
+      if (it == m_bodies.end())
+        return false;
+      command = it->second.command;
+      blob = it->second.blob;
+      return true;
+    }
+
+    /**
+     * \brief want - called for an offered id we haven't seen
+     * \return true if the body should be requested now
+     */
+    bool want(const std::string &message_id)
+    {
+      return want(message_id, clock::now());
+    }
+
+    bool want(const std::string &message_id, clock::time_point now)
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      if (m_bodies.count(message_id))
+        return false;
+      // peers offering ids that are never delivered can't grow it forever
+      if (m_pulls.size() >= MAX_PENDING_PULLS)
+        expire_pulls(now);
+      auto it = m_pulls.find(message_id);
+      if (it != m_pulls.end() && it->second + m_pull_timeout > now)
+        return false;
+      if (m_pulls.size() >= MAX_PENDING_PULLS)
+        return false;
+      m_pulls[message_id] = now;
+      return true;
+    }
+
+    size_t size()
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      return m_bodies.size();
+    }
+
+    size_t bytes()
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      return m_bytes;
+    }
+
+    static constexpr size_t MAX_PENDING_PULLS = 16 * 1024;
+
+  private:
+    struct body
+    {
+      int command;
+      blob_ptr blob;
+    };
+
+    struct entry
+    {
+      std::string message_id;
+      clock::time_point added;
+    };
+
+    void expire(clock::time_point now)
+    {
+      while (!m_order.empty() && m_order.front().added + m_ttl < now)
+        pop_oldest();
+    }
+
+    void expire_pulls(clock::time_point now)
+    {
+      for (auto it = m_pulls.begin(); it != m_pulls.end();)
+      {
+        if (it->second + m_pull_timeout <= now)
+          it = m_pulls.erase(it);
+        else
+          ++it;
+      }
+    }
+
+    void pop_oldest()
+    {
+      auto it = m_bodies.find(m_order.front().message_id);
+      if (it != m_bodies.end())
+      {
+        m_bytes -= it->second.blob->size();
+        m_bodies.erase(it);
+      }
+      m_order.pop_front();
+    }
+
+    const clock::duration m_ttl;
+    const size_t m_max_bytes;
+    const clock::duration m_pull_timeout;
+    boost::mutex m_lock;
+    std::unordered_map<std::string, body> m_bodies;
+    std::deque<entry> m_order;
+    std::unordered_map<std::string, clock::time_point> m_pulls;
+    size_t m_bytes;
+  };
+}
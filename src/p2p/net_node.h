@@ -54,7 +54,13 @@
 #include "net_node_common.h"
 #include "common/command_line.h"
 #include "net/jsonrpc_structs.h"
+#include "net/traffic_metrics.h"
 #include "storages/http_abstract_invoke.h"
+#include "gossip_inventory.h"
+#include "request_cache.h"
+#include "supernode_forwarder.h"
+#include "supernode_list_feed.h"
+#include "supernode_route_table.h"
 
 #include <map>
 #include <set>
@@ -79,15 +85,30 @@ namespace nodetool
     bool m_in_timedsync;
   };
 
+  // position of a local supernode in a binary delta feed
+  struct supernode_feed_state {
+    uint32_t version = 0; // 0 - full JSON push on every block
+    uint64_t block_height = 0; // last block pushed
+    std::shared_ptr<std::atomic<bool>> failed = std::make_shared<std::atomic<bool>>(false); // a push was lost, next one is full
+  };
+
   struct local_supernode {
-    local_supernode(std::string host, uint64_t port, std::string uri) : http_host(std::move(host)), http_port(port), uri(std::move(uri)) {
-        client.set_server(http_host, std::to_string(http_port), {});
+    local_supernode(std::string host, uint64_t port, std::string uri, size_t queue_size)
+        : http_host(std::move(host)), http_port(port), uri(std::move(uri)),
+          forwarder(supernode_forwarder::create(http_host, http_port, queue_size)) {
+    }
+
+    local_supernode(const local_supernode&) = delete;
+    local_supernode& operator=(const local_supernode&) = delete;
+
+    ~local_supernode() {
+        // don't wait for the request in flight, caller may hold m_supernode_lock
+        forwarder->stop(false);
     }
 
     void update(const std::string &new_host, uint64_t new_port, const std::string &new_uri) {
         if (new_host != http_host || new_port != http_port) {
-            if (client.is_connected()) client.disconnect();
-            client.set_server(new_host, std::to_string(new_port), {});
+            forwarder->set_server(new_host, new_port);
             http_host = new_host;
             http_port = new_port;
             uri = new_uri;
@@ -97,7 +118,9 @@ namespace nodetool
     std::string http_host;
     uint64_t http_port;
     std::string uri;
-    epee::net_utils::http::http_simple_client client;
+    std::shared_ptr<supernode_forwarder> forwarder;
+    supernode_feed_state list_feed;
+    supernode_feed_state stakes_feed;
   };
 
   template<class t_payload_net_handler>
@@ -126,7 +149,12 @@ namespace nodetool
     m_offline(false),
     m_save_graph(false),
     is_closing(false),
-    m_net_server( epee::net_utils::e_connection_type_P2P ) // this is a P2P connection of the main p2p node server, because this is class node_server<>
+    m_net_server( epee::net_utils::e_connection_type_P2P ), // this is a P2P connection of the main p2p node server, because this is class node_server<>
+    m_request_cache(REQUEST_CACHE_TIME_MILLIS, REQUEST_CACHE_MAX_ENTRIES),
+    m_supernode_routes(DIFFICULTY_TARGET_V2),
+    m_rta_gossip_fanout(0),
+    m_gossip_inventory(std::chrono::milliseconds(uint64_t(REQUEST_CACHE_TIME_MILLIS)), size_t(GOSSIP_INVENTORY_MAX_BYTES),
+                       std::chrono::milliseconds(uint64_t(GOSSIP_PULL_TIMEOUT_MILLIS)))
     {}
     virtual ~node_server()
     {}
@@ -205,6 +233,8 @@ namespace nodetool
       HANDLE_NOTIFY_T2(COMMAND_BROADCAST, &node_server::handle_broadcast)
       HANDLE_NOTIFY_T2(COMMAND_MULTICAST, &node_server::handle_multicast)
       HANDLE_NOTIFY_T2(COMMAND_UNICAST, &node_server::handle_unicast)
+      HANDLE_NOTIFY_T2(COMMAND_RTA_INVENTORY, &node_server::handle_rta_inventory)
+      HANDLE_NOTIFY_T2(COMMAND_RTA_GET_BODIES, &node_server::handle_rta_get_bodies)
 
       HANDLE_INVOKE_T2(COMMAND_HANDSHAKE, &node_server::handle_handshake)
       HANDLE_INVOKE_T2(COMMAND_TIMED_SYNC, &node_server::handle_timed_sync)
@@ -228,28 +258,83 @@ namespace nodetool
 
     // sometimes supernode gets very busy so it doesn't respond within 1 second, increasing timeout to 3s
     static constexpr size_t SUPERNODE_HTTP_TIMEOUT_MILLIS = 3 * 1000;
+    // requests queued per local supernode before new ones are dropped
+    static constexpr size_t SUPERNODE_FORWARD_QUEUE_SIZE = 256;
+    // broadcast/multicast/unicast message ids are remembered this long to drop duplicates
+    static constexpr uint64_t REQUEST_CACHE_TIME_MILLIS = 2 * 60 * 1000;
+    static constexpr size_t REQUEST_CACHE_MAX_ENTRIES = 256 * 1024;
+    // gossip mode: relayed bodies kept for pulls, and how long a pull may take before asking another peer
+    static constexpr size_t GOSSIP_INVENTORY_MAX_BYTES = 64 * 1024 * 1024;
+    static constexpr uint64_t GOSSIP_PULL_TIMEOUT_MILLIS = 2 * 1000;
+    static constexpr size_t GOSSIP_MAX_PULL_IDS = 256;
+
+    /**
+     * \brief gossip_rta_message - in gossip mode stores the serialized message and offers its id
+     *        to rta-gossip-fanout random peers, peers without gossip support get the body
+     * \param source - connection the message came from, not offered to
+     * \return false if gossip mode is off and caller has to flood the message
+     */
+    bool gossip_rta_message(const rta_inventory_item &item, const gossip_inventory::blob_ptr &blob,
+                            const boost::uuids::uuid &source, std::atomic<uint64_t> &bytes_out);
+
+    // names levin commands in the traffic metrics
+    void register_command_names();
+
+    /**
+     * \brief post_request_to_supernode - queues request to the supernode's forwarder,
+     *        actual http call is done by the forwarder thread
+     * \return 1 if request was queued, 0 if it was dropped
+     */
     template<class request_struct>
     int post_request_to_supernode(local_supernode &supernode, const std::string &method, const typename request_struct::request &body,
                                   const std::string &endpoint = std::string())
     {
-        boost::value_initialized<epee::json_rpc::request<typename request_struct::request> > init_req;
-        epee::json_rpc::request<typename request_struct::request>& req = static_cast<epee::json_rpc::request<typename request_struct::request> &>(init_req);
+        typedef epee::json_rpc::request<typename request_struct::request> json_request;
+        boost::value_initialized<json_request> init_req;
+        json_request& req = static_cast<json_request &>(init_req);
         req.jsonrpc = "2.0";
         req.id = 0;
         req.method = method;
         req.params = body;
 
-        std::string uri = "/" + method;
-        if (!endpoint.empty())
+        std::string uri = supernode.uri + (endpoint.empty() ? "/" + method : endpoint);
+        bool r = supernode.forwarder->post([req, uri](epee::net_utils::http::http_simple_client &client) {
+            typename request_struct::response resp = AUTO_VAL_INIT(resp);
+            bool r = epee::net_utils::invoke_http_json(uri, req, resp, client,
+                                                       std::chrono::milliseconds(size_t(SUPERNODE_HTTP_TIMEOUT_MILLIS)), "POST");
+            return r && resp.status != 0;
+        });
+        if (!r)
         {
-            uri = endpoint;
+            MWARNING("Supernode " << supernode.http_host << ":" << supernode.http_port << " forwarding queue is full, " << method << " dropped");
+            return 0;
         }
-        typename request_struct::response resp = AUTO_VAL_INIT(resp);
-        bool r = epee::net_utils::invoke_http_json(supernode.uri + uri,
-                                                   req, resp, supernode.client,
-                                                   std::chrono::milliseconds(size_t(SUPERNODE_HTTP_TIMEOUT_MILLIS)), "POST");
-        if (!r || resp.status == 0)
+        return 1;
+    }
+
+    /**
+     * \brief post_blob_to_supernode - queues binary POST to the supernode's forwarder
+     * \param failed - set if the request is dropped or fails
+     * \return 1 if request was queued, 0 if it was dropped
+     */
+    int post_blob_to_supernode(local_supernode &supernode, const std::string &method, const supernode_list_encoder::blob_ptr &blob,
+                               const std::shared_ptr<std::atomic<bool>> &failed)
+    {
+        std::string uri = supernode.uri + "/" + method;
+        bool r = supernode.forwarder->post([blob, uri, failed](epee::net_utils::http::http_simple_client &client) {
+            const epee::net_utils::http::http_response_info *info = nullptr;
+            epee::net_utils::http::fields_list fields;
+            fields.emplace_back("Content-Type", "application/octet-stream");
+            bool r = client.invoke(uri, "POST", *blob, std::chrono::milliseconds(size_t(SUPERNODE_HTTP_TIMEOUT_MILLIS)), &info, fields) &&
+                     info && info->m_response_code == 200;
+            if (!r)
+                *failed = true;
+            return r;
+        });
+        if (!r)
         {
+            *failed = true;
+            MWARNING("Supernode " << supernode.http_host << ":" << supernode.http_port << " forwarding queue is full, " << method << " dropped");
             return 0;
         }
         return 1;
@@ -265,13 +350,13 @@ namespace nodetool
         return ret;
     }
 
-    void remove_old_request_cache();
-
     //----------------- commands handlers ----------------------------------------------
     int handle_supernode_announce(int command, typename COMMAND_SUPERNODE_ANNOUNCE::request& arg, p2p_connection_context& context);
     int handle_broadcast(int command, typename COMMAND_BROADCAST::request &arg, p2p_connection_context &context);
     int handle_multicast(int command, typename COMMAND_MULTICAST::request &arg, p2p_connection_context &context);
     int handle_unicast(int command, typename COMMAND_UNICAST::request &arg, p2p_connection_context &context);
+    int handle_rta_inventory(int command, typename COMMAND_RTA_INVENTORY::request &arg, p2p_connection_context &context);
+    int handle_rta_get_bodies(int command, typename COMMAND_RTA_GET_BODIES::request &arg, p2p_connection_context &context);
     int handle_handshake(int command, typename COMMAND_HANDSHAKE::request& arg, typename COMMAND_HANDSHAKE::response& rsp, p2p_connection_context& context);
     int handle_timed_sync(int command, typename COMMAND_TIMED_SYNC::request& arg, typename COMMAND_TIMED_SYNC::response& rsp, p2p_connection_context& context);
     int handle_ping(int command, COMMAND_PING::request& arg, COMMAND_PING::response& rsp, p2p_connection_context& context);
@@ -414,12 +499,34 @@ namespace nodetool
             LOG_PRINT_L0("Adding supernode " << addr << " at " << parsed.host << ":" << parsed.port);
             m_supernodes.emplace(std::piecewise_construct,
                     std::forward_as_tuple(addr),
-                    std::forward_as_tuple(std::move(parsed.host), parsed.port, std::move(parsed.uri)));
+                    std::forward_as_tuple(std::move(parsed.host), parsed.port, std::move(parsed.uri), size_t(SUPERNODE_FORWARD_QUEUE_SIZE)));
         } else {
             it->second.update(parsed.host, parsed.port, parsed.uri);
         }
     }
 
+    // version 0 switches the supernode back to full JSON pushes
+    void set_supernode_list_feed_version(const std::string& addr, uint32_t version)
+    {
+        set_supernode_feed_version(addr, &local_supernode::list_feed, version);
+    }
+
+    void set_supernode_stakes_feed_version(const std::string& addr, uint32_t version)
+    {
+        set_supernode_feed_version(addr, &local_supernode::stakes_feed, version);
+    }
+
+    void set_supernode_feed_version(const std::string& addr, supernode_feed_state local_supernode::*feed, uint32_t version)
+    {
+        version = std::min(version, uint32_t(supernode_list_encoder::FEED_VERSION));
+        boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+        auto it = m_supernodes.find(addr);
+        if (it == m_supernodes.end() || (it->second.*feed).version == version)
+            return;
+        it->second.*feed = supernode_feed_state();
+        (it->second.*feed).version = version;
+    }
+
     std::vector<std::string> get_supernodes_addresses() {
         boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
         std::vector<std::string> addrs;
@@ -451,6 +558,16 @@ namespace nodetool
         m_supernodes.clear();
     }
 
+    std::vector<std::pair<std::string, supernode_forward_stats>> get_supernode_forward_stats() {
+        boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+        std::vector<std::pair<std::string, supernode_forward_stats>> stats;
+        stats.reserve(m_supernodes.size());
+        for (auto &sn : m_supernodes) {
+            stats.emplace_back(sn.first, sn.second.forwarder->get_stats());
+        }
+        return stats;
+    }
+
     bool notify_peer_list(int command, const std::string& buf, const std::vector<peerlist_entry>& peers_to_send, bool try_connect = false);
 
     void send_stakes_to_supernode();
@@ -462,18 +579,27 @@ namespace nodetool
     uint64_t get_broadcast_bytes_out() const { return m_broadcast_bytes_out; }
     uint64_t get_multicast_bytes_in() const { return m_multicast_bytes_in; }
     uint64_t get_multicast_bytes_out() const { return m_multicast_bytes_out; }
+    request_cache_stats get_request_cache_stats() { return m_request_cache.get_stats(); }
+    uint64_t get_gossip_bytes_in() const { return m_gossip_bytes_in; }
+    uint64_t get_gossip_bytes_out() const { return m_gossip_bytes_out; }
+    size_t get_gossip_inventory_size() { return m_gossip_inventory.size(); }
 
   private:
     void handle_stakes_update(uint64_t block_number, const cryptonote::StakeTransactionProcessor::supernode_stake_array& stakes);
+    void push_stakes(uint64_t block_number, const cryptonote::StakeTransactionProcessor::supernode_stake_array& stakes);
+    void push_blockchain_based_list(uint64_t block_number, const cryptonote::StakeTransactionProcessor::supernode_tier_array& tiers);
     void handle_blockchain_based_list_update(uint64_t block_number, const cryptonote::StakeTransactionProcessor::supernode_tier_array& tiers);
 
   private:
-    std::multimap<int, std::string> m_supernode_requests_timestamps;
-    std::set<std::string> m_supernode_requests_cache;
-    std::map<std::string, nodetool::supernode_route> m_supernode_routes;
+    request_cache m_request_cache;
+    supernode_route_table m_supernode_routes;
+    uint32_t m_rta_gossip_fanout;
+    gossip_inventory m_gossip_inventory;
     std::unordered_map<std::string, local_supernode> m_supernodes;
     boost::recursive_mutex m_supernode_lock;
-    boost::recursive_mutex m_request_cache_lock;
+    std::unique_ptr<supernode_list_encoder> m_supernode_list_encoder;
+    // declared after everything its jobs use
+    supernode_feed_worker m_supernode_feed;
     std::vector<epee::net_utils::network_address> m_custom_seed_nodes;
 
     std::string m_config_folder;
@@ -531,6 +657,9 @@ namespace nodetool
     std::atomic<uint64_t> m_broadcast_bytes_out {0};
     std::atomic<uint64_t> m_multicast_bytes_in {0};
     std::atomic<uint64_t> m_multicast_bytes_out {0};
+    // gossip inventory and pull requests, bodies are counted by their type above
+    std::atomic<uint64_t> m_gossip_bytes_in {0};
+    std::atomic<uint64_t> m_gossip_bytes_out {0};
 
 
 
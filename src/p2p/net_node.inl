@@ -75,7 +75,6 @@
 #define MIN_WANTED_SEED_NODES 12
 
 #define MAX_TUNNEL_PEERS (3u)
-#define REQUEST_CACHE_TIME 2 * 60 * 1000
 #define HOP_RETRIES_MULTIPLIER 2
 
 namespace nodetool
@@ -114,6 +113,7 @@ namespace nodetool
     const command_line::arg_descriptor<int64_t> arg_limit_rate = {"limit-rate", "set limit-rate [kB/s]", -1};
 
     const command_line::arg_descriptor<bool> arg_save_graph = {"save-graph", "Save data for dr monero", false};
+    const command_line::arg_descriptor<uint32_t> arg_rta_gossip_fanout = {"rta-gossip-fanout", "Offer RTA broadcasts and supernode announces to this many random peers by id, peers pull the messages they lack. 0 floods full messages to all peers", 0};
     const command_line::arg_descriptor<Uuid> arg_p2p_net_id = {"net-id", "The way to replace hardcoded NETWORK_ID. Effective only with --testnet, ex.: 'net-id = 54686520-4172-7420-6f77-205761722037'"};
 
     // helper struct used to notify peers by uuid
@@ -143,6 +143,31 @@ namespace nodetool
             }
         } while (out.empty());
     }
+    /*!
+     * helper to return random subset of 'in' with at most 'count' elements
+     */
+    template <typename T>
+    void select_random_subset(size_t count, T &in, T &out)
+    {
+        static thread_local auto gen = std::mt19937{std::random_device{}()};
+        for (size_t i = 0; i < in.size() && i < count; ++i) {
+            std::uniform_int_distribution<size_t> uid(i, in.size() - 1);
+            std::swap(in[i], in[uid(gen)]);
+            out.push_back(in[i]);
+        }
+    }
+
+    /*!
+     * helper to make gossip message id of supernode announce, one per supernode and height
+     */
+    inline std::string get_announce_message_id(const std::string &supernode_public_id, uint64_t height)
+    {
+        std::string id = supernode_public_id + ":" + std::to_string(height);
+        crypto::hash hash;
+        crypto::cn_fast_hash(id.data(), id.size(), hash);
+        return epee::string_tools::pod_to_hex(hash);
+    }
+
     /*!
      * helper to calculate p2p command size in bytes
      */
@@ -178,6 +203,7 @@ namespace nodetool
     command_line::add_arg(desc, arg_limit_rate);
     command_line::add_arg(desc, arg_save_graph);
     command_line::add_arg(desc, arg_p2p_net_id);
+    command_line::add_arg(desc, arg_rta_gossip_fanout);
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
@@ -415,6 +441,8 @@ namespace nodetool
     if ( !set_rate_limit(vm, command_line::get_arg(vm, arg_limit_rate) ) )
       return false;
 
+    m_rta_gossip_fanout = command_line::get_arg(vm, arg_rta_gossip_fanout);
+
     return true;
   }
   //-----------------------------------------------------------------------------------
@@ -524,6 +552,25 @@ namespace nodetool
     MDEBUG("NETWORK_ID: '" << net_id << "' (" << hint << ")" << std::endl);
   }
 
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::register_command_names()
+  {
+    epee::net_utils::levin_traffic_metrics &metrics = epee::net_utils::get_levin_metrics();
+    metrics.set_name(int(COMMAND_HANDSHAKE::ID), "handshake");
+    metrics.set_name(int(COMMAND_TIMED_SYNC::ID), "timed_sync");
+    metrics.set_name(int(COMMAND_PING::ID), "ping");
+    metrics.set_name(int(COMMAND_REQUEST_STAT_INFO::ID), "request_stat_info");
+    metrics.set_name(int(COMMAND_REQUEST_NETWORK_STATE::ID), "request_network_state");
+    metrics.set_name(int(COMMAND_REQUEST_PEER_ID::ID), "request_peer_id");
+    metrics.set_name(int(COMMAND_REQUEST_SUPPORT_FLAGS::ID), "request_support_flags");
+    metrics.set_name(int(COMMAND_SUPERNODE_ANNOUNCE::ID), "supernode_announce");
+    metrics.set_name(int(COMMAND_BROADCAST::ID), "broadcast");
+    metrics.set_name(int(COMMAND_MULTICAST::ID), "multicast");
+    metrics.set_name(int(COMMAND_UNICAST::ID), "unicast");
+    metrics.set_name(int(COMMAND_RTA_INVENTORY::ID), "rta_inventory");
+    metrics.set_name(int(COMMAND_RTA_GET_BODIES::ID), "rta_get_bodies");
+  }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::init(const boost::program_options::variables_map& vm)
@@ -536,8 +583,11 @@ namespace nodetool
       [&](uint64_t block_height, const cryptonote::StakeTransactionProcessor::supernode_tier_array& tiers) { handle_blockchain_based_list_update(block_height, tiers); }
     );
 
+    register_command_names();
+
     std::set<std::string> full_addrs;
     m_testnet = command_line::get_arg(vm, command_line::arg_testnet_on);
+    m_supernode_list_encoder.reset(new supernode_list_encoder(m_testnet));
 
     assign_network_id(vm, m_testnet, m_network_id);
     if (m_testnet)
@@ -789,6 +839,13 @@ namespace nodetool
   template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::deinit()
   {
+    m_supernode_feed.stop();
+    {
+      boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+      for (auto &sn : m_supernodes)
+        sn.second.forwarder->stop(true);
+      m_supernodes.clear();
+    }
     kill();
     m_peerlist.deinit();
     m_net_server.deinit_server();
@@ -887,87 +944,62 @@ namespace nodetool
   {
       MDEBUG("P2P Request: multicast_send: Start tunneling for addresses: "
                    << boost::algorithm::join(addresses, ", "));
-      std::vector<peerlist_entry> tunnels;
+
+      // connected peers are collected once instead of searching connections per tunnel
+      std::unordered_map<peerid_type, boost::uuids::uuid> connected;
+      m_net_server.get_config_object().foreach_connection([&](p2p_connection_context& cntxt)
       {
-          std::map<std::string, nodetool::supernode_route> local_supernode_routes;
+          if (cntxt.peer_id != 0)
+              connected.emplace(cntxt.peer_id, cntxt.m_connection_id);
+          return true;
+      });
+
+      std::vector<std::vector<peerlist_entry>> ranked_peers = m_supernode_routes.find_peers(addresses);
+      std::vector<std::pair<peerid_type, boost::uuids::uuid>> tunnels;
+      std::unordered_set<peerid_type> selected(exclude_peerids.begin(), exclude_peerids.end());
+      auto addr_it = addresses.begin();
+      for (const std::vector<peerlist_entry> &peers : ranked_peers)
+      {
+          const std::string &addr = *addr_it++;
+          if (peers.empty())
           {
-              MDEBUG("P2P Request: multicast_send: lock");
-              boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
-              MDEBUG("P2P Request: multicast_send: unlock");
-              local_supernode_routes = m_supernode_routes;
+              MWARNING("no tunnel found for address: " << addr);
+              continue;
           }
-          for (auto addr : addresses)
+          unsigned int count = 0;
+          for (const peerlist_entry &addr_tunnel : peers)
           {
-              MDEBUG("P2P Request: multicast_send: looking for tunnel for " << addr);
-              auto it = local_supernode_routes.find(addr);
-              if (it == local_supernode_routes.end())
-              {
-                  MWARNING("no tunnel found for address: " << addr);
+              if (count >= MAX_TUNNEL_PEERS)
+                  break;
+              auto conn_it = connected.find(addr_tunnel.id);
+              if (conn_it == connected.end())
                   continue;
-              }
-              // peers for address
-              std::vector<peerlist_entry> addr_tunnels = (*it).second.peers;
-              unsigned int count = 0;
-              for (auto peer_it = addr_tunnels.begin(); peer_it != addr_tunnels.end(); ++peer_it)
-              {
-                  peerlist_entry addr_tunnel = *peer_it;
-
-
-                  // check if peer connected connections
-                  boost::uuids::uuid dummy;
-                  if (!find_connection_id_by_peer(addr_tunnel, dummy))
-                    continue;
-
-                  // don't allow duplicate entries
-                  auto tunnel_it = std::find_if(tunnels.begin(), tunnels.end(),
-                                                [addr_tunnel](const peerlist_entry &entry) -> bool {
-                      return entry.id == addr_tunnel.id;
-                  });
-                  // check if our peer is in excluded peers
-                  auto exclude_it = std::find(exclude_peerids.begin(), exclude_peerids.end(),
-                                              addr_tunnel.id);
-                  if (tunnel_it == tunnels.end() && exclude_it == exclude_peerids.end())
-                  {
-                      MDEBUG("found tunnel for address: " << addr << ":  " << addr_tunnel.adr.str());
-                      tunnels.push_back(addr_tunnel);
-                      count++;
-                  }
-                  if (count >= MAX_TUNNEL_PEERS)
-                  {
-                      break;
-                  }
-              }
+              // skip excluded peers and duplicates
+              if (!selected.insert(addr_tunnel.id).second)
+                  continue;
+              MDEBUG("found tunnel for address: " << addr << ":  " << addr_tunnel.adr.str());
+              tunnels.push_back(*conn_it);
+              count++;
           }
       }
       MDEBUG("P2P Request: multicast_send: End tunneling, tunnels found: " << tunnels.size());
       m_multicast_bytes_out += data.size() * tunnels.size();
 
-      return notify_peer_list(command, data, tunnels);
+      for (const auto &tunnel : tunnels)
+      {
+          bool sent = relay_notify(command, data, tunnel.second);
+          if (!sent)
+              MWARNING("P2P Request: multicast_send: sending to peer " << tunnel.first << " FAILED");
+          m_supernode_routes.report(tunnel.first, sent);
+      }
+      return true;
   }
 
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
   uint64_t node_server<t_payload_net_handler>::get_max_hop(const std::list<std::string> &addresses)
   {
-      uint64_t max_hop = 0;
-      {
-          std::map<std::string, nodetool::supernode_route> local_supernode_routes;
-          {
-              MDEBUG("P2P Request: multicast_send: lock");
-              boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
-              MDEBUG("P2P Request: multicast_send: unlock");
-              local_supernode_routes = m_supernode_routes;
-          }
-          for (auto addr : addresses)
-          {
-              auto it = local_supernode_routes.find(addr);
-              if (it != local_supernode_routes.end() && max_hop < (*it).second.max_hop)
-              {
-                  max_hop = (*it).second.max_hop;
-              }
-          }
-      }
-      return max_hop;
+      return m_supernode_routes.max_hop(addresses);
   }
 
   //-----------------------------------------------------------------------------------
@@ -975,41 +1007,11 @@ namespace nodetool
   std::list<std::string> node_server<t_payload_net_handler>::get_routes()
   {
       std::list<std::string> routes;
-      {
-          std::map<std::string, nodetool::supernode_route> local_supernode_routes;
-          {
-              MDEBUG("P2P Request: multicast_send: lock");
-              boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
-              MDEBUG("P2P Request: multicast_send: unlock");
-              local_supernode_routes = m_supernode_routes;
-          }
-          for (auto it = local_supernode_routes.begin(); it != local_supernode_routes.end(); ++it)
-          {
-              routes.push_back((*it).first);
-          }
-      }
+      for (const auto &route : m_supernode_routes.snapshot())
+          routes.push_back(route->id);
       return routes;
   }
 
-  //-----------------------------------------------------------------------------------
-  template<class t_payload_net_handler>
-  void node_server<t_payload_net_handler>::remove_old_request_cache()
-  {
-      int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-      for (auto it = m_supernode_requests_timestamps.begin(); it != m_supernode_requests_timestamps.end();)
-      {
-          if ((*it).first + REQUEST_CACHE_TIME < timestamp)
-          {
-              m_supernode_requests_cache.erase((*it).second);
-              it = m_supernode_requests_timestamps.erase(it);
-          }
-          else
-          {
-              break;
-          }
-      }
-  }
-
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
   int node_server<t_payload_net_handler>::handle_supernode_announce(int command, COMMAND_SUPERNODE_ANNOUNCE::request& arg, p2p_connection_context& context)
@@ -1044,87 +1046,53 @@ namespace nodetool
               MDEBUG("unknown peer, alternative handshake with it " << context.peer_id);
               return 1;
           }
+          switch (m_supernode_routes.update(supernode_str, pe, arg.height, arg.hop, time(nullptr)))
           {
-              MDEBUG("P2P Request: handle_supernode_announce: lock");
-              boost::lock_guard<boost::recursive_mutex> guard(m_request_cache_lock);
-              MDEBUG("P2P Request: handle_supernode_announce: unlock");
-              remove_old_request_cache();
-          }
-          MDEBUG("P2P Request: handle_supernode_announce: lock");
-          boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
-          MDEBUG("P2P Request: handle_supernode_announce: unlock");
-
-          MDEBUG("P2P Request: handle_supernode_announce: routes number - " << m_supernode_routes.size());
-          for (auto it2 = m_supernode_routes.begin(); it2 != m_supernode_routes.end(); ++it2)
-          {
-              MDEBUG("P2P Request: handle_supernode_announce: " << (*it2).first << " " << (*it2).second.peers.size());
-          }
-
-          auto it = m_supernode_routes.find(supernode_str);
-          if (it == m_supernode_routes.end())
-          {
-              std::vector<peerlist_entry> peer_vec;
-              peer_vec.push_back(pe);
-              nodetool::supernode_route route;
-              route.last_announce_height = arg.height;
-              route.last_announce_time = time(nullptr);
-              route.max_hop = arg.hop;
-              route.peers = peer_vec;
-              m_supernode_routes[supernode_str] = route;
-          }
-          else {
-              auto &route = it->second;
-              if (route.last_announce_height > arg.height)
-              {
-                  MINFO("SUPERNODE_ANNOUNCE from " << context.peer_id
-                        << " too old, corrent route height " << (*it).second.last_announce_height);
-                  return 1;
-              }
-
-              if (route.last_announce_height == arg.height && route.last_announce_time + DIFFICULTY_TARGET_V2 > (unsigned)time(nullptr))
-              {
-                  MDEBUG("existing announce, height: " << arg.height << ", last_announce_time: " << (*it).second.last_announce_time
-                         << ", current time: " << time(nullptr));
-                  auto peer_it = std::find_if(route.peers.begin(), route.peers.end(),
-                                              [pe](const peerlist_entry &p) -> bool { return pe.id == p.id; });
-                  if (peer_it == route.peers.end())
-                  {
-                      route.peers.push_back(pe);
-                      if (route.max_hop < arg.hop)
-                      {
-                          route.max_hop = arg.hop;
-                      }
-                  }
-                  return 1;
-              }
-              route.peers.clear();
-              route.peers.push_back(pe);
-              route.last_announce_height = arg.height;
-              route.last_announce_time = time(nullptr);
-              route.max_hop = arg.hop;
+          case supernode_route_table::route_stale:
+              MINFO("SUPERNODE_ANNOUNCE from " << context.peer_id << " too old for " << supernode_str);
+              return 1;
+          case supernode_route_table::route_duplicate:
+              MDEBUG("existing announce, height: " << arg.height << ", peer: " << context.peer_id);
+              return 1;
+          case supernode_route_table::route_updated:
+              MDEBUG("P2P Request: handle_supernode_announce: routes number - " << m_supernode_routes.size());
+              break;
           }
+          // lets gossip inventory tell this announce is already known
+          m_request_cache.insert(get_announce_message_id(supernode_str, arg.height));
       }
 
-      std::list<std::reference_wrapper<local_supernode>> post_to_sn;
       {
           LOG_PRINT_L3("P2P Request: handle_supernode_announce: lock");
           boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
           LOG_PRINT_L3("P2P Request: handle_supernode_announce: unlock");
+          // posting only queues request, safe to do under the lock
           for (auto &sn : m_supernodes) {
-              if (sn.first != supernode_str)
-                  post_to_sn.push_back(std::ref(sn.second));
+              if (sn.first == supernode_str)
+                  continue;
+              LOG_PRINT_L1("P2P Request: handle_supernode_announce: post to supernode");
+              post_request_to_supernode<cryptonote::COMMAND_RPC_SUPERNODE_ANNOUNCE>(sn.second, supernode_endpoint, arg);
           }
       }
-      for (auto &sn : post_to_sn) {
-          LOG_PRINT_L1("P2P Request: handle_supernode_announce: post to supernode");
-          post_request_to_supernode<cryptonote::COMMAND_RPC_SUPERNODE_ANNOUNCE>(sn, supernode_endpoint, arg);
-      }
 
       if (!is_local) {
           // Notify neighbours about new ANNOUNCE
           arg.hop++;
           MDEBUG("P2P Request: handle_supernode_announce: notify peers " << arg.hop);
 
+          rta_inventory_item item = AUTO_VAL_INIT(item);
+          item.command = COMMAND_SUPERNODE_ANNOUNCE::ID;
+          item.message_id = get_announce_message_id(supernode_str, arg.height);
+          item.supernode_public_id = supernode_str;
+          item.height = arg.height;
+          item.hop = arg.hop;
+          std::shared_ptr<std::string> blob = std::make_shared<std::string>();
+          epee::serialization::store_t_to_binary(arg, *blob);
+          if (gossip_rta_message(item, blob, context.m_connection_id, m_announce_bytes_out)) {
+              MDEBUG("P2P Request: handle_supernode_announce: end (gossip)");
+              return 1;
+          }
+
           std::list<boost::uuids::uuid> all_connections, random_connections;
           m_net_server.get_config_object().foreach_connection([&](const p2p_connection_context& cntxt)
           {
@@ -1142,11 +1110,9 @@ namespace nodetool
 
           select_subset_with_probability(1.0 / all_connections.size(), all_connections, random_connections);
 
-          std::string arg_buff;
-          epee::serialization::store_t_to_binary(arg, arg_buff);
           MDEBUG("P2P Request: handle_supernode_announce: relaying to neighbours: " << random_connections.size());
-          relay_notify_to_list(command, arg_buff, random_connections);
-          m_announce_bytes_out += arg_buff.size() * random_connections.size();
+          relay_notify_to_list(command, *blob, random_connections);
+          m_announce_bytes_out += blob->size() * random_connections.size();
       }
 
       MDEBUG("P2P Request: handle_supernode_announce: end");
@@ -1169,43 +1135,43 @@ namespace nodetool
     return 1;
 #endif
 
+      if (!m_request_cache.insert(arg.message_id))
+      {
+          MDEBUG("P2P Request: handle_broadcast: request found in cache, skipping");
+          return 1;
+      }
+
       {
           MDEBUG("P2P Request: handle_broadcast: lock");
-          boost::unique_lock<boost::recursive_mutex> cache_guard(m_request_cache_lock, boost::defer_lock),
-              sn_guard(m_supernode_lock, boost::defer_lock);
-          boost::lock(cache_guard, sn_guard);
+          boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
           MDEBUG("P2P Request: handle_broadcast: unlock");
           MDEBUG("P2P Request: handle_broadcast: sender_address: " << arg.sender_address
                        << ", our address(es): " << join_supernodes_addresses(", "));
-          if (m_supernode_requests_cache.find(arg.message_id) == m_supernode_requests_cache.end())
-          {
-              MDEBUG("P2P Request: handle_broadcast: post to supernodes");
-              m_supernode_requests_cache.insert(arg.message_id);
-              int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-              m_supernode_requests_timestamps.insert(std::make_pair(timestamp, arg.message_id));
-
-              post_request_to_supernodes<cryptonote::COMMAND_RPC_BROADCAST>("broadcast", arg, arg.callback_uri);
-
-              if (arg.hop > 0)
-              {
-                  MDEBUG("P2P Request: handle_broadcast: notify broadcast from " << arg.sender_address
-                               << " to peers. Hop level: " << arg.hop);
-                  arg.hop--;
-                  std::string buff;
-                  epee::serialization::store_t_to_binary(arg, buff);
+          MDEBUG("P2P Request: handle_broadcast: post to supernodes");
+          post_request_to_supernodes<cryptonote::COMMAND_RPC_BROADCAST>("broadcast", arg, arg.callback_uri);
+      }
 
-                  m_broadcast_bytes_out += buff.size() * get_connections_count();
+      if (arg.hop > 0)
+      {
+          MDEBUG("P2P Request: handle_broadcast: notify broadcast from " << arg.sender_address
+                       << " to peers. Hop level: " << arg.hop);
+          arg.hop--;
+          std::shared_ptr<std::string> buff = std::make_shared<std::string>();
+          epee::serialization::store_t_to_binary(arg, *buff);
 
-                  relay_notify_to_all(command, buff, context);
-              }
-              else
-              {
-                  MDEBUG("P2P Request: handle_broadcast: hop counter ended for broadcast from "
-                               << arg.sender_address);
-              }
+          rta_inventory_item item = AUTO_VAL_INIT(item);
+          item.command = COMMAND_BROADCAST::ID;
+          item.message_id = arg.message_id;
+          if (!gossip_rta_message(item, buff, context.m_connection_id, m_broadcast_bytes_out))
+          {
+              m_broadcast_bytes_out += buff->size() * get_connections_count();
+              relay_notify_to_all(command, *buff, context);
           }
-          MDEBUG("P2P Request: handle_broadcast: clean request cache");
-          remove_old_request_cache();
+      }
+      else
+      {
+          MDEBUG("P2P Request: handle_broadcast: hop counter ended for broadcast from "
+                       << arg.sender_address);
       }
       MDEBUG("P2P Request: handle_broadcast: end");
       return 1;
@@ -1227,51 +1193,42 @@ namespace nodetool
     return 1;
 #endif
 
+      if (!m_request_cache.insert(arg.message_id))
+      {
+          MDEBUG("P2P Request: handle_multicast: request found in cache, skipping");
+          return 1;
+      }
+
       std::list<std::string> addresses = arg.receiver_addresses;
       bool forward = false;
       {
           MDEBUG("P2P Request: handle_multicast: lock");
-          boost::unique_lock<boost::recursive_mutex> cache_guard(m_request_cache_lock, boost::defer_lock),
-              sn_guard(m_supernode_lock, boost::defer_lock);
-          boost::lock(cache_guard, sn_guard);
-
+          boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
           MDEBUG("P2P Request: handle_multicast: unlock");
           MDEBUG("P2P Request: handle_multicast: sender_address: " << arg.sender_address
                        << ", receiver_addresses: " << boost::algorithm::join(arg.receiver_addresses, ", ")
                        << ", our address(es): " << join_supernodes_addresses(", "));
-          if (m_supernode_requests_cache.find(arg.message_id) == m_supernode_requests_cache.end())
-          {
-              MDEBUG("P2P Request: handle_multicast: post to supernodes");
-              m_supernode_requests_cache.insert(arg.message_id);
-              int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-              m_supernode_requests_timestamps.insert(std::make_pair(timestamp, arg.message_id));
-              for (auto it = addresses.begin(); it != addresses.end(); ) {
-                  auto snit = m_supernodes.find(*it);
-                  if (snit != m_supernodes.end()) {
-                      MDEBUG("P2P Request: handle_multicast: posting to local supernode " << snit->first);
-                      post_request_to_supernode<cryptonote::COMMAND_RPC_MULTICAST>(snit->second, "multicast", arg, arg.callback_uri);
-                      it = addresses.erase(it);
-                  } else {
-                      ++it;
-                  }
-              }
-
-              if (arg.hop > 0)
-              {
-                  forward = true;
-              }
-              else
-              {
-                  MDEBUG("P2P Request: handle_multicast: hop counter ended for multicast from "
-                               << arg.sender_address);
+          MDEBUG("P2P Request: handle_multicast: post to supernodes");
+          for (auto it = addresses.begin(); it != addresses.end(); ) {
+              auto snit = m_supernodes.find(*it);
+              if (snit != m_supernodes.end()) {
+                  MDEBUG("P2P Request: handle_multicast: posting to local supernode " << snit->first);
+                  post_request_to_supernode<cryptonote::COMMAND_RPC_MULTICAST>(snit->second, "multicast", arg, arg.callback_uri);
+                  it = addresses.erase(it);
+              } else {
+                  ++it;
               }
           }
-          else
-          {
-              MDEBUG("P2P Request: handle_multicast: request found in cache, skipping");
-          }
-          MDEBUG("P2P Request: handle_multicast: clean request cache");
-          remove_old_request_cache();
+      }
+
+      if (arg.hop > 0)
+      {
+          forward = true;
+      }
+      else
+      {
+          MDEBUG("P2P Request: handle_multicast: hop counter ended for multicast from "
+                       << arg.sender_address);
       }
       if (forward)
       {
@@ -1303,45 +1260,37 @@ namespace nodetool
     return 1;
 #endif
 
+      if (!m_request_cache.insert(arg.message_id))
+      {
+          MDEBUG("P2P Request: handle_unicast: request found in cache, skipping");
+          return 1;
+      }
+
       std::string address = arg.receiver_address;
       bool forward = false;
       {
           MDEBUG("P2P Request: handle_unicast: lock");
-          boost::unique_lock<boost::recursive_mutex> cache_guard(m_request_cache_lock, boost::defer_lock),
-              sn_guard(m_supernode_lock, boost::defer_lock);
-          boost::lock(cache_guard, sn_guard);
+          boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
           MDEBUG("P2P Request: handle_unicast: unlock");
           MDEBUG("P2P Request: handle_unicast: sender_address: " << arg.sender_address
                        << ", receiver_address: " << arg.receiver_address
                        << ", our address(es): " << join_supernodes_addresses(", "));
-          if (m_supernode_requests_cache.find(arg.message_id) == m_supernode_requests_cache.end())
+          MDEBUG("P2P Request: handle_unicast: post to supernodes");
+          auto it = m_supernodes.find(address);
+          bool local_sn = it != m_supernodes.end();
+          if (local_sn) {
+              MDEBUG("P2P Request: handle_unicast: sending to local supernode " << address);
+              post_request_to_supernode<cryptonote::COMMAND_RPC_UNICAST>(it->second, "unicast", arg, arg.callback_uri);
+          }
+          else if (arg.hop > 0)
           {
-              MDEBUG("P2P Request: handle_unicast: post to supernodes");
-              m_supernode_requests_cache.insert(arg.message_id);
-              int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-              m_supernode_requests_timestamps.insert(std::make_pair(timestamp, arg.message_id));
-              auto it = m_supernodes.find(address);
-              bool local_sn = it != m_supernodes.end();
-              if (local_sn) {
-                  MDEBUG("P2P Request: handle_unicast: sending to local supernode " << address);
-                  post_request_to_supernode<cryptonote::COMMAND_RPC_UNICAST>(it->second, "unicast", arg, arg.callback_uri);
-              }
-              else if (arg.hop > 0)
-              {
-                  forward = true;
-              }
-              else
-              {
-                  MDEBUG("P2P Request: handle_unicast: hop counter ended for unicast from "
-                               << arg.sender_address);
-              }
+              forward = true;
           }
           else
           {
-              MDEBUG("P2P Request: handle_unicast: request found in cache, skipping");
+              MDEBUG("P2P Request: handle_unicast: hop counter ended for unicast from "
+                           << arg.sender_address);
           }
-          MDEBUG("P2P Request: handle_unicast: clean request cache");
-          remove_old_request_cache();
       }
 
       if (forward)
@@ -1363,6 +1312,135 @@ namespace nodetool
       return 1;
   }
 
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  bool node_server<t_payload_net_handler>::gossip_rta_message(const rta_inventory_item &item, const gossip_inventory::blob_ptr &blob,
+                                                              const boost::uuids::uuid &source, std::atomic<uint64_t> &bytes_out)
+  {
+      if (m_rta_gossip_fanout == 0)
+          return false;
+
+      m_gossip_inventory.put(item.message_id, item.command, blob);
+
+      std::vector<boost::uuids::uuid> gossip_connections;
+      std::list<boost::uuids::uuid> legacy_connections;
+      m_net_server.get_config_object().foreach_connection([&](const p2p_connection_context& cntxt)
+      {
+          if (cntxt.peer_id == 0 || cntxt.peer_id == m_config.m_peer_id || cntxt.m_connection_id == source)
+              return true;
+          if (cntxt.support_flags & P2P_SUPPORT_FLAG_RTA_GOSSIP)
+              gossip_connections.push_back(cntxt.m_connection_id);
+          else
+              legacy_connections.push_back(cntxt.m_connection_id);
+          return true;
+      });
+
+      // peers which can't pull still get the body
+      if (!legacy_connections.empty())
+      {
+          relay_notify_to_list(item.command, *blob, legacy_connections);
+          bytes_out += blob->size() * legacy_connections.size();
+      }
+
+      std::vector<boost::uuids::uuid> selected;
+      select_random_subset(m_rta_gossip_fanout, gossip_connections, selected);
+      if (selected.empty())
+          return true;
+
+      COMMAND_RTA_INVENTORY::request inv;
+      inv.items.push_back(item);
+      std::string inv_blob;
+      epee::serialization::store_t_to_binary(inv, inv_blob);
+      MDEBUG("P2P Request: gossip_rta_message: offering " << item.message_id << " to " << selected.size() << " peers");
+      relay_notify_to_list(COMMAND_RTA_INVENTORY::ID, inv_blob, std::list<boost::uuids::uuid>(selected.begin(), selected.end()));
+      m_gossip_bytes_out += inv_blob.size() * selected.size();
+      return true;
+  }
+
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  int node_server<t_payload_net_handler>::handle_rta_inventory(int command, typename COMMAND_RTA_INVENTORY::request &arg, p2p_connection_context &context)
+  {
+      m_gossip_bytes_in += get_command_size(arg);
+      if (context.m_state != p2p_connection_context::state_normal) {
+          MWARNING(context << " invalid connection (no handshake)");
+          return 1;
+      }
+
+#ifdef LOCK_RTA_SENDING
+    return 1;
+#endif
+
+      COMMAND_RTA_GET_BODIES::request req;
+      for (const rta_inventory_item &item : arg.items)
+      {
+          bool known = m_request_cache.contains(item.message_id);
+          if (item.command == COMMAND_SUPERNODE_ANNOUNCE::ID)
+          {
+              if (known)
+              {
+                  // body isn't needed, the offer still tells a tunnel to the supernode
+                  bool is_local;
+                  {
+                      boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+                      is_local = m_supernodes.count(item.supernode_public_id) > 0;
+                  }
+                  peerlist_entry pe;
+                  if (!is_local && m_peerlist.find_peer(context.peer_id, pe))
+                      m_supernode_routes.update(item.supernode_public_id, pe, item.height, item.hop, time(nullptr));
+                  continue;
+              }
+          }
+          else if (item.command != COMMAND_BROADCAST::ID || known)
+          {
+              continue;
+          }
+
+          if (req.message_ids.size() < GOSSIP_MAX_PULL_IDS && m_gossip_inventory.want(item.message_id))
+              req.message_ids.push_back(item.message_id);
+      }
+
+      if (!req.message_ids.empty())
+      {
+          std::string blob;
+          epee::serialization::store_t_to_binary(req, blob);
+          MDEBUG("P2P Request: handle_rta_inventory: pulling " << req.message_ids.size() << " messages from " << context.peer_id);
+          relay_notify(COMMAND_RTA_GET_BODIES::ID, blob, context.m_connection_id);
+          m_gossip_bytes_out += blob.size();
+      }
+      return 1;
+  }
+
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  int node_server<t_payload_net_handler>::handle_rta_get_bodies(int command, typename COMMAND_RTA_GET_BODIES::request &arg, p2p_connection_context &context)
+  {
+      m_gossip_bytes_in += get_command_size(arg);
+      if (context.m_state != p2p_connection_context::state_normal) {
+          MWARNING(context << " invalid connection (no handshake)");
+          return 1;
+      }
+
+      size_t served = 0;
+      for (const std::string &message_id : arg.message_ids)
+      {
+          if (served >= GOSSIP_MAX_PULL_IDS)
+              break;
+          int body_command;
+          gossip_inventory::blob_ptr blob;
+          if (!m_gossip_inventory.get(message_id, body_command, blob))
+              continue;
+          relay_notify(body_command, *blob, context.m_connection_id);
+          if (body_command == COMMAND_BROADCAST::ID)
+              m_broadcast_bytes_out += blob->size();
+          else
+              m_announce_bytes_out += blob->size();
+          ++served;
+      }
+      MDEBUG("P2P Request: handle_rta_get_bodies: served " << served << " of " << arg.message_ids.size() << " to " << context.peer_id);
+      return 1;
+  }
+
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::do_handshake_with_peer(peerid_type& pi, p2p_connection_context& context_, bool just_take_peerlist)
@@ -2443,8 +2521,22 @@ namespace nodetool
     }
 
     MDEBUG("P2P Request: do_supernode_announce: prepare peerlist");
-    std::string blob;
-    epee::serialization::store_t_to_binary(p2p_req, blob);
+    std::shared_ptr<std::string> blob_ptr = std::make_shared<std::string>();
+    epee::serialization::store_t_to_binary(p2p_req, *blob_ptr);
+    const std::string &blob = *blob_ptr;
+
+    rta_inventory_item item = AUTO_VAL_INIT(item);
+    item.command = COMMAND_SUPERNODE_ANNOUNCE::ID;
+    item.message_id = get_announce_message_id(p2p_req.supernode_public_id, p2p_req.height);
+    item.supernode_public_id = p2p_req.supernode_public_id;
+    item.height = p2p_req.height;
+    item.hop = p2p_req.hop;
+    m_request_cache.insert(item.message_id);
+    if (gossip_rta_message(item, blob_ptr, boost::uuids::nil_uuid(), m_announce_bytes_out)) {
+        MDEBUG("P2P Request: do_supernode_announce: end (gossip)");
+        return;
+    }
+
     std::set<peerid_type> announced_peers;
 
 
@@ -2540,25 +2632,25 @@ namespace nodetool
       p2p_req.callback_uri = req.callback_uri;
       p2p_req.data = req.data;
       p2p_req.wait_answer = req.wait_answer;
-      p2p_req.hop = HOP_RETRIES_MULTIPLIER * get_max_hop(get_routes());
+      p2p_req.hop = HOP_RETRIES_MULTIPLIER * m_supernode_routes.max_hop();
       p2p_req.message_id = epee::string_tools::pod_to_hex(message_hash);
 
-      {
-          MDEBUG("P2P Request: do_broadcast: lock");
-          boost::lock_guard<boost::recursive_mutex> guard(m_request_cache_lock);
-          MDEBUG("P2P Request: do_broadcast: unlock");
-          m_supernode_requests_cache.insert(p2p_req.message_id);
-          int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-          m_supernode_requests_timestamps.insert(std::make_pair(timestamp, p2p_req.message_id));
-
-          MDEBUG("P2P Request: do_broadcast: clean request cache");
-          remove_old_request_cache();
-      }
+      m_request_cache.insert(p2p_req.message_id);
 
       MDEBUG("P2P Request: do_broadcast: prepare peerlist");
 
-      std::string blob;
-      epee::serialization::store_t_to_binary(p2p_req, blob);
+      std::shared_ptr<std::string> blob_ptr = std::make_shared<std::string>();
+      epee::serialization::store_t_to_binary(p2p_req, *blob_ptr);
+      const std::string &blob = *blob_ptr;
+
+      rta_inventory_item item = AUTO_VAL_INIT(item);
+      item.command = COMMAND_BROADCAST::ID;
+      item.message_id = p2p_req.message_id;
+      if (gossip_rta_message(item, blob_ptr, boost::uuids::nil_uuid(), m_broadcast_bytes_out)) {
+          MDEBUG("P2P Request: do_broadcast: End (gossip)");
+          return;
+      }
+
       std::set<peerid_type> announced_peers;
 
       // send to peers
@@ -2659,17 +2751,7 @@ namespace nodetool
       p2p_req.hop = HOP_RETRIES_MULTIPLIER * get_max_hop(p2p_req.receiver_addresses);
       p2p_req.message_id = epee::string_tools::pod_to_hex(message_hash);
 
-      {
-          MDEBUG("P2P Request: do_multicast: lock");
-          boost::lock_guard<boost::recursive_mutex> guard(m_request_cache_lock);
-          MDEBUG("P2P Request: do_multicast: unlock");
-          m_supernode_requests_cache.insert(p2p_req.message_id);
-          int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-          m_supernode_requests_timestamps.insert(std::make_pair(timestamp, p2p_req.message_id));
-
-          MDEBUG("P2P Request: do_multicast: clean request cache");
-          remove_old_request_cache();
-      }
+      m_request_cache.insert(p2p_req.message_id);
 
       MDEBUG("P2P Request: do_multicast: multicast send");
       std::string blob;
@@ -2727,17 +2809,7 @@ namespace nodetool
       p2p_req.hop = HOP_RETRIES_MULTIPLIER * get_max_hop(addresses);
       p2p_req.message_id = epee::string_tools::pod_to_hex(message_hash);
 
-      {
-          MDEBUG("P2P Request: do_unicast: lock");
-          boost::lock_guard<boost::recursive_mutex> guard(m_request_cache_lock);
-          MDEBUG("P2P Request: do_unicast: unlock");
-          m_supernode_requests_cache.insert(p2p_req.message_id);
-          int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-          m_supernode_requests_timestamps.insert(std::make_pair(timestamp, p2p_req.message_id));
-
-          MDEBUG("P2P Request: do_unicast: clean request cache");
-          remove_old_request_cache();
-      }
+      m_request_cache.insert(p2p_req.message_id);
 
       MDEBUG("P2P Request: do_unicast: unicast send");
       std::string blob;
@@ -2750,24 +2822,25 @@ namespace nodetool
   template<class t_payload_net_handler>
   std::vector<cryptonote::route_data> node_server<t_payload_net_handler>::get_tunnels() const
   {
+      // routes are immutable, building the reply doesn't hold the route table lock
       std::vector<cryptonote::route_data> tunnels;
-      for (auto it = m_supernode_routes.begin(); it != m_supernode_routes.end(); ++it)
+      for (const auto &src : m_supernode_routes.snapshot())
       {
           cryptonote::route_data route;
-          route.address = it->first;
-          route.last_announce_height = it->second.last_announce_height;
-          route.max_hop = it->second.max_hop;
-          std::vector<cryptonote::peer_data> peers;
-          for (auto pit = it->second.peers.begin(); pit != it->second.peers.end(); ++pit)
+          route.address = src->id;
+          route.last_announce_height = src->last_announce_height;
+          route.last_announce_time = src->last_announce_time;
+          route.max_hop = src->max_hop;
+          route.peers.reserve(src->peers.size());
+          for (const auto &src_peer : src->peers)
           {
               cryptonote::peer_data peer;
-              peer.host = pit->adr.host_str();
-              peer.port = pit->adr.template as<epee::net_utils::ipv4_network_address>().port();
-              peer.id = pit->id;
-              peer.last_seen = pit->last_seen;
-              peers.push_back(peer);
+              peer.host = src_peer.entry.adr.host_str();
+              peer.port = src_peer.entry.adr.template as<epee::net_utils::ipv4_network_address>().port();
+              peer.id = src_peer.entry.id;
+              peer.last_seen = src_peer.entry.last_seen;
+              route.peers.push_back(peer);
           }
-          route.peers = peers;
           tunnels.push_back(route);
       }
       return tunnels;
@@ -2990,36 +3063,66 @@ namespace nodetool
   template<class t_payload_net_handler>
   void node_server<t_payload_net_handler>::handle_stakes_update(uint64_t block_height, const cryptonote::StakeTransactionProcessor::supernode_stake_array& stakes)
   {
-    static std::string supernode_endpoint("send_supernode_stakes");
-
-    boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+    {
+      boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+      if (m_supernodes.empty())
+        return;
+    }
 
-    if (m_supernodes.empty())
-      return;
+    // called under the stake processor lock, encoding and posting is done by the feed thread
+    auto stakes_copy = std::make_shared<cryptonote::StakeTransactionProcessor::supernode_stake_array>(stakes);
+    m_supernode_feed.post([this, block_height, stakes_copy]() { push_stakes(block_height, *stakes_copy); });
+  }
 
-    MDEBUG("handle_stakes_update to supernode for block #" << block_height);
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::push_stakes(uint64_t block_height, const cryptonote::StakeTransactionProcessor::supernode_stake_array& stakes)
+  {
+    static std::string supernode_endpoint("send_supernode_stakes");
+    static std::string supernode_delta_endpoint("stakes_delta.bin");
 
-    cryptonote::COMMAND_RPC_SUPERNODE_STAKES::request request;
+    bool need_full = false, need_legacy = false;
+    {
+      boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+      if (m_supernodes.empty())
+        return;
+      for (const auto &sn : m_supernodes)
+      {
+        const supernode_feed_state &feed = sn.second.stakes_feed;
+        if (feed.version == 0)
+          need_legacy = true;
+        else if (*feed.failed || feed.block_height + 1 != block_height)
+          need_full = true;
+      }
+    }
 
-    request.block_height = block_height;
+    MDEBUG("push_stakes to supernode for block #" << block_height);
 
-    request.stakes.reserve(stakes.size());
+    cryptonote::COMMAND_RPC_SUPERNODE_STAKES::request request;
+    supernode_list_encoder::encoded update = m_supernode_list_encoder->encode_stakes(block_height, stakes, need_full, need_legacy ? &request : nullptr);
 
-    for (const cryptonote::supernode_stake& src_stake : stakes)
+    boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+    for (auto &sn : m_supernodes)
     {
-      cryptonote::COMMAND_RPC_SUPERNODE_STAKES::supernode_stake dst_stake;
-
-      dst_stake.amount = src_stake.amount;
-      dst_stake.tier = src_stake.tier;
-      dst_stake.block_height = src_stake.block_height;
-      dst_stake.unlock_time = src_stake.unlock_time;
-      dst_stake.supernode_public_id = src_stake.supernode_public_id;
-      dst_stake.supernode_public_address = cryptonote::get_account_address_as_str(m_testnet, src_stake.supernode_public_address);
-
-      request.stakes.emplace_back(std::move(dst_stake));
+      supernode_feed_state &feed = sn.second.stakes_feed;
+      if (feed.version == 0)
+      {
+        post_request_to_supernode<cryptonote::COMMAND_RPC_SUPERNODE_STAKES>(sn.second, supernode_endpoint, request);
+        continue;
+      }
+      // failed may be set by the forwarder after the scan above, delta is still better than nothing then
+      bool delta = update.delta && feed.block_height == update.base_block_height && (!*feed.failed || !update.full);
+      const supernode_list_encoder::blob_ptr &blob = delta ? update.delta : update.full;
+      if (!blob)
+      {
+        // feed was switched on after the scan, full list goes with the next block
+        *feed.failed = true;
+        continue;
+      }
+      if (!delta)
+        *feed.failed = false;
+      post_blob_to_supernode(sn.second, supernode_delta_endpoint, blob, feed.failed);
+      feed.block_height = std::max(feed.block_height, block_height);
     }
-
-    post_request_to_supernodes<cryptonote::COMMAND_RPC_SUPERNODE_STAKES>(supernode_endpoint, request);
   }
 
   template<class t_payload_net_handler>
@@ -3031,41 +3134,66 @@ namespace nodetool
   template<class t_payload_net_handler>
   void node_server<t_payload_net_handler>::handle_blockchain_based_list_update(uint64_t block_height, const cryptonote::StakeTransactionProcessor::supernode_tier_array& tiers)
   {
-    static std::string supernode_endpoint("blockchain_based_list");
+    {
+      boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+      if (m_supernodes.empty())
+        return;
+    }
 
-    boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+    // called under the stake processor lock, encoding and posting is done by the feed thread
+    auto tiers_copy = std::make_shared<cryptonote::StakeTransactionProcessor::supernode_tier_array>(tiers);
+    m_supernode_feed.post([this, block_height, tiers_copy]() { push_blockchain_based_list(block_height, *tiers_copy); });
+  }
 
-    if (m_supernodes.empty())
-      return;
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::push_blockchain_based_list(uint64_t block_height, const cryptonote::StakeTransactionProcessor::supernode_tier_array& tiers)
+  {
+    static std::string supernode_endpoint("blockchain_based_list");
+    static std::string supernode_delta_endpoint("blockchain_based_list_delta.bin");
 
-    MDEBUG("handle_blockchain_based_list_update to supernode for block #" << block_height);
+    bool need_full = false, need_legacy = false;
+    {
+      boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+      if (m_supernodes.empty())
+        return;
+      for (const auto &sn : m_supernodes)
+      {
+        const supernode_feed_state &feed = sn.second.list_feed;
+        if (feed.version == 0)
+          need_legacy = true;
+        else if (*feed.failed || feed.block_height + 1 != block_height)
+          need_full = true;
+      }
+    }
 
-    cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST::request request;
+    MDEBUG("push_blockchain_based_list to supernode for block #" << block_height);
 
-    request.block_height = block_height;
+    cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST::request request;
+    supernode_list_encoder::encoded update = m_supernode_list_encoder->encode_blockchain_based_list(block_height, tiers, need_full, need_legacy ? &request : nullptr);
 
-    for (size_t i=0; i<tiers.size(); i++)
+    boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+    for (auto &sn : m_supernodes)
     {
-      const cryptonote::StakeTransactionProcessor::supernode_tier_array::value_type& src_tier = tiers[i];
-      cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST::tier                  dst_tier;
-
-      dst_tier.supernodes.reserve(src_tier.size());
-
-      for (const cryptonote::BlockchainBasedList::supernode& src_supernode : src_tier)
+      supernode_feed_state &feed = sn.second.list_feed;
+      if (feed.version == 0)
       {
-        cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST::supernode dst_supernode;
-
-        dst_supernode.supernode_public_id      = src_supernode.supernode_public_id;
-        dst_supernode.supernode_public_address = cryptonote::get_account_address_as_str(m_testnet, src_supernode.supernode_public_address);
-        dst_supernode.amount                   = src_supernode.amount;
-
-        dst_tier.supernodes.emplace_back(std::move(dst_supernode));
+        post_request_to_supernode<cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST>(sn.second, supernode_endpoint, request);
+        continue;
       }
-
-      request.tiers.emplace_back(std::move(dst_tier));
+      // failed may be set by the forwarder after the scan above, delta is still better than nothing then
+      bool delta = update.delta && feed.block_height == update.base_block_height && (!*feed.failed || !update.full);
+      const supernode_list_encoder::blob_ptr &blob = delta ? update.delta : update.full;
+      if (!blob)
+      {
+        // feed was switched on after the scan, full list goes with the next block
+        *feed.failed = true;
+        continue;
+      }
+      if (!delta)
+        *feed.failed = false;
+      post_blob_to_supernode(sn.second, supernode_delta_endpoint, blob, feed.failed);
+      feed.block_height = std::max(feed.block_height, block_height);
     }
-
-    post_request_to_supernodes<cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST>(supernode_endpoint, request);
   }
 
   template<class t_payload_net_handler>
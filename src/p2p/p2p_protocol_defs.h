@@ -160,15 +160,6 @@ namespace nodetool
     END_KV_SERIALIZE_MAP()
   };
 
-  struct supernode_route
-  {
-      crypto::public_key addr;
-      uint64_t last_announce_height;
-      uint64_t last_announce_time;
-      uint64_t max_hop;
-      std::vector<peerlist_entry> peers;
-  };
-
 #define P2P_COMMANDS_POOL_BASE 1000
 
   /************************************************************************/
@@ -262,6 +253,54 @@ namespace nodetool
       struct response : public cryptonote::COMMAND_RPC_UNICAST::response { };
   };
 
+  // gossip mode: message ids are offered first, peers pull bodies they don't have
+  struct rta_inventory_item
+  {
+      uint32_t command;
+      std::string message_id;
+      // announce only, lets receiver learn tunnels from every peer offering it
+      std::string supernode_public_id;
+      uint64_t height;
+      uint64_t hop;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(command)
+        KV_SERIALIZE(message_id)
+        KV_SERIALIZE(supernode_public_id)
+        KV_SERIALIZE(height)
+        KV_SERIALIZE(hop)
+      END_KV_SERIALIZE_MAP()
+  };
+
+  struct COMMAND_RTA_INVENTORY
+  {
+      const static int ID = P2P_COMMANDS_POOL_BASE + 24;
+
+      struct request
+      {
+          std::vector<rta_inventory_item> items;
+
+          BEGIN_KV_SERIALIZE_MAP()
+            KV_SERIALIZE(items)
+          END_KV_SERIALIZE_MAP()
+      };
+  };
+
+  // bodies are sent back as the original COMMAND_BROADCAST/COMMAND_SUPERNODE_ANNOUNCE notifications
+  struct COMMAND_RTA_GET_BODIES
+  {
+      const static int ID = P2P_COMMANDS_POOL_BASE + 25;
+
+      struct request
+      {
+          std::list<std::string> message_ids;
+
+          BEGIN_KV_SERIALIZE_MAP()
+            KV_SERIALIZE(message_ids)
+          END_KV_SERIALIZE_MAP()
+      };
+  };
+
   /************************************************************************/
   /*                                                                      */
   /************************************************************************/
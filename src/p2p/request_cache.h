@@ -0,0 +1,215 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+
+#include "crypto/hash.h"
+
+namespace nodetool
+{
+  struct request_cache_stats
+  {
+    uint64_t size = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evicted = 0;
+  };
+
+  /**
+   * \brief request_cache - seen-set of p2p supernode message ids
+   *
+   * Ids are reduced to a 64-bit hash and spread over independently locked shards.
+   * Every shard keeps a ring of time buckets; a bucket is reused once it is older
+   * than the cache time, so expiry costs nothing on lookup and an id is remembered
+   * for at least ttl. Each shard holds at most max_entries / SHARDS ids, when full
+   * its oldest bucket is dropped early.
+   */
+  class request_cache
+  {
+  public:
+    static constexpr size_t SHARDS = 16;
+    static constexpr size_t BUCKETS = 5;
+
+    request_cache(uint64_t ttl_ms, size_t max_entries)
+        : m_bucket_ms(std::max<uint64_t>(1, (ttl_ms + BUCKETS - 2) / (BUCKETS - 1))),
+          m_shard_capacity(std::max<size_t>(1, max_entries / SHARDS))
+    {
+    }
+
+    /**
+     * \brief insert - records message id
+     * \return true if id wasn't seen before
+     */
+    bool insert(const std::string &message_id)
+    {
+        return insert(message_id, now_ms());
+    }
+
+    bool insert(const std::string &message_id, uint64_t now)
+    {
+        uint64_t key = hash_id(message_id);
+        shard &s = m_shards[key % SHARDS];
+        uint64_t epoch = now / m_bucket_ms;
+
+        boost::lock_guard<boost::mutex> guard(s.lock);
+        if (find(s, key, epoch))
+        {
+            ++m_hits;
+            return false;
+        }
+        ++m_misses;
+
+        bucket &current = rotate(s, epoch);
+        if (s.size >= m_shard_capacity)
+            evict_oldest(s, epoch);
+        if (s.size < m_shard_capacity)
+        {
+            current.keys.insert(key);
+            ++s.size;
+        }
+        return true;
+    }
+
+    bool contains(const std::string &message_id)
+    {
+        return contains(message_id, now_ms());
+    }
+
+    bool contains(const std::string &message_id, uint64_t now)
+    {
+        uint64_t key = hash_id(message_id);
+        shard &s = m_shards[key % SHARDS];
+        boost::lock_guard<boost::mutex> guard(s.lock);
+        return find(s, key, now / m_bucket_ms);
+    }
+
+    request_cache_stats get_stats()
+    {
+        request_cache_stats stats;
+        for (shard &s : m_shards)
+        {
+            boost::lock_guard<boost::mutex> guard(s.lock);
+            stats.size += s.size;
+        }
+        stats.hits = m_hits;
+        stats.misses = m_misses;
+        stats.evicted = m_evicted;
+        return stats;
+    }
+
+  private:
+    struct bucket
+    {
+        uint64_t epoch = 0;
+        std::unordered_set<uint64_t> keys;
+    };
+
+    struct shard
+    {
+        boost::mutex lock;
+        std::array<bucket, BUCKETS> buckets;
+        size_t size = 0;
+    };
+
+    static uint64_t now_ms()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static uint64_t hash_id(const std::string &message_id)
+    {
+        crypto::hash h;
+        crypto::cn_fast_hash(message_id.data(), message_id.size(), h);
+        uint64_t key;
+        memcpy(&key, h.data, sizeof(key));
+        return key;
+    }
+
+    static bool live(const bucket &b, uint64_t epoch)
+    {
+        return !b.keys.empty() && b.epoch + BUCKETS > epoch;
+    }
+
+    static bool find(const shard &s, uint64_t key, uint64_t epoch)
+    {
+        for (const bucket &b : s.buckets)
+        {
+            if (live(b, epoch) && b.keys.count(key))
+                return true;
+        }
+        return false;
+    }
+
+    // current bucket for the epoch, stale content is dropped
+    bucket &rotate(shard &s, uint64_t epoch)
+    {
+        bucket &b = s.buckets[epoch % BUCKETS];
+        if (b.epoch != epoch)
+        {
+            s.size -= b.keys.size();
+            std::unordered_set<uint64_t>().swap(b.keys);
+            b.epoch = epoch;
+        }
+        return b;
+    }
+
+    void evict_oldest(shard &s, uint64_t epoch)
+    {
+        bucket *oldest = nullptr;
+        for (bucket &b : s.buckets)
+        {
+            if (b.epoch != epoch && !b.keys.empty() && (!oldest || b.epoch < oldest->epoch))
+                oldest = &b;
+        }
+        if (!oldest)
+            return;
+        if (live(*oldest, epoch))
+            m_evicted += oldest->keys.size();
+        s.size -= oldest->keys.size();
+        std::unordered_set<uint64_t>().swap(oldest->keys);
+    }
+
+    const uint64_t m_bucket_ms;
+    const size_t m_shard_capacity;
+    std::array<shard, SHARDS> m_shards;
+    std::atomic<uint64_t> m_hits {0};
+    std::atomic<uint64_t> m_misses {0};
+    std::atomic<uint64_t> m_evicted {0};
+  };
+}
@@ -0,0 +1,235 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "misc_log_ex.h"
+#include "net/http_client.h"
+
+namespace nodetool
+{
+  struct supernode_forward_stats
+  {
+    uint64_t queued = 0;
+    uint64_t max_queued = 0;
+    uint64_t sent = 0;
+    uint64_t failed = 0;
+    uint64_t dropped = 0;
+    uint64_t latency_avg_us = 0;
+    uint64_t latency_max_us = 0;
+  };
+
+  /**
+   * \brief supernode_forwarder - bounded outbound queue to one local supernode
+   *
+   * p2p handlers only post requests here; a dedicated thread owns the http client
+   * and sends them in order. When the queue is full new requests are dropped
+   * instead of blocking the caller, so a slow supernode can't stall p2p processing.
+   * Latency is measured from post to response.
+   */
+  class supernode_forwarder : public std::enable_shared_from_this<supernode_forwarder>
+  {
+  public:
+    typedef std::chrono::steady_clock clock;
+    typedef std::function<bool(epee::net_utils::http::http_simple_client&)> send_func;
+
+    static std::shared_ptr<supernode_forwarder> create(const std::string &host, uint64_t port, size_t capacity)
+    {
+        std::shared_ptr<supernode_forwarder> forwarder(new supernode_forwarder(host, port, capacity));
+        forwarder->start();
+        return forwarder;
+    }
+
+    ~supernode_forwarder()
+    {
+        if (m_thread.joinable())
+            m_thread.detach();
+    }
+
+    /**
+     * \brief post - queues request, never blocks on the network
+     * \return false if the queue is full or forwarder is stopped, request is dropped
+     */
+    bool post(send_func &&send)
+    {
+        {
+            boost::lock_guard<boost::mutex> guard(m_lock);
+            if (m_stop || m_queue.size() >= m_capacity)
+            {
+                ++m_dropped;
+                return false;
+            }
+            m_queue.emplace_back(task{std::move(send), clock::now()});
+            if (m_queue.size() > m_max_queued)
+                m_max_queued = m_queue.size();
+        }
+        m_event.notify_one();
+        return true;
+    }
+
+    /**
+     * \brief set_server - changes supernode address, applied before the next send
+     */
+    void set_server(const std::string &host, uint64_t port)
+    {
+        boost::lock_guard<boost::mutex> guard(m_lock);
+        m_host = host;
+        m_port = port;
+        m_reconnect = true;
+    }
+
+    /**
+     * \brief stop - drops queued requests and stops sender
+     * \param wait - wait for the request in flight to complete
+     */
+    void stop(bool wait)
+    {
+        {
+            boost::lock_guard<boost::mutex> guard(m_lock);
+            m_dropped += m_queue.size();
+            m_queue.clear();
+            m_stop = true;
+        }
+        m_event.notify_one();
+        if (wait && m_thread.joinable() && m_thread.get_id() != boost::this_thread::get_id())
+            m_thread.join();
+    }
+
+    supernode_forward_stats get_stats() const
+    {
+        supernode_forward_stats stats;
+        {
+            boost::lock_guard<boost::mutex> guard(m_lock);
+            stats.queued = m_queue.size();
+            stats.max_queued = m_max_queued;
+            stats.dropped = m_dropped;
+        }
+        stats.sent = m_sent;
+        stats.failed = m_failed;
+        uint64_t done = stats.sent + stats.failed;
+        stats.latency_avg_us = done ? m_latency_sum_us / done : 0;
+        stats.latency_max_us = m_latency_max_us;
+        return stats;
+    }
+
+  private:
+    struct task
+    {
+        send_func send;
+        clock::time_point posted;
+    };
+
+    supernode_forwarder(const std::string &host, uint64_t port, size_t capacity)
+        : m_capacity(capacity), m_host(host), m_port(port), m_reconnect(true)
+    {
+    }
+
+    void start()
+    {
+        // sender keeps forwarder alive until it is stopped
+        std::shared_ptr<supernode_forwarder> self = shared_from_this();
+        m_thread = boost::thread([self]() { self->run(); });
+    }
+
+    void run()
+    {
+        epee::net_utils::http::http_simple_client client;
+        for (;;)
+        {
+            task t;
+            {
+                boost::unique_lock<boost::mutex> lock(m_lock);
+                while (!m_stop && m_queue.empty())
+                    m_event.wait(lock);
+                if (m_stop)
+                    break;
+                t = std::move(m_queue.front());
+                m_queue.pop_front();
+                if (m_reconnect)
+                {
+                    if (client.is_connected())
+                        client.disconnect();
+                    client.set_server(m_host, std::to_string(m_port), {});
+                    m_reconnect = false;
+                }
+            }
+
+            bool ok = false;
+            try
+            {
+                ok = t.send(client);
+            }
+            catch (const std::exception &e)
+            {
+                MERROR("Failed to post request to supernode: " << e.what());
+            }
+
+            uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - t.posted).count();
+            m_latency_sum_us += latency;
+            if (latency > m_latency_max_us)
+                m_latency_max_us = latency;
+            if (ok)
+                ++m_sent;
+            else
+                ++m_failed;
+        }
+        if (client.is_connected())
+            client.disconnect();
+    }
+
+    const size_t m_capacity;
+    mutable boost::mutex m_lock;
+    boost::condition_variable m_event;
+    std::deque<task> m_queue;
+    std::string m_host;
+    uint64_t m_port;
+    bool m_reconnect;
+    bool m_stop = false;
+    uint64_t m_max_queued = 0;
+    uint64_t m_dropped = 0;
+    boost::thread m_thread;
+
+    // written by the sender thread only
+    std::atomic<uint64_t> m_sent {0};
+    std::atomic<uint64_t> m_failed {0};
+    std::atomic<uint64_t> m_latency_sum_us {0};
+    std::atomic<uint64_t> m_latency_max_us {0};
+  };
+}
@@ -0,0 +1,393 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "misc_log_ex.h"
+#include "storages/portable_storage_template_helper.h"
+#include "cryptonote_basic/cryptonote_basic_impl.h"
+#include "cryptonote_core/blockchain_based_list.h"
+#include "cryptonote_core/stake_transaction_storage.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+
+namespace nodetool
+{
+  /**
+   * \brief supernode_list_encoder - encodes blockchain based list and stakes pushed to local supernodes
+   *
+   * Remembers the last list of each kind to produce a delta against the previous
+   * block, and the textual address of every supernode so an address is converted
+   * only when it changes. Used from the feed thread only, not thread safe.
+   */
+  class supernode_list_encoder
+  {
+  public:
+    typedef std::shared_ptr<const std::string> blob_ptr;
+    typedef cryptonote::BlockchainBasedList::supernode_tier_array supernode_tier_array;
+    typedef cryptonote::StakeTransactionStorage::supernode_stake_array supernode_stake_array;
+
+    static constexpr uint32_t FEED_VERSION = 1;
+
+    struct encoded
+    {
+      uint64_t block_height = 0;
+      uint64_t base_block_height = 0;
+      blob_ptr delta; // null if the previous block isn't known, full has to be sent
+      blob_ptr full;  // null unless requested or there is no delta
+    };
+
+    explicit supernode_list_encoder(bool testnet)
+      : m_testnet(testnet), m_list_height(0), m_list_valid(false), m_stakes_height(0), m_stakes_valid(false)
+    {
+    }
+
+    /**
+     * \brief encode_blockchain_based_list
+     * \param need_full - encode the full list even if there is a delta
+     * \param legacy - if not null, filled with the full JSON-RPC request
+     */
+    encoded encode_blockchain_based_list(uint64_t height, const supernode_tier_array &tiers, bool need_full,
+                                         cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST::request *legacy)
+    {
+      typedef cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST rpc_list;
+      typedef cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST_DELTA rpc_delta;
+
+      const bool has_delta = m_list_valid && height == m_list_height + 1;
+      encoded result;
+      result.block_height = height;
+
+      std::vector<list_tier> new_tiers(tiers.size());
+      rpc_delta::request delta = AUTO_VAL_INIT(delta), full = AUTO_VAL_INIT(full);
+      delta.version = full.version = FEED_VERSION;
+      delta.block_height = full.block_height = height;
+      delta.base_block_height = m_list_height;
+      full.base_block_height = height;
+      full.full = true;
+      delta.tiers.resize(tiers.size());
+      full.tiers.resize(tiers.size());
+      if (legacy)
+      {
+        legacy->block_height = height;
+        legacy->tiers.clear();
+        legacy->tiers.resize(tiers.size());
+      }
+
+      for (size_t i = 0; i < tiers.size(); ++i)
+      {
+        const list_tier *old_tier = i < m_list.size() ? &m_list[i] : nullptr;
+        list_tier &new_tier = new_tiers[i];
+        new_tier.reserve(tiers[i].size());
+        for (const cryptonote::BlockchainBasedList::supernode &src : tiers[i])
+        {
+          list_entry &entry = new_tier[src.supernode_public_id];
+          entry.address = src.supernode_public_address;
+          entry.amount = src.amount;
+
+          bool changed = true;
+          if (has_delta && old_tier)
+          {
+            auto it = old_tier->find(src.supernode_public_id);
+            changed = it == old_tier->end() || it->second.amount != entry.amount || !same_address(it->second.address, entry.address);
+          }
+          if (has_delta && !changed && !need_full && !legacy)
+            continue;
+
+          rpc_list::supernode dst;
+          dst.supernode_public_id = src.supernode_public_id;
+          dst.supernode_public_address = address_str(src.supernode_public_id, src.supernode_public_address);
+          dst.amount = src.amount;
+          if (has_delta && changed)
+            delta.tiers[i].added.push_back(dst);
+          if (need_full || !has_delta)
+            full.tiers[i].added.push_back(dst);
+          if (legacy)
+            legacy->tiers[i].supernodes.emplace_back(std::move(dst));
+        }
+        if (has_delta && old_tier)
+        {
+          for (const auto &old : *old_tier)
+            if (!new_tier.count(old.first))
+              delta.tiers[i].removed.push_back(old.first);
+        }
+      }
+      if (has_delta)
+      {
+        // tiers dropped from the list
+        for (size_t i = tiers.size(); i < m_list.size(); ++i)
+        {
+          delta.tiers.emplace_back();
+          for (const auto &old : m_list[i])
+            delta.tiers.back().removed.push_back(old.first);
+        }
+        result.base_block_height = m_list_height;
+        result.delta = to_blob(delta);
+      }
+      if (need_full || !has_delta)
+        result.full = to_blob(full);
+
+      // lists resent on request for older blocks don't replace the latest one
+      if (!m_list_valid || height >= m_list_height)
+      {
+        m_list.swap(new_tiers);
+        m_list_height = height;
+        m_list_valid = true;
+      }
+      return result;
+    }
+
+    /**
+     * \brief encode_stakes
+     * \param need_full - encode all stakes even if there is a delta
+     * \param legacy - if not null, filled with the full JSON-RPC request
+     */
+    encoded encode_stakes(uint64_t height, const supernode_stake_array &stakes, bool need_full,
+                          cryptonote::COMMAND_RPC_SUPERNODE_STAKES::request *legacy)
+    {
+      typedef cryptonote::COMMAND_RPC_SUPERNODE_STAKES rpc_stakes;
+      typedef cryptonote::COMMAND_RPC_SUPERNODE_STAKES_DELTA rpc_delta;
+
+      const bool has_delta = m_stakes_valid && height == m_stakes_height + 1;
+      encoded result;
+      result.block_height = height;
+
+      std::unordered_map<std::string, cryptonote::supernode_stake> new_stakes;
+      new_stakes.reserve(stakes.size());
+      rpc_delta::request delta = AUTO_VAL_INIT(delta), full = AUTO_VAL_INIT(full);
+      delta.version = full.version = FEED_VERSION;
+      delta.block_height = full.block_height = height;
+      delta.base_block_height = m_stakes_height;
+      full.base_block_height = height;
+      full.full = true;
+      if (legacy)
+      {
+        legacy->block_height = height;
+        legacy->stakes.clear();
+        legacy->stakes.reserve(stakes.size());
+      }
+
+      for (const cryptonote::supernode_stake &src : stakes)
+      {
+        new_stakes[src.supernode_public_id] = src;
+
+        bool changed = true;
+        if (has_delta)
+        {
+          auto it = m_stakes.find(src.supernode_public_id);
+          changed = it == m_stakes.end() || !same_stake(it->second, src);
+          if (!changed && !need_full && !legacy)
+            continue;
+        }
+
+        rpc_stakes::supernode_stake dst;
+        dst.amount = src.amount;
+        dst.tier = src.tier;
+        dst.block_height = src.block_height;
+        dst.unlock_time = src.unlock_time;
+        dst.supernode_public_id = src.supernode_public_id;
+        dst.supernode_public_address = address_str(src.supernode_public_id, src.supernode_public_address);
+        if (has_delta && changed)
+          delta.added.push_back(dst);
+        if (need_full || !has_delta)
+          full.added.push_back(dst);
+        if (legacy)
+          legacy->stakes.emplace_back(std::move(dst));
+      }
+      if (has_delta)
+      {
+        for (const auto &old : m_stakes)
+          if (!new_stakes.count(old.first))
+            delta.removed.push_back(old.first);
+        result.base_block_height = m_stakes_height;
+        result.delta = to_blob(delta);
+      }
+      if (need_full || !has_delta)
+        result.full = to_blob(full);
+
+      if (!m_stakes_valid || height >= m_stakes_height)
+      {
+        m_stakes.swap(new_stakes);
+        m_stakes_height = height;
+        m_stakes_valid = true;
+      }
+      return result;
+    }
+
+    size_t cached_addresses() const { return m_addresses.size(); }
+
+    static constexpr size_t MAX_CACHED_ADDRESSES = 64 * 1024;
+
+  private:
+    struct list_entry
+    {
+      cryptonote::account_public_address address;
+      uint64_t amount;
+    };
+    typedef std::unordered_map<std::string, list_entry> list_tier;
+
+    struct address_entry
+    {
+      cryptonote::account_public_address address;
+      std::string str;
+    };
+
+    static bool same_address(const cryptonote::account_public_address &a, const cryptonote::account_public_address &b)
+    {
+      return std::memcmp(&a, &b, sizeof(a)) == 0;
+    }
+
+    static bool same_stake(const cryptonote::supernode_stake &a, const cryptonote::supernode_stake &b)
+    {
+      return a.amount == b.amount && a.tier == b.tier && a.block_height == b.block_height &&
+             a.unlock_time == b.unlock_time && same_address(a.supernode_public_address, b.supernode_public_address);
+    }
+
+    const std::string &address_str(const std::string &id, const cryptonote::account_public_address &address)
+    {
+      auto it = m_addresses.find(id);
+      if (it != m_addresses.end() && same_address(it->second.address, address))
+        return it->second.str;
+      if (it == m_addresses.end())
+      {
+        // ids of supernodes gone long ago aren't worth keeping
+        if (m_addresses.size() >= MAX_CACHED_ADDRESSES)
+          m_addresses.clear();
+        it = m_addresses.emplace(id, address_entry()).first;
+      }
+      it->second.address = address;
+      it->second.str = cryptonote::get_account_address_as_str(m_testnet, address);
+      return it->second.str;
+    }
+
+    template<class T>
+    static blob_ptr to_blob(const T &request)
+    {
+      std::shared_ptr<std::string> blob = std::make_shared<std::string>();
+      epee::serialization::store_t_to_binary(request, *blob);
+      return blob;
+    }
+
+    const bool m_testnet;
+    std::unordered_map<std::string, address_entry> m_addresses;
+    std::vector<list_tier> m_list;
+    uint64_t m_list_height;
+    bool m_list_valid;
+    std::unordered_map<std::string, cryptonote::supernode_stake> m_stakes;
+    uint64_t m_stakes_height;
+    bool m_stakes_valid;
+  };
+
+  /**
+   * \brief supernode_feed_worker - runs supernode list pushes one by one on its own thread,
+   *        so encoding happens outside of the core and supernode locks
+   */
+  class supernode_feed_worker
+  {
+  public:
+    typedef std::function<void()> job;
+
+    supernode_feed_worker() : m_stop(false), m_started(false) {}
+
+    ~supernode_feed_worker()
+    {
+      stop();
+    }
+
+    void post(job &&j)
+    {
+      boost::unique_lock<boost::mutex> lock(m_lock);
+      if (m_stop)
+        return;
+      if (!m_started)
+      {
+        m_thread = boost::thread([this] { run(); });
+        m_started = true;
+      }
+      m_jobs.push_back(std::move(j));
+      m_cond.notify_one();
+    }
+
+    // drops jobs not started yet and waits for the running one
+    void stop()
+    {
+      {
+        boost::unique_lock<boost::mutex> lock(m_lock);
+        m_stop = true;
+        m_jobs.clear();
+        m_cond.notify_all();
+      }
+      if (m_thread.joinable())
+        m_thread.join();
+    }
+
+  private:
+    void run()
+    {
+      for (;;)
+      {
+        job j;
+        {
+          boost::unique_lock<boost::mutex> lock(m_lock);
+          while (!m_stop && m_jobs.empty())
+            m_cond.wait(lock);
+          if (m_stop)
+            return;
+          j = std::move(m_jobs.front());
+          m_jobs.pop_front();
+        }
+        try
+        {
+          j();
+        }
+        catch (const std::exception &e)
+        {
+          MERROR("supernode feed: " << e.what());
+        }
+      }
+    }
+
+    boost::mutex m_lock;
+    boost::condition_variable m_cond;
+    std::deque<job> m_jobs;
+    boost::thread m_thread;
+    bool m_stop;
+    bool m_started;
+  };
+}
@@ -0,0 +1,282 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+#include "string_tools.h"
+#include "p2p_protocol_defs.h"
+
+namespace nodetool
+{
+  /**
+   * \brief supernode_route_table - tunnels to remote supernodes learned from announces
+   *
+   * Routes are keyed by binary supernode id and kept as immutable snapshots: an
+   * announce copies one route, updates it and swaps the pointer, so readers only
+   * hold the lock to copy pointers. Peers of a route are ranked on update by the
+   * announce height they delivered, hop count and recency; peers whose last sends
+   * failed are moved behind the others on lookup.
+   */
+  class supernode_route_table
+  {
+  public:
+    // peers kept per route, best ones first
+    static constexpr size_t MAX_ROUTE_PEERS = 8;
+    // peer is moved to the end of the ranking after this many failed sends in a row
+    static constexpr uint32_t MAX_PEER_FAILURES = 3;
+    static constexpr size_t MAX_FAILED_PEERS = 1024;
+
+    enum update_result
+    {
+      route_stale,      // announce is older than the route
+      route_duplicate,  // same announce via another peer, don't relay
+      route_updated     // new announce, relay it
+    };
+
+    struct route_peer
+    {
+      peerlist_entry entry;
+      uint64_t height;
+      uint64_t hop;
+      uint64_t last_seen;
+    };
+
+    struct route
+    {
+      std::string id;
+      uint64_t last_announce_height;
+      uint64_t last_announce_time;
+      uint64_t max_hop;
+      std::vector<route_peer> peers;
+    };
+
+    typedef std::shared_ptr<const route> route_ptr;
+
+    explicit supernode_route_table(uint64_t duplicate_window_seconds)
+      : m_duplicate_window(duplicate_window_seconds)
+    {
+    }
+
+    update_result update(const std::string &id, const peerlist_entry &pe, uint64_t height, uint64_t hop, uint64_t now)
+    {
+      crypto::public_key key = make_key(id);
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      auto it = m_routes.find(key);
+      if (it == m_routes.end())
+      {
+        std::shared_ptr<route> r = std::make_shared<route>();
+        r->id = id;
+        r->last_announce_height = height;
+        r->last_announce_time = now;
+        r->max_hop = hop;
+        r->peers.push_back(route_peer{pe, height, hop, now});
+        m_routes.emplace(key, std::move(r));
+        return route_updated;
+      }
+
+      const route &old = *it->second;
+      if (old.last_announce_height > height)
+        return route_stale;
+
+      bool duplicate = old.last_announce_height == height && old.last_announce_time + m_duplicate_window > now;
+      if (duplicate)
+      {
+        auto pit = std::find_if(old.peers.begin(), old.peers.end(),
+                                [&pe](const route_peer &p) { return p.entry.id == pe.id; });
+        if (pit != old.peers.end() && pit->height == height)
+          return route_duplicate;
+      }
+
+      std::shared_ptr<route> r = std::make_shared<route>(old);
+      if (!duplicate)
+      {
+        r->last_announce_height = height;
+        r->last_announce_time = now;
+      }
+      upsert_peer(*r, route_peer{pe, height, hop, now});
+      r->max_hop = 0;
+      for (const route_peer &p : r->peers)
+      {
+        if (p.height == r->last_announce_height)
+          r->max_hop = std::max(r->max_hop, p.hop);
+      }
+      it->second = std::move(r);
+      return duplicate ? route_duplicate : route_updated;
+    }
+
+    /**
+     * \brief find_peers - ranked peers for every id in one lookup
+     * \return peers in the order of ids, empty for unknown ids
+     */
+    std::vector<std::vector<peerlist_entry>> find_peers(const std::list<std::string> &ids) const
+    {
+      std::vector<crypto::public_key> keys;
+      keys.reserve(ids.size());
+      for (const std::string &id : ids)
+        keys.push_back(make_key(id));
+
+      std::vector<std::vector<peerlist_entry>> result(keys.size());
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      for (size_t i = 0; i < keys.size(); ++i)
+      {
+        auto it = m_routes.find(keys[i]);
+        if (it == m_routes.end())
+          continue;
+        std::vector<peerlist_entry> &peers = result[i];
+        std::vector<peerlist_entry> failing;
+        for (const route_peer &p : it->second->peers)
+        {
+          auto fit = m_failures.find(p.entry.id);
+          if (fit != m_failures.end() && fit->second >= MAX_PEER_FAILURES)
+            failing.push_back(p.entry);
+          else
+            peers.push_back(p.entry);
+        }
+        peers.insert(peers.end(), failing.begin(), failing.end());
+      }
+      return result;
+    }
+
+    uint64_t max_hop(const std::list<std::string> &ids) const
+    {
+      std::vector<crypto::public_key> keys;
+      keys.reserve(ids.size());
+      for (const std::string &id : ids)
+        keys.push_back(make_key(id));
+
+      uint64_t hop = 0;
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      for (const crypto::public_key &key : keys)
+      {
+        auto it = m_routes.find(key);
+        if (it != m_routes.end())
+          hop = std::max(hop, it->second->max_hop);
+      }
+      return hop;
+    }
+
+    uint64_t max_hop() const
+    {
+      uint64_t hop = 0;
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      for (const auto &r : m_routes)
+        hop = std::max(hop, r.second->max_hop);
+      return hop;
+    }
+
+    /**
+     * \brief report - result of sending to a tunnel peer
+     */
+    void report(peerid_type peer_id, bool sent)
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      if (sent)
+      {
+        m_failures.erase(peer_id);
+        return;
+      }
+      // failures of disconnected peers are never reset, keep the map bounded
+      if (m_failures.size() >= MAX_FAILED_PEERS)
+        m_failures.clear();
+      ++m_failures[peer_id];
+    }
+
+    std::vector<route_ptr> snapshot() const
+    {
+      std::vector<route_ptr> routes;
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      routes.reserve(m_routes.size());
+      for (const auto &r : m_routes)
+        routes.push_back(r.second);
+      return routes;
+    }
+
+    size_t size() const
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      return m_routes.size();
+    }
+
+    // supernode ids are hex public keys, anything else is hashed
+    static crypto::public_key make_key(const std::string &id)
+    {
+      crypto::public_key key;
+      if (!epee::string_tools::hex_to_pod(id, key))
+      {
+        crypto::hash h;
+        crypto::cn_fast_hash(id.data(), id.size(), h);
+        memcpy(&key, &h, sizeof(key));
+      }
+      return key;
+    }
+
+  private:
+    static void upsert_peer(route &r, const route_peer &peer)
+    {
+      auto pit = std::find_if(r.peers.begin(), r.peers.end(),
+                              [&peer](const route_peer &p) { return p.entry.id == peer.entry.id; });
+      if (pit != r.peers.end())
+        *pit = peer;
+      else
+        r.peers.push_back(peer);
+
+      // peers which haven't delivered the current or previous announce are dropped
+      uint64_t height = r.last_announce_height;
+      r.peers.erase(std::remove_if(r.peers.begin(), r.peers.end(),
+                                   [height](const route_peer &p) { return p.height + 1 < height; }),
+                    r.peers.end());
+
+      std::stable_sort(r.peers.begin(), r.peers.end(), [](const route_peer &a, const route_peer &b) {
+        if (a.height != b.height)
+          return a.height > b.height;
+        if (a.hop != b.hop)
+          return a.hop < b.hop;
+        return a.last_seen > b.last_seen;
+      });
+      if (r.peers.size() > MAX_ROUTE_PEERS)
+        r.peers.resize(MAX_ROUTE_PEERS);
+    }
+
+    const uint64_t m_duplicate_window;
+    mutable boost::mutex m_lock;
+    std::unordered_map<crypto::public_key, std::shared_ptr<const route>> m_routes;
+    std::unordered_map<peerid_type, uint32_t> m_failures;
+  };
+}
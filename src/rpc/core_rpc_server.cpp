@@ -59,6 +59,28 @@ namespace cryptonote
     cryptonote::account_public_address acc = AUTO_VAL_INIT(acc);
     return wallet_addr.size() && cryptonote::get_account_address_from_str(acc, testnet, wallet_addr);
   }
+
+  template<class t_metrics>
+  void fill_traffic_stats(const t_metrics &metrics, std::vector<COMMAND_RPC_GET_TRAFFIC_STATS::command_stats> &out)
+  {
+    for (const auto &c : metrics.snapshot())
+    {
+      COMMAND_RPC_GET_TRAFFIC_STATS::command_stats stats;
+      stats.command = metrics.get_name(c.first);
+      stats.messages_in = c.second.messages_in;
+      stats.bytes_in = c.second.bytes_in;
+      stats.messages_out = c.second.messages_out;
+      stats.bytes_out = c.second.bytes_out;
+      stats.handled = c.second.handled;
+      stats.errors = c.second.errors;
+      stats.exec_us_total = c.second.exec_us_total;
+      stats.exec_us_max = c.second.exec_us_max;
+      stats.wait_us_total = c.second.wait_us_total;
+      stats.wait_us_max = c.second.wait_us_max;
+      stats.exec_histogram.assign(c.second.exec_histogram, c.second.exec_histogram + t_metrics::HISTOGRAM_BUCKETS);
+      out.push_back(stats);
+    }
+  }
   //-----------------------------------------------------------------------------------
   void core_rpc_server::init_options(boost::program_options::options_description& desc)
   {
@@ -1757,6 +1779,27 @@ namespace cryptonote
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_traffic_stats(const COMMAND_RPC_GET_TRAFFIC_STATS::request& req, COMMAND_RPC_GET_TRAFFIC_STATS::response& res, epee::json_rpc::error& error_resp)
+  {
+    const uint64_t *bounds = epee::net_utils::levin_traffic_metrics::histogram_bounds();
+    res.histogram_bounds_us.assign(bounds, bounds + epee::net_utils::levin_traffic_metrics::HISTOGRAM_BUCKETS - 1);
+    fill_traffic_stats(epee::net_utils::get_levin_metrics(), res.p2p);
+    fill_traffic_stats(epee::net_utils::get_rpc_metrics(), res.rpc);
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_metrics(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, const connection_context& context)
+  {
+    if (m_restricted)
+      return false;
+    response_info.m_body = epee::net_utils::get_levin_metrics().to_text("graft_p2p", "command");
+    response_info.m_body += epee::net_utils::get_rpc_metrics().to_text("graft_rpc", "method");
+    response_info.m_mime_tipe = "text/plain";
+    response_info.m_header_info.m_content_type = " text/plain; version=0.0.4";
+    return true;
+  }
 
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_supernode_announce(const COMMAND_RPC_SUPERNODE_ANNOUNCE::request &req, COMMAND_RPC_SUPERNODE_ANNOUNCE::response &res, json_rpc::error &error_resp)
@@ -1790,6 +1833,7 @@ namespace cryptonote
 
       // send p2p stakes
       m_p2p.add_supernode(req.supernode_public_id, req.network_address);
+      m_p2p.set_supernode_stakes_feed_version(req.supernode_public_id, req.delta_feed_version);
       m_p2p.send_stakes_to_supernode();
       res.status = 0;
       MDEBUG("RPC Request: on_supernode_stakes: end");
@@ -1809,6 +1853,7 @@ namespace cryptonote
 
       // send p2p stake txs
       m_p2p.add_supernode(req.supernode_public_id, req.network_address);
+      m_p2p.set_supernode_list_feed_version(req.supernode_public_id, req.delta_feed_version);
       m_p2p.send_blockchain_based_list_to_supernode(req.last_received_block_height);
       res.status = 0;
       MDEBUG("RPC Request: on_supernode_blockchain_based_list: end");
@@ -1940,6 +1985,34 @@ namespace cryptonote
       res.broadcast_bytes_out = m_p2p.get_broadcast_bytes_out();
       res.multicast_bytes_in = m_p2p.get_multicast_bytes_in();
       res.multicast_bytes_out = m_p2p.get_multicast_bytes_out();
+
+      res.forward_queued = 0;
+      res.forward_dropped = 0;
+      for (const auto &sn : m_p2p.get_supernode_forward_stats())
+      {
+          COMMAND_RPC_RTA_STATS::forward_queue queue;
+          queue.address = sn.first;
+          queue.queued = sn.second.queued;
+          queue.max_queued = sn.second.max_queued;
+          queue.sent = sn.second.sent;
+          queue.failed = sn.second.failed;
+          queue.dropped = sn.second.dropped;
+          queue.latency_avg_us = sn.second.latency_avg_us;
+          queue.latency_max_us = sn.second.latency_max_us;
+          res.forward_queued += queue.queued;
+          res.forward_dropped += queue.dropped;
+          res.forward_queues.push_back(queue);
+      }
+
+      nodetool::request_cache_stats cache = m_p2p.get_request_cache_stats();
+      res.request_cache_size = cache.size;
+      res.request_cache_hits = cache.hits;
+      res.request_cache_misses = cache.misses;
+      res.request_cache_evicted = cache.evicted;
+
+      res.gossip_bytes_in = m_p2p.get_gossip_bytes_in();
+      res.gossip_bytes_out = m_p2p.get_gossip_bytes_out();
+      res.gossip_inventory_size = m_p2p.get_gossip_inventory_size();
       return true;
   }
 
@@ -1711,9 +1711,11 @@ namespace cryptonote
     {
       std::string supernode_public_id;
       std::string network_address;
+      uint32_t    delta_feed_version; // 0 - JSON full stakes on every block, otherwise binary deltas
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(supernode_public_id)
         KV_SERIALIZE(network_address)
+        KV_SERIALIZE_OPT(delta_feed_version, (uint32_t)0)
       END_KV_SERIALIZE_MAP()
     };
 
@@ -1772,10 +1774,12 @@ namespace cryptonote
       std::string supernode_public_id;
       std::string network_address;
       uint64_t    last_received_block_height;
+      uint32_t    delta_feed_version; // 0 - JSON full list on every block, otherwise binary deltas
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(supernode_public_id)
         KV_SERIALIZE(network_address)
         KV_SERIALIZE(last_received_block_height)
+        KV_SERIALIZE_OPT(delta_feed_version, (uint32_t)0)
       END_KV_SERIALIZE_MAP()
     };
 
@@ -1829,6 +1833,75 @@ namespace cryptonote
     };
   };
 
+  // Binary (epee portable storage) feeds pushed to supernodes which asked for delta_feed_version.
+  // A delta lists per tier the supernodes added or changed and the ids removed since
+  // base_block_height; a full update (full = true) lists everything and replaces the list.
+  struct COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST_DELTA
+  {
+    struct tier
+    {
+      std::vector<COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST::supernode> added;
+      std::vector<std::string> removed;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(added)
+        KV_SERIALIZE(removed)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct request
+    {
+      uint32_t version;
+      uint64_t block_height;
+      uint64_t base_block_height;
+      bool full;
+      std::vector<tier> tiers;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(version)
+        KV_SERIALIZE(block_height)
+        KV_SERIALIZE(base_block_height)
+        KV_SERIALIZE(full)
+        KV_SERIALIZE(tiers)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      int64_t status;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  struct COMMAND_RPC_SUPERNODE_STAKES_DELTA
+  {
+    struct request
+    {
+      uint32_t version;
+      uint64_t block_height;
+      uint64_t base_block_height;
+      bool full;
+      std::vector<COMMAND_RPC_SUPERNODE_STAKES::supernode_stake> added;
+      std::vector<std::string> removed;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(version)
+        KV_SERIALIZE(block_height)
+        KV_SERIALIZE(base_block_height)
+        KV_SERIALIZE(full)
+        KV_SERIALIZE(added)
+        KV_SERIALIZE(removed)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      int64_t status;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
   struct COMMAND_RPC_SUPERNODE_ANNOUNCE
   {
     struct request
@@ -1995,6 +2068,29 @@ namespace cryptonote
       END_KV_SERIALIZE_MAP()
     };
 
+    // outbound queue from p2p to one local supernode
+    struct forward_queue
+    {
+      std::string address;
+      uint64_t queued;
+      uint64_t max_queued;
+      uint64_t sent;
+      uint64_t failed;
+      uint64_t dropped;
+      uint64_t latency_avg_us;
+      uint64_t latency_max_us;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(address)
+        KV_SERIALIZE(queued)
+        KV_SERIALIZE(max_queued)
+        KV_SERIALIZE(sent)
+        KV_SERIALIZE(failed)
+        KV_SERIALIZE(dropped)
+        KV_SERIALIZE(latency_avg_us)
+        KV_SERIALIZE(latency_max_us)
+      END_KV_SERIALIZE_MAP()
+    };
+
     struct response
     {
       uint64_t announce_bytes_in;
@@ -2003,6 +2099,16 @@ namespace cryptonote
       uint64_t broadcast_bytes_out;
       uint64_t multicast_bytes_in;
       uint64_t multicast_bytes_out;
+      uint64_t forward_queued;
+      uint64_t forward_dropped;
+      std::vector<forward_queue> forward_queues;
+      uint64_t request_cache_size;
+      uint64_t request_cache_hits;
+      uint64_t request_cache_misses;
+      uint64_t request_cache_evicted;
+      uint64_t gossip_bytes_in;
+      uint64_t gossip_bytes_out;
+      uint64_t gossip_inventory_size;
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(announce_bytes_in)
         KV_SERIALIZE(announce_bytes_out)
@@ -2010,6 +2116,71 @@ namespace cryptonote
         KV_SERIALIZE(broadcast_bytes_out)
         KV_SERIALIZE(multicast_bytes_in)
         KV_SERIALIZE(multicast_bytes_out)
+        KV_SERIALIZE(forward_queued)
+        KV_SERIALIZE(forward_dropped)
+        KV_SERIALIZE(forward_queues)
+        KV_SERIALIZE(request_cache_size)
+        KV_SERIALIZE(request_cache_hits)
+        KV_SERIALIZE(request_cache_misses)
+        KV_SERIALIZE(request_cache_evicted)
+        KV_SERIALIZE(gossip_bytes_in)
+        KV_SERIALIZE(gossip_bytes_out)
+        KV_SERIALIZE(gossip_inventory_size)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  struct COMMAND_RPC_GET_TRAFFIC_STATS
+  {
+    struct request
+    {
+      BEGIN_KV_SERIALIZE_MAP()
+      END_KV_SERIALIZE_MAP()
+    };
+
+    // counters of one levin command or RPC method, times in microseconds
+    struct command_stats
+    {
+      std::string command;
+      uint64_t messages_in;
+      uint64_t bytes_in;
+      uint64_t messages_out;
+      uint64_t bytes_out;
+      uint64_t handled;
+      uint64_t errors;
+      uint64_t exec_us_total;
+      uint64_t exec_us_max;
+      uint64_t wait_us_total;
+      uint64_t wait_us_max;
+      std::vector<uint64_t> exec_histogram;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(command)
+        KV_SERIALIZE(messages_in)
+        KV_SERIALIZE(bytes_in)
+        KV_SERIALIZE(messages_out)
+        KV_SERIALIZE(bytes_out)
+        KV_SERIALIZE(handled)
+        KV_SERIALIZE(errors)
+        KV_SERIALIZE(exec_us_total)
+        KV_SERIALIZE(exec_us_max)
+        KV_SERIALIZE(wait_us_total)
+        KV_SERIALIZE(wait_us_max)
+        KV_SERIALIZE(exec_histogram)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      // upper bounds of exec_histogram buckets, the last bucket is unbounded
+      std::vector<uint64_t> histogram_bounds_us;
+      std::vector<command_stats> p2p;
+      std::vector<command_stats> rpc;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(histogram_bounds_us)
+        KV_SERIALIZE(p2p)
+        KV_SERIALIZE(rpc)
       END_KV_SERIALIZE_MAP()
     };
   };
@@ -28,6 +28,7 @@
 //
 
 #include "AuthSample.h"
+#include "RTATracer.h"
 
 
 
@@ -38,6 +39,7 @@ void supernode::AuthSample::Init()  {
 
 
 bool supernode::AuthSample::PosProxySale(const rpc_command::POS_PROXY_SALE::request& in, rpc_command::POS_PROXY_SALE::response& out) {
+	RTATracer::Scope trace(in.PaymentID, "AuthSample.PosProxySale");
 	RTA_TransactionRecord tr;
 	rpc_command::ConvertToTR(tr, in, m_Servant);
 
@@ -59,11 +61,12 @@ bool supernode::AuthSample::PosProxySale(const rpc_command::POS_PROXY_SALE::requ
 }
 
 bool supernode::AuthSample::WalletProxyPay(const rpc_command::WALLET_PROXY_PAY::request& in, rpc_command::WALLET_PROXY_PAY::response& out) {
+	RTATracer::Scope trace(in.PaymentID, "AuthSample.WalletProxyPay");
 	boost::shared_ptr<BaseRTAObject> ff = ObjectByPayment(in.PaymentID);
 	boost::shared_ptr<AuthSampleObject> data = boost::dynamic_pointer_cast<AuthSampleObject>(ff);
-    if(!data) { LOG_PRINT_L4("not found object: "<<in.PaymentID<<"  in: "<<m_DAPIServer->Port()); return false; }
+    if(!data) { LOG_PRINT_L4("not found object: "<<in.PaymentID<<"  in: "<<m_DAPIServer->Port()); trace.Failed(); return false; }
 
-    if( !data->WalletProxyPay(in, out) ) { LOG_PRINT_L4("!WalletProxyPay"); Remove(data); return false; }
+    if( !data->WalletProxyPay(in, out) ) { LOG_PRINT_L4("!WalletProxyPay"); trace.Failed(); Remove(data); return false; }
 
 	return true;
 }
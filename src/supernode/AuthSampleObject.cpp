@@ -29,6 +29,7 @@
 
 #include "AuthSampleObject.h"
 #include "graft_wallet2.h"
+#include "RTATracer.h"
 
 void supernode::AuthSampleObject::Owner(AuthSample* o) { m_Owner = o; }
 
@@ -61,11 +62,12 @@ bool supernode::AuthSampleObject::WalletProxyPay(const rpc_command::WALLET_PROXY
 }
 
 bool supernode::AuthSampleObject::WalletPutTxInPool(const rpc_command::WALLET_PUT_TX_IN_POOL::request& in, rpc_command::WALLET_PUT_TX_IN_POOL::response& out) {
+	RTATracer::Scope trace(TransactionRecord.PaymentID, "AuthSample.WalletPutTxInPool");
 	// all ok, notify PoS about this
 	rpc_command::POS_TR_SIGNED::request req;
 	rpc_command::POS_TR_SIGNED::response resp;
 	req.TransactionPoolID = in.TransactionPoolID;
-	if( !SendDAPICall(PosIP, PosPort, dapi_call::PoSTRSigned, req, resp) ) return false;
+	if( !SendDAPICall(PosIP, PosPort, dapi_call::PoSTRSigned, req, resp) ) { trace.Failed(); return false; }
 
 
 	return true;
@@ -56,6 +56,10 @@ bool supernode::BaseRTAObject::CheckSign(const string& wallet, const string& sig
 	return m_Servant->IsSignValid( TransactionRecord.MessageForSign(), wallet, sign );
 }
 
+bool supernode::BaseRTAObject::CheckSigns(const vector< pair<string, string> >& signs, vector<bool>& results) {
+	return m_Servant->AreSignsValid( TransactionRecord.MessageForSign(), signs, results );
+}
+
 void supernode::BaseRTAObject::MarkForDelete() {
 	boost::lock_guard<boost::recursive_mutex> lock(m_HanlderIdxGuard);
 	m_ReadyForDelete = true;
@@ -34,7 +34,8 @@
 #include "SubNetBroadcast.h"
 #include "DAPI_RPC_Server.h"
 #include "FSN_ServantBase.h"
-#include "DAPI_RPC_Client.h"
+#include "DAPI_RPC_ClientPool.h"
+#include "RTATracer.h"
 #include <string>
 using namespace std;
 
@@ -60,13 +61,16 @@ namespace supernode {
 
 		template<class IN_t, class OUT_t>
 		bool SendDAPICall(const string& ip, const string& port, const string& method, IN_t& req, OUT_t& resp) {
-			DAPI_RPC_Client call;
-			call.Set(ip, port);
 			req.PaymentID = TransactionRecord.PaymentID;
-			return call.Invoke(method, req, resp);
+			auto started = RTATracer::Clock::now();
+			bool ret = DAPI_RPC_ClientPool::Shared().Invoke(ip, port, method, req, resp);
+			RTATracer::Shared().Call(TransactionRecord.PaymentID, method, ip+":"+port, started, ret);
+			return ret;
 		}
 
 		bool CheckSign(const string& wallet, const string& sign);
+		// all signs of auth sample in one batch, signs - (wallet, sign)
+		bool CheckSigns(const vector< pair<string, string> >& signs, vector<bool>& results);
 
 		template<class IN_t, class OUT_t>
 		void AddHandler( const string& method, boost::function<bool (const IN_t&, OUT_t&)> handler ) {
@@ -31,6 +31,7 @@
 
 
 static const unsigned s_ObjectLifetime = 20*60*1000;//20 min
+static const unsigned s_RemovedObjectLifetime = 5*60*1000;//5 min
 
 supernode::BaseRTAProcessor::~BaseRTAProcessor() {}
 
@@ -44,9 +45,18 @@ void supernode::BaseRTAProcessor::Set(const FSN_ServantBase* ser, DAPI_RPC_Serve
 }
 
 void supernode::BaseRTAProcessor::Add(boost::shared_ptr<BaseRTAObject> obj) {
+	Add(obj, obj->TransactionRecord.PaymentID);
+}
+
+void supernode::BaseRTAProcessor::Add(boost::shared_ptr<BaseRTAObject> obj, const string& payment_id) {
+	// object can be created a while ago
+	auto age = std::chrono::milliseconds( (boost::posix_time::second_clock::local_time()-obj->TimeMark).total_milliseconds() );
+	auto expire = std::chrono::steady_clock::now()+std::chrono::milliseconds(s_ObjectLifetime)-age;
 	{
-		boost::lock_guard<boost::recursive_mutex> lock(m_ObjectsGuard);
-		m_Objects.push_back(obj);
+		boost::lock_guard<boost::mutex> lock(m_ObjectsGuard);
+		m_Objects[obj.get()] = make_pair(obj, payment_id);
+		if( !payment_id.empty() ) m_ObjectsByPayment.insert( make_pair(payment_id, obj) );
+		m_Expire.Schedule( expire, SExpire{obj, nullptr} );
 	}
 	Tick();
 }
@@ -56,53 +66,40 @@ void supernode::BaseRTAProcessor::Setup(boost::shared_ptr<BaseRTAObject> obj) {
 }
 
 boost::shared_ptr<supernode::BaseRTAObject> supernode::BaseRTAProcessor::ObjectByPayment(const string& payment_id) {
-	boost::shared_ptr<BaseRTAObject> ret;
-	{
-		boost::lock_guard<boost::recursive_mutex> lock(m_ObjectsGuard);
-		for(auto& a : m_Objects) if(a->TransactionRecord.PaymentID==payment_id) {
-			ret = a;
-			break;
-		}
-	}
-	return ret;
+	boost::lock_guard<boost::mutex> lock(m_ObjectsGuard);
+	auto it = m_ObjectsByPayment.find(payment_id);
+	if( it==m_ObjectsByPayment.end() ) return nullptr;
+	return it->second;
 }
 
 void supernode::BaseRTAProcessor::Remove(boost::shared_ptr<BaseRTAObject> obj) {
 	obj->MarkForDelete();
     LOG_PRINT_L4("Remove: "<<obj->TransactionRecord.PaymentID);
-	{
-		boost::lock_guard<boost::recursive_mutex> lock(m_ObjectsGuard);
-		auto it = find(m_Objects.begin(), m_Objects.end(), obj);
-		if( it!=m_Objects.end() ) m_Objects.erase(it);
+	boost::lock_guard<boost::mutex> lock(m_ObjectsGuard);
+	auto it = m_Objects.find( obj.get() );
+	if( it==m_Objects.end() ) return;
 
-	}
-	{
-		obj->TimeMark = boost::posix_time::second_clock::local_time();
-		boost::lock_guard<boost::recursive_mutex> lock(m_RemoveObjectsGuard);
-		m_RemoveObjects.push_back( obj );
-	}
+	auto pit = m_ObjectsByPayment.find(it->second.second);
+	if( pit!=m_ObjectsByPayment.end() && pit->second==obj ) m_ObjectsByPayment.erase(pit);
+	m_Objects.erase(it);
 
+	obj->TimeMark = boost::posix_time::second_clock::local_time();
+	m_Expire.Schedule( std::chrono::steady_clock::now()+std::chrono::milliseconds(s_RemovedObjectLifetime), SExpire{boost::weak_ptr<BaseRTAObject>(), obj} );
 }
 
 
 void supernode::BaseRTAProcessor::Tick() {
-	auto now = boost::posix_time::second_clock::local_time();
+	vector<SExpire> expired;
 	{
-		vector< boost::shared_ptr<BaseRTAObject> > vv;
-		{
-			boost::lock_guard<boost::recursive_mutex> lock(m_ObjectsGuard);
-			for(auto a: m_Objects) if( (now-a->TimeMark).total_milliseconds()>s_ObjectLifetime ) vv.push_back(a);//20 min
-		}
-		for(auto a : vv) Remove(a);
-	}
-	{
-		boost::lock_guard<boost::recursive_mutex> lock(m_RemoveObjectsGuard);
-		for(int i=0;i<int(m_RemoveObjects.size());i++) if( (now-m_RemoveObjects[i]->TimeMark).total_milliseconds()>(5*60*1000) ) {
-			m_RemoveObjects.erase( m_RemoveObjects.begin()+i );
-			i--;
-		}
+		boost::lock_guard<boost::mutex> lock(m_ObjectsGuard);
+		m_Expire.Advance(std::chrono::steady_clock::now(), expired);
 	}
 
+	for(auto& a : expired) {
+		boost::shared_ptr<BaseRTAObject> obj = a.Alive.lock();
+		if(obj) Remove(obj);// not removed yet, lifetime is over
+	}
+	// references to removed objects go out of scope here, not under the lock
 }
 
 
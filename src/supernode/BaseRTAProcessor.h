@@ -31,6 +31,9 @@
 #define BASE_RTA_PROCESSOR_H_
 
 #include "BaseRTAObject.h"
+#include "TimerWheel.h"
+#include <boost/weak_ptr.hpp>
+#include <unordered_map>
 
 namespace supernode {
 
@@ -45,7 +48,10 @@ namespace supernode {
 		virtual void Tick();
 
 		protected:
+		// indexed by TransactionRecord.PaymentID, so object must be initialized
 		void Add(boost::shared_ptr<BaseRTAObject> obj);
+		// for object which gets PaymentID in Init after Add
+		void Add(boost::shared_ptr<BaseRTAObject> obj, const string& payment_id);
 		void Remove(boost::shared_ptr<BaseRTAObject> obj);
 		void Setup(boost::shared_ptr<BaseRTAObject> obj);
 		boost::shared_ptr<BaseRTAObject> ObjectByPayment(const string& payment_id);
@@ -55,16 +61,17 @@ namespace supernode {
 		protected:
 		const FSN_ServantBase* m_Servant = nullptr;
 		DAPI_RPC_Server* m_DAPIServer = nullptr;
-		mutable boost::recursive_mutex m_ObjectsGuard;
-		vector< boost::shared_ptr<BaseRTAObject> > m_Objects;
 
-		mutable boost::recursive_mutex m_RemoveObjectsGuard;
-		vector< boost::shared_ptr<BaseRTAObject> > m_RemoveObjects;
-
-//		mutable boost::mutex m_DeleteGuard;
-//		map< boost::posix_time::ptime, boost::shared_ptr<BaseRTAObject> > m_ForDelete;
-		// boost::posix_time::second_clock::local_time()
+		struct SExpire {
+			boost::weak_ptr<BaseRTAObject> Alive;// lifetime of not removed object
+			boost::shared_ptr<BaseRTAObject> Removed;// removed object is kept for a while
+		};
 
+		mutable boost::mutex m_ObjectsGuard;
+		// value: object and PaymentID it was indexed by
+		unordered_map< BaseRTAObject*, pair<boost::shared_ptr<BaseRTAObject>, string> > m_Objects;
+		unordered_map< string, boost::shared_ptr<BaseRTAObject> > m_ObjectsByPayment;// first added wins
+		TimerWheel<SExpire> m_Expire;
 	};
 
 }
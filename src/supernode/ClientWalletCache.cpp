@@ -0,0 +1,202 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "ClientWalletCache.h"
+#include "crypto/hash.h"
+#include <boost/make_shared.hpp>
+
+namespace supernode {
+
+ClientWalletCache::ClientWalletCache(OpenFunc open, StoreFunc store) : m_Open(open), m_Store(store) {
+}
+
+ClientWalletCache::~ClientWalletCache() {
+	Stop();
+}
+
+void ClientWalletCache::Start() {
+	if(m_Thread) return;
+	m_Running = true;
+	m_LastStore = std::chrono::steady_clock::now();
+	m_Thread = new boost::thread(&ClientWalletCache::Run, this);
+}
+
+void ClientWalletCache::Stop() {
+	if(m_Thread) {
+		m_Running = false;
+		m_Thread->join();
+		delete m_Thread;
+		m_Thread = nullptr;
+	}
+
+	vector< boost::shared_ptr<SEntry> > all;
+	{
+		boost::lock_guard<boost::mutex> lock(m_Guard);
+		all.swap(m_Evicted);
+		for(auto& a : m_Entries) all.push_back(a.second.first);
+		m_Entries.clear();
+		m_Lru.clear();
+	}
+	for(auto& a : all) StoreAndClose(a);
+}
+
+string ClientWalletCache::Key(const string& account, const string& password) {
+	// password hash, so the key can't be used to get password back
+	crypto::hash pass_hash = crypto::cn_fast_hash( password.data(), password.size() );
+	string data = account;
+	data.append( reinterpret_cast<const char*>(&pass_hash), sizeof(pass_hash) );
+	crypto::hash key = crypto::cn_fast_hash( data.data(), data.size() );
+	return string( reinterpret_cast<const char*>(&key), sizeof(key) );
+}
+
+ClientWalletCache::Handle ClientWalletCache::Open(const string& account, const string& password) {
+	auto requested = std::chrono::steady_clock::now();
+	string key = Key(account, password);
+	boost::shared_ptr<SEntry> entry;
+	{
+		boost::lock_guard<boost::mutex> lock(m_Guard);
+		auto it = m_Entries.find(key);
+		if( it!=m_Entries.end() ) {
+			entry = it->second.first;
+			m_Lru.splice( m_Lru.begin(), m_Lru, it->second.second );
+		} else {
+			entry = boost::make_shared<SEntry>();
+			m_Lru.push_front(key);
+			m_Entries[key] = make_pair( entry, m_Lru.begin() );
+			while( m_Entries.size()>Capacity ) {
+				auto last = m_Entries.find( m_Lru.back() );
+				m_Evicted.push_back( last->second.first );
+				m_Entries.erase(last);
+				m_Lru.pop_back();
+			}
+		}
+	}
+
+	// concurrent requests for the same wallet wait here, so it opened only once
+	Handle ret(entry);
+	ret.m_Requested = requested;
+	if( !entry->Wallet ) {
+		entry->Wallet = m_Open(account, password);
+		if( !entry->Wallet ) {
+			boost::lock_guard<boost::mutex> lock(m_Guard);
+			auto it = m_Entries.find(key);
+			if( it!=m_Entries.end() && it->second.first==entry ) {
+				m_Lru.erase(it->second.second);
+				m_Entries.erase(it);
+			}
+			return Handle();
+		}
+		entry->LastRefresh = std::chrono::steady_clock::time_point();
+		entry->Dirty = false;
+	}
+	entry->LastUsed = std::chrono::steady_clock::now();
+	return ret;
+}
+
+void ClientWalletCache::Refresh(Handle& wallet) {
+	SEntry& e = *wallet.m_Entry;
+	if( e.LastRefresh+RefreshAge>=wallet.m_Requested ) return;// refreshed while we waited for wallet
+	e.Wallet->refresh();
+	e.LastRefresh = std::chrono::steady_clock::now();
+	e.Dirty = true;
+}
+
+void ClientWalletCache::Store(Handle& wallet) {
+	m_Store( wallet.get() );
+	wallet.m_Entry->Dirty = false;
+}
+
+void ClientWalletCache::StoreAndClose(boost::shared_ptr<SEntry> entry) {
+	boost::lock_guard<boost::mutex> lock(entry->Guard);
+	if( !entry->Wallet ) return;
+	try {
+		if(entry->Dirty) m_Store( entry->Wallet.get() );
+	} catch(const std::exception& e) {
+		LOG_ERROR("failed to store wallet: "<<e.what());
+	}
+	entry->Dirty = false;
+	entry->Wallet.reset();
+}
+
+void ClientWalletCache::Run() {
+	while(m_Running) {
+		DoBackgroundWork();
+		boost::this_thread::sleep_for(boost::chrono::seconds(1));
+	}
+}
+
+void ClientWalletCache::DoBackgroundWork() {
+	vector< boost::shared_ptr<SEntry> > evicted;
+	vector< pair<string, boost::shared_ptr<SEntry> > > all;
+	{
+		boost::lock_guard<boost::mutex> lock(m_Guard);
+		evicted.swap(m_Evicted);
+		for(auto& a : m_Entries) all.push_back( make_pair(a.first, a.second.first) );
+	}
+	for(auto& a : evicted) StoreAndClose(a);
+
+	auto now = std::chrono::steady_clock::now();
+	bool storeTime = now-m_LastStore>=StoreInterval;
+	if(storeTime) m_LastStore = now;
+
+	for(unsigned i=0;i<all.size() && m_Running;i++) {
+		SEntry& e = *all[i].second;
+		boost::unique_lock<boost::mutex> lock(e.Guard, boost::try_to_lock);
+		if( !lock.owns_lock() || !e.Wallet ) continue;// busy with request
+
+		if( now-e.LastUsed>IdleTimeout ) {
+			{
+				boost::lock_guard<boost::mutex> glock(m_Guard);
+				auto it = m_Entries.find(all[i].first);
+				if( it!=m_Entries.end() && it->second.first==all[i].second ) {
+					m_Lru.erase(it->second.second);
+					m_Entries.erase(it);
+				}
+			}
+			lock.unlock();
+			StoreAndClose(all[i].second);
+			continue;
+		}
+
+		try {
+			if( now-e.LastRefresh>=BackgroundRefresh ) {
+				e.Wallet->refresh();
+				e.LastRefresh = std::chrono::steady_clock::now();
+				e.Dirty = true;
+			}
+			if( storeTime && e.Dirty ) {
+				m_Store( e.Wallet.get() );
+				e.Dirty = false;
+			}
+		} catch(const std::exception& ex) {
+			LOG_ERROR("background refresh of wallet failed: "<<ex.what());
+		}
+	}
+}
+
+}
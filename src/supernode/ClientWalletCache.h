@@ -0,0 +1,123 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef CLIENT_WALLET_CACHE_H_
+#define CLIENT_WALLET_CACHE_H_
+
+#include "graft_wallet2.h"
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+namespace supernode {
+
+	// opened client wallets of BaseClientProxy, so balance polling don't decrypt account,
+	// read cache file and store it back on every call.
+	// wallets are refreshed and stored in background, unused ones are stored and closed
+	class ClientWalletCache {
+		public:
+		typedef boost::function<std::unique_ptr<tools::GraftWallet2> (const string& account, const string& password)> OpenFunc;
+		typedef boost::function<void (tools::GraftWallet2*)> StoreFunc;
+
+		struct SEntry {
+			boost::mutex Guard;// GraftWallet2 is not thread safe
+			std::unique_ptr<tools::GraftWallet2> Wallet;
+			std::chrono::steady_clock::time_point LastUsed;
+			std::chrono::steady_clock::time_point LastRefresh;
+			bool Dirty = false;// refreshed, but not stored
+		};
+
+		// wallet is locked while handle alive
+		class Handle {
+			public:
+			Handle() {}
+			Handle(boost::shared_ptr<SEntry> entry) : m_Entry(entry), m_Lock(entry->Guard) {}
+
+			tools::GraftWallet2* get() const { return m_Entry?m_Entry->Wallet.get():nullptr; }
+			tools::GraftWallet2* operator->() const { return get(); }
+			explicit operator bool() const { return get()!=nullptr; }
+
+			protected:
+			friend class ClientWalletCache;
+			boost::shared_ptr<SEntry> m_Entry;
+			boost::unique_lock<boost::mutex> m_Lock;
+			std::chrono::steady_clock::time_point m_Requested;
+		};
+
+		public:
+		ClientWalletCache(OpenFunc open, StoreFunc store);
+		~ClientWalletCache();
+
+		void Start();
+		void Stop();// stores all not stored wallets
+
+		// empty handle if wallet can't be opened (wrong account or password)
+		Handle Open(const string& account, const string& password);
+		// refresh, if nobody did it while we waited for the wallet. throws as GraftWallet2::refresh
+		void Refresh(Handle& wallet);
+		// store now, e.g. after commit_tx
+		void Store(Handle& wallet);
+
+		public:
+		unsigned Capacity = 256;
+		std::chrono::milliseconds RefreshAge = std::chrono::seconds(1);// fresher wallets are not refreshed on request
+		std::chrono::milliseconds BackgroundRefresh = std::chrono::seconds(10);
+		std::chrono::milliseconds StoreInterval = std::chrono::seconds(30);
+		std::chrono::milliseconds IdleTimeout = std::chrono::minutes(10);
+
+		protected:
+		static string Key(const string& account, const string& password);
+		void Run();
+		void DoBackgroundWork();
+		void StoreAndClose(boost::shared_ptr<SEntry> entry);
+
+		protected:
+		OpenFunc m_Open;
+		StoreFunc m_Store;
+
+		mutable boost::mutex m_Guard;
+		list<string> m_Lru;// most recent first
+		unordered_map< string, pair< boost::shared_ptr<SEntry>, list<string>::iterator > > m_Entries;
+		vector< boost::shared_ptr<SEntry> > m_Evicted;// to store in background
+
+		bool m_Running = false;
+		boost::thread* m_Thread = nullptr;
+		std::chrono::steady_clock::time_point m_LastStore;
+	};
+
+}
+
+#endif /* CLIENT_WALLET_CACHE_H_ */
@@ -0,0 +1,392 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "CoinbaseIndex.h"
+#include "common/util.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "file_io_utils.h"
+#include "storages/portable_storage_template_helper.h"
+#include "string_tools.h"
+#include <boost/filesystem.hpp>
+#include <boost/make_shared.hpp>
+
+using namespace cryptonote;
+
+namespace supernode {
+
+namespace helpers {
+public_key get_tx_gen_pub_key(const transaction &tx)
+{
+    if (!is_coinbase(tx)) {
+        return null_pkey;
+    }
+    const tx_out &out = tx.vout.at(0);
+    return boost::get<txout_to_key>(out.target).key;
+}
+
+// tx key of coinbase output. extra may be parsed only partially, keys found so far are used.
+// if there are two keys (old wallet bug), the second one is the real one
+public_key get_coinbase_tx_pub_key(const transaction &tx)
+{
+    std::vector<tx_extra_field> fields;
+    parse_tx_extra(tx.extra, fields);
+
+    tx_extra_pub_key key;
+    if( find_tx_extra_field_by_type(fields, key, 1) ) return key.pub_key;
+    if( find_tx_extra_field_by_type(fields, key, 0) ) return key.pub_key;
+    return null_pkey;
+}
+} // namespace helpers
+
+
+CoinbaseIndex::CoinbaseIndex(BlockchainDB* db, bool testnet, const string& fileName) : m_DB(db), m_Testnet(testnet), m_FileName(fileName) {
+	// own pool: indexing runs in parallel with tasks of the shared one
+	m_Workers.Workers( tools::get_max_concurrency() );
+}
+
+CoinbaseIndex::~CoinbaseIndex() {
+	Stop();
+	m_Workers.Stop();
+}
+
+void CoinbaseIndex::Start() {
+	if(m_Thread) return;
+	m_Running = true;
+	m_Thread = new boost::thread(&CoinbaseIndex::Run, this);
+}
+
+void CoinbaseIndex::Stop() {
+	if(!m_Thread) return;
+	m_Running = false;
+	m_Thread->join();
+	delete m_Thread;
+	m_Thread = nullptr;
+	Store();
+}
+
+void CoinbaseIndex::Run() {
+	auto next = std::chrono::steady_clock::now();
+	while(m_Running) {
+		if( std::chrono::steady_clock::now()>=next ) {
+			try {
+				Update();
+				Store();
+			} catch(const std::exception& e) {
+				LOG_ERROR("coinbase index update failed: " << e.what());
+			}
+			next = std::chrono::steady_clock::now()+RefreshInterval;
+		}
+		boost::this_thread::sleep( boost::posix_time::milliseconds(100) );
+	}
+}
+
+bool CoinbaseIndex::Add(boost::shared_ptr<FSN_Data> fsn) {
+	boost::shared_ptr<SMiner> miner = boost::make_shared<SMiner>();
+	miner->Data = fsn;
+	LOG_PRINT_L3("parsing address : " << fsn->Miner.Addr << "; testnet: " << m_Testnet);
+	if( !get_account_address_from_str(miner->Address, m_Testnet, fsn->Miner.Addr) ) {
+		LOG_ERROR("Error parsing address: " << fsn->Miner.Addr);
+		return false;
+	}
+	if( !epee::string_tools::hex_to_pod(fsn->Miner.ViewKey, miner->ViewKey) ) {
+		LOG_ERROR("Error parsing view key of: " << fsn->Miner.Addr);
+		return false;
+	}
+
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	auto st = m_Stored.find(fsn->Miner.Addr);
+	if( st!=m_Stored.end() && st->second.ViewKey==fsn->Miner.ViewKey ) {
+		miner->IndexedHeight = st->second.IndexedHeight;
+		for(uint64_t h : st->second.Solved) m_Solved.insert( make_pair(h, fsn) );
+		m_Stored.erase(st);
+	}
+	m_Miners.push_back(miner);
+	m_Changed = true;
+	return true;
+}
+
+bool CoinbaseIndex::Remove(boost::shared_ptr<FSN_Data> fsn) {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	auto it = std::find_if(m_Miners.begin(), m_Miners.end(), [&fsn](const boost::shared_ptr<SMiner>& m) {
+		return *m->Data==*fsn;
+	});
+	if( it==m_Miners.end() ) return false;
+
+	boost::shared_ptr<FSN_Data> data = (*it)->Data;
+	m_Miners.erase(it);
+	for(auto s=m_Solved.begin();s!=m_Solved.end();) {
+		if(s->second==data) s = m_Solved.erase(s);
+		else ++s;
+	}
+	m_Changed = true;
+	return true;
+}
+
+void CoinbaseIndex::Update() {
+	boost::lock_guard<boost::mutex> updateLock(m_UpdateGuard);
+
+	uint64_t fork = ForkHeight();
+	if(fork<m_IndexedHeight) {
+		LOG_PRINT_L1("coinbase index: chain reorganized from block " << fork);
+		Rollback(fork);
+	}
+
+	uint64_t top = m_DB->height();
+
+	// FSN added with empty index are indexed from genesis here, by batches, so Stop is not held for long
+	while(m_Running || !m_Thread) {
+		vector< boost::shared_ptr<SMiner> > miners;
+		vector<uint64_t> starts;
+		uint64_t from = top;
+		{
+			boost::lock_guard<boost::mutex> lock(m_Guard);
+			for(auto& m : m_Miners) if(m->IndexedHeight<top) {
+				miners.push_back(m);
+				starts.push_back(m->IndexedHeight);
+				from = std::min(from, m->IndexedHeight);
+			}
+		}
+		if( miners.empty() ) break;
+
+		uint64_t to = std::min<uint64_t>(top, from+BatchBlocks);
+		vector<SCoinbase> blocks;
+		vector<crypto::hash> hashes;
+		ReadBlocks(from, to, blocks, &hashes);
+
+		// key derivations for all blocks x miners, split by blocks
+		vector<int> solvers( blocks.size(), -1 );
+		{
+			static const size_t blocksPerTask = 64;
+			WorkerTasks tasks(m_Workers);
+			for(size_t i=0;i<blocks.size();i+=blocksPerTask) {
+				size_t cnt = std::min(blocksPerTask, blocks.size()-i);
+				tasks.Post( boost::bind(&CoinbaseIndex::CheckBlocks, this, &blocks[i], cnt, &miners, &starts, &solvers[i]) );
+			}
+			tasks.Wait();
+		}
+
+		{
+			boost::lock_guard<boost::mutex> lock(m_Guard);
+			for(size_t i=0;i<blocks.size();i++) {
+				if(solvers[i]<0) continue;
+				const SMiner& m = *miners[ solvers[i] ];
+				// removed while we were checking
+				if( std::find(m_Miners.begin(), m_Miners.end(), miners[ solvers[i] ])==m_Miners.end() ) continue;
+				m_Solved.insert( make_pair(blocks[i].Height, m.Data) );
+			}
+			for(auto& m : miners) m->IndexedHeight = std::max(m->IndexedHeight, to);
+			for(size_t i=0;i<hashes.size();i++) m_Hashes[from+i] = hashes[i];
+			while( m_Hashes.size()>ReorgDepth ) m_Hashes.erase( m_Hashes.begin() );
+			m_IndexedHeight = std::max(m_IndexedHeight, to);
+			m_Changed = true;
+		}
+	}
+}
+
+void CoinbaseIndex::ReadBlocks(uint64_t from, uint64_t to, vector<SCoinbase>& blocks, vector<crypto::hash>* hashes) const {
+	blocks.reserve(to-from);
+	if(hashes) hashes->reserve(to-from);
+	for(uint64_t h=from;h<to;h++) {
+		const block blk = m_DB->get_block_from_height(h);
+		if(hashes) hashes->push_back( get_block_hash(blk) );
+
+		SCoinbase cb;
+		cb.Height = h;
+		cb.TxPubKey = helpers::get_coinbase_tx_pub_key(blk.miner_tx);
+		cb.OutKey = helpers::get_tx_gen_pub_key(blk.miner_tx);
+		if(cb.TxPubKey!=null_pkey && cb.OutKey!=null_pkey) blocks.push_back(cb);
+	}
+}
+
+void CoinbaseIndex::CheckBlocks(const SCoinbase* blocks, size_t count, const vector< boost::shared_ptr<SMiner> >* miners, const vector<uint64_t>* starts, int* solvers) const {
+	for(size_t b=0;b<count;b++) {
+		const SCoinbase& cb = blocks[b];
+		for(size_t i=0;i<miners->size();i++) {
+			const SMiner& m = *(*miners)[i];
+			if(cb.Height<(*starts)[i]) continue;
+
+			// public transaction key is combined with miner viewkey to create derived key
+			crypto::key_derivation derivation;
+			if( !crypto::generate_key_derivation(cb.TxPubKey, m.ViewKey, derivation) ) {
+				LOG_ERROR("Cant get derived key for block " << cb.Height);
+				continue;
+			}
+			crypto::public_key derived;
+			if( !crypto::derive_public_key(derivation, 0, m.Address.m_spend_public_key, derived) ) continue;
+			if(derived==cb.OutKey) {
+				solvers[b] = i;
+				break;
+			}
+		}
+	}
+}
+
+uint64_t CoinbaseIndex::ForkHeight() const {
+	map<uint64_t, crypto::hash> hashes;
+	{
+		boost::lock_guard<boost::mutex> lock(m_Guard);
+		if( m_Hashes.empty() ) return m_IndexedHeight;
+		hashes = m_Hashes;
+	}
+
+	uint64_t height = m_DB->height();
+	for(auto it=hashes.rbegin();it!=hashes.rend();++it) {
+		if( it->first<height && m_DB->get_block_hash_from_height(it->first)==it->second ) return it->first+1;
+	}
+	// deeper than we remember
+	return 0;
+}
+
+void CoinbaseIndex::Rollback(uint64_t height) {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	for(auto& m : m_Miners) m->IndexedHeight = std::min(m->IndexedHeight, height);
+	for(auto& st : m_Stored) {
+		SStoredMiner& m = st.second;
+		m.IndexedHeight = std::min(m.IndexedHeight, height);
+		m.Solved.erase( std::lower_bound(m.Solved.begin(), m.Solved.end(), height), m.Solved.end() );
+	}
+	m_Solved.erase( m_Solved.lower_bound(height), m_Solved.end() );
+	m_Hashes.erase( m_Hashes.lower_bound(height), m_Hashes.end() );
+	m_IndexedHeight = height;
+	m_Changed = true;
+}
+
+vector<pair<uint64_t, boost::shared_ptr<FSN_Data>>> CoinbaseIndex::Solved(uint64_t from, uint64_t to) const {
+	vector<pair<uint64_t, boost::shared_ptr<FSN_Data>>> result;
+	if(to<from) return result;
+
+	map< uint64_t, boost::shared_ptr<FSN_Data> > solved;
+	vector< boost::shared_ptr<SMiner> > miners;
+	vector<uint64_t> starts;
+	{
+		boost::lock_guard<boost::mutex> lock(m_Guard);
+		solved.insert( m_Solved.lower_bound(from), m_Solved.upper_bound(to) );
+		for(auto& m : m_Miners) if(m->IndexedHeight<=to) {
+			miners.push_back(m);
+			starts.push_back( std::max(from, m->IndexedHeight) );
+		}
+	}
+
+	// not indexed part of the range only, index itself is advanced by own thread
+	uint64_t top = std::min<uint64_t>(to+1, m_DB->height());
+	if( !miners.empty() ) {
+		uint64_t begin = *std::min_element(starts.begin(), starts.end());
+		if(begin<top) {
+			vector<SCoinbase> blocks;
+			ReadBlocks(begin, top, blocks, nullptr);
+			vector<int> solvers( blocks.size(), -1 );
+			CheckBlocks(blocks.data(), blocks.size(), &miners, &starts, solvers.data());
+			for(size_t i=0;i<blocks.size();i++) {
+				if(solvers[i]>=0) solved.insert( make_pair(blocks[i].Height, miners[ solvers[i] ]->Data) );
+			}
+		}
+	}
+
+	result.assign( solved.rbegin(), solved.rend() );
+	return result;
+}
+
+bool CoinbaseIndex::Load() {
+	if( m_FileName.empty() || !boost::filesystem::exists(m_FileName) ) return false;
+
+	string buf;
+	SIndexFile file;
+	if( !epee::file_io_utils::load_file_to_string(m_FileName, buf) || !epee::serialization::load_t_from_binary(file, buf) || file.HashHeights.size()!=file.Hashes.size() ) {
+		LOG_ERROR("coinbase index: failed to read " << m_FileName << ", blocks will be indexed again");
+		return false;
+	}
+
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	m_Stored.clear();
+	for(auto& e : file.Miners) {
+		SStoredMiner& m = m_Stored[e.Addr];
+		m.ViewKey = e.ViewKey;
+		m.IndexedHeight = e.IndexedHeight;
+		m.Solved = e.Solved;
+		std::sort(m.Solved.begin(), m.Solved.end());
+	}
+	m_Hashes.clear();
+	for(size_t i=0;i<file.Hashes.size();i++) m_Hashes[ file.HashHeights[i] ] = file.Hashes[i];
+	m_IndexedHeight = m_Hashes.empty() ? 0 : m_Hashes.rbegin()->first+1;
+	m_Changed = false;
+	LOG_PRINT_L1("coinbase index: loaded " << m_Stored.size() << " FSN, indexed up to block " << m_IndexedHeight);
+	return true;
+}
+
+bool CoinbaseIndex::Store() {
+	if( m_FileName.empty() ) return false;
+
+	SIndexFile file;
+	{
+		boost::lock_guard<boost::mutex> lock(m_Guard);
+		if(!m_Changed) return true;
+
+		map<boost::shared_ptr<FSN_Data>, size_t> entries;
+		for(auto& m : m_Miners) {
+			entries[m->Data] = file.Miners.size();
+			SIndexFile::SMinerEntry e;
+			e.Addr = m->Data->Miner.Addr;
+			e.ViewKey = m->Data->Miner.ViewKey;
+			e.IndexedHeight = m->IndexedHeight;
+			file.Miners.push_back(e);
+		}
+		for(auto& s : m_Solved) file.Miners[ entries[s.second] ].Solved.push_back(s.first);
+		// not added since restart, kept until they are
+		for(auto& st : m_Stored) {
+			SIndexFile::SMinerEntry e;
+			e.Addr = st.first;
+			e.ViewKey = st.second.ViewKey;
+			e.IndexedHeight = st.second.IndexedHeight;
+			e.Solved = st.second.Solved;
+			file.Miners.push_back(e);
+		}
+		for(auto& h : m_Hashes) {
+			file.HashHeights.push_back(h.first);
+			file.Hashes.push_back(h.second);
+		}
+		m_Changed = false;
+	}
+
+	// written aside and renamed, so a crash leaves the previous index
+	string buf;
+	string tmp = m_FileName+".tmp";
+	boost::system::error_code ec;
+	if( !epee::serialization::store_t_to_binary(file, buf) || !epee::file_io_utils::save_string_to_file(tmp, buf) ) {
+		LOG_ERROR("coinbase index: failed to write " << tmp);
+	} else {
+		boost::filesystem::rename(tmp, m_FileName, ec);
+		if(!ec) return true;
+		LOG_ERROR("coinbase index: failed to replace " << m_FileName << ": " << ec.message());
+	}
+
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	m_Changed = true;
+	return false;
+}
+
+}
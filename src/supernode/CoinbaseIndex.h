@@ -0,0 +1,154 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef COINBASE_INDEX_H_
+#define COINBASE_INDEX_H_
+
+#include "supernode_common_struct.h"
+#include "WorkerPool.h"
+#include "blockchain_db/blockchain_db.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace supernode {
+
+	// which FSN miner wallet solved each block. own thread indexes blocks as they appear in
+	// the local blockchain (and the chain once more for FSN added later), so queries are a range lookup.
+	// miner keys are parsed once on Add. index is kept in a file, so restart doesn't rescan the chain
+	class CoinbaseIndex {
+		public:
+		// fileName - index file, empty - index is not stored
+		CoinbaseIndex(cryptonote::BlockchainDB* db, bool testnet, const string& fileName);
+		~CoinbaseIndex();
+
+		void Start();
+		void Stop();
+
+		// false if miner address or view key can't be parsed
+		bool Add(boost::shared_ptr<FSN_Data> fsn);
+		bool Remove(boost::shared_ptr<FSN_Data> fsn);
+
+		// index new blocks and not yet indexed FSN, called by own thread
+		void Update();
+
+		// blocks in [from, to], newest first. blocks of the range which are not indexed yet
+		// (just arrived, or FSN still being indexed) are checked here, only inside the range
+		vector<pair<uint64_t, boost::shared_ptr<FSN_Data>>> Solved(uint64_t from, uint64_t to) const;
+
+		// state of FSN from the file is applied when they are added
+		bool Load();
+		bool Store();
+
+		public:
+		std::chrono::milliseconds RefreshInterval = std::chrono::seconds(5);
+		unsigned BatchBlocks = 1000;
+		unsigned ReorgDepth = 100;// block hashes kept to detect reorg
+
+		protected:
+		struct SMiner {
+			boost::shared_ptr<FSN_Data> Data;
+			cryptonote::account_public_address Address;
+			crypto::secret_key ViewKey;
+			uint64_t IndexedHeight = 0;// first not checked block
+		};
+
+		struct SCoinbase {
+			uint64_t Height;
+			crypto::public_key TxPubKey;
+			crypto::public_key OutKey;
+		};
+
+		// miner from index file, not added (yet)
+		struct SStoredMiner {
+			string ViewKey;
+			uint64_t IndexedHeight = 0;
+			vector<uint64_t> Solved;
+		};
+
+		struct SIndexFile {
+			struct SMinerEntry {
+				string Addr;
+				string ViewKey;
+				uint64_t IndexedHeight;
+				vector<uint64_t> Solved;
+
+				BEGIN_KV_SERIALIZE_MAP()
+					KV_SERIALIZE(Addr)
+					KV_SERIALIZE(ViewKey)
+					KV_SERIALIZE(IndexedHeight)
+					KV_SERIALIZE_CONTAINER_POD_AS_BLOB(Solved)
+				END_KV_SERIALIZE_MAP()
+			};
+
+			vector<SMinerEntry> Miners;
+			vector<uint64_t> HashHeights;
+			vector<crypto::hash> Hashes;
+
+			BEGIN_KV_SERIALIZE_MAP()
+				KV_SERIALIZE(Miners)
+				KV_SERIALIZE_CONTAINER_POD_AS_BLOB(HashHeights)
+				KV_SERIALIZE_CONTAINER_POD_AS_BLOB(Hashes)
+			END_KV_SERIALIZE_MAP()
+		};
+
+		void Run();
+		void ReadBlocks(uint64_t from, uint64_t to, vector<SCoinbase>& blocks, vector<crypto::hash>* hashes) const;
+		// starts - IndexedHeight of miners when they were taken, blocks below are skipped
+		void CheckBlocks(const SCoinbase* blocks, size_t count, const vector< boost::shared_ptr<SMiner> >* miners, const vector<uint64_t>* starts, int* solvers) const;
+		uint64_t ForkHeight() const;
+		void Rollback(uint64_t height);
+
+		protected:
+		cryptonote::BlockchainDB* m_DB;
+		bool m_Testnet;
+		string m_FileName;
+
+		mutable boost::mutex m_Guard;
+		vector< boost::shared_ptr<SMiner> > m_Miners;// in order of Add, first found wins
+		map< uint64_t, boost::shared_ptr<FSN_Data> > m_Solved;
+		map<uint64_t, crypto::hash> m_Hashes;// last indexed blocks
+		uint64_t m_IndexedHeight = 0;
+		map<string, SStoredMiner> m_Stored;// by miner address
+		bool m_Changed = false;// not stored yet
+
+		boost::mutex m_UpdateGuard;
+		WorkerPool m_Workers;
+
+		bool m_Running = false;
+		boost::thread* m_Thread = nullptr;
+	};
+
+}
+
+#endif /* COINBASE_INDEX_H_ */
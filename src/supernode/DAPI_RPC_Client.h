@@ -48,9 +48,21 @@ namespace supernode {
 		void Set(string ip, string port);
 
 		bool WasConnected = false;
+		// try binary transport first, switched off when server answers not in binary
+		bool Binary = false;
 
 		template<class t_request, class t_response>
 		bool Invoke(const string& call, const t_request& out_struct, t_response& result_struct, std::chrono::milliseconds timeout = std::chrono::seconds(5)) {
+			if(Binary) {
+				bool ret = InvokeBinary(call, out_struct, result_struct, timeout);
+				if(Binary) return ret;
+				LOG_PRINT_L1("No binary DAPI on "<<m_URI<<", fall back to json");
+			}
+			return InvokeJson(call, out_struct, result_struct, timeout);
+		}
+
+		template<class t_request, class t_response>
+		bool InvokeJson(const string& call, const t_request& out_struct, t_response& result_struct, std::chrono::milliseconds timeout) {
 
 			rpc_command::RequestContainer<t_request> req;
 	    	req.params = out_struct;
@@ -94,6 +106,49 @@ namespace supernode {
 
 		}
 
+		// same envelope as json, in epee binary storage. server which knows
+		// DAPI_BIN_URI answers with DAPI_BIN_CONTENT_TYPE, even on error
+		template<class t_request, class t_response>
+		bool InvokeBinary(const string& call, const t_request& out_struct, t_response& result_struct, std::chrono::milliseconds timeout) {
+			rpc_command::RequestContainer<t_request> req;
+			req.params = out_struct;
+			req.method = call;
+
+			epee::serialization::portable_storage ps;
+			std::string req_param;
+			if( !req.store(ps) || !ps.store_to_binary(req_param) ) return false;
+
+			epee::net_utils::http::fields_list fields;
+			fields.push_back( make_pair("Content-Type", rpc_command::DAPI_BIN_CONTENT_TYPE) );
+
+			const epee::net_utils::http::http_response_info* pri = NULL;
+
+			WasConnected = false;
+			if(!invoke(rpc_command::DAPI_BIN_URI, rpc_command::DAPI_METHOD, req_param, timeout, std::addressof(pri), fields)) {
+				LOG_ERROR("Failed to invoke http request to  " << call<<"  URI: "<<m_URI);
+				return false;
+			}
+			WasConnected = true;
+
+			if(!pri) return false;
+			if( pri->m_header_info.m_content_type.find(rpc_command::DAPI_BIN_CONTENT_TYPE)==string::npos ) {
+				Binary = false;
+				return false;
+			}
+			if(pri->m_response_code != 200) {
+				LOG_PRINT_L4("Failed to invoke http request to  " << call << ", wrong response code: " << pri->m_response_code);
+				return false;
+			}
+
+			epee::json_rpc::response<t_response, epee::json_rpc::dummy_error> resp;
+			epee::serialization::portable_storage rps;
+			if( !rps.load_from_binary(pri->m_body) ) return false;
+			if( !resp.load(rps) ) return false;
+
+			result_struct = resp.result;
+			return true;
+		}
+
 		protected:
 		string m_URI;
 
@@ -0,0 +1,145 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "DAPI_RPC_ClientPool.h"
+#include <boost/make_shared.hpp>
+
+namespace supernode {
+
+DAPI_RPC_ClientPool& DAPI_RPC_ClientPool::Shared() {
+	static DAPI_RPC_ClientPool* pool = new DAPI_RPC_ClientPool();
+	return *pool;
+}
+
+string DAPI_RPC_ClientPool::Key(const string& ip, const string& port) {
+	return ip + string(":") + port;
+}
+
+boost::shared_ptr<DAPI_RPC_Client> DAPI_RPC_ClientPool::Acquire(const string& ip, const string& port, std::chrono::milliseconds timeout, bool& reused) {
+	reused = false;
+	auto until = boost::chrono::steady_clock::now()+boost::chrono::milliseconds( timeout.count() );
+
+	string key = Key(ip, port);
+	boost::unique_lock<boost::mutex> lock(m_Guard);
+	SEndpoint* ep = &m_Endpoints[key];
+	EvictIdle( *ep, std::chrono::steady_clock::now() );
+
+	while( ep->Idle.empty() && ep->Busy>=MaxPerHost ) {
+		if( m_Released.wait_until(lock, until)==boost::cv_status::timeout ) {
+			LOG_ERROR("no free connection to "<<key);
+			return nullptr;
+		}
+		ep = &m_Endpoints[key];// can be swept while we wait
+	}
+
+	ep->Busy++;
+	if( !ep->Idle.empty() ) {
+		boost::shared_ptr<DAPI_RPC_Client> client = ep->Idle.back().Client;
+		ep->Idle.pop_back();
+		client->Binary = Binary && !ep->JsonOnly;
+		m_Stats.ReusedConnections++;
+		reused = true;
+		return client;
+	}
+
+	m_Stats.NewConnections++;
+	bool binary = Binary && !ep->JsonOnly;
+	lock.unlock();
+
+	boost::shared_ptr<DAPI_RPC_Client> client = boost::make_shared<DAPI_RPC_Client>();
+	client->Set(ip, port);
+	client->Binary = binary;
+	return client;
+}
+
+void DAPI_RPC_ClientPool::Release(const string& ip, const string& port, boost::shared_ptr<DAPI_RPC_Client> client, bool ok) {
+	// after fail we don't know state of connection, so close it
+	if( !ok ) client->disconnect();
+
+	{
+		boost::lock_guard<boost::mutex> lock(m_Guard);
+		SEndpoint& ep = m_Endpoints[ Key(ip, port) ];
+		ep.Busy--;
+		// client fell back to json during call
+		if( Binary && !client->Binary ) ep.JsonOnly = true;
+		if( ok && client->is_connected() ) {
+			SConnection conn;
+			conn.Client = client;
+			conn.LastUsed = std::chrono::steady_clock::now();
+			ep.Idle.push_back(conn);
+		}
+	}
+	m_Released.notify_all();
+}
+
+void DAPI_RPC_ClientPool::CallDone(const string& ip, const string& port, bool ok, bool connected, bool exhausted, std::chrono::milliseconds time) {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	SEndpoint& ep = m_Endpoints[ Key(ip, port) ];
+	// endpoint was not called when we ran out of connections, keep its health as is
+	if(exhausted) m_Stats.PoolExhausted++;
+	else if(connected) ep.NotAvailCount = 0;
+	else ep.NotAvailCount++;
+
+	m_Stats.Calls++;
+	if(!ok) m_Stats.FailedCalls++;
+	uint64_t ms = time.count();
+	m_Stats.TotalLatencyMs += ms;
+	if( ms>m_Stats.MaxLatencyMs ) m_Stats.MaxLatencyMs = ms;
+
+	// endpoints which are not called any more
+	auto now = std::chrono::steady_clock::now();
+	if( now-m_LastSweep<IdleTimeout ) return;
+	m_LastSweep = now;
+	for(auto it=m_Endpoints.begin();it!=m_Endpoints.end();) {
+		EvictIdle(it->second, now);
+		if( it->second.Idle.empty() && !it->second.Busy && !it->second.NotAvailCount ) it = m_Endpoints.erase(it);
+		else ++it;
+	}
+}
+
+void DAPI_RPC_ClientPool::EvictIdle(SEndpoint& ep, std::chrono::steady_clock::time_point now) {
+	for(unsigned i=0;i<ep.Idle.size();) {
+		if( now-ep.Idle[i].LastUsed<IdleTimeout ) { i++; continue; }
+		ep.Idle[i].Client->disconnect();
+		ep.Idle.erase( ep.Idle.begin()+i );
+		m_Stats.EvictedConnections++;
+	}
+}
+
+unsigned DAPI_RPC_ClientPool::NotAvailCount(const string& ip, const string& port) const {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	auto it = m_Endpoints.find( Key(ip, port) );
+	return it==m_Endpoints.end()?0:it->second.NotAvailCount;
+}
+
+DAPI_RPC_ClientPool::SStats DAPI_RPC_ClientPool::Stats() const {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	return m_Stats;
+}
+
+}
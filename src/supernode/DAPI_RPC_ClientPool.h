@@ -0,0 +1,125 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef DAPI_RPC_CLIENT_POOL_H_
+#define DAPI_RPC_CLIENT_POOL_H_
+
+#include "DAPI_RPC_Client.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace supernode {
+
+	// keep-alive connections to other supernodes, shared by all RTA objects.
+	// also keeps health of each endpoint, so broadcasts can drop dead members
+	class DAPI_RPC_ClientPool {
+		public:
+		struct SStats {
+			uint64_t Calls = 0;
+			uint64_t FailedCalls = 0;
+			uint64_t NewConnections = 0;
+			uint64_t ReusedConnections = 0;
+			uint64_t EvictedConnections = 0;
+			uint64_t PoolExhausted = 0;// no free connection within timeout, endpoint not called
+			uint64_t TotalLatencyMs = 0;
+			uint64_t MaxLatencyMs = 0;
+		};
+
+		public:
+		static DAPI_RPC_ClientPool& Shared();
+
+		// same as DAPI_RPC_Client::Invoke, on pooled connection to ip:port
+		// wasConnected - false if endpoint not answered at all. stays true when all MaxPerHost
+		// connections were busy: that is our local limit, it says nothing about endpoint health
+		template<class IN_t, class OUT_t>
+		bool Invoke(const string& ip, const string& port, const string& method, const IN_t& in, OUT_t& out, std::chrono::milliseconds timeout=std::chrono::seconds(5), bool* wasConnected=nullptr) {
+			auto started = std::chrono::steady_clock::now();
+			bool ok = false;
+			bool connected = false;
+			bool exhausted = false;
+			for(unsigned i=0;i<2;i++) {
+				bool reused = false;
+				boost::shared_ptr<DAPI_RPC_Client> client = Acquire(ip, port, timeout, reused);
+				if(!client) { exhausted = true; break; }
+				ok = client->Invoke<IN_t, OUT_t>(method, in, out, timeout);
+				connected = connected || client->WasConnected;
+				Release(ip, port, client, ok);
+				if( ok || !reused || client->WasConnected ) break;
+				// server closed keep-alive connection, try once more on new one
+			}
+			CallDone( ip, port, ok, connected, exhausted, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-started) );
+			if(wasConnected) *wasConnected = connected || exhausted;
+			return ok;
+		}
+
+		// number of calls in a row, which can't reach endpoint
+		unsigned NotAvailCount(const string& ip, const string& port) const;
+		SStats Stats() const;
+
+		public:
+		unsigned MaxPerHost = 16;
+		// supernode to supernode calls go in binary, json only for endpoints without binary DAPI
+		bool Binary = true;
+		std::chrono::milliseconds IdleTimeout = std::chrono::seconds(30);
+
+		protected:
+		struct SConnection {
+			boost::shared_ptr<DAPI_RPC_Client> Client;
+			std::chrono::steady_clock::time_point LastUsed;
+		};
+
+		struct SEndpoint {
+			vector<SConnection> Idle;
+			unsigned Busy = 0;
+			unsigned NotAvailCount = 0;
+			bool JsonOnly = false;
+		};
+
+		boost::shared_ptr<DAPI_RPC_Client> Acquire(const string& ip, const string& port, std::chrono::milliseconds timeout, bool& reused);
+		void Release(const string& ip, const string& port, boost::shared_ptr<DAPI_RPC_Client> client, bool ok);
+		void CallDone(const string& ip, const string& port, bool ok, bool connected, bool exhausted, std::chrono::milliseconds time);
+		void EvictIdle(SEndpoint& ep, std::chrono::steady_clock::time_point now);// under m_Guard
+		static string Key(const string& ip, const string& port);
+
+		protected:
+		mutable boost::mutex m_Guard;
+		boost::condition_variable m_Released;
+		map<string, SEndpoint> m_Endpoints;
+		SStats m_Stats;
+		std::chrono::steady_clock::time_point m_LastSweep;
+	};
+
+}
+
+#endif /* DAPI_RPC_CLIENT_POOL_H_ */
@@ -44,6 +44,9 @@ bool supernode::DAPI_RPC_Server::handle_http_request(const epee::net_utils::http
 	response.m_additional_fields.push_back( make_pair("Access-Control-Max-Age", "1728000") );
 	response.m_additional_fields.push_back( make_pair("Access-Control-Allow-Headers", "X-Requested-With, Content-Type, Origin, Cache-Control, Pragma, Authorization, Accept, Accept-Encoding") );
 
+	// binary clients take any other content type as "no binary DAPI here" and fall back to json
+	if( query_info.m_URI==rpc_command::DAPI_BIN_URI ) response.m_mime_tipe = rpc_command::DAPI_BIN_CONTENT_TYPE;
+
 	if( !HandleRequest(query_info, response, m_conn_context) ) {
 		response.m_response_code = 500;
 		response.m_response_comment = "Internal server error";
@@ -52,7 +55,8 @@ bool supernode::DAPI_RPC_Server::handle_http_request(const epee::net_utils::http
 }
 
 bool supernode::DAPI_RPC_Server::HandleRequest(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, connection_context& m_conn_context) {
-    if (query_info.m_URI != rpc_command::DAPI_URI)
+    bool binary = query_info.m_URI==rpc_command::DAPI_BIN_URI;
+    if (!binary && query_info.m_URI != rpc_command::DAPI_URI)
     {
         if (query_info.m_http_method == epee::net_utils::http::http_method_get)
         {
@@ -64,67 +68,70 @@ bool supernode::DAPI_RPC_Server::HandleRequest(const epee::net_utils::http::http
         }
         return false;
     }
-    uint64_t ticks = epee::misc_utils::get_tick_count();
-    epee::serialization::portable_storage ps;
-
-//    epee::json_rpc::error_response rsp;
-    string version;
-    std::string callback_name;
-    epee::serialization::storage_entry id_ = epee::serialization::storage_entry(std::string());
-
-    if( !ps.load_from_json(query_info.m_body) ) {
-        LOG_ERROR("!load_from_json");
-		response_info.m_response_code = 500;
-		response_info.m_response_comment = "Parse error";
-    } else if( !ps.get_value("dapi_version", version, nullptr) ) {
-    	response_info.m_response_code = 500;
-    	response_info.m_response_comment = "No DAPI version";
-    } else if( !ps.get_value("method", callback_name, nullptr) ) {
-    	response_info.m_response_code = 500;
-    	response_info.m_response_comment = "No method";
-    } else if( version!=rpc_command::DAPI_VERSION ) {
+    SRequest req;
+    string error;
+    req.Binary = binary;
+    if( !ParseRequest(query_info.m_body, req, error) ) {
     	response_info.m_response_code = 500;
-    	response_info.m_response_comment = "Wrong DAPI version";
-    }
-
-    if( response_info.m_response_code!=200 ) {
-    	//epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(rsp), response_info.m_body);
+    	response_info.m_response_comment = error;
         LOG_PRINT_L0( "Error: "<<response_info.m_response_comment );
     	return true;
     }
 
-    ps.get_value("id", id_, nullptr);
-
-    std::string payment_id;
-    {
-    	epee::json_rpc::request<SubNetData> resp;
-    	if( resp.load(ps) ) payment_id = resp.params.PaymentID;
-    }
+    boost::shared_ptr<SCallHandler> handler = FindHandler(req.Method, req.PaymentID);
+    if(!binary) LOG_PRINT_L2(query_info.m_body);
 
+    if(!handler) { LOG_ERROR("handler not found for: "<<req.Method); return false; }
+    if( !handler->Process(req, response_info.m_body) ) { LOG_ERROR("Fail to process (ret false): "<<req.Method); return false; }
 
+    if(binary) return true;
+    response_info.m_mime_tipe = "application/json";
+    response_info.m_header_info.m_content_type = " application/json";
+    return true;
+}
 
-    SCallHandler* handler = nullptr;
-
-    {
-    	boost::lock_guard<boost::recursive_mutex> lock(m_Handlers_Guard);
-    	for(unsigned i=0;i<m_vHandlers.size();i++) {
-    		SHandlerData& hh = m_vHandlers[i];
+bool supernode::DAPI_RPC_Server::ParseRequest(const string& body, SRequest& req, string& error) {
+	if( req.Binary?!req.Storage.load_from_binary(body):!req.Storage.load_from_json(body) ) {
+		LOG_ERROR( (req.Binary?"!load_from_binary":"!load_from_json") );
+		error = "Parse error";
+		return false;
+	}
+	if( !req.Storage.get_value("dapi_version", req.Version, nullptr) ) {
+		error = "No DAPI version";
+		return false;
+	}
+	if( !req.Storage.get_value("method", req.Method, nullptr) ) {
+		error = "No method";
+		return false;
+	}
+	if( req.Version!=rpc_command::DAPI_VERSION ) {
+		error = "Wrong DAPI version";
+		return false;
+	}
 
-    		if(hh.Name!=callback_name) continue;
-    		if(hh.PaymentID.size() &&  hh.PaymentID!=payment_id) continue;
+	req.Storage.get_value("id", req.Id, nullptr);
+	// all payment requests are SubNetData, so PaymentID is just a field of params
+	req.Params = req.Storage.open_section("params", nullptr, false);
+	if(req.Params) req.Storage.get_value("PaymentID", req.PaymentID, req.Params);
+	return true;
+}
 
-    		handler = hh.Handler;
-    		break;
-    	}
-    }
-    LOG_PRINT_L2(response_info.m_body);
+void supernode::DAPI_RPC_Server::WriteResponse(const SRequest& req, epee::serialization::portable_storage& ps, const epee::serialization::section& result, string& out_js) {
+	if(req.Binary) {
+		ps.set_value("jsonrpc", string("2.0"), nullptr);
+		ps.set_value("id", req.Id, nullptr);
+		ps.store_to_binary(out_js);
+		return;
+	}
 
-    if(!handler) { LOG_ERROR("handler not found for: "<<callback_name); return false; }
-    if( !handler->Process(ps, response_info.m_body) ) { LOG_ERROR("Fail to process (ret false): "<<callback_name); return false; }
+	out_js.clear();
 
-    response_info.m_mime_tipe = "application/json";
-    response_info.m_header_info.m_content_type = " application/json";
-    return true;
+	SJsonWriter js(out_js);
+	js << "{\"id\":";
+	epee::serialization::dump_as_json(js, req.Id, 0, false);
+	js << ",\"jsonrpc\":\"2.0\",\"result\":";
+	epee::serialization::dump_as_json(js, result, 0, false);
+	js << "}";
 }
 
 const string& supernode::DAPI_RPC_Server::IP() const { return m_IP; }
@@ -146,20 +153,74 @@ void supernode::DAPI_RPC_Server::Start() { run(m_NumThreads); }
 
 void supernode::DAPI_RPC_Server::Stop() { send_stop_signal(); }
 
+string supernode::DAPI_RPC_Server::HandlerKey(const string& method, const string& payment_id) {
+	string key = method;
+	key += '\n';
+	key += payment_id;
+	return key;
+}
+
+boost::shared_ptr<const supernode::DAPI_RPC_Server::HandlersMap> supernode::DAPI_RPC_Server::HandlersShard(const string& key) const {
+	return boost::atomic_load( &m_Handlers[ std::hash<string>()(key) % s_HandlersShards ] );
+}
+
+boost::shared_ptr<supernode::DAPI_RPC_Server::SCallHandler> supernode::DAPI_RPC_Server::FindHandler(const string& method, const string& payment_id) const {
+	// handler for exact payment id or global one (without payment id), if both - first added
+	const SHandlerData* found = nullptr;
+
+	string key = HandlerKey(method, payment_id);
+	boost::shared_ptr<const HandlersMap> shard = HandlersShard(key);
+	if(shard) {
+		auto it = shard->find(key);
+		if( it!=shard->end() && !it->second.empty() ) found = &it->second.front();
+	}
+
+	if( payment_id.empty() ) return found?found->Handler:nullptr;
+
+	string global_key = HandlerKey(method, "");
+	boost::shared_ptr<const HandlersMap> global_shard = HandlersShard(global_key);
+	if(global_shard) {
+		auto it = global_shard->find(global_key);
+		if( it!=global_shard->end() && !it->second.empty() && (!found || it->second.front().Idx<found->Idx) ) found = &it->second.front();
+	}
+
+	return found?found->Handler:nullptr;
+}
+
 int supernode::DAPI_RPC_Server::AddHandlerData(const SHandlerData& h) {
-	boost::lock_guard<boost::recursive_mutex> lock(m_Handlers_Guard);
+	boost::lock_guard<boost::mutex> lock(m_Handlers_Guard);
 	int idx = m_HandlerIdx;
 	m_HandlerIdx++;
-	m_vHandlers.push_back(h);
-	m_vHandlers.rbegin()->Idx = idx;
+
+	string key = HandlerKey(h.Name, h.PaymentID);
+	boost::shared_ptr<const HandlersMap>& shard = m_Handlers[ std::hash<string>()(key) % s_HandlersShards ];
+	boost::shared_ptr<HandlersMap> copy = shard?boost::make_shared<HandlersMap>(*shard):boost::make_shared<HandlersMap>();
+	vector<SHandlerData>& hv = (*copy)[key];
+	hv.push_back(h);
+	hv.rbegin()->Idx = idx;
+	boost::atomic_store( &shard, boost::shared_ptr<const HandlersMap>(copy) );
+
+	m_HandlerKeys[idx] = key;
 	return idx;
 }
 
 void supernode::DAPI_RPC_Server::RemoveHandler(int idx) {
-	boost::lock_guard<boost::recursive_mutex> lock(m_Handlers_Guard);
-	for(unsigned i=0;i<m_vHandlers.size();i++) if( m_vHandlers[i].Idx==idx ) {
-		m_vHandlers.erase( m_vHandlers.begin()+i );
+	boost::lock_guard<boost::mutex> lock(m_Handlers_Guard);
+	auto kit = m_HandlerKeys.find(idx);
+	if( kit==m_HandlerKeys.end() ) return;
+	string key = kit->second;
+	m_HandlerKeys.erase(kit);
+
+	boost::shared_ptr<const HandlersMap>& shard = m_Handlers[ std::hash<string>()(key) % s_HandlersShards ];
+	if(!shard) return;
+	boost::shared_ptr<HandlersMap> copy = boost::make_shared<HandlersMap>(*shard);
+	auto it = copy->find(key);
+	if( it==copy->end() ) return;
+	vector<SHandlerData>& hv = it->second;
+	for(unsigned i=0;i<hv.size();i++) if( hv[i].Idx==idx ) {
+		hv.erase( hv.begin()+i );
 		break;
 	}
+	if( hv.empty() ) copy->erase(it);
+	boost::atomic_store( &shard, boost::shared_ptr<const HandlersMap>(copy) );
 }
-
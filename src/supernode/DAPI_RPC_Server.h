@@ -32,12 +32,17 @@
 
 #include <boost/bind.hpp>
 #include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
 #include "supernode_rpc_command.h"
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
 #include "net/http_server_impl_base.h"
 #include "FSN_Servant.h"
+#include <cstdio>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
 using namespace std;
 
 namespace supernode {
@@ -56,47 +61,83 @@ namespace supernode {
         void setServant(FSN_Servant *servant);
 
 		protected:
+		// request parsed once: header fields are read from the storage and
+		// handler loads its typed params straight from the params section.
+		// Binary - came to DAPI_BIN_URI, answer in binary storage too
+		struct SRequest {
+			bool Binary = false;
+			string Method;
+			string Version;
+			string PaymentID;
+			epee::serialization::storage_entry Id = epee::serialization::storage_entry(string());
+			epee::serialization::portable_storage Storage;
+			epee::serialization::hsection Params = nullptr;
+		};
+
+		// appends dump_as_json output to string, instead of going through stringstream and copying it out
+		class SJsonWriter {
+			public:
+			explicit SJsonWriter(string& buff) : Buff(buff) {}
+			SJsonWriter& operator<<(const char* str) { Buff += str; return *this; }
+			SJsonWriter& operator<<(const string& str) { Buff += str; return *this; }
+			SJsonWriter& operator<<(double val) {
+				char tmp[32];
+				snprintf(tmp, sizeof(tmp), "%g", val);
+				Buff += tmp;
+				return *this;
+			}
+			template<class T>
+			typename std::enable_if<std::is_integral<T>::value, SJsonWriter&>::type operator<<(T val) { Buff += std::to_string(val); return *this; }
+
+			string& Buff;
+		};
+
 		class SCallHandler {
 			public:
-			virtual bool Process(epee::serialization::portable_storage& in, string& out_js)=0;
+			virtual ~SCallHandler() {}
+			virtual bool Process(SRequest& req, string& out_js)=0;
 		};
 		template<class IN_t, class OUT_t>
 		class STemplateHandler : public SCallHandler {
 			public:
 			STemplateHandler( boost::function<bool (const IN_t&, OUT_t&)>& handler) : Handler(handler) {}
 
-			bool Process(epee::serialization::portable_storage& ps, string& out_js) {
-				  boost::value_initialized<epee::json_rpc::request<IN_t> > req_;
-				  epee::json_rpc::request<IN_t>& req = static_cast<epee::json_rpc::request<IN_t>&>(req_);
-				  if( !req.load(ps) ) return false;
+			bool Process(SRequest& req, string& out_js) {
+				boost::value_initialized<IN_t> in_;
+				IN_t& in = static_cast<IN_t&>(in_);
+				if( req.Params && !in.load(req.Storage, req.Params) ) return false;
 
-				  boost::value_initialized<epee::json_rpc::response<OUT_t, epee::json_rpc::dummy_error> > resp_;
-				  epee::json_rpc::response<OUT_t, epee::json_rpc::dummy_error>& resp =  static_cast<epee::json_rpc::response<OUT_t, epee::json_rpc::dummy_error> &>(resp_);
-				  resp.jsonrpc = "2.0";
-				  resp.id = req.id;
+				boost::value_initialized<OUT_t> out_;
+				OUT_t& out = static_cast<OUT_t&>(out_);
+				if( !Handler(in, out) ) return false;
 
-				  if( !Handler(req.params, resp.result) ) return false;
-
-				  epee::serialization::store_t_to_json(resp, out_js);
-				  return true;
+				epee::serialization::portable_storage ps;
+				epee::serialization::hsection result = ps.open_section("result", nullptr, true);
+				out.store(ps, result);
+				WriteResponse(req, ps, *result, out_js);
+				return true;
 			}
 
 			boost::function<bool (const IN_t&, OUT_t&)> Handler;
 		};
 
 		struct SHandlerData {
-			SCallHandler* Handler = nullptr;
+			boost::shared_ptr<SCallHandler> Handler;
 			string Name;
 			int Idx = -1;
 			string PaymentID;
 		};
 
+		// key - method and payment id, value - handlers in order of add, first one is used
+		typedef unordered_map< string, vector<SHandlerData> > HandlersMap;
+		static const unsigned s_HandlersShards = 64;
+
 
 		public:
 		template<class IN_t, class OUT_t>
 		int AddHandler( const string& method, boost::function<bool (const IN_t&, OUT_t&)> handler ) {
 			SHandlerData hh;
-			hh.Handler = new STemplateHandler<IN_t, OUT_t>(handler);
+			hh.Handler = boost::make_shared< STemplateHandler<IN_t, OUT_t> >(handler);
 			hh.Name = method;
 			return AddHandlerData(hh);
 		}
@@ -108,7 +149,7 @@ namespace supernode {
 		template<class IN_t, class OUT_t>
 		int Add_UUID_MethodHandler( string paymentid, const string& method, boost::function<bool (const IN_t&, OUT_t&)> handler ) {
 			SHandlerData hh;
-			hh.Handler = new STemplateHandler<IN_t, OUT_t>(handler);
+			hh.Handler = boost::make_shared< STemplateHandler<IN_t, OUT_t> >(handler);
 			hh.Name = method;
 			hh.PaymentID = paymentid;
 			return AddHandlerData(hh);
@@ -122,11 +163,24 @@ namespace supernode {
 		protected:
 		bool handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context) override;
 		bool HandleRequest(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, connection_context& m_conn_context);
+		// false and error comment if body is not DAPI request of our version, req.Binary selects encoding
+		static bool ParseRequest(const string& body, SRequest& req, string& error);
+		// json-rpc response, json is written straight into out_js (the response body).
+		// ps - storage holding result section, binary response is stored from it as is
+		static void WriteResponse(const SRequest& req, epee::serialization::portable_storage& ps, const epee::serialization::section& result, string& out_js);
 		int AddHandlerData(const SHandlerData& h);
+		// doesn't take m_Handlers_Guard: shard snapshots are read by boost::atomic_load, which is not lock free,
+		// it holds a boost spinlock (from a small pool, picked by address) for a pointer copy.
+		// returned handler stays valid even if removed meanwhile
+		boost::shared_ptr<SCallHandler> FindHandler(const string& method, const string& payment_id) const;
+		static string HandlerKey(const string& method, const string& payment_id);
+		boost::shared_ptr<const HandlersMap> HandlersShard(const string& key) const;
 
 		protected:
-		boost::recursive_mutex m_Handlers_Guard;
-		vector<SHandlerData> m_vHandlers;
+		// readers take snapshot of one shard, writers copy shard under m_Handlers_Guard and swap it
+		boost::mutex m_Handlers_Guard;
+		boost::shared_ptr<const HandlersMap> m_Handlers[s_HandlersShards];
+		unordered_map<int, string> m_HandlerKeys;// idx -> key, under m_Handlers_Guard
 		int m_HandlerIdx = 0;
 
 		protected:
@@ -30,10 +30,11 @@
 #include "FSN_ActualList.h"
 #include "P2P_Broadcast.h"
 #include "DAPI_RPC_Server.h"
-#include "DAPI_RPC_Client.h"
+#include "DAPI_RPC_ClientPool.h"
 #include <unistd.h>
 
 static const unsigned s_AuditTime = 50*60*1000;//50 min
+static const unsigned s_BlockPollTime = 5*1000;// servant has no block notification, so height is polled
 static const uint64_t s_MinStakeBalance = 0;
 
 namespace supernode {
@@ -53,16 +54,19 @@ FSN_ActualList::FSN_ActualList(FSN_ServantBase* servant, P2P_Broadcast* p2p, DAP
 void FSN_ActualList::Start() {
 	CheckIfIamFSN(true);// may be very slow operation
 
-	m_Work.Workers(10);
-
 	m_Running = true;
 	m_Thread = new boost::thread(&FSN_ActualList::Run, this);
 }
 
 void FSN_ActualList::Stop() {
-	m_Running = false;
+	{
+		boost::lock_guard<boost::mutex> lock(m_AuditGuard);
+		m_Running = false;
+		m_Wakeup = true;
+	}
+	m_AuditEvent.notify_all();
 	m_Thread->join();
-	m_Work.Stop();
+	m_Tasks.Wait();
 }
 
 void FSN_ActualList::GetFSNList(const rpc_command::BROADCAST_NEAR_GET_ACTUAL_FSN_LIST::request& in, rpc_command::BROADCAST_NEAR_GET_ACTUAL_FSN_LIST::response& out) {
@@ -74,7 +78,7 @@ void FSN_ActualList::GetFSNList(const rpc_command::BROADCAST_NEAR_GET_ACTUAL_FSN
 		data.StakeAddr = a->Stake.Addr;
 		data.StakeViewKey = a->Stake.ViewKey;
 		data.MinerAddr = a->Miner.Addr;
-		data.MinerAddr = a->Miner.ViewKey;
+		data.MinerViewKey = a->Miner.ViewKey;
 		out.List.push_back(data);
 	}
 
@@ -89,31 +93,67 @@ void FSN_ActualList::Run() {
 		vector<rpc_command::BROADCAST_NEAR_GET_ACTUAL_FSN_LIST::response> outv;
 		m_P2P->SendNear(p2p_call::GetFSNList, in, outv);
 
-		boost::lock_guard<boost::recursive_mutex> lock(m_All_FSN_Guard);
-		for(auto aa : outv)
-			for(auto a : aa.List) _OnAddFSN(a);
-
+		// checked in parallel on workers, same FSN from several neighbors is checked once
+		for(auto& aa : outv)
+			for(auto& a : aa.List) OnAddFSN(a);
 	}
 
-
+	m_LastHeight = m_Servant->GetCurrentBlockHeight();
+	CheckIfIamFSN();
 
 	while(m_Running) {
-		CheckIfIamFSN();
+		DoAudit();
 
-		while(m_Running) {
-			auto now = boost::posix_time::second_clock::local_time();
-			if( (now-m_AuditStartAt).total_milliseconds()>s_AuditTime ) break;
-			sleep(1);
+		// sleep till next deadline or block poll, AuditNow and Stop wake us earlier
+		{
+			boost::unique_lock<boost::mutex> lock(m_AuditGuard);
+			Clock::time_point until = Clock::now()+boost::chrono::milliseconds(s_BlockPollTime);
+			if( !m_Audits.empty() && m_Audits.top().At<until ) until = m_Audits.top().At;
+			while( m_Running && !m_Wakeup && Clock::now()<until ) m_AuditEvent.wait_until(lock, until);
+			m_Wakeup = false;
 		}
 		if(!m_Running) break;
 
-		m_AuditStartAt = boost::posix_time::second_clock::local_time();
-		DoAudit();
+		// new block: stake may be arrived, so check if we are FSN now
+		uint64_t height = m_Servant->GetCurrentBlockHeight();
+		if( height!=m_LastHeight ) {
+			m_LastHeight = height;
+			CheckIfIamFSN();
+		}
 	}
 
 
 }
 
+void FSN_ActualList::AuditNow() {
+	{
+		boost::lock_guard<boost::mutex> lock(m_AuditGuard);
+		Clock::time_point now = Clock::now();
+		for(auto& a : m_NextAudit) ScheduleAudit(a.first, now);
+		m_Wakeup = true;
+	}
+	m_AuditEvent.notify_all();
+}
+
+void FSN_ActualList::ScheduleAudit(const string& stakeAddr, Clock::time_point at) {
+	m_NextAudit[stakeAddr] = at;
+	SAudit a;
+	a.At = at;
+	a.StakeAddr = stakeAddr;
+	m_Audits.push(a);
+
+	// AuditNow leaves whole heap stale
+	if( m_Audits.size()>4*m_NextAudit.size()+64 ) {
+		priority_queue< SAudit, vector<SAudit>, std::greater<SAudit> > fresh;
+		for(auto& b : m_NextAudit) {
+			a.At = b.second;
+			a.StakeAddr = b.first;
+			fresh.push(a);
+		}
+		m_Audits.swap(fresh);
+	}
+}
+
 void FSN_ActualList::DoAudit() {
 	vector< boost::shared_ptr<FSN_Data> > all;
 	{
@@ -121,21 +161,64 @@ void FSN_ActualList::DoAudit() {
 		all = m_All_FSN;
 	}
 
-	for(unsigned i=0;i<all.size() && m_Running;i++) {
-		if( CheckIsFSN(all[i]) ) continue;
-		auto data = m_Servant->FSN_DataByStakeAddr( all[i]->Stake.Addr );
-		if( !data ) continue;// was deleted
+	vector<string> due;
+	{
+		boost::lock_guard<boost::mutex> lock(m_AuditGuard);
+		Clock::time_point now = Clock::now();
+		// FSN added since last time (from broadcast, config or ourself)
+		for(auto& a : all) if( m_NextAudit.find(a->Stake.Addr)==m_NextAudit.end() ) ScheduleAudit( a->Stake.Addr, now+boost::chrono::milliseconds(s_AuditTime) );
+
+		while( !m_Audits.empty() && m_Audits.top().At<=now ) {
+			SAudit a = m_Audits.top();
+			m_Audits.pop();
+			auto it = m_NextAudit.find(a.StakeAddr);
+			if( it==m_NextAudit.end() || it->second!=a.At ) continue;
+			m_NextAudit.erase(it);
+			due.push_back(a.StakeAddr);
+		}
+	}
+	if( due.empty() ) return;
+
+	vector< boost::shared_ptr<FSN_Data> > datas( due.size() );
+	vector<char> alive( due.size(), 0 );
+	{
+		WorkerTasks tasks;
+		for(unsigned i=0;i<due.size();i++) {
+			datas[i] = m_Servant->FSN_DataByStakeAddr(due[i]);
+			if( !datas[i] ) continue;// was deleted
+			tasks.Post( [this, i, &datas, &alive]() {
+				// audit is about liveness, so always ask FSN again
+				if(m_Running) alive[i] = CheckIsFSN(datas[i], false);
+				else alive[i] = 1;
+			} );
+		}
+		tasks.Wait();
+	}
+
+	{
+		boost::lock_guard<boost::mutex> lock(m_AuditGuard);
+		Clock::time_point next = Clock::now()+boost::chrono::milliseconds(s_AuditTime);
+		for(unsigned i=0;i<due.size();i++) if( datas[i] && alive[i] ) ScheduleAudit(due[i], next);
+	}
+
+	for(unsigned i=0;i<due.size();i++) {
+		if( !datas[i] || alive[i] ) continue;
 
 		rpc_command::BROADCACT_LOST_STATUS_FULL_SUPER_NODE in;
-		in.StakeAddr = data->Stake.Addr;
+		in.StakeAddr = datas[i]->Stake.Addr;
 		m_P2P->Send(p2p_call::LostFSNStatus, in);
-		m_Servant->RemoveFsnAccount(data);
+		m_Servant->RemoveFsnAccount(datas[i]);
 	}//for
 
 }
 
 void FSN_ActualList::CheckIfIamFSN(bool checkOnly) {
 	boost::shared_ptr<FSN_Data> data = boost::shared_ptr<FSN_Data>( new FSN_Data(m_Servant->GetMyStakeWallet(), m_Servant->GetMyMinerWallet(), m_DAPIServer->IP(), m_DAPIServer->Port()) );
+	if(!checkOnly) {
+		boost::lock_guard<boost::recursive_mutex> lock(m_All_FSN_Guard);
+		for(auto a : m_All_FSN) if( a->IP==data->IP && a->Port==data->Port ) return;
+	}
+
 	if( !CheckIsFSN(data) ) return;
 
 	if(checkOnly) return;
@@ -166,7 +249,7 @@ boost::shared_ptr<FSN_Data> FSN_ActualList::_OnAddFSN(const rpc_command::BROADCA
 }
 
 void FSN_ActualList::OnAddFSN(const rpc_command::BROADCACT_ADD_FULL_SUPER_NODE& in ) {
-	m_Work.Service.post( [this, in](){
+	m_Tasks.Post( [this, in](){
 		OnAddFSNFromWorker(in);
 	} );
 }
@@ -177,12 +260,28 @@ void FSN_ActualList::OnAddFSNFromWorker(const rpc_command::BROADCACT_ADD_FULL_SU
 		boost::lock_guard<boost::recursive_mutex> lock(m_All_FSN_Guard);
 		data = _OnAddFSN(in);
 	}
+	if(!data) return;
+
+	// same announcement from many neighbors at once
+	string key = MemoKey(*data);
+	{
+		boost::lock_guard<boost::mutex> lock(m_MemoGuard);
+		if( !m_Checking.insert(key).second ) return;
+	}
+
+	bool ok = CheckIsFSN(data);
+	if(ok) {
+		boost::lock_guard<boost::recursive_mutex> lock(m_All_FSN_Guard);
+		if( !_OnAddFSN(in) ) ok = false;// added while we checked
+	}
+	if(ok) m_Servant->AddFsnAccount(data);// VERY SLOW!!!
 
-	if( data && CheckIsFSN(data) ) m_Servant->AddFsnAccount(data);// VERY SLOW!!!
+	boost::lock_guard<boost::mutex> lock(m_MemoGuard);
+	m_Checking.erase(key);
 }
 
 void FSN_ActualList::OnLostFSNStatus(const rpc_command::BROADCACT_LOST_STATUS_FULL_SUPER_NODE& in) {
-	m_Work.Service.post( [this, in](){
+	m_Tasks.Post( [this, in](){
 		OnLostFSNStatusFromWorker(in);
 	} );
 }
@@ -190,32 +289,52 @@ void FSN_ActualList::OnLostFSNStatus(const rpc_command::BROADCACT_LOST_STATUS_FU
 void FSN_ActualList::OnLostFSNStatusFromWorker(const rpc_command::BROADCACT_LOST_STATUS_FULL_SUPER_NODE& in) {
 	boost::shared_ptr<FSN_Data> data = m_Servant->FSN_DataByStakeAddr(in.StakeAddr);
 	if(!data) return;
-	if( CheckIsFSN(data) ) return;
+	// other node says it's gone, so don't trust what we saw earlier in this block
+	if( CheckIsFSN(data, false) ) return;
 	m_Servant->RemoveFsnAccount(data);
 }
 
-bool FSN_ActualList::CheckWalletOwner(boost::shared_ptr<FSN_Data> data, const string& wa) {
+bool FSN_ActualList::CheckWalletOwner(boost::shared_ptr<FSN_Data> data, const string& wa, bool& answered) {
 	rpc_command::FSN_CHECK_WALLET_OWNERSHIP::request in;
 	rpc_command::FSN_CHECK_WALLET_OWNERSHIP::response out;
 	in.Str = GenStrForSign( data->IP, data->Port, wa );
 	in.WalletAddr = wa;
 
-	DAPI_RPC_Client call;
-	call.Set(data->IP, data->Port);
-	if( !call.Invoke(dapi_call::FSN_CheckWalletOwnership, in, out) ) return false;
+	answered = DAPI_RPC_ClientPool::Shared().Invoke(data->IP, data->Port, dapi_call::FSN_CheckWalletOwnership, in, out);
+	if(!answered) return false;
 	return m_Servant->IsSignValid(in.Str, in.WalletAddr, out.Sign);
 
 }
 
-bool FSN_ActualList::CheckIsFSN(boost::shared_ptr<FSN_Data> data) {
-	if( !CheckWalletOwner(data, data->Stake.Addr) ) return false;
-	if( !CheckWalletOwner(data, data->Miner.Addr) ) return false;
+string FSN_ActualList::MemoKey(const FSN_Data& data) {
+	return data.IP + string(":") + data.Port + string(":") + data.Stake.Addr + string(":") + data.Stake.ViewKey + string(":") + data.Miner.Addr;
+}
 
+bool FSN_ActualList::CheckIsFSN(boost::shared_ptr<FSN_Data> data, bool useMemo) {
+	uint64_t height = m_Servant->GetCurrentBlockHeight();
+	string key = MemoKey(*data);
+	if(useMemo) {
+		boost::lock_guard<boost::mutex> lock(m_MemoGuard);
+		auto it = m_Memo.find(key);
+		if( m_MemoHeight==height && it!=m_Memo.end() ) return it->second;
+	}
 
-	uint64_t bal = m_Servant->GetWalletBalance( m_Servant->GetCurrentBlockHeight(), data->Stake );
-	if(bal<s_MinStakeBalance) return false;
+	bool answered = true;
+	bool ret = CheckWalletOwner(data, data->Stake.Addr, answered) && CheckWalletOwner(data, data->Miner.Addr, answered);
+	if(ret) {
+		uint64_t bal = m_Servant->GetWalletBalance( height, data->Stake );
+		if(bal<s_MinStakeBalance) ret = false;
+	}
 
-	return true;
+	if(!answered) return false;
+
+	boost::lock_guard<boost::mutex> lock(m_MemoGuard);
+	if( height>m_MemoHeight ) {
+		m_Memo.clear();
+		m_MemoHeight = height;
+	}
+	if( height==m_MemoHeight ) m_Memo[key] = ret;
+	return ret;
 }
 
 bool FSN_ActualList::FSN_CheckWalletOwnership(const rpc_command::FSN_CHECK_WALLET_OWNERSHIP::request& in, rpc_command::FSN_CHECK_WALLET_OWNERSHIP::response& out) {
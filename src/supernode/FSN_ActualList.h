@@ -33,6 +33,11 @@
 #include "FSN_ServantBase.h"
 #include "supernode_rpc_command.h"
 #include "WorkerPool.h"
+#include <boost/chrono.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace supernode {
 
@@ -55,14 +60,32 @@ public:
 	void OnAddFSNFromWorker(const rpc_command::BROADCACT_ADD_FULL_SUPER_NODE& in );
 	void OnLostFSNStatusFromWorker(const rpc_command::BROADCACT_LOST_STATUS_FULL_SUPER_NODE& in);
 
+	// make all known FSN due for audit and wake audit thread
+	void AuditNow();
+
+protected:
+	typedef boost::chrono::steady_clock Clock;
+
+	struct SAudit {
+		Clock::time_point At;
+		string StakeAddr;
+		bool operator>(const SAudit& s) const { return At>s.At; }
+	};
+
 protected:
 	string GenStrForSign(const string& dapiIP, const string& dapiPort, const string& walletAddr);
-	bool CheckIsFSN(boost::shared_ptr<FSN_Data> data);
-	bool CheckWalletOwner(boost::shared_ptr<FSN_Data> data, const string& wa);
+	// result is kept per FSN and block height, so repeated announcements are not checked again.
+	// fails of unreachable FSN are not kept, audits and lost status reports don't use kept results
+	bool CheckIsFSN(boost::shared_ptr<FSN_Data> data, bool useMemo=true);
+	// answered - false if FSN was not reachable
+	bool CheckWalletOwner(boost::shared_ptr<FSN_Data> data, const string& wa, bool& answered);
 	boost::shared_ptr<FSN_Data> _OnAddFSN(const rpc_command::BROADCACT_ADD_FULL_SUPER_NODE& in );
 	void Run();
 	void CheckIfIamFSN(bool checkOnly=false);
+	// checks in parallel FSN which audit deadline passed
 	virtual void DoAudit();
+	void ScheduleAudit(const string& stakeAddr, Clock::time_point at);// under m_AuditGuard
+	static string MemoKey(const FSN_Data& data);
 
 protected:
     boost::recursive_mutex& m_All_FSN_Guard;// DO NOT block for long time. if need - use copy
@@ -73,8 +96,21 @@ protected:
     bool m_Running = false;
     boost::thread* m_Thread = nullptr;
 
-    WorkerPool m_Work;
-    boost::posix_time::ptime m_AuditStartAt;
+    WorkerTasks m_Tasks;
+
+    // audit deadlines, earliest on top. entry is stale if m_NextAudit has other time for the wallet
+    boost::mutex m_AuditGuard;
+    boost::condition_variable m_AuditEvent;
+    priority_queue< SAudit, vector<SAudit>, std::greater<SAudit> > m_Audits;
+    unordered_map<string, Clock::time_point> m_NextAudit;
+    bool m_Wakeup = false;
+    uint64_t m_LastHeight = 0;
+
+    // CheckIsFSN results for m_MemoHeight, and checks running now
+    boost::mutex m_MemoGuard;
+    uint64_t m_MemoHeight = 0;
+    unordered_map<string, bool> m_Memo;
+    unordered_set<string> m_Checking;
 
 };
 
@@ -32,6 +32,10 @@
 #include <blockchain_db/blockchain_db.h>
 #include <cryptonote_core/tx_pool.h>
 #include <cryptonote_core/blockchain.h>
+#include <common/base58.h>
+#include <crypto/signature_batch.h>
+#include <boost/make_shared.hpp>
+#include <cstring>
 #include <exception>
 
 
@@ -45,62 +49,10 @@ namespace supernode {
 namespace consts {
     static const string DEFAULT_FSN_WALLETS_DIR = "/tmp/graft/fsn_data/wallets_vo";
     static const int    DEFAULT_FSN_WALLET_REFRESH_INTERVAL_MS = 5000;
+    // how long balance query waits for the scanner to reach top of chain
+    static const int    DEFAULT_FSN_WALLET_SCAN_WAIT_MS = 10000;
 }
 
-namespace helpers {
-public_key get_tx_gen_pub_key(const transaction &tx)
-{
-    if (!is_coinbase(tx)) {
-        return null_pkey;
-    }
-    const tx_out &out = tx.vout.at(0);
-    return boost::get<txout_to_key>(out.target).key;
-}
-
-
-// copied code from monero-blockchain-explorer
-// TODO: optimize it for the purpose
-public_key get_tx_pub_key_from_received_outs(const transaction &tx)
-{
-    std::vector<tx_extra_field> tx_extra_fields;
-
-    if(!parse_tx_extra(tx.extra, tx_extra_fields))
-    {
-        // Extra may only be partially parsed, it's OK if tx_extra_fields contains public key
-    }
-
-    // Due to a previous bug, there might be more than one tx pubkey in extra, one being
-    // the result of a previously discarded signature.
-    // For speed, since scanning for outputs is a slow process, we check whether extra
-    // contains more than one pubkey. If not, the first one is returned. If yes, they're
-    // checked for whether they yield at least one output
-    tx_extra_pub_key pub_key_field;
-
-    if (!find_tx_extra_field_by_type(tx_extra_fields, pub_key_field, 0))
-    {
-        return null_pkey;
-    }
-
-    public_key tx_pub_key = pub_key_field.pub_key;
-
-    bool two_found = find_tx_extra_field_by_type(tx_extra_fields, pub_key_field, 1);
-
-    if (!two_found)
-    {
-        // easy case, just one found
-        return tx_pub_key;
-    }
-    else
-    {
-        // just return second one if there are two.
-        // this does not require private view key, as
-        // its not needed for my use case.
-        return pub_key_field.pub_key;
-    }
-
-    return null_pkey;
-}
-} // namespace helpers
 
 
 
@@ -135,6 +87,14 @@ FSN_Servant::FSN_Servant(const string &bdb_path, const string &node_addr, const
     if (!initBlockchain(bdb_path, testnet))
         throw std::runtime_error("Failed to open blockchain");
 
+    m_viewOnlyWallets = boost::make_shared<WalletScanner>(boost::make_shared<WalletScanner::DBBlockSource>(m_bdb), testnet, (boost::filesystem::path(m_fsnWalletsDir) / "wallet_scanner.bin").string());
+    m_viewOnlyWallets->RefreshInterval = std::chrono::milliseconds(consts::DEFAULT_FSN_WALLET_REFRESH_INTERVAL_MS);
+    m_viewOnlyWallets->Load();
+    m_viewOnlyWallets->Start();
+    m_coinbaseIndex = boost::make_shared<CoinbaseIndex>(m_bdb, testnet, (boost::filesystem::path(m_fsnWalletsDir) / "coinbase_index.bin").string());
+    m_coinbaseIndex->RefreshInterval = std::chrono::milliseconds(consts::DEFAULT_FSN_WALLET_REFRESH_INTERVAL_MS);
+    m_coinbaseIndex->Load();
+    m_coinbaseIndex->Start();
 }
 
 void FSN_Servant::Set(const string& stakeFileName, const string& stakePasswd, const string& minerFileName, const string& minerPasswd)
@@ -158,45 +118,12 @@ FSN_Servant::LastBlocksResolvedByFSN(uint64_t startFromBlock, uint64_t blockNums
         return result;
     }
 
-    // option #2: as we have direct access to blockchain, we can use Blockchain class directly
-    //1. retrieve the blocks
-
     LOG_PRINT_L3("Start checking from block " << startFromBlock);
     LOG_PRINT_L3("block height " << block_height);
     uint64_t endBlock = std::min(block_height - 1, startFromBlock + blockNums - 1);
 
-    // TODO: read/write lock
-    All_FSN_Guard.lock();
-
-    for (uint64_t block_index = endBlock; block_index >= startFromBlock; --block_index) {
-        const cryptonote::block block = m_bdb->get_block_from_height(block_index);
-        //2. for each blocks, apply function from xmrblocks (page.h:show_my_outputs)
-        // TODO: can be faster algorithm?
-        for (const auto & fsn_wallet : All_FSN) {
-            secret_key viewkey;
-            epee::string_tools::hex_to_pod(fsn_wallet->Miner.ViewKey, viewkey);
-            cryptonote::account_public_address address;
-            LOG_PRINT_L3("parsing address : " << fsn_wallet->Miner.Addr << "; testnet: " << m_testnet);
-
-            if (!cryptonote::get_account_address_from_str(address, m_testnet, fsn_wallet->Miner.Addr)) {
-                LOG_ERROR("Error parsing address: " << fsn_wallet->Miner.Addr);
-                // throw exception here?
-                continue;
-            }
-
-            LOG_PRINT_L3("pub spend key: " << epee::string_tools::pod_to_hex(address.m_spend_public_key));
-            LOG_PRINT_L3("pub view key: " << epee::string_tools::pod_to_hex(address.m_view_public_key));
-
-            if (proofCoinbaseTx(address, block, viewkey)) {
-                result.push_back(std::make_pair(block_index, fsn_wallet));
-                // stop wallets loop as we already found the wallet who solved block
-                break;
-            }
-        }
-    }
-    All_FSN_Guard.unlock();
-
-    return result;
+    // indexed by own thread, only not yet indexed blocks of the range are checked here
+    return m_coinbaseIndex->Solved(startFromBlock, endBlock);
 }
 
 vector< boost::shared_ptr<supernode::FSN_Data> > FSN_Servant::GetAuthSample(uint64_t forBlockNum) const
@@ -218,41 +145,95 @@ string FSN_Servant::SignByWalletPrivateKey(const string& str, const string& wall
     return wallet->signMessage(str);
 }
 
+// as wallet2::verify does, without going through wallet
+static bool parseSign(const string &address, const string &signature, bool testnet, crypto::public_key &key, crypto::signature &sig)
+{
+    cryptonote::account_public_address addr;
+    bool has_payment_id;
+    crypto::hash8 payment_id;
+    if (!cryptonote::get_account_integrated_address_from_str(addr, has_payment_id, payment_id, testnet, address))
+        return false;
+
+    const size_t header_len = strlen("SigV1");
+    if (signature.size() < header_len || signature.compare(0, header_len, "SigV1") != 0)
+        return false;
+    std::string decoded;
+    if (!tools::base58::decode(signature.substr(header_len), decoded) || decoded.size() != sizeof(sig))
+        return false;
+    memcpy(&sig, decoded.data(), sizeof(sig));
+    key = addr.m_spend_public_key;
+    return true;
+}
+
 bool FSN_Servant::IsSignValid(const string &message, const string &address, const string &signature) const
 {
-    // verify can be done by any wallet
-    // TODO: make is static in wallet2_api/wallet2;
-    return m_minerWallet->verifySignedMessage(message, address, signature);
+    crypto::public_key key;
+    crypto::signature sig;
+    if (!parseSign(address, signature, m_testnet, key, sig))
+        return false;
+
+    crypto::hash hash;
+    crypto::cn_fast_hash(message.data(), message.size(), hash);
+    return crypto::check_signature(hash, key, sig);
+}
+
+bool FSN_Servant::AreSignsValid(const string &message, const vector< pair<string, string> > &signs, vector<bool> &results) const
+{
+    crypto::hash hash;
+    crypto::cn_fast_hash(message.data(), message.size(), hash);
+
+    // unparsable ones are not in batch
+    crypto::signature_batch batch;
+    vector<int> index(signs.size(), -1);
+    for (unsigned i = 0; i < signs.size(); ++i) {
+        crypto::public_key key;
+        crypto::signature sig;
+        if (parseSign(signs[i].first, signs[i].second, m_testnet, key, sig))
+            index[i] = batch.add(hash, key, sig);
+    }
+
+    vector<bool> valid;
+    batch.verify(valid);
+
+    results.assign(signs.size(), false);
+    bool ret = true;
+    for (unsigned i = 0; i < signs.size(); ++i) {
+        results[i] = index[i] >= 0 && valid[index[i]];
+        ret = ret && results[i];
+    }
+    return ret;
 }
 
 
 uint64_t FSN_Servant::GetWalletBalance(uint64_t block_num, const FSN_WalletData& wallet) const
 {
-    // create or open view-only wallet;
-    Monero::Wallet * w = initViewOnlyWallet(wallet, m_testnet);
-    uint64_t result = w->unlockedBalance(block_num);
+    if (!initViewOnlyWallet(wallet))
+        return 0;
 
-    return result;
+    // scanned by own thread of the scanner, caller (a task of the shared pool) waits bounded time
+    if (!m_viewOnlyWallets->WaitScanned(wallet.Addr, std::chrono::milliseconds(consts::DEFAULT_FSN_WALLET_SCAN_WAIT_MS))) {
+        LOG_PRINT_L1("wallet " << wallet.Addr << " is not scanned yet");
+        return 0;
+    }
+
+    return m_viewOnlyWallets->UnlockedBalance(wallet.Addr, block_num);
 }
 
 void FSN_Servant::AddFsnAccount(boost::shared_ptr<FSN_Data> fsn) {
 	FSN_ServantBase::AddFsnAccount(fsn);
+    // miner keys parsed once here, not on every LastBlocksResolvedByFSN
+    m_coinbaseIndex->Add(fsn);
     // create view-only wallet for stake account
-    initViewOnlyWallet(fsn->Stake, m_testnet);
+    initViewOnlyWallet(fsn->Stake);
 }
 
 bool FSN_Servant::RemoveFsnAccount(boost::shared_ptr<FSN_Data> fsn) {
-    boost::lock_guard<boost::recursive_mutex> lock(All_FSN_Guard);// we use one mutex for All_FSN && for m_viewOnlyWallets
+    boost::lock_guard<boost::recursive_mutex> lock(All_FSN_Guard);
 
     if( !FSN_ServantBase::RemoveFsnAccount(fsn) ) return false;
+    m_coinbaseIndex->Remove(fsn);
 
-    // TODO: RAII based (scoped) locks
-    const auto &it = m_viewOnlyWallets.find(fsn->Stake.Addr);
-    if (it != m_viewOnlyWallets.end()) {
-        Monero::Wallet * w = it->second;
-        Monero::WalletManagerFactory::getWalletManager()->closeWallet(w);
-        m_viewOnlyWallets.erase(it);
-    } else {
+    if (!m_viewOnlyWallets->RemoveAccount(fsn->Stake.Addr)) {
         LOG_ERROR("Internal error: All_FSN doesn't have corresponding wallet: " << fsn->Stake.Addr);
     }
 
@@ -276,41 +257,6 @@ FSN_WalletData FSN_Servant::GetMyMinerWallet() const
     return walletData(m_minerWallet);
 }
 
-bool FSN_Servant::proofCoinbaseTx(const cryptonote::account_public_address &address, const cryptonote::block &block,
-                                  const crypto::secret_key &viewkey)
-{
-    // public transaction key is combined with our viewkey
-    // to create, so called, derived key.
-    // TODO: check why block.hash is invalid here;
-    // LOG_PRINT_L3("checking block: " << epee::string_tools::pod_to_hex(block.hash) << ", hash valid: " << block.is_hash_valid());
-
-    crypto::public_key tx_pubkey = helpers::get_tx_pub_key_from_received_outs(block.miner_tx);
-
-    crypto::key_derivation derivation;
-    if (!generate_key_derivation(tx_pubkey, viewkey, derivation)) {
-        LOG_ERROR("Cant get derived key for: "  << "\n"
-             << "pub_view_key: " << tx_pubkey << " and "
-             << "prv_view_key" << viewkey);
-        return false;
-    }
-
-    LOG_PRINT_L3("view_pub_key: " << epee::string_tools::pod_to_hex(address.m_view_public_key));
-    LOG_PRINT_L3("priv_viewkey: " << epee::string_tools::pod_to_hex(viewkey));
-    // TODO: check why tx_id is invalid here
-    LOG_PRINT_L3("tx_id: " << epee::string_tools::pod_to_hex(block.miner_tx.hash));
-    public_key output_pubkey = helpers::get_tx_gen_pub_key(block.miner_tx);
-    public_key tx_pubkey_derived;
-    derive_public_key(derivation,
-                      0,
-                      address.m_spend_public_key,
-                      tx_pubkey_derived);
-
-    LOG_PRINT_L3("out pubkey: " << epee::string_tools::pod_to_hex(output_pubkey));
-    LOG_PRINT_L3("pubkey derived: " << epee::string_tools::pod_to_hex(tx_pubkey_derived));
-
-    return tx_pubkey_derived == output_pubkey;
-}
-
 bool FSN_Servant::initBlockchain(const string &dbpath, bool testnet)
 {
 
@@ -370,48 +316,22 @@ Wallet *FSN_Servant::initWallet(Wallet * existingWallet, const string &path, con
     return wallet;
 }
 
-Wallet *FSN_Servant::initViewOnlyWallet(const FSN_WalletData &walletData, bool testnet) const
+bool FSN_Servant::initViewOnlyWallet(const FSN_WalletData &walletData) const
 {
 
     if (walletData.Addr.empty()) {
         LOG_ERROR("Adding wallet with empty address");
-        return nullptr;
-    }
-
-    const auto & walletIter = m_viewOnlyWallets.find(walletData.Addr);
-    if (walletIter != m_viewOnlyWallets.end())
-        return walletIter->second;
-
-    // No luck, somehow caller requested the address we don't have view-only wallet yet
-    boost::filesystem::path wallet_path (m_fsnWalletsDir);
-    wallet_path /= walletData.Addr;
-    Monero::Wallet * w = nullptr;
-    Monero::WalletManager * wmgr = Monero::WalletManagerFactory::getWalletManager();
-
-    if (!wmgr->walletExists(wallet_path.string())) {
-        // create new view only wallet
-        w = wmgr->createWalletFromKeys(wallet_path.string(), "English", m_testnet, 0, walletData.Addr, walletData.ViewKey);
-    } else {
-        // open existing
-        w = wmgr->openWallet(wallet_path.string(), "", m_testnet);
+        return false;
     }
 
-    if (!w)
-        throw std::runtime_error(std::string("unable to open/create view only wallet: " + wmgr->errorString()));
+    if (m_viewOnlyWallets->HasAccount(walletData.Addr))
+        return true;
 
+    if (!m_viewOnlyWallets->AddAccount(walletData.Addr, walletData.ViewKey))
+        return m_viewOnlyWallets->HasAccount(walletData.Addr);// added by other thread
 
-    if (!w->init(GetNodeAddress(), 0)) {
-        MERROR("Can't connect to a daemon.");
-    } else {
-        w->setAutoRefreshInterval(consts::DEFAULT_FSN_WALLET_REFRESH_INTERVAL_MS);
-        w->startRefresh();
-        w->refresh();
-    }
-
-    // add wallet to map
-    m_viewOnlyWallets[walletData.Addr] = w;
     // TODO: should have opened wallets in sync with the All_FSN ???
-    return w;
+    return true;
 }
 
 
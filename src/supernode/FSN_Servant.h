@@ -31,6 +31,8 @@
 #define FSN_SERVANT_H_
 
 #include "FSN_ServantBase.h"
+#include "CoinbaseIndex.h"
+#include "WalletScanner.h"
 #include <cryptonote_core/cryptonote_core.h>
 #include <wallet/wallet2_api.h>
 #include <boost/thread/mutex.hpp>
@@ -105,6 +107,15 @@ public:
      */
     bool IsSignValid(const string& message, const string &address, const string &signature) const  override;
 
+    /*!
+     * \brief AreSignsValid - checks signatures of one message in one batch
+     * \param message     - message
+     * \param signs       - wallet address and signature pairs
+     * \param results     - result for each pair
+     * \return            - true if all signatures are valid
+     */
+    bool AreSignsValid(const string& message, const vector< pair<string, string> >& signs, vector<bool>& results) const  override;
+
     // calc balance from chain begin to block_num
     uint64_t GetWalletBalance(uint64_t block_num, const FSN_WalletData& wallet) const  override;
 
@@ -118,18 +129,16 @@ public:
     unsigned AuthSampleSize() const override;
 
 private:
-    static bool proofCoinbaseTx(const cryptonote::account_public_address &address, const cryptonote::block &block,
-                         const crypto::secret_key &viewkey);
     bool initBlockchain(const std::string &dbpath, bool testnet);
 
     Monero::Wallet * initWallet(Monero::Wallet *existingWallet, const string &path, const string &password, bool testnet);
     /*!
-     * \brief initViewOnlyWallet - creates new or opens existing view only wallet
+     * \brief initViewOnlyWallet - registers address and viewkey in view-only wallets scanner,
+     *                             new wallet is scanned by the scanner thread
      * \brief walletData         - address and viewkey
-     * \param testnet            - testnet flag
-     * \return                   - pointer to Monero::Wallet obj
+     * \return                   - false if wallet data can't be parsed
      */
-    Monero::Wallet * initViewOnlyWallet(const FSN_WalletData &walletData, bool testnet) const;
+    bool initViewOnlyWallet(const FSN_WalletData &walletData) const;
     static FSN_WalletData walletData(Monero::Wallet * wallet);
 
     Monero::Wallet * getMyWalletByAddress(const std::string &address) const;
@@ -143,7 +152,10 @@ private:
 
     mutable Monero::Wallet *m_stakeWallet = nullptr;
     mutable Monero::Wallet *m_minerWallet = nullptr;
-    mutable std::map<std::string, Monero::Wallet*> m_viewOnlyWallets;
+    // view-only wallets of other FSNs, all scanned in one pass over local blockchain
+    boost::shared_ptr<WalletScanner> m_viewOnlyWallets;
+    // blocks solved by miner wallets of All_FSN
+    boost::shared_ptr<CoinbaseIndex> m_coinbaseIndex;
 
 };
 
@@ -83,6 +83,16 @@ void FSN_ServantBase::SetNodeAddress(const string &address)
     }
 }
 
+bool FSN_ServantBase::AreSignsValid(const string& message, const vector< pair<string, string> >& signs, vector<bool>& results) const {
+	results.assign(signs.size(), false);
+	bool ret = true;
+	for(unsigned i=0;i<signs.size();i++) {
+		results[i] = IsSignValid(message, signs[i].first, signs[i].second);
+		ret = ret && results[i];
+	}
+	return ret;
+}
+
 void FSN_ServantBase::AddFsnAccount(boost::shared_ptr<FSN_Data> fsn) {
 	boost::lock_guard<boost::recursive_mutex> lock(All_FSN_Guard);
     All_FSN.push_back(fsn);
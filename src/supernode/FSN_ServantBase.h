@@ -47,6 +47,8 @@ namespace supernode {
 	    virtual string SignByWalletPrivateKey(const string& str, const string& wallet_addr) const=0;
 
 	    virtual bool IsSignValid(const string& message, const string &address, const string &signature) const=0;
+	    // many signatures of one message, signs - (address, signature). true if all valid, results[i] - of i-th one
+	    virtual bool AreSignsValid(const string& message, const vector< pair<string, string> >& signs, vector<bool>& results) const;
 
 
 	    virtual uint64_t GetWalletBalance(uint64_t block_num, const FSN_WalletData& wallet) const=0;
@@ -29,6 +29,7 @@
 
 #include "graft_defines.h"
 #include "PosProxy.h"
+#include "RTATracer.h"
 
 void supernode::PosProxy::Init() {
     BaseClientProxy::Init();
@@ -40,6 +41,7 @@ void supernode::PosProxy::Init() {
 
 bool supernode::PosProxy::Sale(const rpc_command::POS_SALE::request& in, rpc_command::POS_SALE::response& out) {
 	LOG_PRINT_L0("PosProxy::Sale" << in.POSAddress << in.Amount);
+	RTATracer::Scope trace("", "PosProxy.Sale");
     //TODO: Add input data validation
 	boost::shared_ptr<PosSaleObject> data = boost::shared_ptr<PosSaleObject>( new PosSaleObject() );
 	data->Owner(this);
@@ -50,8 +52,10 @@ bool supernode::PosProxy::Sale(const rpc_command::POS_SALE::request& in, rpc_com
     {
         out.Result = ERROR_SALE_REQUEST_FAILED;
         LOG_ERROR("ERROR_SALE_REQUEST_FAILED");
+        trace.Failed();
         return false;
     }
+	trace.Payment(data->TransactionRecord.PaymentID);
 	Add(data);
 
 	m_Work.Service.post( [data](){
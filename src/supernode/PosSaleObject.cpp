@@ -122,10 +122,16 @@ bool supernode::PosSaleObject::PoSTRSigned(const rpc_command::POS_TR_SIGNED::req
         return false;
     }
 
+    vector< pair<string, string> > signs;
+    for (unsigned i = 0; i < graft_tx_extra.Signs.size(); ++i)
+        signs.push_back( make_pair(TransactionRecord.AuthNodes[i]->Stake.Addr, graft_tx_extra.Signs.at(i)) );
+    vector<bool> signsValid;
+    CheckSigns(signs, signsValid);
+
     for (unsigned i = 0; i < graft_tx_extra.Signs.size(); ++i) {
         const string &sign = graft_tx_extra.Signs.at(i);
 
-        if( CheckSign(TransactionRecord.AuthNodes[i]->Stake.Addr, sign) ) {
+        if( signsValid[i] ) {
         	m_Signs++;
         } else {
         	LOG_ERROR("TX " << in.TransactionPoolID << " : signature failed to check for all nodes: " << sign);
@@ -0,0 +1,172 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "RTATracer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace supernode {
+
+unsigned LatencyHistogram::Bucket(uint64_t value) {
+	if(value<16) return value;
+	unsigned msb = 63-__builtin_clzll(value);
+	unsigned shift = msb-3;
+	return shift*8+(value>>shift);
+}
+
+uint64_t LatencyHistogram::BucketMax(unsigned bucket) {
+	if(bucket<16) return bucket;
+	unsigned shift = bucket/8-1;
+	uint64_t m = bucket%8+8;
+	return ((m+1)<<shift)-1;
+}
+
+void LatencyHistogram::Add(uint64_t value) {
+	m_Buckets[ Bucket(value) ]++;
+	m_Count++;
+	m_Max = std::max(m_Max, value);
+}
+
+uint64_t LatencyHistogram::Percentile(double p) const {
+	if(!m_Count) return 0;
+	uint64_t target = std::max<uint64_t>( 1, uint64_t( std::ceil(p*m_Count) ) );
+	uint64_t seen = 0;
+	for(unsigned i=0;i<s_Buckets;i++) {
+		seen += m_Buckets[i];
+		if(seen>=target) return std::min( BucketMax(i), m_Max );
+	}
+	return m_Max;
+}
+
+
+RTATracer& RTATracer::Shared() {
+	static RTATracer* tracer = new RTATracer();
+	return *tracer;
+}
+
+uint64_t RTATracer::Micro(Clock::duration d) {
+	return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+void RTATracer::Phase(const string& paymentID, const string& name, Clock::time_point start, bool ok) {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	Event( paymentID, SEvent{name, string(), start, Clock::now(), ok}, m_Phases[name] );
+}
+
+void RTATracer::Call(const string& paymentID, const string& method, const string& remote, Clock::time_point start, bool ok) {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	Event( paymentID, SEvent{method, remote, start, Clock::now(), ok}, m_Calls[method] );
+}
+
+void RTATracer::Event(const string& paymentID, SEvent&& ev, LatencyHistogram& hist) {
+	hist.Add( Micro(ev.End-ev.Start) );
+	if( paymentID.empty() ) return;
+
+	auto it = m_Pending.find(paymentID);
+	if( it==m_Pending.end() ) {
+		FinishIdle(ev.End);
+		it = m_Pending.insert( make_pair(paymentID, STrace()) ).first;
+		it->second.PaymentID = paymentID;
+		it->second.Start = ev.Start;
+		it->second.End = ev.End;
+		it->second.Order = m_PendingOrder.insert(m_PendingOrder.end(), paymentID);
+	} else {
+		m_PendingOrder.splice(m_PendingOrder.end(), m_PendingOrder, it->second.Order);
+	}
+
+	STrace& tr = it->second;
+	tr.Start = std::min(tr.Start, ev.Start);
+	tr.End = std::max(tr.End, ev.End);
+	tr.Events.push_back( std::move(ev) );
+}
+
+void RTATracer::Finish(const string& paymentID) {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	auto it = m_Pending.find(paymentID);
+	if( it!=m_Pending.end() ) DoFinish(it);
+}
+
+void RTATracer::DoFinish(unordered_map<string, STrace>::iterator it) {
+	STrace& tr = it->second;
+	m_Total.Add( Micro(tr.End-tr.Start) );
+	m_PendingOrder.erase(tr.Order);
+
+	m_Finished.push_back( std::move(tr) );
+	while( m_Finished.size()>RecentFinished ) m_Finished.pop_front();
+	m_Pending.erase(it);
+}
+
+void RTATracer::FinishIdle(Clock::time_point now) {
+	while( !m_PendingOrder.empty() ) {
+		auto it = m_Pending.find( m_PendingOrder.front() );
+		if( m_Pending.size()<MaxPending && now-it->second.End<IdleTimeout ) break;
+		DoFinish(it);
+	}
+}
+
+rpc_command::RTA_LATENCY RTATracer::Latency(const string& name, const LatencyHistogram& hist) {
+	rpc_command::RTA_LATENCY ret;
+	ret.Name = name;
+	ret.Count = hist.Count();
+	ret.P50 = hist.Percentile(0.5);
+	ret.P99 = hist.Percentile(0.99);
+	ret.P999 = hist.Percentile(0.999);
+	ret.Max = hist.Max();
+	return ret;
+}
+
+rpc_command::RTA_LATENCY_REPORT RTATracer::Report(unsigned slowest) {
+	rpc_command::RTA_LATENCY_REPORT ret;
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	FinishIdle( Clock::now() );
+
+	ret.Total = Latency("Total", m_Total);
+	for(auto& a : m_Phases) ret.Phases.push_back( Latency(a.first, a.second) );
+	for(auto& a : m_Calls) ret.Calls.push_back( Latency(a.first, a.second) );
+
+	vector<const STrace*> traces;
+	for(auto& a : m_Finished) traces.push_back(&a);
+	size_t cnt = std::min<size_t>(slowest, traces.size());
+	std::partial_sort(traces.begin(), traces.begin()+cnt, traces.end(), [](const STrace* a, const STrace* b) {
+		return a->End-a->Start > b->End-b->Start;
+	});
+
+	for(size_t i=0;i<cnt;i++) {
+		const STrace& tr = *traces[i];
+		rpc_command::RTA_TRACE out;
+		out.PaymentID = tr.PaymentID;
+		out.Total = Micro(tr.End-tr.Start);
+		for(auto& ev : tr.Events) {
+			out.Events.push_back( rpc_command::RTA_TRACE_EVENT{ev.Name, ev.Remote, Micro(ev.Start-tr.Start), Micro(ev.End-ev.Start), ev.Ok} );
+		}
+		ret.Slowest.push_back(out);
+	}
+	return ret;
+}
+
+}
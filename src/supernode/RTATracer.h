@@ -0,0 +1,205 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef RTA_TRACER_H_
+#define RTA_TRACER_H_
+
+#include "serialization/keyvalue_serialization.h"
+#include <boost/thread/mutex.hpp>
+#include <chrono>
+#include <deque>
+#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+namespace supernode {
+
+	namespace rpc_command {
+		// all times in microseconds
+		struct RTA_LATENCY {
+			string Name;
+			uint64_t Count = 0;
+			uint64_t P50 = 0;
+			uint64_t P99 = 0;
+			uint64_t P999 = 0;
+			uint64_t Max = 0;
+
+			BEGIN_KV_SERIALIZE_MAP()
+				KV_SERIALIZE(Name)
+				KV_SERIALIZE(Count)
+				KV_SERIALIZE(P50)
+				KV_SERIALIZE(P99)
+				KV_SERIALIZE(P999)
+				KV_SERIALIZE(Max)
+			END_KV_SERIALIZE_MAP()
+		};
+
+		struct RTA_TRACE_EVENT {
+			string Name;
+			string Remote;// ip:port for DAPI call
+			uint64_t Start;// from trace start
+			uint64_t Duration;
+			bool Ok;
+
+			BEGIN_KV_SERIALIZE_MAP()
+				KV_SERIALIZE(Name)
+				KV_SERIALIZE(Remote)
+				KV_SERIALIZE(Start)
+				KV_SERIALIZE(Duration)
+				KV_SERIALIZE(Ok)
+			END_KV_SERIALIZE_MAP()
+		};
+
+		struct RTA_TRACE {
+			string PaymentID;
+			uint64_t Total;
+			vector<RTA_TRACE_EVENT> Events;
+
+			BEGIN_KV_SERIALIZE_MAP()
+				KV_SERIALIZE(PaymentID)
+				KV_SERIALIZE(Total)
+				KV_SERIALIZE(Events)
+			END_KV_SERIALIZE_MAP()
+		};
+
+		struct RTA_LATENCY_REPORT {
+			RTA_LATENCY Total;// first event start - last event end of payment
+			vector<RTA_LATENCY> Phases;
+			vector<RTA_LATENCY> Calls;
+			vector<RTA_TRACE> Slowest;
+
+			BEGIN_KV_SERIALIZE_MAP()
+				KV_SERIALIZE(Total)
+				KV_SERIALIZE(Phases)
+				KV_SERIALIZE(Calls)
+				KV_SERIALIZE(Slowest)
+			END_KV_SERIALIZE_MAP()
+		};
+	}
+
+	// log-linear buckets, 8 per power of two, so percentiles are within 12.5%
+	class LatencyHistogram {
+		public:
+		void Add(uint64_t value);
+		uint64_t Count() const { return m_Count; }
+		uint64_t Max() const { return m_Max; }
+		// upper bound of the bucket with p-th value, p in [0, 1]
+		uint64_t Percentile(double p) const;
+
+		protected:
+		static unsigned Bucket(uint64_t value);
+		static uint64_t BucketMax(unsigned bucket);
+
+		protected:
+		static const unsigned s_Buckets = 8*64;
+		uint64_t m_Buckets[s_Buckets] = {};
+		uint64_t m_Count = 0;
+		uint64_t m_Max = 0;
+	};
+
+	// timestamps of RTA phases and DAPI calls by PaymentID, for latency histograms and
+	// dump of the slowest payments. payment is done when it's idle for IdleTimeout or Finish called
+	class RTATracer {
+		public:
+		typedef std::chrono::steady_clock Clock;
+
+		// records phase from construction to destruction
+		class Scope {
+			public:
+			Scope(const string& paymentID, const char* phase) : m_PaymentID(paymentID), m_Phase(phase), m_Start(Clock::now()) {}
+			~Scope() { Done(); }
+			void Payment(const string& paymentID) { m_PaymentID = paymentID; }// when it's known later
+			void Failed() { m_Ok = false; }
+			// phase ends before the scope
+			void Done() {
+				if(m_Done) return;
+				m_Done = true;
+				RTATracer::Shared().Phase(m_PaymentID, m_Phase, m_Start, m_Ok);
+			}
+
+			protected:
+			string m_PaymentID;
+			const char* m_Phase;
+			Clock::time_point m_Start;
+			bool m_Ok = true;
+			bool m_Done = false;
+		};
+
+		public:
+		static RTATracer& Shared();
+
+		void Phase(const string& paymentID, const string& name, Clock::time_point start, bool ok=true);
+		void Call(const string& paymentID, const string& method, const string& remote, Clock::time_point start, bool ok);
+		void Finish(const string& paymentID);
+
+		rpc_command::RTA_LATENCY_REPORT Report(unsigned slowest=10);
+
+		public:
+		std::chrono::milliseconds IdleTimeout = std::chrono::seconds(30);
+		unsigned MaxPending = 10000;
+		unsigned RecentFinished = 1000;// slowest are picked from them
+
+		protected:
+		struct SEvent {
+			string Name;
+			string Remote;
+			Clock::time_point Start;
+			Clock::time_point End;
+			bool Ok;
+		};
+
+		struct STrace {
+			string PaymentID;
+			Clock::time_point Start;
+			Clock::time_point End;
+			vector<SEvent> Events;
+			list<string>::iterator Order;
+		};
+
+		void Event(const string& paymentID, SEvent&& ev, LatencyHistogram& hist);
+		void DoFinish(unordered_map<string, STrace>::iterator it);
+		void FinishIdle(Clock::time_point now);
+		static uint64_t Micro(Clock::duration d);
+		static rpc_command::RTA_LATENCY Latency(const string& name, const LatencyHistogram& hist);
+
+		protected:
+		boost::mutex m_Guard;
+		unordered_map<string, STrace> m_Pending;
+		list<string> m_PendingOrder;// oldest activity first
+		deque<STrace> m_Finished;
+		map<string, LatencyHistogram> m_Phases;
+		map<string, LatencyHistogram> m_Calls;
+		LatencyHistogram m_Total;
+	};
+
+}
+
+#endif /* RTA_TRACER_H_ */
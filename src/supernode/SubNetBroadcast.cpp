@@ -32,15 +32,12 @@
 
 static const unsigned s_MaxNotAvailCount = 4;
 
-supernode::SubNetBroadcast::SubNetBroadcast(unsigned workerThreads)  {
-	m_Work.Workers(workerThreads);
-
-}
+supernode::SubNetBroadcast::SubNetBroadcast() {}
 
 supernode::SubNetBroadcast::~SubNetBroadcast() {
 	for(auto a : m_MyHandlers) m_DAPIServer->RemoveHandler(a);
 	m_MyHandlers.clear();
-	m_Work.Stop();
+	m_Tasks.Wait();
 }
 
 vector< pair<string, string> > supernode::SubNetBroadcast::Members() {
@@ -86,17 +83,103 @@ void supernode::SubNetBroadcast::Set( DAPI_RPC_Server* pa, string subnet_id, con
 
 void supernode::SubNetBroadcast::IncNoConnectAndRemove(const string& ip, const string& port) {
 	boost::lock_guard<boost::recursive_mutex> lock(m_MembersGuard);
+	if( DAPI_RPC_ClientPool::Shared().NotAvailCount(ip, port)<s_MaxNotAvailCount ) return;
 	for(unsigned i=0;i<m_Members.size();i++) if( m_Members[i].IP==ip && m_Members[i].Port==port ) {
-		m_Members[i].NotAvailCount++;
-		if( m_Members[i].NotAvailCount>=s_MaxNotAvailCount ) {
-			m_Members.erase( m_Members.begin()+i );
-		}
+		m_Members.erase( m_Members.begin()+i );
 		break;
 	}
 
 
 }
 
+supernode::SubNetBroadcast::SSendStateBase::SSendStateBase(const vector<SMember>& members, unsigned quorum) {
+	for(auto& a : members) {
+		SCallResult r;
+		r.IP = a.IP;
+		r.Port = a.Port;
+		m_Results.push_back(r);
+	}
+	m_Quorum = std::min<unsigned>( quorum, m_Results.size() );
+}
+
+supernode::SubNetBroadcast::SSendStateBase::~SSendStateBase() {}
 
+void supernode::SubNetBroadcast::SSendStateBase::Start(boost::function<void ()> onCompleted) {
+	bool completed = false;
+	{
+		boost::lock_guard<boost::mutex> lock(m_Guard);
+		m_OnCompleted = onCompleted;
+		completed = CheckCompleted();
+	}
+	if(completed) Complete();
+}
 
+void supernode::SubNetBroadcast::SSendStateBase::SetResult(unsigned idx, CallStatus status, std::chrono::milliseconds time) {
+	bool completed = false;
+	{
+		boost::lock_guard<boost::mutex> lock(m_Guard);
+		m_Results[idx].Status = status;
+		m_Results[idx].Time = time;
+		m_DoneCount++;
+		if(status==CallStatus::Ok) m_OkCount++;
+		completed = CheckCompleted();
+	}
+	if(completed) Complete();
+}
+
+bool supernode::SubNetBroadcast::SSendStateBase::CheckCompleted() {
+	if(m_Completing) return false;
+
+	unsigned pending = m_Results.size()-m_DoneCount;
+	if( m_Quorum==0 ) {
+		if(pending) return false;
+		m_Succeeded = true;
+	} else if( m_OkCount>=m_Quorum ) {
+		m_Succeeded = true;
+	} else if( m_OkCount+pending>=m_Quorum ) {
+		return false;
+	}
+
+	m_Completing = true;
+	return true;
+}
 
+void supernode::SubNetBroadcast::SSendStateBase::Complete() {
+	// callback first, so it's done when Wait() returns
+	if(m_OnCompleted) m_OnCompleted();
+	m_OnCompleted.clear();
+	{
+		boost::lock_guard<boost::mutex> lock(m_Guard);
+		m_Completed = true;
+	}
+	m_CompletedCond.notify_all();
+}
+
+void supernode::SubNetBroadcast::SSendStateBase::Wait() {
+	boost::unique_lock<boost::mutex> lock(m_Guard);
+	while(!m_Completed) m_CompletedCond.wait(lock);
+}
+
+bool supernode::SubNetBroadcast::SSendStateBase::Wait(std::chrono::milliseconds timeout) {
+	boost::unique_lock<boost::mutex> lock(m_Guard);
+	auto until = boost::chrono::steady_clock::now()+boost::chrono::milliseconds( timeout.count() );
+	while(!m_Completed) {
+		if( m_CompletedCond.wait_until(lock, until)==boost::cv_status::timeout ) break;
+	}
+	return m_Completed;
+}
+
+bool supernode::SubNetBroadcast::SSendStateBase::Completed() const {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	return m_Completed;
+}
+
+bool supernode::SubNetBroadcast::SSendStateBase::Succeeded() const {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	return m_Succeeded;
+}
+
+vector<supernode::SubNetBroadcast::SCallResult> supernode::SubNetBroadcast::SSendStateBase::Results() const {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	return m_Results;
+}
@@ -32,9 +32,12 @@
 
 #include "supernode_common_struct.h"
 #include <string>
-#include "DAPI_RPC_Client.h"
+#include "DAPI_RPC_ClientPool.h"
 #include "DAPI_RPC_Server.h"
+#include "RTATracer.h"
 #include "WorkerPool.h"
+#include <boost/make_shared.hpp>
+#include <chrono>
 using namespace std;
 
 namespace supernode {
@@ -43,7 +46,7 @@ namespace supernode {
 
 	class SubNetBroadcast {
 		public:
-		SubNetBroadcast(unsigned workerThreads=10);
+		SubNetBroadcast();
 		virtual ~SubNetBroadcast();
 		// all messages will send with subnet_id
 		// and handler will recieve only messages with subnet_id
@@ -56,7 +59,6 @@ namespace supernode {
 			SMember(const string& ip, const string& p) { IP = ip; Port = p; }
 			string IP;
 			string Port;
-			unsigned NotAvailCount = 0;
 		};
 
 		vector< pair<string, string> > Members();//port, ip
@@ -66,67 +68,121 @@ namespace supernode {
 		std::chrono::milliseconds CallTimeout = std::chrono::seconds(5);
 		bool AllowSendSefl = true;
 
-		public:
-		template<class IN_t, class OUT_t>
-		bool Send( const string& method, const IN_t& in, vector<OUT_t>& out, bool reqAllResps=true ) {
-			if(m_SendsCount) throw string("m_SendsCount not zero");
+		enum class CallStatus : int {
+			Pending = 0,
+			Ok,
+			Failed,// connected, but no valid answer
+			NoConnect// can't connect or timeout
+		};
+
+		struct SCallResult {
+			string IP;
+			string Port;
+			CallStatus Status = CallStatus::Pending;
+			std::chrono::milliseconds Time = std::chrono::milliseconds(0);// with all retries
+		};
+
+		static const unsigned QuorumAll = unsigned(-1);
+
+		// state of one send to all members. shared between caller and worker tasks,
+		// so caller can go on after quorum, while rest of calls are still in flight
+		class SSendStateBase {
+			public:
+			// quorum - number of Ok answers needed, 0 - just wait all answers
+			SSendStateBase(const vector<SMember>& members, unsigned quorum);
+			virtual ~SSendStateBase();
+
+			// completed: quorum reached, quorum can't be reached or all members answered
+			void Wait();
+			bool Wait(std::chrono::milliseconds timeout);// false if not completed in time
+			bool Completed() const;
+			bool Succeeded() const;
+			vector<SCallResult> Results() const;
+
+			public:
+			// for SubNetBroadcast only
+			void Start(boost::function<void ()> onCompleted);
+			void SetResult(unsigned idx, CallStatus status, std::chrono::milliseconds time);
+
+			protected:
+			bool CheckCompleted();// under m_Guard, true only once
+			void Complete();
+
+			protected:
+			mutable boost::mutex m_Guard;
+			boost::condition_variable m_CompletedCond;
+			vector<SCallResult> m_Results;
+			unsigned m_Quorum = 0;
+			unsigned m_OkCount = 0;
+			unsigned m_DoneCount = 0;
+			bool m_Completing = false;
+			bool m_Completed = false;
+			bool m_Succeeded = false;
+			boost::function<void ()> m_OnCompleted;
+		};
 
-			m_MembersGuard.lock();
+		template<class OUT_t>
+		class SSendState : public SSendStateBase {
+			public:
+			SSendState(const vector<SMember>& members, unsigned quorum) : SSendStateBase(members, quorum), m_Out( members.size() ) {}
+
+			// Ok answers, in members order
+			vector<OUT_t> Responses() const {
+				boost::lock_guard<boost::mutex> lock(m_Guard);
+				vector<OUT_t> ret;
+				for(unsigned i=0;i<m_Results.size();i++) if( m_Results[i].Status==CallStatus::Ok ) ret.push_back( m_Out[i] );
+				return ret;
+			}
 
-			out.resize( m_Members.size() );
-			vector<int> rets;
-			rets.resize( m_Members.size(), 0 );
-			m_SendsCount = m_Members.size();
+			void SetResponse(unsigned idx, const OUT_t& out) {
+				boost::lock_guard<boost::mutex> lock(m_Guard);
+				m_Out[idx] = out;
+			}
+
+			protected:
+			vector<OUT_t> m_Out;
+		};
+
+		public:
+		// not blocked, onCompleted called from worker thread before Wait() returns
+		template<class IN_t, class OUT_t>
+		boost::shared_ptr< SSendState<OUT_t> > SendAsync( const string& method, const IN_t& in, unsigned quorum=QuorumAll, boost::function<void (const SSendState<OUT_t>&)> onCompleted=boost::function<void (const SSendState<OUT_t>&)>() ) {
+			boost::lock_guard<boost::recursive_mutex> lock(m_MembersGuard);
 
+			boost::shared_ptr< SSendState<OUT_t> > state = boost::make_shared< SSendState<OUT_t> >(m_Members, quorum);
+			SSendState<OUT_t>* statep = state.get();
+			boost::function<void ()> completed;
+			if(onCompleted) completed = [onCompleted, statep](){ onCompleted(*statep); };
+			state->Start(completed);
 
 			for(unsigned i=0;i<m_Members.size();i++) {
-				OUT_t* outp = &out[i];
-				int* retp = &rets[i];
 				string ip = m_Members[i].IP;
 				string port = m_Members[i].Port;
-				m_Work.Service.post(
-					[this, method, in, outp, retp, ip, port]() {
-					DoCallInThread<IN_t, OUT_t>(method, in, outp, retp, ip, port);
+				m_Tasks.Post(
+					[this, method, in, state, i, ip, port]() {
+					DoCallInThread<IN_t, OUT_t>(method, in, state, i, ip, port);
 				} );
 			}
 
-			m_MembersGuard.unlock();
-
-			while(m_SendsCount) boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+			return state;
+		}
 
-			bool ret = true;
+		template<class IN_t, class OUT_t>
+		bool Send( const string& method, const IN_t& in, vector<OUT_t>& out, bool reqAllResps=true ) {
+			boost::shared_ptr< SSendState<OUT_t> > state = SendAsync<IN_t, OUT_t>(method, in, reqAllResps?QuorumAll:0);
+			state->Wait();
 
-			if(reqAllResps) {
-				for(unsigned i=0;i<m_Members.size();i++) if( rets[i]==0 ) {
-					ret = false; break;
-				}
-				if(!ret) out.clear();
-			} else {
-				 vector<OUT_t> vv;
-				 for(unsigned i=0;i<out.size();i++) if( rets[i]!=0 ) vv.push_back( out[i] );
-				 out = vv;
+			out = state->Responses();
+			if( reqAllResps && !state->Succeeded() ) {
+				out.clear();
+				return false;
 			}
-
-			return ret;
+			return true;
 		}
 
 		template<class IN_t>
 		void Send( const string& method, const IN_t& in) {
-			if(m_SendsCount) throw string("m_SendsCount not zero");
-
-			rpc_command::P2P_DUMMY_RESP* outp = &m_DummyOut;
-			int* retp = &m_DummyRet;
-
-			boost::lock_guard<boost::recursive_mutex> lock(m_MembersGuard);
-
-			for(unsigned i=0;i<m_Members.size();i++) {
-				string ip = m_Members[i].IP;
-				string port = m_Members[i].Port;
-				m_Work.Service.post(
-					[this, method, in, outp, retp, ip, port]() {
-					DoCallInThread<IN_t, rpc_command::P2P_DUMMY_RESP>(method, in, outp, retp, ip, port);
-				} );
-			}//for
+			SendAsync<IN_t, rpc_command::P2P_DUMMY_RESP>(method, in, 0);
 		}
 
 
@@ -139,24 +195,27 @@ namespace supernode {
 
 		public:
 		template<class IN_t, class OUT_t>
-		void DoCallInThread(string method, const IN_t in, OUT_t* outo, int* ret, string ip, string port) {
+		void DoCallInThread(string method, const IN_t in, boost::shared_ptr< SSendState<OUT_t> > state, unsigned idx, string ip, string port) {
+			auto started = std::chrono::steady_clock::now();
+			OUT_t out;
 			bool localcOk = false;
 			bool wasNoConnect = false;
 			for(unsigned k=0;k<RetryCount;k++) {
-				DAPI_RPC_Client client;
-				client.Set( ip, port );
-				if( !client.Invoke<IN_t, OUT_t>(method, in, *outo, CallTimeout) ) {
-					wasNoConnect = wasNoConnect || !client.WasConnected;
+				bool connected = false;
+				if( !DAPI_RPC_ClientPool::Shared().Invoke<IN_t, OUT_t>(ip, port, method, in, out, CallTimeout, &connected) ) {
+					wasNoConnect = wasNoConnect || !connected;
 					boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
 					continue;
 				}
 				localcOk = true;
 				break;
 			}//for K
-			*ret = localcOk?1:0;
 			if(!localcOk && wasNoConnect) IncNoConnectAndRemove(ip, port);
 
-			if(m_SendsCount) m_SendsCount--;
+			if(localcOk) state->SetResponse(idx, out);
+			RTATracer::Shared().Call(m_PaymentID, method, ip+":"+port, started, localcOk);
+			auto time = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now()-started );
+			state->SetResult( idx, localcOk?CallStatus::Ok:( wasNoConnect?CallStatus::NoConnect:CallStatus::Failed ), time );
 		}//do work
 
 
@@ -172,14 +231,7 @@ namespace supernode {
 		vector<int> m_MyHandlers;
 
 		protected:
-		int m_SendsCount = 0;
-	    WorkerPool m_Work;
-
-		protected:
-		rpc_command::P2P_DUMMY_RESP m_DummyOut;
-		int m_DummyRet=0;
-
-
+		WorkerTasks m_Tasks;// in process-wide WorkerPool::Shared()
 
 };
 
@@ -0,0 +1,126 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TIMER_WHEEL_H_
+#define TIMER_WHEEL_H_
+
+#include <chrono>
+#include <vector>
+using namespace std;
+
+namespace supernode {
+
+	// hierarchical timer wheel: schedule and expire are O(1) amortized, no matter how many
+	// timers are pending. timers are not cancelled, owner checks if value is still actual when it expires.
+	// not thread safe
+	template<class T>
+	class TimerWheel {
+		public:
+		typedef std::chrono::steady_clock::time_point TimePoint;
+
+		TimerWheel(std::chrono::milliseconds resolution=std::chrono::seconds(1))
+			: m_Resolution(resolution), m_Start(std::chrono::steady_clock::now()) {
+		}
+
+		void Schedule(TimePoint at, const T& value) {
+			uint64_t tick = TickOf(at);
+			if(tick<m_Current) tick = m_Current;
+			Place( SEntry{tick, value} );
+			m_Size++;
+		}
+
+		// moves values of all timers expired to 'now' into 'expired'
+		void Advance(TimePoint now, vector<T>& expired) {
+			uint64_t tick = TickOf(now);
+			while(m_Current<=tick) {
+				if(m_Size==0) {// nothing to walk through
+					m_Current = tick+1;
+					break;
+				}
+
+				unsigned slot = m_Current&s_SlotMask;
+				if(slot==0) Cascade();
+
+				vector<SEntry>& entries = m_Slots[0][slot];
+				for(auto& e : entries) expired.push_back(e.Value);
+				m_Size -= entries.size();
+				entries.clear();
+				m_Current++;
+			}
+		}
+
+		size_t Size() const { return m_Size; }
+
+		protected:
+		static const unsigned s_SlotBits = 6;
+		static const unsigned s_Slots = 1<<s_SlotBits;
+		static const unsigned s_SlotMask = s_Slots-1;
+		static const unsigned s_Levels = 4;// 64^4 ticks, ~194 days with 1 sec resolution
+
+		struct SEntry {
+			uint64_t Tick;
+			T Value;
+		};
+
+		uint64_t TickOf(TimePoint at) const {
+			if(at<=m_Start) return 0;
+			return std::chrono::duration_cast<std::chrono::milliseconds>(at-m_Start).count()/m_Resolution.count();
+		}
+
+		void Place(const SEntry& e) {
+			uint64_t delta = e.Tick-m_Current;
+			unsigned level = 0;
+			while( level<s_Levels-1 && delta>=(uint64_t(1)<<(s_SlotBits*(level+1))) ) level++;
+			uint64_t tick = e.Tick;
+			// too far: park in the farthest slot, it's placed again on cascade
+			if( delta>=(uint64_t(1)<<(s_SlotBits*s_Levels)) ) tick = m_Current+(uint64_t(1)<<(s_SlotBits*s_Levels))-1;
+			m_Slots[level][ (tick>>(s_SlotBits*level))&s_SlotMask ].push_back(e);
+		}
+
+		// lower level wrapped, move timers of the next period down
+		void Cascade() {
+			for(unsigned level=1;level<s_Levels;level++) {
+				unsigned slot = (m_Current>>(s_SlotBits*level))&s_SlotMask;
+				vector<SEntry> entries;
+				entries.swap( m_Slots[level][slot] );
+				for(auto& e : entries) Place(e);
+				if(slot!=0) break;
+			}
+		}
+
+		protected:
+		std::chrono::milliseconds m_Resolution;
+		TimePoint m_Start;
+		uint64_t m_Current = 0;// next tick to expire
+		size_t m_Size = 0;
+		vector<SEntry> m_Slots[s_Levels][s_Slots];
+	};
+
+}
+
+#endif /* TIMER_WHEEL_H_ */
@@ -30,6 +30,7 @@
 #include "WalletPayObject.h"
 #include "graft_defines.h"
 #include "WalletProxy.h"
+#include "RTATracer.h"
 
 void supernode::WalletPayObject::Owner(WalletProxy* o) { m_Owner = o; }
 
@@ -52,7 +53,14 @@ void supernode::WalletPayObject::BeforStart() {
 
 
 bool supernode::WalletPayObject::Init(const rpc_command::WALLET_PAY::request& src) {
-	bool ret = _Init(src);
+	bool ret;
+	{
+		RTATracer::Scope trace(src.PaymentID, "WalletPay.Init");
+		ret = _Init(src);
+		if(!ret) trace.Failed();
+	}
+	// wallet side is the last one, payment is done
+	RTATracer::Shared().Finish(src.PaymentID);
     m_Status = ret ? NTransactionStatus::Success : NTransactionStatus::Fail;
 	return ret;
 }
@@ -71,6 +79,7 @@ bool supernode::WalletPayObject::_Init(const rpc_command::WALLET_PAY::request& s
 
 	InitSubnet();
 
+	RTATracer::Scope signsTrace(TransactionRecord.PaymentID, "WalletPay.CollectSigns");
 	vector<rpc_command::WALLET_PROXY_PAY::response> outv;
 	rpc_command::WALLET_PROXY_PAY::request inbr;
 	rpc_command::ConvertFromTR(inbr, TransactionRecord);
@@ -95,9 +104,13 @@ bool supernode::WalletPayObject::_Init(const rpc_command::WALLET_PAY::request& s
         return false;// not all signs gotted
     }
 
+    vector< pair<string, string> > signs;
+    for (auto& a : outv) signs.push_back( make_pair(a.FSN_StakeWalletAddr, a.Sign) );
+    vector<bool> signsValid;
+    if( !CheckSigns(signs, signsValid) ) return false;
+
     for (auto& a : outv) {
 
-		if( !CheckSign(a.FSN_StakeWalletAddr, a.Sign) ) return false;
 		m_Signs.push_back(a.Sign);
         LOG_PRINT_L0("pushing sign " << a.Sign << " to tx,  checked with address: " << a.FSN_StakeWalletAddr);
 
@@ -105,15 +118,21 @@ bool supernode::WalletPayObject::_Init(const rpc_command::WALLET_PAY::request& s
 
 
 
-	if( !PutTXToPool() ) return false;
+	signsTrace.Done();
+
+	{
+		RTATracer::Scope trace(TransactionRecord.PaymentID, "WalletPay.PutTXToPool");
+		if( !PutTXToPool() ) { trace.Failed(); return false; }
+	}
 
+	RTATracer::Scope trace(TransactionRecord.PaymentID, "WalletPay.WalletPutTxInPool");
 	rpc_command::WALLET_PUT_TX_IN_POOL::request req;
 	req.PaymentID = TransactionRecord.PaymentID;
 	req.TransactionPoolID = m_TransactionPoolID;
 
 	vector<rpc_command::WALLET_PUT_TX_IN_POOL::response> vv_out;
 
-	if( !m_SubNetBroadcast.Send( dapi_call::WalletPutTxInPool, req, vv_out) ) return false;
+	if( !m_SubNetBroadcast.Send( dapi_call::WalletPutTxInPool, req, vv_out) ) { trace.Failed(); return false; }
 
 
 	return true;
@@ -29,6 +29,7 @@
 
 #include "graft_defines.h"
 #include "WalletProxy.h"
+#include "RTATracer.h"
 
 void supernode::WalletProxy::Init() {
     BaseClientProxy::Init();
@@ -52,11 +53,13 @@ bool supernode::WalletProxy::WalletRejectPay(const rpc_command::WALLET_REJECT_PA
 
 bool supernode::WalletProxy::Pay(const rpc_command::WALLET_PAY::request& in, rpc_command::WALLET_PAY::response& out) {
 	LOG_PRINT_L0("WalletProxy::Pay" << in.POSAddress << in.Amount);
+	RTATracer::Scope trace(in.PaymentID, "WalletProxy.Pay");
 	boost::shared_ptr<WalletPayObject> data = boost::shared_ptr<WalletPayObject>( new WalletPayObject() );
 	data->Owner(this);
 	Setup(data);
 	data->BeforStart();
-	Add(data);
+	// PaymentID comes to the object in Init, index it by the request one now
+	Add(data, in.PaymentID);
 
 	m_Work.Service.post( [data, in](){
 	    if (!data->Init(in)) {
@@ -76,7 +79,5 @@ bool supernode::WalletProxy::WalletGetPosData(const rpc_command::WALLET_GET_POS_
 
 	boost::shared_ptr<FSN_Data> data = *vv.begin();
 
-	DAPI_RPC_Client call;
-	call.Set(data->IP, data->Port);
-	return call.Invoke(dapi_call::WalletProxyGetPosData, in, out);
+	return DAPI_RPC_ClientPool::Shared().Invoke(data->IP, data->Port, dapi_call::WalletProxyGetPosData, in, out);
 }
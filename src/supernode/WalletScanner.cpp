@@ -0,0 +1,477 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "WalletScanner.h"
+#include "common/util.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "file_io_utils.h"
+#include "ringct/rctSigs.h"
+#include "storages/portable_storage_template_helper.h"
+#include "string_tools.h"
+#include <boost/filesystem.hpp>
+#include <boost/make_shared.hpp>
+
+namespace supernode {
+
+uint64_t WalletScanner::DBBlockSource::Height() const {
+	return m_DB->height();
+}
+
+crypto::hash WalletScanner::DBBlockSource::BlockHash(uint64_t height) const {
+	return m_DB->get_block_hash_from_height(height);
+}
+
+bool WalletScanner::DBBlockSource::Block(uint64_t height, cryptonote::block& blk, vector<cryptonote::transaction>& txs) const {
+	blk = m_DB->get_block_from_height(height);
+	txs.reserve( txs.size()+blk.tx_hashes.size() );
+	for(auto& h : blk.tx_hashes) {
+		txs.push_back( cryptonote::transaction() );
+		if( !m_DB->get_tx(h, txs.back()) ) return false;
+	}
+	return true;
+}
+
+
+WalletScanner::WalletScanner(boost::shared_ptr<BlockSource> source, bool testnet, const string& fileName) : m_Source(source), m_Testnet(testnet), m_FileName(fileName) {
+	// own pool: accounts are checked in parallel with tasks of the shared one
+	m_Workers.Workers( tools::get_max_concurrency() );
+}
+
+WalletScanner::~WalletScanner() {
+	Stop();
+	m_Workers.Stop();
+}
+
+void WalletScanner::Start() {
+	if(m_Thread) return;
+	m_Running = true;
+	m_Thread = new boost::thread(&WalletScanner::Run, this);
+}
+
+void WalletScanner::Stop() {
+	if(!m_Thread) return;
+	m_Running = false;
+	m_Thread->join();
+	delete m_Thread;
+	m_Thread = nullptr;
+	Store();
+}
+
+void WalletScanner::Run() {
+	auto next = std::chrono::steady_clock::now();
+	while(m_Running) {
+		bool refreshNow = false;
+		{
+			boost::lock_guard<boost::mutex> lock(m_Guard);
+			std::swap(refreshNow, m_RefreshNow);
+		}
+		if( refreshNow || std::chrono::steady_clock::now()>=next ) {
+			try {
+				Refresh();
+				Store();
+			} catch(const std::exception& e) {
+				LOG_ERROR("wallet scanner refresh failed: " << e.what());
+			}
+			next = std::chrono::steady_clock::now()+RefreshInterval;
+		}
+		boost::this_thread::sleep( boost::posix_time::milliseconds(100) );
+	}
+}
+
+bool WalletScanner::AddAccount(const string& addr, const string& viewKey) {
+	boost::shared_ptr<SAccount> acc = boost::make_shared<SAccount>();
+	acc->Addr = addr;
+	if( !cryptonote::get_account_address_from_str(acc->Address, m_Testnet, addr) ) {
+		LOG_ERROR("Error parsing address: " << addr);
+		return false;
+	}
+	if( !epee::string_tools::hex_to_pod(viewKey, acc->ViewKey) ) {
+		LOG_ERROR("Error parsing view key of: " << addr);
+		return false;
+	}
+
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	if( m_Accounts.find(addr)!=m_Accounts.end() ) return false;
+	auto st = m_Stored.find(addr);
+	if( st!=m_Stored.end() && st->second.ViewKey==epee::string_tools::pod_to_hex(acc->ViewKey) ) {
+		acc->ScannedHeight = st->second.ScannedHeight;
+		acc->Outputs = std::move(st->second.Outputs);
+		m_Stored.erase(st);
+	}
+	m_Accounts.insert( make_pair(addr, acc) );
+	m_Changed = true;
+	m_RefreshNow = true;
+	return true;
+}
+
+bool WalletScanner::RemoveAccount(const string& addr) {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	if( !m_Accounts.erase(addr) ) return false;
+	m_Changed = true;
+	return true;
+}
+
+bool WalletScanner::HasAccount(const string& addr) const {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	return m_Accounts.find(addr)!=m_Accounts.end();
+}
+
+size_t WalletScanner::AccountsCount() const {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	return m_Accounts.size();
+}
+
+uint64_t WalletScanner::ScannedHeight() const {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	return m_ScannedHeight;
+}
+
+bool WalletScanner::WaitScanned(const string& addr, std::chrono::milliseconds timeout) {
+	uint64_t top = m_Source->Height();
+	auto until = boost::chrono::steady_clock::now()+boost::chrono::milliseconds( timeout.count() );
+
+	boost::unique_lock<boost::mutex> lock(m_Guard);
+	while(true) {
+		auto it = m_Accounts.find(addr);
+		if( it==m_Accounts.end() ) return false;
+		if( it->second->ScannedHeight>=top ) return true;
+		m_RefreshNow = true;
+		if( m_Scanned.wait_until(lock, until)==boost::cv_status::timeout ) return false;
+	}
+}
+
+uint64_t WalletScanner::Refresh() {
+	boost::lock_guard<boost::mutex> scanLock(m_ScanGuard);
+
+	uint64_t fork = ForkHeight();
+	if( fork<ScannedHeight() ) {
+		LOG_PRINT_L1("wallet scanner: chain reorganized from block " << fork);
+		Rollback(fork);
+	}
+
+	uint64_t top = m_Source->Height();
+	uint64_t scanned = 0;
+
+	while(true) {
+		vector< boost::shared_ptr<SAccount> > accounts;
+		SBatch batch;
+		batch.From = top;
+		{
+			boost::lock_guard<boost::mutex> lock(m_Guard);
+			for(auto& a : m_Accounts) if(a.second->ScannedHeight<top) {
+				accounts.push_back(a.second);
+				batch.From = std::min(batch.From, a.second->ScannedHeight);
+			}
+		}
+		if( accounts.empty() ) break;
+
+		batch.To = std::min(top, batch.From+BatchBlocks);
+		if( !ReadBatch(batch) ) {
+			LOG_ERROR("wallet scanner: can't read blocks " << batch.From << " - " << batch.To);
+			break;
+		}
+
+		// accounts added later are behind, only they need older blocks
+		accounts.erase( std::remove_if(accounts.begin(), accounts.end(), [&batch](const boost::shared_ptr<SAccount>& a) {
+			return a->ScannedHeight>=batch.To;
+		}), accounts.end() );
+
+		vector< vector<SOutput> > found( accounts.size() );
+		{
+			WorkerTasks tasks(m_Workers);
+			for(size_t i=0;i<accounts.size();i+=AccountsPerTask) {
+				size_t cnt = std::min<size_t>(AccountsPerTask, accounts.size()-i);
+				tasks.Post( boost::bind(&WalletScanner::ScanAccounts, this, boost::cref(batch), &accounts[i], cnt, &found[i]) );
+			}
+			tasks.Wait();
+		}
+
+		{
+			boost::lock_guard<boost::mutex> lock(m_Guard);
+			for(size_t i=0;i<accounts.size();i++) {
+				SAccount& a = *accounts[i];
+				a.Outputs.insert( a.Outputs.end(), found[i].begin(), found[i].end() );
+				a.ScannedHeight = batch.To;
+			}
+			m_ScannedHeight = std::max(m_ScannedHeight, batch.To);
+			for(size_t i=0;i<batch.Hashes.size();i++) m_Hashes[batch.From+i] = batch.Hashes[i];
+			while( m_Hashes.size()>ReorgDepth ) m_Hashes.erase( m_Hashes.begin() );
+			m_Changed = true;
+		}
+		m_Scanned.notify_all();
+
+		scanned += batch.To-batch.From;
+	}
+
+	return scanned;
+}
+
+bool WalletScanner::ReadBatch(SBatch& batch) {
+	vector<size_t> txsInBlock;
+	for(uint64_t h=batch.From;h<batch.To;h++) {
+		cryptonote::block blk;
+		size_t first = batch.Txs.size();
+		if( !m_Source->Block(h, blk, batch.Txs) ) return false;
+		batch.Txs.push_back(blk.miner_tx);
+		batch.Hashes.push_back( cryptonote::get_block_hash(blk) );
+		txsInBlock.push_back( batch.Txs.size()-first );
+	}
+
+	// parse once for all accounts
+	batch.Parsed.reserve( batch.Txs.size() );
+	size_t t = 0;
+	for(size_t b=0;b<txsInBlock.size();b++) for(size_t i=0;i<txsInBlock[b];i++, t++) {
+		const cryptonote::transaction& tx = batch.Txs[t];
+		STx p;
+		p.Height = batch.From+b;
+		p.UnlockTime = tx.unlock_time;
+		p.Tx = &tx;
+
+		// same as wallet2: there can be a second key due to an old bug
+		for(size_t k=0;k<2;k++) {
+			crypto::public_key key = cryptonote::get_tx_pub_key_from_extra(tx, k);
+			if(key==cryptonote::null_pkey) break;
+			p.TxPubKeys.push_back(key);
+		}
+		if( p.TxPubKeys.empty() ) continue;
+
+		bool any = false;
+		for(auto& out : tx.vout) {
+			if( out.target.type()==typeid(cryptonote::txout_to_key) ) {
+				p.OutKeys.push_back( boost::get<cryptonote::txout_to_key>(out.target).key );
+				any = true;
+			} else {
+				p.OutKeys.push_back(cryptonote::null_pkey);
+			}
+			p.Amounts.push_back(out.amount);
+		}
+		if(any) batch.Parsed.push_back( std::move(p) );
+	}
+	return true;
+}
+
+void WalletScanner::ScanAccounts(const SBatch& batch, const boost::shared_ptr<SAccount>* accounts, size_t count, vector<SOutput>* found) const {
+	for(size_t a=0;a<count;a++) {
+		const SAccount& acc = *accounts[a];
+		for(const STx& tx : batch.Parsed) {
+			if(tx.Height<acc.ScannedHeight) continue;
+
+			for(auto& txKey : tx.TxPubKeys) {
+				crypto::key_derivation derivation;
+				if( !crypto::generate_key_derivation(txKey, acc.ViewKey, derivation) ) continue;
+
+				bool received = false;
+				for(size_t i=0;i<tx.OutKeys.size();i++) {
+					if(tx.OutKeys[i]==cryptonote::null_pkey) continue;
+					crypto::public_key derived;
+					if( !crypto::derive_public_key(derivation, i, acc.Address.m_spend_public_key, derived) ) continue;
+					if(derived!=tx.OutKeys[i]) continue;
+
+					SOutput out;
+					out.Height = tx.Height;
+					out.UnlockTime = tx.UnlockTime;
+					out.Amount = tx.Amounts[i];
+					if(out.Amount==0 && tx.Tx->version>1) out.Amount = DecodeAmount(*tx.Tx, derivation, i);
+					found[a].push_back(out);
+					received = true;
+				}
+				if(received) break;
+			}
+		}
+	}
+}
+
+uint64_t WalletScanner::DecodeAmount(const cryptonote::transaction& tx, const crypto::key_derivation& derivation, size_t i) {
+	crypto::secret_key scalar;
+	crypto::derivation_to_scalar(derivation, i, scalar);
+	rct::key mask;
+	try {
+		switch(tx.rct_signatures.type) {
+			case rct::RCTTypeSimple: return rct::decodeRctSimple(tx.rct_signatures, rct::sk2rct(scalar), i, mask);
+			case rct::RCTTypeFull: return rct::decodeRct(tx.rct_signatures, rct::sk2rct(scalar), i, mask);
+			default: return 0;
+		}
+	} catch(const std::exception& e) {
+		LOG_ERROR("Failed to decode output " << i << ": " << e.what());
+	}
+	return 0;
+}
+
+uint64_t WalletScanner::ForkHeight() const {
+	map<uint64_t, crypto::hash> hashes;
+	uint64_t scanned;
+	{
+		boost::lock_guard<boost::mutex> lock(m_Guard);
+		hashes = m_Hashes;
+		scanned = m_ScannedHeight;
+	}
+	if( hashes.empty() ) return scanned;
+
+	uint64_t height = m_Source->Height();
+	for(auto it=hashes.rbegin();it!=hashes.rend();++it) {
+		if( it->first<height && m_Source->BlockHash(it->first)==it->second ) return it->first+1;
+	}
+	// deeper than we remember
+	return 0;
+}
+
+void WalletScanner::Rollback(uint64_t height) {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	for(auto& a : m_Accounts) {
+		SAccount& acc = *a.second;
+		while( !acc.Outputs.empty() && acc.Outputs.back().Height>=height ) acc.Outputs.pop_back();
+		acc.ScannedHeight = std::min(acc.ScannedHeight, height);
+	}
+	for(auto& st : m_Stored) {
+		SStoredAccount& acc = st.second;
+		while( !acc.Outputs.empty() && acc.Outputs.back().Height>=height ) acc.Outputs.pop_back();
+		acc.ScannedHeight = std::min(acc.ScannedHeight, height);
+	}
+	m_Hashes.erase( m_Hashes.lower_bound(height), m_Hashes.end() );
+	m_ScannedHeight = std::min(m_ScannedHeight, height);
+	m_Changed = true;
+}
+
+bool WalletScanner::IsUnlocked(const SOutput& out, uint64_t chainHeight) const {
+	// same rules as wallet2::is_transfer_unlocked
+	if(out.Height+CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE>chainHeight) return false;
+
+	if(out.UnlockTime<CRYPTONOTE_MAX_BLOCK_NUMBER) return chainHeight-1+CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS>=out.UnlockTime;
+
+	uint64_t now = static_cast<uint64_t>( time(NULL) );
+	uint64_t v2height = m_Testnet?624634:1009827;
+	uint64_t leeway = out.Height<v2height?CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_SECONDS_V1:CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_SECONDS_V2;
+	return now+leeway>=out.UnlockTime;
+}
+
+uint64_t WalletScanner::UnlockedBalance(const string& addr, uint64_t tillBlock) const {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	auto it = m_Accounts.find(addr);
+	if( it==m_Accounts.end() ) return 0;
+
+	uint64_t amount = 0;
+	for(auto& out : it->second->Outputs) {
+		if(tillBlock>0 && out.Height>tillBlock) break;
+		if( IsUnlocked(out, it->second->ScannedHeight) ) amount += out.Amount;
+	}
+	return amount;
+}
+
+uint64_t WalletScanner::Balance(const string& addr) const {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	auto it = m_Accounts.find(addr);
+	if( it==m_Accounts.end() ) return 0;
+
+	uint64_t amount = 0;
+	for(auto& out : it->second->Outputs) amount += out.Amount;
+	return amount;
+}
+
+vector<WalletScanner::SOutput> WalletScanner::Outputs(const string& addr) const {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	auto it = m_Accounts.find(addr);
+	if( it==m_Accounts.end() ) return vector<SOutput>();
+	return it->second->Outputs;
+}
+
+bool WalletScanner::Load() {
+	if( m_FileName.empty() || !boost::filesystem::exists(m_FileName) ) return false;
+
+	string buf;
+	SScanFile file;
+	if( !epee::file_io_utils::load_file_to_string(m_FileName, buf) || !epee::serialization::load_t_from_binary(file, buf) || file.HashHeights.size()!=file.Hashes.size() ) {
+		LOG_ERROR("wallet scanner: failed to read " << m_FileName << ", wallets will be scanned again");
+		return false;
+	}
+
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	m_Stored.clear();
+	for(auto& e : file.Accounts) {
+		SStoredAccount& acc = m_Stored[e.Addr];
+		acc.ViewKey = e.ViewKey;
+		acc.ScannedHeight = e.ScannedHeight;
+		acc.Outputs = e.Outputs;
+	}
+	m_Hashes.clear();
+	for(size_t i=0;i<file.Hashes.size();i++) m_Hashes[ file.HashHeights[i] ] = file.Hashes[i];
+	m_ScannedHeight = m_Hashes.empty() ? 0 : m_Hashes.rbegin()->first+1;
+	m_Changed = false;
+	LOG_PRINT_L1("wallet scanner: loaded " << m_Stored.size() << " wallets, scanned up to block " << m_ScannedHeight);
+	return true;
+}
+
+bool WalletScanner::Store() {
+	if( m_FileName.empty() ) return false;
+
+	SScanFile file;
+	{
+		boost::lock_guard<boost::mutex> lock(m_Guard);
+		if(!m_Changed) return true;
+
+		for(auto& a : m_Accounts) {
+			SScanFile::SAccountEntry e;
+			e.Addr = a.first;
+			e.ViewKey = epee::string_tools::pod_to_hex(a.second->ViewKey);
+			e.ScannedHeight = a.second->ScannedHeight;
+			e.Outputs = a.second->Outputs;
+			file.Accounts.push_back(e);
+		}
+		// not added since restart, kept until they are
+		for(auto& st : m_Stored) {
+			SScanFile::SAccountEntry e;
+			e.Addr = st.first;
+			e.ViewKey = st.second.ViewKey;
+			e.ScannedHeight = st.second.ScannedHeight;
+			e.Outputs = st.second.Outputs;
+			file.Accounts.push_back(e);
+		}
+		for(auto& h : m_Hashes) {
+			file.HashHeights.push_back(h.first);
+			file.Hashes.push_back(h.second);
+		}
+		m_Changed = false;
+	}
+
+	// written aside and renamed, so a crash leaves the previous file
+	string buf;
+	string tmp = m_FileName+".tmp";
+	boost::system::error_code ec;
+	if( !epee::serialization::store_t_to_binary(file, buf) || !epee::file_io_utils::save_string_to_file(tmp, buf) ) {
+		LOG_ERROR("wallet scanner: failed to write " << tmp);
+	} else {
+		boost::filesystem::rename(tmp, m_FileName, ec);
+		if(!ec) return true;
+		LOG_ERROR("wallet scanner: failed to replace " << m_FileName << ": " << ec.message());
+	}
+
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	m_Changed = true;
+	return false;
+}
+
+}
@@ -0,0 +1,210 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef WALLET_SCANNER_H_
+#define WALLET_SCANNER_H_
+
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "blockchain_db/blockchain_db.h"
+#include "serialization/keyvalue_serialization.h"
+#include "WorkerPool.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <chrono>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+namespace supernode {
+
+	// one scanner for all view-only wallets of the supernode: every block is read and
+	// parsed once, then outputs are checked against all registered view keys in a batch.
+	// only incoming outputs are tracked, as view-only wallet can't see spends.
+	// scanning runs on own thread, scan progress is kept in a file, so restart doesn't rescan the chain
+	class WalletScanner {
+		public:
+		// where blocks come from
+		class BlockSource {
+			public:
+			virtual ~BlockSource() {}
+			virtual uint64_t Height() const=0;
+			virtual crypto::hash BlockHash(uint64_t height) const=0;
+			// block with all it's transactions, miner tx is not included in txs
+			virtual bool Block(uint64_t height, cryptonote::block& blk, vector<cryptonote::transaction>& txs) const=0;
+		};
+
+		// blocks from local blockchain db
+		class DBBlockSource : public BlockSource {
+			public:
+			DBBlockSource(cryptonote::BlockchainDB* db) : m_DB(db) {}
+			uint64_t Height() const override;
+			crypto::hash BlockHash(uint64_t height) const override;
+			bool Block(uint64_t height, cryptonote::block& blk, vector<cryptonote::transaction>& txs) const override;
+
+			protected:
+			cryptonote::BlockchainDB* m_DB;
+		};
+
+		struct SOutput {
+			uint64_t Height;
+			uint64_t UnlockTime;
+			uint64_t Amount;
+		};
+
+		public:
+		// fileName - scan progress file, empty - progress is not stored
+		WalletScanner(boost::shared_ptr<BlockSource> source, bool testnet, const string& fileName);
+		~WalletScanner();
+
+		void Start();
+		void Stop();
+
+		// false if account already registered or keys can't be parsed. new account is scanned by own thread
+		// from the first block, or from where the file left it
+		bool AddAccount(const string& addr, const string& viewKey);
+		bool RemoveAccount(const string& addr);
+		bool HasAccount(const string& addr) const;
+		size_t AccountsCount() const;
+
+		// scan all accounts up to the top of chain. returns number of scanned blocks
+		uint64_t Refresh();
+		uint64_t ScannedHeight() const;
+		// wakes own thread and waits until account is scanned up to current top of chain.
+		// false on timeout or unknown account, scan goes on anyway
+		bool WaitScanned(const string& addr, std::chrono::milliseconds timeout);
+
+		// state of accounts from the file is applied when they are added
+		bool Load();
+		bool Store();
+
+		// as wallet2::unlocked_balance(till_block)
+		uint64_t UnlockedBalance(const string& addr, uint64_t tillBlock) const;
+		uint64_t Balance(const string& addr) const;
+		vector<SOutput> Outputs(const string& addr) const;
+
+		public:
+		std::chrono::milliseconds RefreshInterval = std::chrono::seconds(5);
+		unsigned BatchBlocks = 100;// blocks parsed at once
+		unsigned AccountsPerTask = 32;// accounts checked by one worker task
+		unsigned ReorgDepth = 100;// block hashes kept to detect reorg
+
+		protected:
+		struct SAccount {
+			string Addr;
+			cryptonote::account_public_address Address;
+			crypto::secret_key ViewKey;
+			uint64_t ScannedHeight = 0;// first not scanned block
+			vector<SOutput> Outputs;// sorted by height
+		};
+
+		// account from progress file, not added (yet)
+		struct SStoredAccount {
+			string ViewKey;
+			uint64_t ScannedHeight = 0;
+			vector<SOutput> Outputs;
+		};
+
+		struct SScanFile {
+			struct SAccountEntry {
+				string Addr;
+				string ViewKey;
+				uint64_t ScannedHeight;
+				vector<SOutput> Outputs;
+
+				BEGIN_KV_SERIALIZE_MAP()
+					KV_SERIALIZE(Addr)
+					KV_SERIALIZE(ViewKey)
+					KV_SERIALIZE(ScannedHeight)
+					KV_SERIALIZE_CONTAINER_POD_AS_BLOB(Outputs)
+				END_KV_SERIALIZE_MAP()
+			};
+
+			vector<SAccountEntry> Accounts;
+			vector<uint64_t> HashHeights;
+			vector<crypto::hash> Hashes;
+
+			BEGIN_KV_SERIALIZE_MAP()
+				KV_SERIALIZE(Accounts)
+				KV_SERIALIZE_CONTAINER_POD_AS_BLOB(HashHeights)
+				KV_SERIALIZE_CONTAINER_POD_AS_BLOB(Hashes)
+			END_KV_SERIALIZE_MAP()
+		};
+
+		struct STx {
+			uint64_t Height;
+			uint64_t UnlockTime;
+			vector<crypto::public_key> TxPubKeys;
+			vector<crypto::public_key> OutKeys;// null_pkey for non txout_to_key
+			vector<uint64_t> Amounts;
+			const cryptonote::transaction* Tx;
+		};
+
+		struct SBatch {
+			uint64_t From;
+			uint64_t To;
+			vector<cryptonote::transaction> Txs;// miner tx follows block txs
+			vector<crypto::hash> Hashes;
+			vector<STx> Parsed;
+		};
+
+		void Run();
+		bool ReadBatch(SBatch& batch);
+		void ScanAccounts(const SBatch& batch, const boost::shared_ptr<SAccount>* accounts, size_t count, vector<SOutput>* found) const;
+		static uint64_t DecodeAmount(const cryptonote::transaction& tx, const crypto::key_derivation& derivation, size_t i);
+		bool IsUnlocked(const SOutput& out, uint64_t chainHeight) const;
+		uint64_t ForkHeight() const;
+		void Rollback(uint64_t height);
+
+		protected:
+		boost::shared_ptr<BlockSource> m_Source;
+		bool m_Testnet;
+		string m_FileName;
+
+		mutable boost::mutex m_Guard;
+		unordered_map< string, boost::shared_ptr<SAccount> > m_Accounts;
+		uint64_t m_ScannedHeight = 0;
+		map<uint64_t, crypto::hash> m_Hashes;// last scanned blocks
+		map<string, SStoredAccount> m_Stored;// by address
+		bool m_Changed = false;// not stored yet
+		bool m_RefreshNow = false;// new account or waiter, don't wait for RefreshInterval
+		boost::condition_variable m_Scanned;// batch of blocks scanned
+
+		boost::mutex m_ScanGuard;// one scan at a time
+		WorkerPool m_Workers;
+
+		bool m_Running = false;
+		boost::thread* m_Thread = nullptr;
+	};
+
+}
+
+#endif /* WALLET_SCANNER_H_ */
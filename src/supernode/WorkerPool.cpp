@@ -6,6 +6,11 @@
  */
 
 #include <supernode/WorkerPool.h>
+#include "common/util.h"
+#include "misc_log_ex.h"
+
+static const unsigned s_MinSharedWorkers = 4;// tasks mostly wait for network, so don't go below it on small boxes
+static unsigned s_SharedWorkers = 0;
 
 namespace supernode {
 
@@ -24,4 +29,49 @@ void WorkerPool::Stop() {
 	Threadpool.join_all();
 }
 
+void WorkerPool::SetSharedWorkers(unsigned cnt) { s_SharedWorkers = cnt; }
+
+unsigned WorkerPool::SharedWorkers() {
+	if(s_SharedWorkers) return s_SharedWorkers;
+	return std::max(s_MinSharedWorkers, 2*tools::get_max_concurrency());
+}
+
+WorkerPool& WorkerPool::Shared() {
+	// never deleted, so tasks still queued at exit never touch destroyed pool
+	static WorkerPool* pool = [](){
+		WorkerPool* p = new WorkerPool();
+		p->Workers( SharedWorkers() );
+		return p;
+	}();
+	return *pool;
+}
+
+
+WorkerTasks::WorkerTasks(WorkerPool& pool) : m_Pool(pool) {
+}
+
+WorkerTasks::~WorkerTasks() {
+	Wait();
+}
+
+void WorkerTasks::Wait() {
+	boost::unique_lock<boost::mutex> lock(m_Guard);
+	while(m_Pending) m_AllDone.wait(lock);
+}
+
+unsigned WorkerTasks::Pending() const {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	return m_Pending;
+}
+
+void WorkerTasks::Done() {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	m_Pending--;
+	if(!m_Pending) m_AllDone.notify_all();
+}
+
+void WorkerTasks::OnTaskFailed() {
+	LOG_ERROR("worker task failed with exception");
+}
+
 } /* namespace supernode */
@@ -33,6 +33,8 @@
 #include <boost/asio/io_service.hpp>
 #include <boost/bind.hpp>
 #include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 
 
 namespace supernode {
@@ -43,6 +45,13 @@ public:
 	void Workers(int cnt);
 	void Stop();
 
+	// process-wide pool, shared by all RTA objects, broadcasts and FSN list
+	// created on first use with SharedWorkers() threads
+	static WorkerPool& Shared();
+	// 0 - auto (depends on core count). must be called before first Shared()
+	static void SetSharedWorkers(unsigned cnt);
+	static unsigned SharedWorkers();
+
 public:
     boost::asio::io_service Service;
     boost::thread_group Threadpool;
@@ -50,6 +59,49 @@ public:
 
 };
 
+// handle for tasks posted by one owner into a (shared) pool.
+// owner must Wait() (or destroy this object) before it's own data destroyed,
+// because posted tasks can still use it
+class WorkerTasks {
+public:
+	WorkerTasks(WorkerPool& pool=WorkerPool::Shared());
+	~WorkerTasks();
+
+	template<class F>
+	void Post(F task) {
+		{
+			boost::lock_guard<boost::mutex> lock(m_Guard);
+			m_Pending++;
+		}
+		m_Pool.Service.post( [this, task]() {
+			Run(task);
+		} );
+	}
+
+	void Wait();
+	unsigned Pending() const;
+
+protected:
+	template<class F>
+	void Run(F& task) {
+		try {
+			task();
+		} catch(...) {
+			OnTaskFailed();
+		}
+		Done();
+	}
+
+	void Done();
+	void OnTaskFailed();
+
+protected:
+	WorkerPool& m_Pool;
+	mutable boost::mutex m_Guard;
+	boost::condition_variable m_AllDone;
+	unsigned m_Pending = 0;
+};
+
 }
 
 #endif
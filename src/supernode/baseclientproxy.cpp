@@ -37,9 +37,23 @@
 static const std::string scWalletCachePath("/cache/");
 
 supernode::BaseClientProxy::BaseClientProxy()
+    : m_Wallets(boost::bind(&BaseClientProxy::initWallet, this, _1, _2),
+                boost::bind(&BaseClientProxy::storeWalletState, this, _1))
 {
 }
 
+void supernode::BaseClientProxy::Start()
+{
+    BaseRTAProcessor::Start();
+    m_Wallets.Start();
+}
+
+void supernode::BaseClientProxy::Stop()
+{
+    m_Wallets.Stop();
+    BaseRTAProcessor::Stop();
+}
+
 void supernode::BaseClientProxy::Init()
 {
     m_DAPIServer->ADD_DAPI_HANDLER(GetWalletBalance, rpc_command::GET_WALLET_BALANCE, BaseClientProxy);
@@ -53,7 +67,7 @@ void supernode::BaseClientProxy::Init()
 bool supernode::BaseClientProxy::GetWalletBalance(const supernode::rpc_command::GET_WALLET_BALANCE::request &in, supernode::rpc_command::GET_WALLET_BALANCE::response &out)
 {
 	LOG_PRINT_L0("BaseClientProxy::GetWalletBalance" << in.Account);
-    std::unique_ptr<tools::GraftWallet2> wal = initWallet(base64_decode(in.Account), in.Password);
+    ClientWalletCache::Handle wal = m_Wallets.Open(base64_decode(in.Account), in.Password);
     if (!wal)
     {
         out.Result = ERROR_OPEN_WALLET_FAILED;
@@ -61,10 +75,10 @@ bool supernode::BaseClientProxy::GetWalletBalance(const supernode::rpc_command::
     }
     try
     {
-        wal->refresh();
+        // stored in background
+        m_Wallets.Refresh(wal);
         out.Balance = wal->balance();
         out.UnlockedBalance = wal->unlocked_balance();
-        storeWalletState(wal.get());
     }
     catch (const std::exception& e)
     {
@@ -121,7 +135,7 @@ bool supernode::BaseClientProxy::CreateAccount(const supernode::rpc_command::CRE
 bool supernode::BaseClientProxy::GetSeed(const supernode::rpc_command::GET_SEED::request &in, supernode::rpc_command::GET_SEED::response &out)
 {
 	LOG_PRINT_L0("BaseClientProxy::GetSeed" << in.Account);
-    std::unique_ptr<tools::GraftWallet2> wal = initWallet(base64_decode(in.Account), in.Password);
+    ClientWalletCache::Handle wal = m_Wallets.Open(base64_decode(in.Account), in.Password);
     if (!wal)
     {
         out.Result = ERROR_OPEN_WALLET_FAILED;
@@ -181,7 +195,7 @@ bool supernode::BaseClientProxy::RestoreAccount(const supernode::rpc_command::RE
 
 bool supernode::BaseClientProxy::GetTransferFee(const supernode::rpc_command::GET_TRANSFER_FEE::request &in, supernode::rpc_command::GET_TRANSFER_FEE::response &out)
 {
-    std::unique_ptr<tools::GraftWallet2> wal = initWallet(base64_decode(in.Account), in.Password);
+    ClientWalletCache::Handle wal = m_Wallets.Open(base64_decode(in.Account), in.Password);
     if (!wal)
     {
         out.Result = ERROR_OPEN_WALLET_FAILED;
@@ -260,7 +274,7 @@ bool supernode::BaseClientProxy::GetTransferFee(const supernode::rpc_command::GE
 
 bool supernode::BaseClientProxy::Transfer(const supernode::rpc_command::TRANSFER::request &in, supernode::rpc_command::TRANSFER::response &out)
 {
-    std::unique_ptr<tools::GraftWallet2> wal = initWallet(base64_decode(in.Account), in.Password);
+    ClientWalletCache::Handle wal = m_Wallets.Open(base64_decode(in.Account), in.Password);
     if (!wal)
     {
         out.Result = ERROR_OPEN_WALLET_FAILED;
@@ -303,7 +317,7 @@ bool supernode::BaseClientProxy::Transfer(const supernode::rpc_command::TRANSFER
         if (!do_not_relay && ptx_vector.size() > 0)
         {
             wal->commit_tx(ptx_vector);
-            storeWalletState(wal.get());
+            m_Wallets.Store(wal);
         }
     }
     catch (const tools::error::daemon_busy& e)
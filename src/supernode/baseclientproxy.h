@@ -31,6 +31,7 @@
 
 #include "BaseRTAProcessor.h"
 #include "graft_wallet2.h"
+#include "ClientWalletCache.h"
 
 namespace supernode {
 class BaseClientProxy : public BaseRTAProcessor
@@ -38,6 +39,9 @@ class BaseClientProxy : public BaseRTAProcessor
 public:
     BaseClientProxy();
 
+    void Start() override;
+    void Stop() override;
+
     std::unique_ptr<tools::GraftWallet2> initWallet(const std::string &account, const std::string &password) const;
     void storeWalletState(tools::GraftWallet2 *wallet);
 
@@ -56,6 +60,9 @@ protected:
     bool GetTransferFee(const rpc_command::GET_TRANSFER_FEE::request &in, rpc_command::GET_TRANSFER_FEE::response &out);
     bool Transfer(const rpc_command::TRANSFER::request &in, rpc_command::TRANSFER::response &out);
 
+protected:
+    ClientWalletCache m_Wallets;
+
 private:
     bool validate_transfer(tools::GraftWallet2 *wallet,
                            const std::string &address, uint64_t amount,
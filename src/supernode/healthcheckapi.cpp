@@ -1,10 +1,12 @@
 #include "healthcheckapi.h"
+#include "RTATracer.h"
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "storages/http_abstract_invoke.h"
 #include "net/jsonrpc_structs.h"
 #include "net/net_utils_base.h"
 
 static const std::string HEALTH_URI("/health");
+static const std::string RTA_LATENCY_URI("/health/rta");
 
 struct HealthResponse {
     string NodeAccess;
@@ -34,6 +36,16 @@ bool supernode::HealthcheckAPI::processHealthchecks(const string uri, epee::net_
         response_info.m_response_code = 200;
         return true;
     }
+    if (uri == RTA_LATENCY_URI)
+    {
+        rpc_command::RTA_LATENCY_REPORT response = RTATracer::Shared().Report();
+        epee::serialization::store_t_to_json(response, response_info.m_body);
+        response_info.m_header_info.m_content_type = " application/json";
+        response_info.m_mime_tipe = "application/json";
+        response_info.m_response_comment = "OK";
+        response_info.m_response_code = 200;
+        return true;
+    }
     return false;
 }
 
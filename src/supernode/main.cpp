@@ -36,6 +36,7 @@
 #include "AuthSample.h"
 #include "P2P_Broadcast.h"
 #include "FSN_ActualList.h"
+#include "WorkerPool.h"
 
 #include "supernode_helpers.h"
 #include <boost/bind.hpp>
@@ -93,6 +94,7 @@ int main(int argc, const char** argv) {
 	supernode::rpc_command::SetDAPIVersion( dapi_conf.get<string>("version") );
 	supernode::DAPI_RPC_Server dapi_server;
 	dapi_server.Set( dapi_conf.get<string>("ip"), dapi_conf.get<string>("port"), dapi_conf.get<int>("threads") );
+	supernode::WorkerPool::SetSharedWorkers( dapi_conf.get<unsigned>("worker_threads", 0) );
 
 	supernode::rpc_command::SetWalletProxyOnly( dapi_conf.get<int>("wallet_proxy_only", 0)==1 );
 
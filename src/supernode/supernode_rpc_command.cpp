@@ -33,6 +33,8 @@
 const string supernode::rpc_command::DAPI_URI = "/dapi";
 const string supernode::rpc_command::DAPI_METHOD = "POST";
 const string supernode::rpc_command::DAPI_PROTOCOL = "http";
+const string supernode::rpc_command::DAPI_BIN_URI = "/dapi.bin";
+const string supernode::rpc_command::DAPI_BIN_CONTENT_TYPE = "application/octet-stream";
 const string supernode::rpc_command::DAPI_VERSION = "http";
 
 void supernode::rpc_command::SetDAPIVersion(const string& v) {
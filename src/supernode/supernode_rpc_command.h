@@ -83,6 +83,8 @@ namespace supernode {
 		extern const string DAPI_URI;//  /dapi
         extern const string DAPI_METHOD;//  POST
 		extern const string DAPI_PROTOCOL;//  http for now
+		extern const string DAPI_BIN_URI;//  /dapi.bin - same calls in binary portable storage, between supernodes
+		extern const string DAPI_BIN_CONTENT_TYPE;
 		extern const string DAPI_VERSION;
 
 		bool IsWalletProxyOnly();
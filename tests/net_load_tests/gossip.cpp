@@ -0,0 +1,267 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Compares RTA broadcast flooding against inventory-first gossip on a simulated
+// network. Nothing is sent over sockets: message sizes are the sizes of the real
+// serialized levin notifications, so the figures match what net_node puts on the wire.
+//
+// usage: net_load_tests_gossip [nodes] [degree] [message_size] [messages] [hop]
+
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "net/levin_base.h"
+#include "storages/portable_storage_template_helper.h"
+#include "p2p/p2p_protocol_defs.h"
+
+using namespace nodetool;
+
+namespace
+{
+  typedef std::vector<std::vector<size_t>> graph_t;
+
+  enum event_type { ev_body, ev_inventory, ev_get };
+
+  struct event
+  {
+    event_type type;
+    size_t from;
+    size_t to;
+    uint64_t hop;
+  };
+
+  struct sizes
+  {
+    size_t body;
+    size_t inventory;
+    size_t get;
+  };
+
+  struct result
+  {
+    uint64_t bytes = 0;
+    uint64_t delivered = 0;
+    uint64_t duplicates = 0;
+  };
+
+  template<class T>
+  size_t wire_size(const T &arg)
+  {
+    std::string blob;
+    epee::serialization::store_t_to_binary(arg, blob);
+    return blob.size() + sizeof(epee::levin::bucket_head2);
+  }
+
+  sizes message_sizes(size_t data_size)
+  {
+    std::string message_id(64, 'f');
+
+    COMMAND_BROADCAST::request body = AUTO_VAL_INIT(body);
+    body.sender_address = std::string(64, 'a');
+    body.callback_uri = "/cryptonode/authorize_rta_tx_request";
+    body.data = std::string(data_size, 'd');
+    body.message_id = message_id;
+
+    COMMAND_RTA_INVENTORY::request inv;
+    rta_inventory_item item = AUTO_VAL_INIT(item);
+    item.command = COMMAND_BROADCAST::ID;
+    item.message_id = message_id;
+    inv.items.push_back(item);
+
+    COMMAND_RTA_GET_BODIES::request get;
+    get.message_ids.push_back(message_id);
+
+    return sizes{wire_size(body), wire_size(inv), wire_size(get)};
+  }
+
+  graph_t make_graph(size_t nodes, size_t degree, std::mt19937 &rng)
+  {
+    graph_t graph(nodes);
+    std::set<std::pair<size_t, size_t>> edges;
+    auto connect = [&](size_t a, size_t b) {
+      if (a == b || !edges.insert(std::make_pair(std::min(a, b), std::max(a, b))).second)
+        return;
+      graph[a].push_back(b);
+      graph[b].push_back(a);
+    };
+    // a ring keeps the graph connected, the rest of the edges are random
+    for (size_t i = 0; i < nodes; ++i)
+      connect(i, (i + 1) % nodes);
+    std::uniform_int_distribution<size_t> pick(0, nodes - 1);
+    for (size_t i = 0; i < nodes * (degree - 2) / 2; ++i)
+      connect(pick(rng), pick(rng));
+    return graph;
+  }
+
+  // mirrors handle_broadcast: every node relays a new body to all connections but the source
+  void flood(const graph_t &graph, size_t origin, uint64_t hop, const sizes &sz, result &res)
+  {
+    std::vector<bool> seen(graph.size(), false);
+    std::deque<event> queue;
+    seen[origin] = true;
+    for (size_t peer : graph[origin])
+      queue.push_back(event{ev_body, origin, peer, hop});
+    while (!queue.empty())
+    {
+      event ev = queue.front();
+      queue.pop_front();
+      res.bytes += sz.body;
+      if (seen[ev.to])
+      {
+        ++res.duplicates;
+        continue;
+      }
+      seen[ev.to] = true;
+      ++res.delivered;
+      if (ev.hop == 0)
+        continue;
+      for (size_t peer : graph[ev.to])
+        if (peer != ev.from)
+          queue.push_back(event{ev_body, ev.to, peer, ev.hop - 1});
+    }
+  }
+
+  // mirrors gossip_rta_message/handle_rta_inventory/handle_rta_get_bodies
+  void gossip(const graph_t &graph, size_t origin, uint64_t hop, size_t fanout, const sizes &sz, std::mt19937 &rng, result &res)
+  {
+    std::vector<bool> seen(graph.size(), false);
+    std::vector<bool> pulling(graph.size(), false);
+    std::vector<uint64_t> hops(graph.size(), 0);
+    std::deque<event> queue;
+
+    auto offer = [&](size_t node, size_t source) {
+      std::vector<size_t> peers;
+      for (size_t peer : graph[node])
+        if (peer != source)
+          peers.push_back(peer);
+      std::shuffle(peers.begin(), peers.end(), rng);
+      if (peers.size() > fanout)
+        peers.resize(fanout);
+      for (size_t peer : peers)
+        queue.push_back(event{ev_inventory, node, peer, hops[node]});
+    };
+
+    seen[origin] = true;
+    hops[origin] = hop;
+    offer(origin, origin);
+    while (!queue.empty())
+    {
+      event ev = queue.front();
+      queue.pop_front();
+      switch (ev.type)
+      {
+      case ev_inventory:
+        res.bytes += sz.inventory;
+        if (seen[ev.to] || pulling[ev.to])
+          break;
+        pulling[ev.to] = true;
+        queue.push_back(event{ev_get, ev.to, ev.from, ev.hop});
+        break;
+      case ev_get:
+        res.bytes += sz.get;
+        queue.push_back(event{ev_body, ev.to, ev.from, ev.hop});
+        break;
+      case ev_body:
+        res.bytes += sz.body;
+        if (seen[ev.to])
+        {
+          ++res.duplicates;
+          break;
+        }
+        seen[ev.to] = true;
+        ++res.delivered;
+        if (ev.hop == 0)
+          break;
+        hops[ev.to] = ev.hop - 1;
+        offer(ev.to, ev.from);
+        break;
+      }
+    }
+  }
+
+  void report(const std::string &name, const result &res, size_t nodes, size_t messages)
+  {
+    double coverage = 100.0 * res.delivered / (double(nodes - 1) * messages);
+    double per_delivered = res.delivered ? double(res.bytes) / res.delivered : 0;
+    std::cout << std::left << std::setw(12) << name << std::right
+              << std::setw(16) << res.bytes
+              << std::setw(14) << std::fixed << std::setprecision(1) << per_delivered
+              << std::setw(12) << coverage << "%"
+              << std::setw(12) << res.duplicates << std::endl;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  size_t nodes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+  size_t degree = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 12;
+  size_t data_size = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 2048;
+  size_t messages = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 100;
+  uint64_t hop = argc > 5 ? std::strtoull(argv[5], nullptr, 10) : 6;
+  if (nodes < 3 || degree < 2)
+  {
+    std::cerr << "at least 3 nodes and degree 2 are required" << std::endl;
+    return 1;
+  }
+
+  std::mt19937 rng(12345);
+  graph_t graph = make_graph(nodes, degree, rng);
+  sizes sz = message_sizes(data_size);
+
+  std::cout << "nodes " << nodes << ", degree " << degree << ", hop " << hop << ", messages " << messages << std::endl;
+  std::cout << "body " << sz.body << " bytes, inventory " << sz.inventory << " bytes, get " << sz.get << " bytes" << std::endl;
+  std::cout << std::left << std::setw(12) << "mode" << std::right
+            << std::setw(16) << "bytes" << std::setw(14) << "bytes/deliv"
+            << std::setw(13) << "coverage" << std::setw(12) << "dup bodies" << std::endl;
+
+  std::uniform_int_distribution<size_t> pick(0, nodes - 1);
+  std::vector<size_t> origins(messages);
+  for (size_t &origin : origins)
+    origin = pick(rng);
+
+  result flooding;
+  for (size_t origin : origins)
+    flood(graph, origin, hop, sz, flooding);
+  report("flooding", flooding, nodes, messages);
+
+  for (size_t fanout : {2, 3, 4, 6, 8})
+  {
+    result res;
+    for (size_t origin : origins)
+      gossip(graph, origin, hop, fanout, sz, rng, res);
+    report("gossip/" + std::to_string(fanout), res, nodes, messages);
+  }
+  return 0;
+}
@@ -0,0 +1,85 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <string>
+
+#include "cryptonote_core/blockchain_based_list.h"
+#include "cryptonote_core/stake_transaction_storage.h"
+#include "graft_rta_config.h"
+
+// blockchain based list of a_supernodes_count supernodes with full history: get tiers at every depth
+template<size_t a_supernodes_count>
+class test_blockchain_based_list
+{
+public:
+  static const size_t loop_count = 100;
+  static const size_t supernodes_count = a_supernodes_count;
+  static const size_t blocks_count = 1000;
+
+  test_blockchain_based_list()
+    : m_storage(0)
+    , m_list(0)
+  {
+  }
+
+  bool init()
+  {
+    for (size_t i = 0; i < supernodes_count; ++i)
+    {
+      cryptonote::stake_transaction tx = AUTO_VAL_INIT(tx);
+      tx.block_height = 1;
+      tx.unlock_time = blocks_count * 10;
+      tx.amount = config::graft::TIER1_STAKE_AMOUNT + (config::graft::TIER4_STAKE_AMOUNT - config::graft::TIER1_STAKE_AMOUNT) / supernodes_count * i;
+      tx.supernode_public_id = "supernode-" + std::to_string(i);
+      m_storage.add_tx(tx);
+    }
+
+    for (uint64_t height = 1; height <= blocks_count; ++height)
+    {
+      crypto::hash hash = cryptonote::null_hash;
+      memcpy(&hash, &height, sizeof(height));
+      m_list.apply_block(height, hash, m_storage);
+    }
+
+    return m_list.history_depth() == blocks_count;
+  }
+
+  bool test()
+  {
+    size_t count = 0;
+    for (size_t depth = 0; depth < m_list.history_depth(); ++depth)
+      count += m_list.tiers(depth).size();
+    return count == blocks_count * config::graft::TIERS_COUNT;
+  }
+
+private:
+  cryptonote::StakeTransactionStorage m_storage;
+  cryptonote::BlockchainBasedList m_list;
+};
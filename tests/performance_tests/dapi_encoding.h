@@ -0,0 +1,97 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <iostream>
+#include <string>
+
+#include "dapi_request_parse.h"
+
+// one DAPI call in json or binary storage: client encodes request, server
+// parses and answers, client decodes response. sizes of both bodies are
+// printed on init.
+template<class a_command, bool a_binary>
+class test_dapi_encoding
+{
+public:
+  static const size_t loop_count = 10000;
+
+  typedef typename a_command::request request_t;
+  typedef typename a_command::response response_t;
+
+  bool init()
+  {
+    dapi_payload::fill(m_request);
+    boost::function<bool (const request_t&, response_t&)> handler = [](const request_t& in, response_t& out) {
+      dapi_payload::fill(out, in);
+      return true;
+    };
+    m_server.template AddHandler<request_t, response_t>("Call", handler);
+
+    std::string body, out;
+    response_t resp;
+    if (!encode(body) || !m_server.call(body, out, a_binary) || !decode(out, resp))
+      return false;
+    std::cout << (a_binary ? "binary" : "json") << " request " << body.size() << " bytes, response " << out.size() << " bytes" << std::endl;
+    return true;
+  }
+
+  bool test()
+  {
+    std::string body, out;
+    response_t resp;
+    return encode(body) && m_server.call(body, out, a_binary) && decode(out, resp);
+  }
+
+private:
+  // as DAPI_RPC_Client does
+  bool encode(std::string& body)
+  {
+    supernode::rpc_command::RequestContainer<request_t> req;
+    req.params = m_request;
+    req.method = "Call";
+    if (!a_binary)
+      return epee::serialization::store_t_to_json(req, body);
+    epee::serialization::portable_storage ps;
+    return req.store(ps) && ps.store_to_binary(body);
+  }
+
+  bool decode(const std::string& body, response_t& out)
+  {
+    epee::json_rpc::response<response_t, epee::json_rpc::dummy_error> resp;
+    epee::serialization::portable_storage ps;
+    if (!(a_binary ? ps.load_from_binary(body) : ps.load_from_json(body)) || !resp.load(ps))
+      return false;
+    out = resp.result;
+    return true;
+  }
+
+  typename test_dapi_request_parse<a_command, true>::dapi_server m_server;
+  request_t m_request;
+};
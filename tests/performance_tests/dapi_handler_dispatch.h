@@ -0,0 +1,104 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "supernode/DAPI_RPC_Server.h"
+
+// 10k live payments with few handlers each, lookups from threads_count
+// DAPI threads while one more thread keeps adding and removing handlers
+template<size_t a_threads_count>
+class test_dapi_handler_dispatch
+{
+public:
+  static const size_t loop_count = 10;
+  static const size_t threads_count = a_threads_count;
+  static const size_t payments_count = 10000;
+  static const size_t lookups_per_thread = 100000;
+
+  class dapi_server : public supernode::DAPI_RPC_Server
+  {
+  public:
+    bool find(const std::string& method, const std::string& payment_id) const { return !!FindHandler(method, payment_id); }
+  };
+
+  bool init()
+  {
+    boost::function<bool (const supernode::SubNetData&, supernode::rpc_command::P2P_DUMMY_RESP&)> handler = [](const supernode::SubNetData&, supernode::rpc_command::P2P_DUMMY_RESP&) { return true; };
+
+    for (size_t i = 0; i < m_methods.size(); ++i)
+      m_server.AddHandler<supernode::SubNetData, supernode::rpc_command::P2P_DUMMY_RESP>("Global" + m_methods[i], handler);
+
+    for (size_t i = 0; i < payments_count; ++i)
+    {
+      m_payments.push_back(boost::lexical_cast<std::string>(i) + "-payment");
+      for (const std::string& method : m_methods)
+        m_server.Add_UUID_MethodHandler<supernode::SubNetData, supernode::rpc_command::P2P_DUMMY_RESP>(m_payments.back(), method, handler);
+    }
+    m_handler = handler;
+    return true;
+  }
+
+  bool test()
+  {
+    boost::thread_group threads;
+    volatile bool failed = false;
+    for (size_t t = 0; t < threads_count; ++t)
+    {
+      threads.create_thread([this, t, &failed]() {
+        for (size_t i = 0; i < lookups_per_thread; ++i)
+        {
+          const std::string& payment = m_payments[(i * 7919 + t) % payments_count];
+          if (!m_server.find(m_methods[i % m_methods.size()], payment))
+            failed = true;
+        }
+      });
+    }
+
+    for (size_t i = 0; i < 1000; ++i)
+    {
+      int idx = m_server.Add_UUID_MethodHandler<supernode::SubNetData, supernode::rpc_command::P2P_DUMMY_RESP>("churn", m_methods[0], m_handler);
+      m_server.RemoveHandler(idx);
+    }
+
+    threads.join_all();
+    return !failed;
+  }
+
+private:
+  dapi_server m_server;
+  std::vector<std::string> m_methods = { "GetSaleStatus", "PoSTRSigned", "PosRejectSale", "WalletProxyGetPosData" };
+  std::vector<std::string> m_payments;
+  boost::function<bool (const supernode::SubNetData&, supernode::rpc_command::P2P_DUMMY_RESP&)> m_handler;
+};
@@ -0,0 +1,173 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <string>
+
+#include "storages/portable_storage_template_helper.h"
+#include "supernode/DAPI_RPC_Server.h"
+
+// representative bodies of Sale and Pay calls and their responses
+struct dapi_payload
+{
+  static void fill(supernode::rpc_command::POS_SALE::request& r)
+  {
+    r.POSAddress = "T6T2LeLmi6hf58g7MeTA8i4rdbVY8WngXBK3oWS7pjjq9qPbcze1gvV32x7GaHx8uWHQGNFBy1JCY1qBofv56Vwb26Xr998SE";
+    r.POSViewKey = "0ae7176e5332974de64713c329d406956e8ff2fd60c85e7ee6d8c88318111007";
+    r.POSSaleDetails = "1 x coffee, 2 x croissant";
+    r.Amount = 3500000000000;
+    r.PaymentID = "8f2cd0b1-52b5-4f3f-9a2c-7b0a3c6a5f11";
+  }
+  static void fill(supernode::rpc_command::POS_SALE::response& r, const supernode::rpc_command::POS_SALE::request& in)
+  {
+    r.Result = 0;
+    r.BlockNum = 123456;
+    r.PaymentID = in.PaymentID;
+  }
+
+  // Account is base64 of wallet keys file, that is what makes Pay heavy
+  static void fill(supernode::rpc_command::WALLET_PAY::request& r)
+  {
+    r.Account = std::string(2048, 'A');
+    r.Password = "";
+    r.POSAddress = "T6T2LeLmi6hf58g7MeTA8i4rdbVY8WngXBK3oWS7pjjq9qPbcze1gvV32x7GaHx8uWHQGNFBy1JCY1qBofv56Vwb26Xr998SE";
+    r.BlockNum = 123456;
+    r.Amount = 3500000000000;
+    r.PaymentID = "8f2cd0b1-52b5-4f3f-9a2c-7b0a3c6a5f11";
+  }
+  static void fill(supernode::rpc_command::WALLET_PAY::response& r, const supernode::rpc_command::WALLET_PAY::request&)
+  {
+    r.Result = 0;
+  }
+
+  // supernode to supernode: wallet proxy asks each auth sample member to sign
+  static void fill(supernode::rpc_command::WALLET_PROXY_PAY::request& r)
+  {
+    r.POSAddress = "T6T2LeLmi6hf58g7MeTA8i4rdbVY8WngXBK3oWS7pjjq9qPbcze1gvV32x7GaHx8uWHQGNFBy1JCY1qBofv56Vwb26Xr998SE";
+    r.BlockNum = 123456;
+    r.Amount = 3500000000000;
+    r.PaymentID = "8f2cd0b1-52b5-4f3f-9a2c-7b0a3c6a5f11";
+    for (size_t i = 0; i < 8; ++i)
+      r.NodesWallet.push_back("T6SnKmirXp6geLAoB7fn2eV51Ctr1WH1xWDnEGzS9pvQARTJQUXupiRKGR7czL7b5XdDnYXosVJu6Wj3Y3NYfiEA2sU2QiGVa");
+    r.CustomerWalletAddr = "T6T2LeLmi6hf58g7MeTA8i4rdbVY8WngXBK3oWS7pjjq9qPbcze1gvV32x7GaHx8uWHQGNFBy1JCY1qBofv56Vwb26Xr998SE";
+    r.CustomerWalletSign = "SigV1" + std::string(88, 'x');
+  }
+  static void fill(supernode::rpc_command::WALLET_PROXY_PAY::response& r, const supernode::rpc_command::WALLET_PROXY_PAY::request&)
+  {
+    r.Sign = "SigV1" + std::string(88, 'y');
+    r.FSN_StakeWalletAddr = "T6SnKmirXp6geLAoB7fn2eV51Ctr1WH1xWDnEGzS9pvQARTJQUXupiRKGR7czL7b5XdDnYXosVJu6Wj3Y3NYfiEA2sU2QiGVa";
+  }
+};
+
+// whole server side of one DAPI call without network: parse body, find
+// handler, load typed params, handler, serialize response. single_pass uses
+// DAPI_RPC_Server, otherwise the previous path is reproduced: header from
+// storage, params loaded as SubNetData for PaymentID, then as request of the
+// handler, and response through store_t_to_json.
+template<class a_command, bool a_single_pass>
+class test_dapi_request_parse
+{
+public:
+  static const size_t loop_count = 10000;
+
+  typedef typename a_command::request request_t;
+  typedef typename a_command::response response_t;
+
+  class dapi_server : public supernode::DAPI_RPC_Server
+  {
+  public:
+    bool call(const std::string& body, std::string& out, bool binary = false)
+    {
+      SRequest req;
+      req.Binary = binary;
+      std::string error;
+      if (!ParseRequest(body, req, error))
+        return false;
+      boost::shared_ptr<SCallHandler> handler = FindHandler(req.Method, req.PaymentID);
+      return handler && handler->Process(req, out);
+    }
+  };
+
+  bool init()
+  {
+    supernode::rpc_command::RequestContainer<request_t> req;
+    req.method = "Call";
+    dapi_payload::fill(req.params);
+    epee::serialization::store_t_to_json(req, m_body);
+
+    m_handler = [](const request_t& in, response_t& out) {
+      dapi_payload::fill(out, in);
+      return true;
+    };
+    // Sale and Pay are global handlers, others are per payment
+    m_server.template AddHandler<request_t, response_t>(req.method, m_handler);
+    for (size_t i = 0; i < 100; ++i)
+      m_server.template Add_UUID_MethodHandler<request_t, response_t>(std::to_string(i) + "-payment", req.method, m_handler);
+    return true;
+  }
+
+  bool test()
+  {
+    std::string out;
+    bool r = a_single_pass ? m_server.call(m_body, out) : call_legacy(out);
+    return r && !out.empty();
+  }
+
+private:
+  bool call_legacy(std::string& out)
+  {
+    epee::serialization::portable_storage ps;
+    std::string version, method;
+    epee::serialization::storage_entry id = epee::serialization::storage_entry(std::string());
+    if (!ps.load_from_json(m_body) || !ps.get_value("dapi_version", version, nullptr) || !ps.get_value("method", method, nullptr))
+      return false;
+    if (version != supernode::rpc_command::DAPI_VERSION)
+      return false;
+    ps.get_value("id", id, nullptr);
+
+    epee::json_rpc::request<supernode::SubNetData> sub;
+    if (!sub.load(ps))
+      return false;
+
+    epee::json_rpc::request<request_t> req;
+    if (!req.load(ps))
+      return false;
+    epee::json_rpc::response<response_t, epee::json_rpc::dummy_error> resp;
+    resp.jsonrpc = "2.0";
+    resp.id = req.id;
+    if (!m_handler(req.params, resp.result))
+      return false;
+    epee::serialization::store_t_to_json(resp, out);
+    return true;
+  }
+
+  dapi_server m_server;
+  std::string m_body;
+  boost::function<bool (const request_t&, response_t&)> m_handler;
+};
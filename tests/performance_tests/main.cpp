@@ -48,6 +48,15 @@
 #include "is_out_to_acc.h"
 #include "sc_reduce32.h"
 #include "cn_fast_hash.h"
+#include "rta_object_lifecycle.h"
+#include "dapi_encoding.h"
+#include "dapi_handler_dispatch.h"
+#include "dapi_request_parse.h"
+#include "blockchain_based_list.h"
+#include "rta_processor.h"
+#include "signature_batch.h"
+#include "stake_transaction_storage.h"
+#include "wallet_scanner.h"
 
 int main(int argc, char** argv)
 {
@@ -119,6 +128,55 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE1(test_cn_fast_hash, 32);
   TEST_PERFORMANCE1(test_cn_fast_hash, 16384);
 
+  TEST_PERFORMANCE1(test_rta_object_lifecycle, 1);
+  TEST_PERFORMANCE1(test_rta_object_lifecycle, 100);
+  TEST_PERFORMANCE1(test_rta_object_lifecycle, 1000);
+
+  TEST_PERFORMANCE1(test_dapi_handler_dispatch, 1);
+  TEST_PERFORMANCE1(test_dapi_handler_dispatch, 8);
+  TEST_PERFORMANCE1(test_dapi_handler_dispatch, 32);
+
+  TEST_PERFORMANCE2(test_dapi_request_parse, supernode::rpc_command::POS_SALE, false);
+  TEST_PERFORMANCE2(test_dapi_request_parse, supernode::rpc_command::POS_SALE, true);
+  TEST_PERFORMANCE2(test_dapi_request_parse, supernode::rpc_command::WALLET_PAY, false);
+  TEST_PERFORMANCE2(test_dapi_request_parse, supernode::rpc_command::WALLET_PAY, true);
+
+  TEST_PERFORMANCE2(test_dapi_encoding, supernode::rpc_command::POS_SALE, false);
+  TEST_PERFORMANCE2(test_dapi_encoding, supernode::rpc_command::POS_SALE, true);
+  TEST_PERFORMANCE2(test_dapi_encoding, supernode::rpc_command::WALLET_PAY, false);
+  TEST_PERFORMANCE2(test_dapi_encoding, supernode::rpc_command::WALLET_PAY, true);
+  TEST_PERFORMANCE2(test_dapi_encoding, supernode::rpc_command::WALLET_PROXY_PAY, false);
+  TEST_PERFORMANCE2(test_dapi_encoding, supernode::rpc_command::WALLET_PROXY_PAY, true);
+
+  TEST_PERFORMANCE1(test_rta_processor, 100);
+  TEST_PERFORMANCE1(test_rta_processor, 10000);
+  TEST_PERFORMANCE1(test_rta_processor, 100000);
+
+  TEST_PERFORMANCE2(test_wallet_scanner, 1, true);
+  TEST_PERFORMANCE2(test_wallet_scanner, 10, true);
+  TEST_PERFORMANCE2(test_wallet_scanner, 100, true);
+  TEST_PERFORMANCE2(test_wallet_scanner, 1000, true);
+  TEST_PERFORMANCE2(test_wallet_scanner, 10000, true);
+  TEST_PERFORMANCE2(test_wallet_scanner, 1, false);
+  TEST_PERFORMANCE2(test_wallet_scanner, 10, false);
+  TEST_PERFORMANCE2(test_wallet_scanner, 100, false);
+  TEST_PERFORMANCE2(test_wallet_scanner, 1000, false);
+
+  TEST_PERFORMANCE3(test_signature_batch, 8, 8, false);
+  TEST_PERFORMANCE3(test_signature_batch, 8, 8, true);
+  TEST_PERFORMANCE3(test_signature_batch, 100, 8, false);
+  TEST_PERFORMANCE3(test_signature_batch, 100, 8, true);
+  TEST_PERFORMANCE3(test_signature_batch, 1000, 8, false);
+  TEST_PERFORMANCE3(test_signature_batch, 1000, 8, true);
+
+  TEST_PERFORMANCE2(test_stake_transaction_storage, 10000, false);
+  TEST_PERFORMANCE2(test_stake_transaction_storage, 10000, true);
+  TEST_PERFORMANCE2(test_stake_transaction_storage, 100000, false);
+  TEST_PERFORMANCE2(test_stake_transaction_storage, 100000, true);
+
+  TEST_PERFORMANCE1(test_blockchain_based_list, 100);
+  TEST_PERFORMANCE1(test_blockchain_based_list, 1000);
+
   std::cout << "Tests finished. Elapsed time: " << timer.elapsed_ms() / 1000 << " sec" << std::endl;
 
   return 0;
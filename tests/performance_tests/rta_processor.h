@@ -0,0 +1,83 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "supernode/BaseRTAProcessor.h"
+
+// objects_count pending sales: add all, find each by PaymentID, remove all
+template<size_t a_objects_count>
+class test_rta_processor
+{
+public:
+  static const size_t loop_count = a_objects_count < 10000 ? 100 : 5;
+  static const size_t objects_count = a_objects_count;
+
+  class rta_processor : public supernode::BaseRTAProcessor
+  {
+  public:
+    using supernode::BaseRTAProcessor::Add;
+    using supernode::BaseRTAProcessor::Remove;
+    using supernode::BaseRTAProcessor::ObjectByPayment;
+
+  protected:
+    void Init() override {}
+  };
+
+  bool init()
+  {
+    for (size_t i = 0; i < objects_count; ++i)
+    {
+      m_objects.push_back(boost::shared_ptr<supernode::BaseRTAObject>(new supernode::BaseRTAObject()));
+      m_objects.back()->TransactionRecord.PaymentID = "payment-" + boost::lexical_cast<std::string>(i);
+    }
+    return true;
+  }
+
+  bool test()
+  {
+    for (auto& obj : m_objects)
+      m_processor.Add(obj);
+    for (auto& obj : m_objects)
+      if (m_processor.ObjectByPayment(obj->TransactionRecord.PaymentID) != obj)
+        return false;
+    for (auto& obj : m_objects)
+      m_processor.Remove(obj);
+    return true;
+  }
+
+private:
+  rta_processor m_processor;
+  std::vector< boost::shared_ptr<supernode::BaseRTAObject> > m_objects;
+};
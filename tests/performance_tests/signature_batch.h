@@ -0,0 +1,92 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+#include "crypto/signature_batch.h"
+
+// verifies a_sign_count signatures made by a_keys_count keys,
+// either one by one with check_signature or in one signature_batch
+template<size_t a_sign_count, size_t a_keys_count, bool a_batched>
+class test_signature_batch
+{
+  static_assert(0 < a_keys_count && a_keys_count <= a_sign_count, "keys_count must be in (0, sign_count]");
+
+public:
+  static const size_t loop_count = a_sign_count < 100 ? 100 : 10;
+
+  bool init()
+  {
+    std::vector<crypto::public_key> pubs(a_keys_count);
+    std::vector<crypto::secret_key> secs(a_keys_count);
+    for (size_t i = 0; i < a_keys_count; ++i)
+      crypto::generate_keys(pubs[i], secs[i]);
+
+    for (size_t i = 0; i < a_sign_count; ++i)
+    {
+      item it;
+      size_t k = i % a_keys_count;
+      crypto::cn_fast_hash(&i, sizeof(i), it.hash);
+      it.pub = pubs[k];
+      crypto::generate_signature(it.hash, pubs[k], secs[k], it.sig);
+      m_items.push_back(it);
+    }
+    return true;
+  }
+
+  bool test()
+  {
+    if (a_batched)
+    {
+      crypto::signature_batch batch;
+      for (const item& it : m_items)
+        batch.add(it.hash, it.pub, it.sig);
+      return batch.verify();
+    }
+
+    for (const item& it : m_items)
+    {
+      if (!crypto::check_signature(it.hash, it.pub, it.sig))
+        return false;
+    }
+    return true;
+  }
+
+private:
+  struct item
+  {
+    crypto::hash hash;
+    crypto::public_key pub;
+    crypto::signature sig;
+  };
+  std::vector<item> m_items;
+};
@@ -0,0 +1,91 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <random>
+#include <string>
+
+#include "cryptonote_core/stake_transaction_storage.h"
+#include "graft_rta_config.h"
+
+// a_txs_count stake transactions in the history: add a block and get stakes for it,
+// either incrementally or with stakes rebuilt from all transactions as before
+template<size_t a_txs_count, bool a_incremental>
+class test_stake_transaction_storage
+{
+public:
+  static const size_t loop_count = a_incremental ? 1000 : 100;
+  static const size_t txs_count = a_txs_count;
+  static const size_t txs_per_block = 5;
+  static const size_t supernodes_count = a_txs_count / 20;
+
+  test_stake_transaction_storage()
+    : m_storage(0)
+    , m_rng(0)
+  {
+  }
+
+  bool init()
+  {
+    for (size_t i = 0; i < txs_count / txs_per_block; ++i)
+      add_block();
+    return !m_storage.get_supernode_stakes(m_storage.get_last_processed_block_index()).empty();
+  }
+
+  bool test()
+  {
+    add_block();
+    uint64_t block_number = m_storage.get_last_processed_block_index();
+    if (!a_incremental)
+      m_storage.clear_supernode_stakes();
+    const cryptonote::StakeTransactionStorage::supernode_stake_array& stakes = m_storage.get_supernode_stakes(block_number);
+    return !stakes.empty() && m_storage.find_supernode_stake(block_number, stakes.front().supernode_public_id);
+  }
+
+private:
+  void add_block()
+  {
+    uint64_t block_height = m_storage.get_last_processed_block_index() + 1;
+    for (size_t i = 0; i < txs_per_block; ++i)
+    {
+      cryptonote::stake_transaction tx = AUTO_VAL_INIT(tx);
+      tx.block_height = block_height;
+      tx.unlock_time = config::graft::STAKE_MIN_UNLOCK_TIME + m_rng() % config::graft::STAKE_MAX_UNLOCK_TIME;
+      tx.amount = config::graft::TIER1_STAKE_AMOUNT;
+      tx.supernode_public_id = "supernode-" + std::to_string(m_rng() % supernodes_count);
+      m_storage.add_tx(tx);
+    }
+    crypto::hash hash = cryptonote::null_hash;
+    memcpy(&hash, &block_height, sizeof(block_height));
+    m_storage.add_last_processed_block(block_height, hash);
+  }
+
+  cryptonote::StakeTransactionStorage m_storage;
+  std::mt19937 m_rng;
+};
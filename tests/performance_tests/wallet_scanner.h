@@ -0,0 +1,187 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "string_tools.h"
+#include "supernode/WalletScanner.h"
+
+// blocks as they come from daemon: blobs, parsed on every read
+class test_wallet_scanner_source : public supernode::WalletScanner::BlockSource
+{
+public:
+  uint64_t Height() const override { return m_blocks.size(); }
+  crypto::hash BlockHash(uint64_t height) const override { return m_hashes[height]; }
+
+  bool Block(uint64_t height, cryptonote::block& blk, std::vector<cryptonote::transaction>& txs) const override
+  {
+    if (!cryptonote::parse_and_validate_block_from_blob(m_blocks[height], blk))
+      return false;
+    for (const auto& blob : m_txs[height])
+    {
+      txs.push_back(cryptonote::transaction());
+      if (!cryptonote::parse_and_validate_tx_from_blob(blob, txs.back()))
+        return false;
+    }
+    return true;
+  }
+
+  void add_block(const std::vector<cryptonote::account_base>& accounts, size_t txs_count)
+  {
+    cryptonote::block blk;
+    blk.major_version = 1;
+    blk.miner_tx = make_tx(accounts, true);
+    m_txs.push_back(std::vector<cryptonote::blobdata>());
+    for (size_t i = 0; i < txs_count; ++i)
+    {
+      cryptonote::transaction tx = make_tx(accounts, false);
+      blk.tx_hashes.push_back(cryptonote::get_transaction_hash(tx));
+      m_txs.back().push_back(cryptonote::tx_to_blob(tx));
+    }
+    m_blocks.push_back(cryptonote::block_to_blob(blk));
+    m_hashes.push_back(cryptonote::get_block_hash(blk));
+  }
+
+private:
+  cryptonote::transaction make_tx(const std::vector<cryptonote::account_base>& accounts, bool miner)
+  {
+    cryptonote::transaction tx;
+    tx.version = 1;
+    tx.unlock_time = 0;
+    if (miner)
+    {
+      cryptonote::txin_gen in;
+      in.height = m_blocks.size();
+      tx.vin.push_back(in);
+    }
+
+    cryptonote::keypair tx_key = cryptonote::keypair::generate();
+    cryptonote::add_tx_pub_key_to_extra(tx, tx_key.pub);
+    for (size_t i = 0; i < 2; ++i)
+    {
+      const cryptonote::account_public_address& dst = accounts[rand() % accounts.size()].get_keys().m_account_address;
+      crypto::key_derivation derivation;
+      crypto::public_key out_key;
+      crypto::generate_key_derivation(dst.m_view_public_key, tx_key.sec, derivation);
+      crypto::derive_public_key(derivation, i, dst.m_spend_public_key, out_key);
+      tx.vout.push_back(cryptonote::tx_out{1000, cryptonote::txout_to_key(out_key)});
+    }
+    return tx;
+  }
+
+private:
+  std::vector<cryptonote::blobdata> m_blocks;
+  std::vector<crypto::hash> m_hashes;
+  std::vector< std::vector<cryptonote::blobdata> > m_txs;
+};
+
+// refresh of wallets_count view-only wallets over the same blocks: by one shared
+// scanner or, as every wallet did with own refresh, each wallet reading blocks itself
+template<size_t a_wallets_count, bool a_shared>
+class test_wallet_scanner
+{
+public:
+  static const size_t loop_count = a_wallets_count < 1000 ? 10 : 1;
+  static const size_t wallets_count = a_wallets_count;
+  static const size_t blocks_count = 10;
+  static const size_t txs_per_block = 1;
+
+  bool init()
+  {
+    m_accounts.resize(wallets_count);
+    for (auto& acc : m_accounts)
+    {
+      acc.generate();
+      m_addresses.push_back(acc.get_public_address_str(false));
+      m_view_keys.push_back(epee::string_tools::pod_to_hex(acc.get_keys().m_view_secret_key));
+    }
+
+    m_source = boost::make_shared<test_wallet_scanner_source>();
+    for (size_t i = 0; i < blocks_count; ++i)
+      m_source->add_block(m_accounts, txs_per_block);
+    return true;
+  }
+
+  bool test()
+  {
+    return a_shared ? test_shared() : test_per_wallet();
+  }
+
+private:
+  bool test_shared()
+  {
+    supernode::WalletScanner scanner(m_source, false, "");
+    for (size_t i = 0; i < wallets_count; ++i)
+      if (!scanner.AddAccount(m_addresses[i], m_view_keys[i]))
+        return false;
+    return scanner.Refresh() == blocks_count;
+  }
+
+  bool test_per_wallet()
+  {
+    for (size_t i = 0; i < wallets_count; ++i)
+    {
+      cryptonote::account_public_address address;
+      crypto::secret_key view_key;
+      if (!cryptonote::get_account_address_from_str(address, false, m_addresses[i]))
+        return false;
+      if (!epee::string_tools::hex_to_pod(m_view_keys[i], view_key))
+        return false;
+
+      for (uint64_t h = 0; h < m_source->Height(); ++h)
+      {
+        cryptonote::block blk;
+        std::vector<cryptonote::transaction> txs;
+        if (!m_source->Block(h, blk, txs))
+          return false;
+        txs.push_back(blk.miner_tx);
+        for (const auto& tx : txs)
+        {
+          crypto::key_derivation derivation;
+          crypto::generate_key_derivation(cryptonote::get_tx_pub_key_from_extra(tx), view_key, derivation);
+          for (size_t o = 0; o < tx.vout.size(); ++o)
+            cryptonote::is_out_to_acc_precomp(address.m_spend_public_key, boost::get<cryptonote::txout_to_key>(tx.vout[o].target), derivation, o);
+        }
+      }
+    }
+    return true;
+  }
+
+private:
+  std::vector<cryptonote::account_base> m_accounts;
+  std::vector<std::string> m_addresses;
+  std::vector<std::string> m_view_keys;
+  boost::shared_ptr<test_wallet_scanner_source> m_source;
+};
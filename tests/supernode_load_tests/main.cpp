@@ -0,0 +1,396 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Load generator for RTA flows: starts several supernodes (DAPI servers with
+// PosProxy, WalletProxy and AuthSample) on localhost with FSN_Servant_Test over
+// the test blockchain, drives Sale/GetSaleStatus/WalletGetPosData and reject or
+// pay flows at a fixed rate and reports throughput, latency percentiles,
+// thread count and memory.
+
+#include "include_base_utils.h"
+#include "common/command_line.h"
+#include "storages/portable_storage_template_helper.h"
+#include "string_coding.h"
+
+#include <boost/asio/io_service.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "supernode/AuthSample.h"
+#include "supernode/DAPI_RPC_ClientPool.h"
+#include "supernode/FSN_Servant_Test.h"
+#include "supernode/PosProxy.h"
+#include "supernode/RTATracer.h"
+#include "supernode/WalletProxy.h"
+#include "supernode/graft_wallet2.h"
+
+using namespace supernode;
+namespace po = boost::program_options;
+
+namespace {
+
+const command_line::arg_descriptor<unsigned> arg_supernodes   = {"supernodes", "Supernodes (DAPI servers) to start, all are in auth sample", 2};
+const command_line::arg_descriptor<unsigned> arg_base_port    = {"base-port", "DAPI port of the first supernode, next ones follow", 9500};
+const command_line::arg_descriptor<unsigned> arg_dapi_threads = {"dapi-threads", "Threads of each DAPI server", 10};
+const command_line::arg_descriptor<unsigned> arg_clients      = {"clients", "Client threads running flows", 16};
+const command_line::arg_descriptor<double>   arg_rate         = {"rate", "Flows started per second", 20};
+const command_line::arg_descriptor<unsigned> arg_duration     = {"duration", "Seconds to generate load", 30};
+const command_line::arg_descriptor<std::string> arg_flow      = {"flow", "reject - sale rejected by wallet, pay - full payment (needs daemon), sale - only sale and status", "reject"};
+const command_line::arg_descriptor<std::string> arg_daemon    = {"daemon-address", "Daemon for FSN servant and pay flow", "localhost:28281"};
+const command_line::arg_descriptor<std::string> arg_data_dir  = {"data-dir", "Test data (test_blockchain, test_wallets)", ""};
+const command_line::arg_descriptor<unsigned> arg_max_p99      = {"max-p99-ms", "Fail if p99 of whole flow is above it, 0 - don't check", 0};
+const command_line::arg_descriptor<bool>     arg_traces       = {"traces", "Print supernode RTA latency report with the slowest payments", false};
+
+const std::string s_POSAddress = "T6T2LeLmi6hf58g7MeTA8i4rdbVY8WngXBK3oWS7pjjq9qPbcze1gvV32x7GaHx8uWHQGNFBy1JCY1qBofv56Vwb26Xr998SE";
+const std::string s_POSViewKey = "0ae7176e5332974de64713c329d406956e8ff2fd60c85e7ee6d8c88318111007";
+
+const std::chrono::seconds s_FlowTimeout(30);
+
+typedef std::chrono::steady_clock Clock;
+
+// one DAPI server with all RTA processors, as supernode runs them
+struct Supernode {
+	DAPI_RPC_Server Server;
+	vector<BaseRTAProcessor*> Processors;
+	boost::thread* Thread = nullptr;
+
+	void Start(FSN_ServantBase* servant, const string& port, unsigned threads) {
+		Server.Set("127.0.0.1", port, threads);
+		Processors.push_back( new WalletProxy() );
+		Processors.push_back( new PosProxy() );
+		Processors.push_back( new AuthSample() );
+		for(auto a : Processors) {
+			a->Set(servant, &Server);
+			a->Start();
+		}
+		Thread = new boost::thread(&DAPI_RPC_Server::Start, &Server);
+	}
+
+	void Stop() {
+		Server.Stop();
+		Thread->join();
+		delete Thread;
+		for(auto a : Processors) {
+			a->Stop();
+			delete a;
+		}
+		Processors.clear();
+	}
+};
+
+// latency histograms of flow steps, in microseconds
+class Stats {
+	public:
+	void Add(const string& step, Clock::time_point start, bool ok) {
+		uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now()-start).count();
+		boost::lock_guard<boost::mutex> lock(m_Guard);
+		SStep& s = m_Steps[step];
+		if(ok) s.Latency.Add(us);
+		else s.Errors++;
+	}
+
+	uint64_t Print(double seconds) const {
+		boost::lock_guard<boost::mutex> lock(m_Guard);
+		std::cout << std::left << std::setw(24) << "step" << std::right << std::setw(10) << "ok" << std::setw(8) << "errors"
+			<< std::setw(10) << "per sec" << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "p999 ms" << std::setw(10) << "max ms" << std::endl;
+		uint64_t flowP99 = 0;
+		for(auto& a : m_Steps) {
+			const LatencyHistogram& h = a.second.Latency;
+			std::cout << std::left << std::setw(24) << a.first << std::right << std::setw(10) << h.Count() << std::setw(8) << a.second.Errors
+				<< std::setw(10) << std::fixed << std::setprecision(1) << h.Count()/seconds
+				<< std::setw(10) << std::setprecision(2) << h.Percentile(0.5)/1000.0
+				<< std::setw(10) << h.Percentile(0.99)/1000.0
+				<< std::setw(10) << h.Percentile(0.999)/1000.0
+				<< std::setw(10) << h.Max()/1000.0 << std::endl;
+			if(a.first=="Flow") flowP99 = h.Percentile(0.99);
+		}
+		return flowP99;
+	}
+
+	uint64_t Errors() const {
+		boost::lock_guard<boost::mutex> lock(m_Guard);
+		uint64_t ret = 0;
+		for(auto& a : m_Steps) ret += a.second.Errors;
+		return ret;
+	}
+
+	protected:
+	struct SStep {
+		LatencyHistogram Latency;
+		uint64_t Errors = 0;
+	};
+	mutable boost::mutex m_Guard;
+	map<string, SStep> m_Steps;
+};
+
+void PrintProcess(const char* when) {
+	std::ifstream status("/proc/self/status");
+	string line;
+	std::cout << when << ":";
+	while( std::getline(status, line) ) {
+		if( line.compare(0, 8, "Threads:")==0 || line.compare(0, 6, "VmRSS:")==0 || line.compare(0, 6, "VmHWM:")==0 ) {
+			boost::algorithm::erase_all(line, "\t");
+			std::cout << "  " << line;
+		}
+	}
+	std::cout << std::endl;
+}
+
+class LoadGenerator {
+	public:
+	string Flow;
+	vector<string> Ports;
+	string PayAccount;// base64 keys for pay flow
+
+	Stats Steps;
+
+	template<class IN_t, class OUT_t>
+	bool Call(const string& step, const string& port, const string& method, IN_t& in, OUT_t& out) {
+		auto start = Clock::now();
+		bool ret = DAPI_RPC_ClientPool::Shared().Invoke("127.0.0.1", port, method, in, out);
+		Steps.Add(step, start, ret);
+		return ret;
+	}
+
+	NTransactionStatus SaleStatus(const string& port, const string& pid) {
+		rpc_command::POS_GET_SALE_STATUS::request in;
+		rpc_command::POS_GET_SALE_STATUS::response out;
+		in.PaymentID = pid;
+		if( !Call("GetSaleStatus", port, dapi_call::GetSaleStatus, in, out) ) return NTransactionStatus::Fail;
+		return NTransactionStatus(out.Status);
+	}
+
+	// polls with 'check' until it returns true or flow timeout
+	template<class F>
+	bool WaitFor(const string& step, F check) {
+		auto start = Clock::now();
+		while( Clock::now()-start<s_FlowTimeout ) {
+			if( check() ) {
+				Steps.Add(step, start, true);
+				return true;
+			}
+			boost::this_thread::sleep_for( boost::chrono::milliseconds(10) );
+		}
+		Steps.Add(step, start, false);
+		return false;
+	}
+
+	// pos and wallet use different supernodes, as in real life
+	void RunFlow(unsigned n, Clock::time_point scheduled) {
+		const string& posPort = Ports[ n%Ports.size() ];
+		const string& walletPort = Ports[ (n+1)%Ports.size() ];
+
+		rpc_command::POS_SALE::request sale_in;
+		rpc_command::POS_SALE::response sale_out;
+		sale_in.Amount = 1;
+		sale_in.POSSaleDetails = "Load test sale";
+		sale_in.POSAddress = s_POSAddress;
+		sale_in.POSViewKey = s_POSViewKey;
+		bool ok = Call("Sale", posPort, dapi_call::Sale, sale_in, sale_out);
+
+		ok = ok && SaleStatus(posPort, sale_out.PaymentID)==NTransactionStatus::InProgress;
+
+		// auth sample gets sale in background, so wallet may ask too early
+		ok = ok && WaitFor("WalletGetPosData", [&]() {
+			rpc_command::WALLET_GET_POS_DATA::request in;
+			rpc_command::WALLET_GET_POS_DATA::response out;
+			in.BlockNum = sale_out.BlockNum;
+			in.PaymentID = sale_out.PaymentID;
+			return DAPI_RPC_ClientPool::Shared().Invoke("127.0.0.1", walletPort, dapi_call::WalletGetPosData, in, out) && out.POSSaleDetails==sale_in.POSSaleDetails;
+		});
+
+		if(ok && Flow=="reject") {
+			rpc_command::WALLET_REJECT_PAY::request in;
+			rpc_command::WALLET_REJECT_PAY::response out;
+			in.BlockNum = sale_out.BlockNum;
+			in.PaymentID = sale_out.PaymentID;
+			ok = Call("WalletRejectPay", walletPort, dapi_call::WalletRejectPay, in, out);
+			ok = ok && WaitFor("SaleRejected", [&]() { return SaleStatus(posPort, sale_out.PaymentID)==NTransactionStatus::RejectedByWallet; });
+		}
+
+		if(ok && Flow=="pay") {
+			rpc_command::WALLET_PAY::request in;
+			rpc_command::WALLET_PAY::response out;
+			in.Amount = sale_in.Amount;
+			in.POSAddress = sale_in.POSAddress;
+			in.BlockNum = sale_out.BlockNum;
+			in.PaymentID = sale_out.PaymentID;
+			in.Account = PayAccount;
+			ok = Call("Pay", walletPort, dapi_call::Pay, in, out);
+
+			NTransactionStatus st = NTransactionStatus::InProgress;
+			ok = ok && WaitFor("PayDone", [&]() {
+				rpc_command::WALLET_GET_TRANSACTION_STATUS::request sin;
+				rpc_command::WALLET_GET_TRANSACTION_STATUS::response sout;
+				sin.PaymentID = sale_out.PaymentID;
+				if( !DAPI_RPC_ClientPool::Shared().Invoke("127.0.0.1", walletPort, dapi_call::GetPayStatus, sin, sout) ) return false;
+				st = NTransactionStatus(sout.Status);
+				return st!=NTransactionStatus::InProgress;
+			});
+			ok = ok && st==NTransactionStatus::Success;
+			ok = ok && WaitFor("SaleSucceeded", [&]() { return SaleStatus(posPort, sale_out.PaymentID)==NTransactionStatus::Success; });
+		}
+
+		// from the time flow had to start, so slow clients don't hide latency
+		Steps.Add("Flow", scheduled, ok);
+	}
+
+	// open loop: flows start on schedule, even if previous are not done
+	void Run(double rate, unsigned seconds, unsigned clients) {
+		boost::asio::io_service service;
+		boost::thread_group threads;
+		{
+			boost::asio::io_service::work work(service);
+			for(unsigned i=0;i<clients;i++) threads.create_thread( boost::bind(&boost::asio::io_service::run, &service) );
+
+			auto start = Clock::now();
+			auto interval = std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>(1.0/rate) );
+			unsigned total = unsigned(rate*seconds);
+			for(unsigned n=0;n<total;n++) {
+				auto scheduled = start+interval*n;
+				std::this_thread::sleep_until(scheduled);
+				service.post( [this, n, scheduled]() { RunFlow(n, scheduled); } );
+			}
+		}
+		threads.join_all();
+	}
+};
+
+}
+
+int main(int argc, char** argv)
+{
+	epee::string_tools::set_module_name_and_folder(argv[0]);
+	mlog_configure("", true);
+	mlog_set_log_level(0);
+
+	po::options_description desc("Allowed options");
+	command_line::add_arg(desc, command_line::arg_help);
+	command_line::add_arg(desc, arg_supernodes);
+	command_line::add_arg(desc, arg_base_port);
+	command_line::add_arg(desc, arg_dapi_threads);
+	command_line::add_arg(desc, arg_clients);
+	command_line::add_arg(desc, arg_rate);
+	command_line::add_arg(desc, arg_duration);
+	command_line::add_arg(desc, arg_flow);
+	command_line::add_arg(desc, arg_daemon);
+	command_line::add_arg(desc, arg_data_dir);
+	command_line::add_arg(desc, arg_max_p99);
+	command_line::add_arg(desc, arg_traces);
+
+	po::variables_map vm;
+	bool r = command_line::handle_error_helper(desc, [&]() {
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		po::notify(vm);
+		return true;
+	});
+	if(!r) return 1;
+	if( command_line::get_arg(vm, command_line::arg_help) ) {
+		std::cout << desc << std::endl;
+		return 0;
+	}
+
+	string dataDir = command_line::get_arg(vm, arg_data_dir);
+	if( dataDir.empty() ) dataDir = epee::string_tools::get_current_module_folder() + "/../data/supernode";
+	unsigned supernodes = std::max(1u, command_line::get_arg(vm, arg_supernodes));
+	unsigned basePort = command_line::get_arg(vm, arg_base_port);
+	double rate = command_line::get_arg(vm, arg_rate);
+	unsigned duration = command_line::get_arg(vm, arg_duration);
+
+	LoadGenerator gen;
+	gen.Flow = command_line::get_arg(vm, arg_flow);
+	if(gen.Flow!="sale" && gen.Flow!="reject" && gen.Flow!="pay") {
+		std::cerr << "unknown flow: " << gen.Flow << std::endl;
+		return 1;
+	}
+
+	rpc_command::SetDAPIVersion("v1.0");
+	PrintProcess("before start");
+
+	// one servant for all: they share blockchain db, and test wallets are only two anyway
+	string wallets = dataDir + "/test_wallets";
+	FSN_Servant_Test servant(dataDir + "/test_blockchain", command_line::get_arg(vm, arg_daemon), "", true);
+	servant.Set(wallets + "/stake_wallet", "", wallets + "/miner_wallet", "");
+	FSN_WalletData stake = servant.GetMyStakeWallet();
+	FSN_WalletData miner = servant.GetMyMinerWallet();
+
+	vector<Supernode*> nodes;
+	for(unsigned i=0;i<supernodes;i++) {
+		string port = std::to_string(basePort+i);
+		gen.Ports.push_back(port);
+		servant.AddFsnAccount( boost::make_shared<FSN_Data>(stake, miner, "127.0.0.1", port) );
+	}
+	for(auto& port : gen.Ports) {
+		nodes.push_back( new Supernode() );
+		nodes.back()->Start(&servant, port, command_line::get_arg(vm, arg_dapi_threads));
+	}
+	boost::this_thread::sleep_for( boost::chrono::seconds(1) );
+
+	if(gen.Flow=="pay") {
+		tools::GraftWallet2 wallet(true, false);
+		wallet.load(wallets + "/stake_wallet", "");
+		gen.PayAccount = epee::string_encoding::base64_encode( wallet.store_keys_graft("", false) );
+	}
+
+	PrintProcess("started");
+	std::cout << "flow: " << gen.Flow << ", supernodes: " << supernodes << ", rate: " << rate << "/sec, duration: " << duration << " sec" << std::endl;
+
+	auto start = Clock::now();
+	gen.Run( rate, duration, command_line::get_arg(vm, arg_clients) );
+	double seconds = std::chrono::duration<double>(Clock::now()-start).count();
+
+	PrintProcess("under load");
+	uint64_t p99 = gen.Steps.Print(seconds);
+
+	if( command_line::get_arg(vm, arg_traces) ) {
+		std::string json;
+		rpc_command::RTA_LATENCY_REPORT rep = RTATracer::Shared().Report();
+		epee::serialization::store_t_to_json(rep, json);
+		std::cout << json << std::endl;
+	}
+
+	for(auto a : nodes) {
+		a->Stop();
+		delete a;
+	}
+
+	unsigned maxP99 = command_line::get_arg(vm, arg_max_p99);
+	if( maxP99 && p99>uint64_t(maxP99)*1000 ) {
+		std::cerr << "p99 of flow " << p99/1000 << " ms is above " << maxP99 << " ms" << std::endl;
+		return 2;
+	}
+	return gen.Steps.Errors() ? 3 : 0;
+}
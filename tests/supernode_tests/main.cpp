@@ -57,6 +57,7 @@
 #include "supernode/FSN_Servant.h"
 #include "supernode/DAPI_RPC_Server.h"
 #include "supernode/DAPI_RPC_Client.h"
+#include "supernode/DAPI_RPC_ClientPool.h"
 #include "supernode/PosProxy.h"
 #include "supernode/WalletProxy.h"
 #include "supernode/AuthSample.h"
@@ -64,6 +65,7 @@
 #include "supernode/FSN_Servant_Test.h"
 #include "supernode/FSN_ActualList.h"
 #include "supernode/graft_wallet2.h"
+#include "supernode/RTATracer.h"
 
 using namespace supernode;
 using namespace std;
@@ -100,6 +102,12 @@ struct TestDAPI_Server_And_ClientBase : public testing::Test {
 		return true;
 	}
 
+	bool SlowCall(const TEST_RPC_CALL::request& req, TEST_RPC_CALL::response& out) {
+		boost::this_thread::sleep_for(boost::chrono::seconds(2));
+		out.Data = req.Data;
+		return true;
+	}
+
 	bool Pay1(const TEST_RPC_CALL::request& req, TEST_RPC_CALL::response& out) {
 		if(req.PaymentID!="1") return false;
 		out.Data = 1;
@@ -655,11 +663,229 @@ TEST_F(TestHanlerP2P, Test_P2PTest) {
 
 }
 
+TEST_F(TestDAPI_Server_And_ClientBase, TestDAPI_ClientPoolReuse) {
+		string ip = "127.0.0.1";
+		string port = "7558";
+
+		supernode::rpc_command::SetDAPIVersion("v1.0");
+		supernode::DAPI_RPC_Server dapi_server;
+		dapi_server.Set( ip, port, 5 );
+
+		boost::thread workerThread(&supernode::DAPI_RPC_Server::Start, &dapi_server);
+		dapi_server.ADD_DAPI_HANDLER(MyTestCall, TestDAPI_Server_And_ClientBase::TEST_RPC_CALL, TestDAPI_Server_And_ClientBase);
+		sleep(1);
+
+		DAPI_RPC_ClientPool pool;
+		TEST_RPC_CALL::request in;
+		TEST_RPC_CALL::response out;
+		for(int i=0;i<5;i++) {
+			in.Data = i;
+			ASSERT_TRUE( pool.Invoke(ip, port, "MyTestCall", in, out) && out.Data==i*2 );
+		}
+
+		DAPI_RPC_ClientPool::SStats stats = pool.Stats();
+		ASSERT_EQ( stats.Calls, 5 );
+		ASSERT_EQ( stats.NewConnections, 1 );
+		ASSERT_EQ( stats.ReusedConnections, 4 );
+		ASSERT_EQ( pool.NotAvailCount(ip, port), 0 );
+
+		bool connected = true;
+		ASSERT_FALSE( pool.Invoke(ip, "7559", "MyTestCall", in, out, std::chrono::seconds(1), &connected) );
+		ASSERT_FALSE( connected );
+		ASSERT_EQ( pool.NotAvailCount(ip, "7559"), 1 );
+
+		dapi_server.Stop();
+		workerThread.join();
+}
+
+TEST_F(TestDAPI_Server_And_ClientBase, TestDAPI_ClientPoolExhausted) {
+		string ip = "127.0.0.1";
+		string port = "7562";
+
+		supernode::rpc_command::SetDAPIVersion("v1.0");
+		supernode::DAPI_RPC_Server dapi_server;
+		dapi_server.Set( ip, port, 5 );
+
+		boost::thread workerThread(&supernode::DAPI_RPC_Server::Start, &dapi_server);
+		dapi_server.ADD_DAPI_HANDLER(MyTestCall, TestDAPI_Server_And_ClientBase::TEST_RPC_CALL, TestDAPI_Server_And_ClientBase);
+		dapi_server.ADD_DAPI_HANDLER(SlowCall, TestDAPI_Server_And_ClientBase::TEST_RPC_CALL, TestDAPI_Server_And_ClientBase);
+		sleep(1);
+
+		DAPI_RPC_ClientPool pool;
+		pool.MaxPerHost = 1;
+
+		bool slowOk = false;
+		boost::thread slowThread([&]() {
+			TEST_RPC_CALL::request in;
+			TEST_RPC_CALL::response out;
+			in.Data = 1;
+			slowOk = pool.Invoke(ip, port, "SlowCall", in, out);
+		});
+		boost::this_thread::sleep_for(boost::chrono::milliseconds(500));
+
+		// only connection is busy: call fails, but endpoint is not counted as unavailable
+		TEST_RPC_CALL::request in;
+		TEST_RPC_CALL::response out;
+		in.Data = 2;
+		for(unsigned i=0;i<5;i++) {
+			bool connected = false;
+			ASSERT_FALSE( pool.Invoke(ip, port, "MyTestCall", in, out, std::chrono::milliseconds(100), &connected) );
+			ASSERT_TRUE( connected );
+		}
+		ASSERT_EQ( pool.NotAvailCount(ip, port), 0 );
+		ASSERT_EQ( pool.Stats().PoolExhausted, 5 );
+
+		slowThread.join();
+		ASSERT_TRUE( slowOk );
+		ASSERT_TRUE( pool.Invoke(ip, port, "MyTestCall", in, out) && out.Data==4 );
+		ASSERT_EQ( pool.NotAvailCount(ip, port), 0 );
+
+		dapi_server.Stop();
+		workerThread.join();
+}
+
+// server from before binary transport: no handler for DAPI_BIN_URI
+struct JsonOnlyDAPI_Server : public supernode::DAPI_RPC_Server {
+	bool handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context) override {
+		if( query_info.m_URI==supernode::rpc_command::DAPI_BIN_URI ) {
+			response.m_response_code = 500;
+			response.m_response_comment = "Internal server error";
+			return true;
+		}
+		return supernode::DAPI_RPC_Server::handle_http_request(query_info, response, m_conn_context);
+	}
+};
+
+TEST_F(TestDAPI_Server_And_ClientBase, TestDAPI_BinaryTransport) {
+		string ip = "127.0.0.1";
+		string port = "7560";
+		string json_port = "7561";
+
+		supernode::rpc_command::SetDAPIVersion("v1.0");
+		supernode::DAPI_RPC_Server dapi_server;
+		dapi_server.Set( ip, port, 5 );
+		JsonOnlyDAPI_Server json_server;
+		json_server.Set( ip, json_port, 5 );
+
+		boost::thread workerThread(&supernode::DAPI_RPC_Server::Start, &dapi_server);
+		boost::thread jsonThread(&supernode::DAPI_RPC_Server::Start, &json_server);
+		dapi_server.ADD_DAPI_HANDLER(MyTestCall, TestDAPI_Server_And_ClientBase::TEST_RPC_CALL, TestDAPI_Server_And_ClientBase);
+		dapi_server.Add_UUID_MethodHandler<TEST_RPC_CALL::request, TEST_RPC_CALL::response>( "1", "Payment", bind( &TestDAPI_Server_And_ClientBase::Pay1, this, _1, _2) );
+		json_server.ADD_DAPI_HANDLER(MyTestCall, TestDAPI_Server_And_ClientBase::TEST_RPC_CALL, TestDAPI_Server_And_ClientBase);
+		sleep(1);
+
+		supernode::DAPI_RPC_Client client;
+		client.Set(ip, port);
+		client.Binary = true;
+
+		TEST_RPC_CALL::request in;
+		TEST_RPC_CALL::response out;
+		in.Data = 10;
+		ASSERT_TRUE( client.Invoke("MyTestCall", in, out) && out.Data==20 );
+		in.PaymentID = "1";
+		ASSERT_TRUE( client.Invoke("Payment", in, out) && out.Data==1 );
+		in.PaymentID = "2";
+		ASSERT_FALSE( client.Invoke("Payment", in, out) );
+		ASSERT_TRUE( client.Binary );
+
+		// old server: first call falls back to json, pool remembers it
+		DAPI_RPC_ClientPool pool;
+		in.Data = 3;
+		ASSERT_TRUE( pool.Invoke(ip, json_port, "MyTestCall", in, out) && out.Data==6 );
+		in.Data = 4;
+		ASSERT_TRUE( pool.Invoke(ip, json_port, "MyTestCall", in, out) && out.Data==8 );
+		in.Data = 5;
+		ASSERT_TRUE( pool.Invoke(ip, port, "MyTestCall", in, out) && out.Data==10 );
+
+		dapi_server.Stop();
+		json_server.Stop();
+		workerThread.join();
+		jsonThread.join();
+}
+
+// -------------------------------------------------------------
+
+struct TestSubNetBroadcast : testing::Test {
+	bool Echo(const TestDAPI_Server_And_ClientBase::TEST_RPC_CALL::request& in, TestDAPI_Server_And_ClientBase::TEST_RPC_CALL::response& out) {
+		out.Data = in.Data;
+		return true;
+	}
+};
+
+TEST_F(TestSubNetBroadcast, Test_SendAsyncQuorum) {
+	typedef TestDAPI_Server_And_ClientBase::TEST_RPC_CALL call;
+
+	supernode::rpc_command::SetDAPIVersion("v1.0");
+	DAPI_RPC_Server dapi_server;
+	dapi_server.Set( "127.0.0.1", "7556", 5 );
+	boost::thread workerThread(&DAPI_RPC_Server::Start, &dapi_server);
+	dapi_server.Add_UUID_MethodHandler<call::request, call::response>( "subnet", "Echo", bind( &TestSubNetBroadcast::Echo, this, _1, _2) );
+	sleep(1);
+
+	vector<string> members;
+	members.push_back("127.0.0.1:7556");
+	members.push_back("127.0.0.1:7557");// nobody listen
+
+	SubNetBroadcast sub;
+	sub.RetryCount = 1;
+	sub.CallTimeout = std::chrono::seconds(1);
+	sub.Set(&dapi_server, "subnet", members);
+
+	call::request in;
+	in.PaymentID = "subnet";
+	in.Data = 7;
+
+	// first answer is enough
+	auto quorum = sub.SendAsync<call::request, call::response>("Echo", in, 1);
+	ASSERT_TRUE( quorum->Wait(std::chrono::seconds(5)) );
+	ASSERT_TRUE( quorum->Succeeded() );
+	vector<call::response> out = quorum->Responses();
+	ASSERT_TRUE( out.size()==1 && out[0].Data==7 );
+
+	// several sends at once, each needs all members
+	atomic_uint completed = {0};
+	vector< boost::shared_ptr< SubNetBroadcast::SSendState<call::response> > > all;
+	for(unsigned i=0;i<3;i++) all.push_back( sub.SendAsync<call::request, call::response>("Echo", in, SubNetBroadcast::QuorumAll, [&completed](const SubNetBroadcast::SSendState<call::response>&) { completed++; }) );
+	for(auto& a : all) {
+		a->Wait();
+		ASSERT_FALSE( a->Succeeded() );
+		vector<SubNetBroadcast::SCallResult> res = a->Results();
+		ASSERT_TRUE( res.size()==2 && res[1].Status!=SubNetBroadcast::CallStatus::Ok );
+	}
+	ASSERT_EQ( completed, 3 );
+
+	dapi_server.Stop();
+	workerThread.join();
+}
+
+TEST(TestRTATracer, Test_LatencyReport) {
+	RTATracer tracer;
+	auto now = RTATracer::Clock::now();
+	for(unsigned i=0;i<1000;i++) {
+		string pid = "payment"+to_string(i);
+		tracer.Phase(pid, "Sale", now-std::chrono::milliseconds(i+1));
+		tracer.Call(pid, "PosProxySale", "127.0.0.1:7500", now-std::chrono::milliseconds(1), true);
+		tracer.Finish(pid);
+	}
+
+	rpc_command::RTA_LATENCY_REPORT rep = tracer.Report(3);
+	ASSERT_EQ( rep.Total.Count, 1000 );
+	ASSERT_TRUE( rep.Phases.size()==1 && rep.Phases[0].Name=="Sale" );
+	ASSERT_TRUE( rep.Calls.size()==1 && rep.Calls[0].Count==1000 );
+	// buckets are within 12.5%
+	ASSERT_TRUE( rep.Phases[0].P50>=500000 && rep.Phases[0].P50<=500000*9/8 );
+	ASSERT_TRUE( rep.Phases[0].P99>=990000 && rep.Phases[0].P99<=rep.Phases[0].Max );
+
+	ASSERT_EQ( rep.Slowest.size(), 3 );
+	ASSERT_EQ( rep.Slowest[0].PaymentID, "payment999" );
+	ASSERT_EQ( rep.Slowest[0].Events.size(), 2 );
+	ASSERT_TRUE( rep.Slowest[0].Total>=rep.Slowest[1].Total );
+}
+
 // -------------------------------------------------------------
 
 struct FSN_ActualList_Test : public FSN_ActualList {
-	FSN_ActualList_Test(FSN_ServantBase* s, P2P_Broadcast* p, DAPI_RPC_Server* d) : FSN_ActualList(s,p,d), AuditStartAt(m_AuditStartAt) {}
-	boost::posix_time::ptime& AuditStartAt;
+	FSN_ActualList_Test(FSN_ServantBase* s, P2P_Broadcast* p, DAPI_RPC_Server* d) : FSN_ActualList(s,p,d) {}
 
 	bool AuditDone = false;
 	void DoAudit() override {
@@ -771,9 +997,9 @@ TEST_F(Test_ActualFSNList_Strut, Test_ActualFSNList) {
     // -------------
     node2.Stop();
 
-    node1.List->AuditDone = false;
-    node1.List->AuditStartAt -= boost::posix_time::hours(30);
-    while(!node1.List->AuditDone) sleep(1);
+    // audit running right now may have checked node2 before it stopped, so wait for result
+    node1.List->AuditNow();
+    for(unsigned i=0;i<30 && node1.Servant->All_FSN.size()!=1;i++) sleep(1);
 
     bool found5 = node1.FindFSN("7510", "T6SnKmirXp6geLAoB7fn2eV51Ctr1WH1xWDnEGzS9pvQARTJQUXupiRKGR7czL7b5XdDnYXosVJu6Wj3Y3NYfiEA2sU2QiGVa", "8c0ccff03e9f2a9805e200f887731129495ff793dc678db6c5b53df814084f04");
     bool found6 = node1.FindFSN("8510", "T6T2LeLmi6hf58g7MeTA8i4rdbVY8WngXBK3oWS7pjjq9qPbcze1gvV32x7GaHx8uWHQGNFBy1JCY1qBofv56Vwb26Xr998SE", "0ae7176e5332974de64713c329d406956e8ff2fd60c85e7ee6d8c88318111007");
@@ -0,0 +1,157 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <deque>
+#include <string>
+
+#include "cryptonote_core/blockchain_based_list.h"
+#include "cryptonote_core/stake_transaction_storage.h"
+#include "graft_rta_config.h"
+
+using cryptonote::BlockchainBasedList;
+using cryptonote::StakeTransactionStorage;
+
+namespace
+{
+  bool same_tiers(const BlockchainBasedList::supernode_tier_array &a, const BlockchainBasedList::supernode_tier_array &b)
+  {
+    if (a.size() != b.size())
+      return false;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+      if (a[i].size() != b[i].size())
+        return false;
+      for (size_t j = 0; j < a[i].size(); ++j)
+      {
+        const BlockchainBasedList::supernode &x = a[i][j], &y = b[i][j];
+        if (x.supernode_public_id != y.supernode_public_id || x.amount != y.amount || x.block_height != y.block_height ||
+            x.unlock_time != y.unlock_time || memcmp(&x.supernode_public_address, &y.supernode_public_address, sizeof(x.supernode_public_address)))
+          return false;
+      }
+    }
+    return true;
+  }
+
+  class blockchain_based_list : public ::testing::Test
+  {
+  protected:
+    blockchain_based_list()
+      : m_storage(0)
+    {
+      // supernodes join and leave over time, so consecutive lists differ
+      for (size_t i = 0; i < 300; ++i)
+      {
+        cryptonote::stake_transaction tx = AUTO_VAL_INIT(tx);
+        tx.block_height = 1 + i * 4;
+        tx.unlock_time = 100 + i % 50;
+        tx.amount = config::graft::TIER1_STAKE_AMOUNT * (1 + i % 6);
+        tx.supernode_public_id = "supernode-" + std::to_string(i % 120);
+        memset(&tx.supernode_public_address, int(i % 120), sizeof(tx.supernode_public_address));
+        m_storage.add_tx(tx);
+      }
+    }
+
+    void apply_block(BlockchainBasedList &list)
+    {
+      uint64_t height = list.block_height() + 1;
+      crypto::hash hash = cryptonote::null_hash;
+      memcpy(&hash, &height, sizeof(height));
+      list.apply_block(height, hash, m_storage);
+      m_expected.push_back(list.tiers());
+    }
+
+    void check_history(const BlockchainBasedList &list)
+    {
+      ASSERT_EQ(uint64_t(std::min(m_expected.size(), size_t(1000))), list.history_depth());
+      for (size_t depth = 0; depth < list.history_depth(); ++depth)
+        ASSERT_TRUE(same_tiers(m_expected[m_expected.size() - 1 - depth], list.tiers(depth))) << "depth " << depth;
+    }
+
+    StakeTransactionStorage m_storage;
+    std::deque<BlockchainBasedList::supernode_tier_array> m_expected;
+  };
+}
+
+TEST_F(blockchain_based_list, history_is_bounded)
+{
+  BlockchainBasedList list(0);
+
+  for (size_t i = 0; i < 1300; ++i)
+    apply_block(list);
+
+  ASSERT_EQ(uint64_t(1300), list.block_height());
+  check_history(list);
+  ASSERT_THROW(list.tiers(1000), std::runtime_error);
+}
+
+TEST_F(blockchain_based_list, remove_latest_blocks)
+{
+  BlockchainBasedList list(0);
+
+  for (size_t i = 0; i < 1100; ++i)
+    apply_block(list);
+
+  for (size_t i = 0; i < 50; ++i)
+  {
+    list.remove_latest_block();
+    m_expected.pop_back();
+  }
+  ASSERT_EQ(uint64_t(1050), list.block_height());
+  ASSERT_EQ(uint64_t(950), list.history_depth());
+
+  for (size_t depth = 0; depth < list.history_depth(); ++depth)
+    ASSERT_TRUE(same_tiers(m_expected[m_expected.size() - 1 - depth], list.tiers(depth)));
+
+  for (size_t i = 0; i < 100; ++i)
+    apply_block(list);
+  ASSERT_EQ(uint64_t(1000), list.history_depth());
+  for (size_t depth = 0; depth < list.history_depth(); ++depth)
+    ASSERT_TRUE(same_tiers(m_expected[m_expected.size() - 1 - depth], list.tiers(depth)));
+}
+
+TEST_F(blockchain_based_list, reset_restores_history)
+{
+  BlockchainBasedList::list_history history;
+  {
+    BlockchainBasedList list(0);
+    for (size_t i = 0; i < 400; ++i)
+      apply_block(list);
+    for (size_t depth = list.history_depth(); depth--;)
+      history.push_back(list.tiers(depth));
+  }
+
+  BlockchainBasedList list(0);
+  list.reset(400, history);
+  ASSERT_EQ(uint64_t(400), list.block_height());
+  check_history(list);
+
+  apply_block(list);
+  check_history(list);
+}
@@ -151,6 +151,24 @@ std::string h2b(const std::string& s)
   return result;
 }
 
+// writes the block hash as RTA state of each block, as a stake processor would write its state
+struct rta_test_extension : public BlockchainDBExtension
+{
+  BlockchainDB& m_db;
+
+  rta_test_extension(BlockchainDB& db) : m_db(db) { }
+
+  void on_block_added(uint64_t height, const block& blk, const crypto::hash& blk_hash, const std::vector<transaction>& txs)
+  {
+    m_db.add_rta_state(RTA_TIERS, height, pod_to_hex(blk_hash));
+  }
+
+  void on_block_removed(uint64_t height, const block& blk)
+  {
+    m_db.remove_rta_state(RTA_TIERS, height);
+  }
+};
+
 template <typename T>
 class BlockchainDBTest : public testing::Test
 {
@@ -343,4 +361,65 @@ TYPED_TEST(BlockchainDBTest, RetrieveBlockData)
   ASSERT_HASH_EQ(get_block_hash(this->m_blocks[1]), hashes[1]);
 }
 
+TYPED_TEST(BlockchainDBTest, RtaState)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  // make sure open does not throw
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  rta_test_extension extension(*this->m_db);
+  this->m_db->set_extension(&extension);
+
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+
+  // state is written with each block
+  uint64_t height = 0;
+  std::string blob;
+  ASSERT_TRUE(this->m_db->get_latest_rta_state(RTA_TIERS, 100, height, blob));
+  ASSERT_EQ(1, height);
+  ASSERT_EQ(pod_to_hex(get_block_hash(this->m_blocks[1])), blob);
+
+  ASSERT_TRUE(this->m_db->get_latest_rta_state(RTA_TIERS, 0, height, blob));
+  ASSERT_EQ(0, height);
+  ASSERT_EQ(pod_to_hex(get_block_hash(this->m_blocks[0])), blob);
+
+  ASSERT_FALSE(this->m_db->get_latest_rta_state(RTA_STAKE_TXS, 100, height, blob));
+
+  std::vector<uint64_t> heights;
+  ASSERT_TRUE(this->m_db->for_rta_states_range(RTA_TIERS, 0, 1, [&](uint64_t h, const std::string&) { heights.push_back(h); return true; }));
+  ASSERT_EQ(2, heights.size());
+  ASSERT_EQ(0, heights[0]);
+  ASSERT_EQ(1, heights[1]);
+
+  // and removed with it
+  block blk;
+  std::vector<transaction> txs;
+  ASSERT_NO_THROW(this->m_db->pop_block(blk, txs));
+  ASSERT_TRUE(this->m_db->get_latest_rta_state(RTA_TIERS, 100, height, blob));
+  ASSERT_EQ(0, height);
+
+  this->m_db->set_extension(nullptr);
+
+  // pruning keeps states from the given height on
+  ASSERT_NO_THROW(this->m_db->add_rta_state(RTA_STAKE_TXS, 5, "a"));
+  ASSERT_NO_THROW(this->m_db->add_rta_state(RTA_STAKE_TXS, 7, "b"));
+  ASSERT_NO_THROW(this->m_db->add_rta_state(RTA_STAKE_TXS, 9, "c"));
+  ASSERT_NO_THROW(this->m_db->prune_rta_state(RTA_STAKE_TXS, 7));
+  ASSERT_FALSE(this->m_db->get_latest_rta_state(RTA_STAKE_TXS, 6, height, blob));
+  ASSERT_TRUE(this->m_db->get_latest_rta_state(RTA_STAKE_TXS, 8, height, blob));
+  ASSERT_EQ(7, height);
+  ASSERT_EQ("b", blob);
+
+  ASSERT_NO_THROW(this->m_db->drop_rta_state());
+  ASSERT_FALSE(this->m_db->get_latest_rta_state(RTA_TIERS, 100, height, blob));
+  ASSERT_FALSE(this->m_db->get_latest_rta_state(RTA_STAKE_TXS, 100, height, blob));
+}
+
 }  // anonymous namespace
@@ -0,0 +1,133 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "net/traffic_metrics.h"
+
+using epee::net_utils::traffic_metrics;
+
+TEST(traffic_metrics, counts_messages_and_bytes)
+{
+  traffic_metrics<int> metrics;
+  metrics.on_in(1, 100);
+  metrics.on_in(1, 50);
+  metrics.on_out(1, 10);
+  metrics.on_out(2, 20);
+
+  auto stats = metrics.snapshot();
+  ASSERT_EQ(size_t(2), stats.size());
+  ASSERT_EQ(uint64_t(2), stats[1].messages_in);
+  ASSERT_EQ(uint64_t(150), stats[1].bytes_in);
+  ASSERT_EQ(uint64_t(1), stats[1].messages_out);
+  ASSERT_EQ(uint64_t(10), stats[1].bytes_out);
+  ASSERT_EQ(uint64_t(0), stats[2].messages_in);
+  ASSERT_EQ(uint64_t(20), stats[2].bytes_out);
+}
+
+TEST(traffic_metrics, handler_time_histogram)
+{
+  traffic_metrics<std::string> metrics;
+  metrics.on_handled("a", 5, 10, true);
+  metrics.on_handled("a", 7, 50, true);
+  metrics.on_handled("a", 1, 51, false);
+  metrics.on_handled("a", 0, 5000000, true);
+
+  auto stats = metrics.snapshot();
+  const auto &a = stats["a"];
+  ASSERT_EQ(uint64_t(4), a.handled);
+  ASSERT_EQ(uint64_t(1), a.errors);
+  ASSERT_EQ(uint64_t(13), a.wait_us_total);
+  ASSERT_EQ(uint64_t(7), a.wait_us_max);
+  ASSERT_EQ(uint64_t(5000111), a.exec_us_total);
+  ASSERT_EQ(uint64_t(5000000), a.exec_us_max);
+  ASSERT_EQ(uint64_t(2), a.exec_histogram[0]);
+  ASSERT_EQ(uint64_t(1), a.exec_histogram[1]);
+  ASSERT_EQ(uint64_t(1), a.exec_histogram[traffic_metrics<std::string>::HISTOGRAM_BUCKETS - 1]);
+}
+
+TEST(traffic_metrics, merges_threads)
+{
+  traffic_metrics<int> metrics;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+    threads.emplace_back([&metrics] {
+      for (int i = 0; i < 1000; ++i)
+        metrics.on_in(i % 2, 1);
+    });
+  for (auto &t : threads)
+    t.join();
+
+  auto stats = metrics.snapshot();
+  ASSERT_EQ(uint64_t(2000), stats[0].messages_in);
+  ASSERT_EQ(uint64_t(2000), stats[1].bytes_in);
+}
+
+TEST(traffic_metrics, text_format)
+{
+  traffic_metrics<int> metrics;
+  metrics.set_name(7, "ping");
+  metrics.on_in(7, 10);
+  metrics.on_in(8, 10);
+  metrics.on_handled(7, 0, 100, true);
+
+  std::string text = metrics.to_text("p2p", "command");
+  ASSERT_NE(std::string::npos, text.find("p2p_messages_in_total{command=\"ping\"} 1\n"));
+  ASSERT_NE(std::string::npos, text.find("p2p_messages_in_total{command=\"8\"} 1\n"));
+  ASSERT_NE(std::string::npos, text.find("p2p_handler_seconds_bucket{command=\"ping\",le=\"5e-05\"} 0\n"));
+  ASSERT_NE(std::string::npos, text.find("p2p_handler_seconds_bucket{command=\"ping\",le=\"0.0001\"} 1\n"));
+  ASSERT_NE(std::string::npos, text.find("p2p_handler_seconds_bucket{command=\"ping\",le=\"+Inf\"} 1\n"));
+  ASSERT_NE(std::string::npos, text.find("p2p_handler_seconds_count{command=\"ping\"} 1\n"));
+}
+
+TEST(traffic_metrics, unknown_keys_are_bounded)
+{
+  traffic_metrics<int> metrics(-1, "other");
+  metrics.set_name(7, "ping");
+  metrics.on_in(7, 10);
+  for (int i = 0; i < 10000; ++i)
+  {
+    metrics.on_in(1000 + i, 1);
+    metrics.on_handled(1000 + i, 0, 1, false);
+    metrics.on_out(1000 + i, 2);
+  }
+
+  auto stats = metrics.snapshot();
+  ASSERT_EQ(size_t(2), stats.size());
+  ASSERT_EQ(uint64_t(1), stats[7].messages_in);
+  ASSERT_EQ(uint64_t(10000), stats[-1].messages_in);
+  ASSERT_EQ(uint64_t(10000), stats[-1].errors);
+  ASSERT_EQ(uint64_t(20000), stats[-1].bytes_out);
+
+  std::string text = metrics.to_text("p2p", "command");
+  ASSERT_NE(std::string::npos, text.find("p2p_messages_in_total{command=\"other\"} 10000\n"));
+}
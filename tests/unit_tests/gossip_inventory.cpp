@@ -0,0 +1,111 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <string>
+
+#include "p2p/gossip_inventory.h"
+
+using nodetool::gossip_inventory;
+
+namespace
+{
+  typedef gossip_inventory::clock clock;
+
+  gossip_inventory::blob_ptr make_blob(size_t size)
+  {
+    return std::make_shared<const std::string>(size, 'x');
+  }
+}
+
+TEST(gossip_inventory, stores_shared_bodies)
+{
+  gossip_inventory inventory(std::chrono::milliseconds(1000), 1024, std::chrono::milliseconds(100));
+  gossip_inventory::blob_ptr blob = make_blob(10);
+  clock::time_point now = clock::now();
+
+  inventory.put("a", 7, blob, now);
+  inventory.put("a", 7, make_blob(10), now);
+  ASSERT_EQ(size_t(1), inventory.size());
+  ASSERT_EQ(size_t(10), inventory.bytes());
+
+  int command = 0;
+  gossip_inventory::blob_ptr stored;
+  ASSERT_TRUE(inventory.get("a", command, stored));
+  ASSERT_EQ(7, command);
+  ASSERT_EQ(blob.get(), stored.get());
+  ASSERT_FALSE(inventory.get("b", command, stored));
+}
+
+TEST(gossip_inventory, expires_by_ttl)
+{
+  gossip_inventory inventory(std::chrono::milliseconds(1000), 1024, std::chrono::milliseconds(100));
+  clock::time_point now = clock::now();
+
+  inventory.put("a", 1, make_blob(10), now);
+  inventory.put("b", 1, make_blob(10), now + std::chrono::milliseconds(1500));
+  ASSERT_EQ(size_t(1), inventory.size());
+  ASSERT_EQ(size_t(10), inventory.bytes());
+
+  int command;
+  gossip_inventory::blob_ptr stored;
+  ASSERT_FALSE(inventory.get("a", command, stored));
+  ASSERT_TRUE(inventory.get("b", command, stored));
+}
+
+TEST(gossip_inventory, bounded_by_bytes)
+{
+  gossip_inventory inventory(std::chrono::milliseconds(1000), 25, std::chrono::milliseconds(100));
+  clock::time_point now = clock::now();
+
+  inventory.put("a", 1, make_blob(10), now);
+  inventory.put("b", 1, make_blob(10), now);
+  inventory.put("c", 1, make_blob(10), now);
+  ASSERT_EQ(size_t(2), inventory.size());
+  ASSERT_EQ(size_t(20), inventory.bytes());
+
+  int command;
+  gossip_inventory::blob_ptr stored;
+  ASSERT_FALSE(inventory.get("a", command, stored));
+  ASSERT_TRUE(inventory.get("c", command, stored));
+}
+
+TEST(gossip_inventory, pulls_once_until_timeout)
+{
+  gossip_inventory inventory(std::chrono::milliseconds(1000), 1024, std::chrono::milliseconds(100));
+  clock::time_point now = clock::now();
+
+  ASSERT_TRUE(inventory.want("a", now));
+  ASSERT_FALSE(inventory.want("a", now + std::chrono::milliseconds(50)));
+  ASSERT_TRUE(inventory.want("a", now + std::chrono::milliseconds(150)));
+
+  inventory.put("a", 1, make_blob(10), now + std::chrono::milliseconds(160));
+  ASSERT_FALSE(inventory.want("a", now + std::chrono::milliseconds(500)));
+}
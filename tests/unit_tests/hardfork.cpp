@@ -123,6 +123,13 @@ public:
   virtual cryptonote::blobdata get_txpool_tx_blob(const crypto::hash& txid) const { return ""; }
   virtual bool for_all_txpool_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata*)>, bool include_blob = false) const { return false; }
 
+  virtual void add_rta_state(rta_state_type type, uint64_t height, const std::string& blob) {}
+  virtual void remove_rta_state(rta_state_type type, uint64_t height) {}
+  virtual bool get_latest_rta_state(rta_state_type type, uint64_t max_height, uint64_t& height, std::string& blob) const { return false; }
+  virtual bool for_rta_states_range(rta_state_type type, uint64_t h1, uint64_t h2, std::function<bool(uint64_t height, const std::string& blob)> f) const { return true; }
+  virtual void prune_rta_state(rta_state_type type, uint64_t height) {}
+  virtual void drop_rta_state() {}
+
   virtual void add_block( const block& blk
                         , const size_t& block_size
                         , const difficulty_type& cumulative_difficulty
@@ -0,0 +1,103 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "p2p/request_cache.h"
+
+using nodetool::request_cache;
+
+TEST(request_cache, drops_duplicates)
+{
+  request_cache cache(1000, 1024);
+  ASSERT_TRUE(cache.insert("a", 0));
+  ASSERT_FALSE(cache.insert("a", 10));
+  ASSERT_TRUE(cache.insert("b", 10));
+  ASSERT_TRUE(cache.contains("a", 20));
+  ASSERT_FALSE(cache.contains("c", 20));
+
+  auto stats = cache.get_stats();
+  ASSERT_EQ(2, stats.size);
+  ASSERT_EQ(1, stats.hits);
+  ASSERT_EQ(2, stats.misses);
+  ASSERT_EQ(0, stats.evicted);
+}
+
+TEST(request_cache, expires)
+{
+  const uint64_t ttl = 1000;
+  request_cache cache(ttl, 1024);
+  ASSERT_TRUE(cache.insert("a", 999));
+  // remembered for at least ttl
+  ASSERT_TRUE(cache.contains("a", 999 + ttl));
+  ASSERT_FALSE(cache.insert("a", 999 + ttl));
+  // and forgotten after ttl plus one bucket
+  ASSERT_FALSE(cache.contains("a", 999 + ttl + ttl / (request_cache::BUCKETS - 1) + 1));
+  ASSERT_TRUE(cache.insert("a", 999 + 2 * ttl));
+}
+
+TEST(request_cache, bounded)
+{
+  const size_t max_entries = request_cache::SHARDS * 4;
+  request_cache cache(1000, max_entries);
+  uint64_t now = 0;
+  for (size_t i = 0; i < 100 * max_entries; ++i)
+  {
+    if (i % max_entries == 0)
+      now += 250;
+    cache.insert(std::to_string(i), now);
+    ASSERT_LE(cache.get_stats().size, max_entries);
+  }
+  ASSERT_LT(0, cache.get_stats().evicted);
+}
+
+TEST(request_cache, concurrent)
+{
+  request_cache cache(60000, 1 << 20);
+  const int threads = 4, ids = 10000;
+  std::vector<std::thread> workers;
+  std::atomic<int> inserted{0};
+  for (int t = 0; t < threads; ++t)
+  {
+    workers.emplace_back([&] {
+      for (int i = 0; i < ids; ++i)
+      {
+        if (cache.insert(std::to_string(i)))
+          ++inserted;
+      }
+    });
+  }
+  for (auto &w : workers)
+    w.join();
+  ASSERT_EQ(ids, inserted);
+  ASSERT_EQ(ids, cache.get_stats().size);
+}
@@ -0,0 +1,245 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <map>
+#include <random>
+#include <string>
+
+#include "cryptonote_core/stake_transaction_storage.h"
+#include "graft_rta_config.h"
+
+using cryptonote::StakeTransactionStorage;
+using cryptonote::stake_transaction;
+using cryptonote::supernode_stake;
+
+namespace
+{
+  unsigned int reference_tier(uint64_t amount)
+  {
+    return (amount >= config::graft::TIER1_STAKE_AMOUNT) + (amount >= config::graft::TIER2_STAKE_AMOUNT) +
+           (amount >= config::graft::TIER3_STAKE_AMOUNT) + (amount >= config::graft::TIER4_STAKE_AMOUNT);
+  }
+
+  // stakes computed by a full pass over all transactions
+  std::map<std::string, supernode_stake> reference_stakes(const StakeTransactionStorage::stake_transaction_array &txs, uint64_t block_number)
+  {
+    std::map<std::string, supernode_stake> result;
+    for (const stake_transaction &tx : txs)
+    {
+      bool obsolete = !tx.is_valid(block_number);
+      if (obsolete && tx.block_height + tx.unlock_time < block_number - config::graft::SUPERNODE_HISTORY_SIZE)
+        continue;
+      uint64_t min_height = tx.block_height + config::graft::STAKE_VALIDATION_PERIOD,
+               max_height = tx.block_height + tx.unlock_time + config::graft::TRUSTED_RESTAKING_PERIOD;
+      auto it = result.find(tx.supernode_public_id);
+      if (it == result.end())
+      {
+        supernode_stake &stake = result[tx.supernode_public_id];
+        stake.amount = obsolete ? 0 : tx.amount;
+        stake.tier = obsolete ? 0 : reference_tier(tx.amount);
+        stake.block_height = obsolete ? 0 : min_height;
+        stake.unlock_time = obsolete ? 0 : max_height - min_height;
+        stake.supernode_public_id = tx.supernode_public_id;
+        stake.supernode_public_address = tx.supernode_public_address;
+        continue;
+      }
+      supernode_stake &stake = it->second;
+      if (obsolete)
+        continue;
+      if (!stake.amount)
+      {
+        stake.amount = tx.amount;
+        stake.tier = reference_tier(tx.amount);
+        stake.block_height = min_height;
+        stake.unlock_time = max_height - min_height;
+        continue;
+      }
+      stake.amount += tx.amount;
+      stake.tier = reference_tier(stake.amount);
+      uint64_t min_block = std::max(stake.block_height, min_height), max_block = std::min(stake.block_height + stake.unlock_time, max_height);
+      if (max_block <= min_block)
+        max_block = min_block;
+      stake.block_height = min_block;
+      stake.unlock_time = max_block - min_block;
+    }
+    return result;
+  }
+
+  bool same_stake(const supernode_stake &a, const supernode_stake &b)
+  {
+    return a.amount == b.amount && a.tier == b.tier && a.block_height == b.block_height && a.unlock_time == b.unlock_time &&
+           a.supernode_public_id == b.supernode_public_id &&
+           !memcmp(&a.supernode_public_address, &b.supernode_public_address, sizeof(a.supernode_public_address));
+  }
+
+  void check_stakes(StakeTransactionStorage &storage, uint64_t block_number)
+  {
+    std::map<std::string, supernode_stake> expected = reference_stakes(storage.get_txs(), block_number);
+    const StakeTransactionStorage::supernode_stake_array &stakes = storage.get_supernode_stakes(block_number);
+    ASSERT_EQ(expected.size(), stakes.size()) << "block " << block_number;
+    for (const supernode_stake &stake : stakes)
+    {
+      auto it = expected.find(stake.supernode_public_id);
+      ASSERT_TRUE(it != expected.end()) << "block " << block_number;
+      ASSERT_TRUE(same_stake(it->second, stake)) << "block " << block_number << ", supernode " << stake.supernode_public_id;
+      const supernode_stake *found = storage.find_supernode_stake(block_number, stake.supernode_public_id);
+      ASSERT_TRUE(found != nullptr);
+      ASSERT_TRUE(same_stake(it->second, *found));
+    }
+  }
+
+  stake_transaction make_tx(std::mt19937 &rng, uint64_t block_height, size_t supernodes_count)
+  {
+    stake_transaction tx = AUTO_VAL_INIT(tx);
+    tx.block_height = block_height;
+    tx.unlock_time = rng() % 200;
+    tx.amount = config::graft::TIER1_STAKE_AMOUNT / 2 * (rng() % 8);
+    tx.supernode_public_id = "sn" + std::to_string(rng() % supernodes_count);
+    memset(&tx.supernode_public_address, int(rng() % 256), sizeof(tx.supernode_public_address));
+    return tx;
+  }
+
+  class stake_transaction_storage : public ::testing::Test
+  {
+  protected:
+    stake_transaction_storage()
+      : m_rng(1)
+    {
+    }
+
+    void add_block(StakeTransactionStorage &storage, size_t txs_count, size_t supernodes_count)
+    {
+      uint64_t block_height = storage.get_last_processed_block_index() + 1;
+      for (size_t i = 0; i < txs_count; ++i)
+        storage.add_tx(make_tx(m_rng, block_height, supernodes_count));
+      crypto::hash hash = cryptonote::null_hash;
+      memcpy(&hash, &block_height, sizeof(block_height));
+      storage.add_last_processed_block(block_height, hash);
+    }
+
+    std::mt19937 m_rng;
+  };
+}
+
+TEST_F(stake_transaction_storage, incremental_stakes_match_full_rebuild)
+{
+  StakeTransactionStorage storage(0);
+
+  for (uint64_t i = 0; i < 600; ++i)
+  {
+    add_block(storage, m_rng() % 4, 30);
+    check_stakes(storage, storage.get_last_processed_block_index());
+  }
+}
+
+TEST_F(stake_transaction_storage, history_queries_keep_current_stakes)
+{
+  StakeTransactionStorage storage(0);
+
+  for (uint64_t i = 0; i < 400; ++i)
+    add_block(storage, 2, 20);
+
+  uint64_t last_block = storage.get_last_processed_block_index();
+  storage.get_supernode_stakes(last_block);
+
+  for (uint64_t block = 50; block < last_block; block += 37)
+  {
+    std::map<std::string, supernode_stake> expected = reference_stakes(storage.get_txs(), block);
+    for (size_t i = 0; i < 20; ++i)
+    {
+      std::string id = "sn" + std::to_string(i);
+      const supernode_stake *found = storage.find_supernode_stake(block, id);
+      auto it = expected.find(id);
+      ASSERT_EQ(it != expected.end(), found != nullptr) << "block " << block << ", supernode " << id;
+      if (found)
+      {
+        ASSERT_TRUE(same_stake(it->second, *found));
+      }
+    }
+  }
+
+  check_stakes(storage, last_block);
+  check_stakes(storage, last_block - 150);
+  check_stakes(storage, last_block - 3);
+  check_stakes(storage, 20);
+  check_stakes(storage, last_block);
+}
+
+TEST_F(stake_transaction_storage, unrolled_blocks)
+{
+  StakeTransactionStorage storage(0);
+
+  for (uint64_t i = 0; i < 300; ++i)
+    add_block(storage, 3, 25);
+  check_stakes(storage, storage.get_last_processed_block_index());
+
+  for (uint64_t i = 0; i < 20; ++i)
+  {
+    storage.remove_last_processed_block();
+    check_stakes(storage, storage.get_last_processed_block_index());
+  }
+
+  for (uint64_t i = 0; i < 20; ++i)
+  {
+    add_block(storage, 3, 25);
+    check_stakes(storage, storage.get_last_processed_block_index());
+  }
+}
+
+TEST_F(stake_transaction_storage, reset_restores_state)
+{
+  StakeTransactionStorage::stake_transaction_array txs;
+  StakeTransactionStorage::block_hash_list block_hashes;
+  uint64_t last_block;
+  {
+    StakeTransactionStorage storage(0);
+    for (uint64_t i = 0; i < 200; ++i)
+      add_block(storage, 2, 10);
+    check_stakes(storage, storage.get_last_processed_block_index());
+    txs = storage.get_txs();
+    last_block = storage.get_last_processed_block_index();
+  }
+
+  for (uint64_t block_height = last_block - 9; block_height <= last_block; ++block_height)
+  {
+    crypto::hash hash = cryptonote::null_hash;
+    memcpy(&hash, &block_height, sizeof(block_height));
+    block_hashes.push_back(hash);
+  }
+
+  StakeTransactionStorage storage(0);
+  storage.reset(last_block, txs, block_hashes);
+  ASSERT_EQ(last_block, storage.get_last_processed_block_index());
+  check_stakes(storage, last_block);
+  add_block(storage, 2, 10);
+  check_stakes(storage, last_block + 1);
+  storage.remove_last_processed_block();
+  check_stakes(storage, last_block);
+}
@@ -0,0 +1,114 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "p2p/supernode_forwarder.h"
+
+using nodetool::supernode_forwarder;
+using epee::net_utils::http::http_simple_client;
+
+namespace
+{
+  template<class Pred>
+  bool wait_for(Pred pred)
+  {
+    for (int i = 0; i < 500 && !pred(); ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return pred();
+  }
+}
+
+TEST(supernode_forwarder, sends_in_order)
+{
+  auto forwarder = supernode_forwarder::create("127.0.0.1", 1, 16);
+  std::mutex lock;
+  std::vector<int> order;
+  for (int i = 0; i < 10; ++i)
+  {
+    ASSERT_TRUE(forwarder->post([i, &lock, &order](http_simple_client&) {
+      std::lock_guard<std::mutex> guard(lock);
+      order.push_back(i);
+      return true;
+    }));
+  }
+  ASSERT_TRUE(wait_for([&] { return forwarder->get_stats().sent == 10; }));
+  forwarder->stop(true);
+
+  for (int i = 0; i < 10; ++i)
+    ASSERT_EQ(i, order[i]);
+  auto stats = forwarder->get_stats();
+  ASSERT_EQ(0, stats.queued);
+  ASSERT_EQ(0, stats.failed);
+  ASSERT_EQ(0, stats.dropped);
+}
+
+TEST(supernode_forwarder, drops_when_full)
+{
+  auto forwarder = supernode_forwarder::create("127.0.0.1", 1, 2);
+  std::atomic<bool> started{false}, release{false};
+  ASSERT_TRUE(forwarder->post([&](http_simple_client&) {
+    started = true;
+    while (!release)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return true;
+  }));
+  ASSERT_TRUE(wait_for([&] { return started.load(); }));
+
+  // sender is busy, posting must not block
+  ASSERT_TRUE(forwarder->post([](http_simple_client&) { return true; }));
+  ASSERT_TRUE(forwarder->post([](http_simple_client&) { return false; }));
+  ASSERT_FALSE(forwarder->post([](http_simple_client&) { return true; }));
+  auto stats = forwarder->get_stats();
+  ASSERT_EQ(2, stats.queued);
+  ASSERT_EQ(2, stats.max_queued);
+  ASSERT_EQ(1, stats.dropped);
+
+  release = true;
+  ASSERT_TRUE(wait_for([&] { auto s = forwarder->get_stats(); return s.sent + s.failed == 3; }));
+  stats = forwarder->get_stats();
+  ASSERT_EQ(2, stats.sent);
+  ASSERT_EQ(1, stats.failed);
+  ASSERT_LE(stats.latency_avg_us, stats.latency_max_us);
+  forwarder->stop(true);
+}
+
+TEST(supernode_forwarder, failed_send)
+{
+  auto forwarder = supernode_forwarder::create("127.0.0.1", 1, 4);
+  ASSERT_TRUE(forwarder->post([](http_simple_client&) -> bool { throw std::runtime_error("connection refused"); }));
+  ASSERT_TRUE(wait_for([&] { return forwarder->get_stats().failed == 1; }));
+  forwarder->stop(true);
+  ASSERT_FALSE(forwarder->post([](http_simple_client&) { return true; }));
+  ASSERT_EQ(1, forwarder->get_stats().dropped);
+}
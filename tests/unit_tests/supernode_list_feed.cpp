@@ -0,0 +1,209 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <string>
+
+#include "p2p/supernode_list_feed.h"
+
+using nodetool::supernode_list_encoder;
+
+namespace
+{
+  typedef cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST_DELTA list_delta;
+  typedef cryptonote::COMMAND_RPC_SUPERNODE_STAKES_DELTA stakes_delta;
+
+  cryptonote::account_public_address make_address(char seed)
+  {
+    cryptonote::account_public_address address;
+    memset(&address, seed, sizeof(address));
+    return address;
+  }
+
+  cryptonote::BlockchainBasedList::supernode make_supernode(const std::string &id, uint64_t amount, char seed = 1)
+  {
+    cryptonote::BlockchainBasedList::supernode sn;
+    sn.supernode_public_id = id;
+    sn.supernode_public_address = make_address(seed);
+    sn.amount = amount;
+    sn.block_height = 0;
+    sn.unlock_time = 0;
+    return sn;
+  }
+
+  cryptonote::supernode_stake make_stake(const std::string &id, uint64_t amount)
+  {
+    cryptonote::supernode_stake stake;
+    stake.amount = amount;
+    stake.tier = 0;
+    stake.block_height = 10;
+    stake.unlock_time = 100;
+    stake.supernode_public_id = id;
+    stake.supernode_public_address = make_address(2);
+    return stake;
+  }
+
+  template<class T>
+  T decode(const supernode_list_encoder::blob_ptr &blob)
+  {
+    T request = AUTO_VAL_INIT(request);
+    EXPECT_TRUE(blob != nullptr);
+    if (blob)
+    {
+      EXPECT_TRUE(epee::serialization::load_t_from_binary(request, *blob));
+    }
+    return request;
+  }
+}
+
+TEST(supernode_list_feed, first_list_is_full)
+{
+  supernode_list_encoder encoder(true);
+  supernode_list_encoder::supernode_tier_array tiers(2);
+  tiers[0].push_back(make_supernode("a", 1));
+  tiers[1].push_back(make_supernode("b", 2));
+
+  supernode_list_encoder::encoded update = encoder.encode_blockchain_based_list(100, tiers, false, nullptr);
+  ASSERT_FALSE(update.delta);
+  list_delta::request full = decode<list_delta::request>(update.full);
+  ASSERT_TRUE(full.full);
+  ASSERT_EQ(uint64_t(100), full.block_height);
+  ASSERT_EQ(size_t(2), full.tiers.size());
+  ASSERT_EQ(size_t(1), full.tiers[0].added.size());
+  ASSERT_EQ("a", full.tiers[0].added[0].supernode_public_id);
+  ASSERT_FALSE(full.tiers[0].added[0].supernode_public_address.empty());
+  ASSERT_EQ(size_t(1), full.tiers[1].added.size());
+}
+
+TEST(supernode_list_feed, next_block_is_delta)
+{
+  supernode_list_encoder encoder(true);
+  supernode_list_encoder::supernode_tier_array tiers(1);
+  tiers[0].push_back(make_supernode("a", 1));
+  tiers[0].push_back(make_supernode("b", 2));
+  tiers[0].push_back(make_supernode("c", 3));
+  encoder.encode_blockchain_based_list(100, tiers, false, nullptr);
+
+  tiers[0].clear();
+  tiers[0].push_back(make_supernode("a", 1));
+  tiers[0].push_back(make_supernode("b", 5));
+  tiers[0].push_back(make_supernode("d", 4));
+  supernode_list_encoder::encoded update = encoder.encode_blockchain_based_list(101, tiers, false, nullptr);
+  ASSERT_FALSE(update.full);
+  ASSERT_EQ(uint64_t(100), update.base_block_height);
+
+  list_delta::request delta = decode<list_delta::request>(update.delta);
+  ASSERT_FALSE(delta.full);
+  ASSERT_EQ(uint64_t(101), delta.block_height);
+  ASSERT_EQ(uint64_t(100), delta.base_block_height);
+  ASSERT_EQ(size_t(1), delta.tiers.size());
+  std::vector<std::string> added;
+  for (const auto &sn : delta.tiers[0].added)
+    added.push_back(sn.supernode_public_id);
+  std::sort(added.begin(), added.end());
+  ASSERT_EQ((std::vector<std::string>{"b", "d"}), added);
+  ASSERT_EQ((std::vector<std::string>{"c"}), delta.tiers[0].removed);
+
+  // both are produced when asked for
+  update = encoder.encode_blockchain_based_list(102, tiers, true, nullptr);
+  ASSERT_TRUE(update.delta);
+  ASSERT_EQ(size_t(0), decode<list_delta::request>(update.delta).tiers[0].added.size());
+  ASSERT_EQ(size_t(3), decode<list_delta::request>(update.full).tiers[0].added.size());
+}
+
+TEST(supernode_list_feed, gaps_and_older_blocks_are_full)
+{
+  supernode_list_encoder encoder(true);
+  supernode_list_encoder::supernode_tier_array tiers(1);
+  tiers[0].push_back(make_supernode("a", 1));
+  encoder.encode_blockchain_based_list(100, tiers, false, nullptr);
+
+  supernode_list_encoder::encoded update = encoder.encode_blockchain_based_list(102, tiers, false, nullptr);
+  ASSERT_FALSE(update.delta);
+  ASSERT_TRUE(update.full);
+
+  // resent on request, doesn't replace the latest list
+  tiers[0].push_back(make_supernode("b", 2));
+  update = encoder.encode_blockchain_based_list(90, tiers, false, nullptr);
+  ASSERT_FALSE(update.delta);
+  ASSERT_EQ(size_t(2), decode<list_delta::request>(update.full).tiers[0].added.size());
+
+  tiers[0].pop_back();
+  update = encoder.encode_blockchain_based_list(103, tiers, false, nullptr);
+  ASSERT_TRUE(update.delta);
+  list_delta::request delta = decode<list_delta::request>(update.delta);
+  ASSERT_TRUE(delta.tiers[0].added.empty());
+  ASSERT_TRUE(delta.tiers[0].removed.empty());
+}
+
+TEST(supernode_list_feed, legacy_request_and_address_cache)
+{
+  supernode_list_encoder encoder(true);
+  supernode_list_encoder::supernode_tier_array tiers(1);
+  tiers[0].push_back(make_supernode("a", 1, 1));
+  tiers[0].push_back(make_supernode("b", 2, 1));
+
+  cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST::request legacy;
+  encoder.encode_blockchain_based_list(100, tiers, false, &legacy);
+  ASSERT_EQ(uint64_t(100), legacy.block_height);
+  ASSERT_EQ(size_t(2), legacy.tiers[0].supernodes.size());
+  ASSERT_EQ(size_t(2), encoder.cached_addresses());
+  const std::string old_address = legacy.tiers[0].supernodes[0].supernode_public_address;
+
+  tiers[0][0].supernode_public_address = make_address(3);
+  encoder.encode_blockchain_based_list(101, tiers, false, &legacy);
+  ASSERT_EQ(size_t(2), legacy.tiers[0].supernodes.size());
+  ASSERT_NE(old_address, legacy.tiers[0].supernodes[0].supernode_public_address);
+  ASSERT_EQ(size_t(2), encoder.cached_addresses());
+}
+
+TEST(supernode_list_feed, stakes_delta)
+{
+  supernode_list_encoder encoder(true);
+  supernode_list_encoder::supernode_stake_array stakes;
+  stakes.push_back(make_stake("a", 1));
+  stakes.push_back(make_stake("b", 2));
+
+  cryptonote::COMMAND_RPC_SUPERNODE_STAKES::request legacy;
+  supernode_list_encoder::encoded update = encoder.encode_stakes(100, stakes, false, &legacy);
+  ASSERT_FALSE(update.delta);
+  ASSERT_EQ(size_t(2), decode<stakes_delta::request>(update.full).added.size());
+  ASSERT_EQ(size_t(2), legacy.stakes.size());
+
+  stakes[1].unlock_time = 200;
+  stakes.erase(stakes.begin());
+  update = encoder.encode_stakes(101, stakes, false, nullptr);
+  ASSERT_FALSE(update.full);
+  stakes_delta::request delta = decode<stakes_delta::request>(update.delta);
+  ASSERT_EQ(size_t(1), delta.added.size());
+  ASSERT_EQ("b", delta.added[0].supernode_public_id);
+  ASSERT_EQ(uint64_t(200), delta.added[0].unlock_time);
+  ASSERT_EQ((std::vector<std::string>{"a"}), delta.removed);
+}
@@ -0,0 +1,119 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "p2p/supernode_route_table.h"
+
+using nodetool::supernode_route_table;
+
+namespace
+{
+  const std::string sn_a = "0f1e2d3c4b5a69788796a5b4c3d2e1f00f1e2d3c4b5a69788796a5b4c3d2e1f0";
+  const std::string sn_b = "not-a-hex-id";
+
+  nodetool::peerlist_entry make_peer(nodetool::peerid_type id)
+  {
+    nodetool::peerlist_entry pe = AUTO_VAL_INIT(pe);
+    pe.id = id;
+    pe.adr = new epee::net_utils::ipv4_network_address(0x0100007f, 18980 + id);
+    return pe;
+  }
+}
+
+TEST(supernode_route_table, announce_updates)
+{
+  supernode_route_table routes(120);
+  ASSERT_EQ(supernode_route_table::route_updated, routes.update(sn_a, make_peer(1), 10, 2, 1000));
+  // same announce through another peer
+  ASSERT_EQ(supernode_route_table::route_duplicate, routes.update(sn_a, make_peer(2), 10, 1, 1001));
+  ASSERT_EQ(supernode_route_table::route_duplicate, routes.update(sn_a, make_peer(2), 10, 1, 1002));
+  ASSERT_EQ(supernode_route_table::route_stale, routes.update(sn_a, make_peer(3), 9, 1, 1003));
+  ASSERT_EQ(2, routes.max_hop(std::list<std::string>{sn_a}));
+
+  // lower hop is preferred
+  auto peers = routes.find_peers(std::list<std::string>{sn_a, sn_b});
+  ASSERT_EQ(2, peers.size());
+  ASSERT_EQ(2, peers[0].size());
+  ASSERT_EQ(2, peers[0][0].id);
+  ASSERT_EQ(1, peers[0][1].id);
+  ASSERT_TRUE(peers[1].empty());
+
+  // new height: peer which delivered it first, previous ones kept as fallback
+  ASSERT_EQ(supernode_route_table::route_updated, routes.update(sn_a, make_peer(3), 11, 3, 1100));
+  ASSERT_EQ(3, routes.max_hop());
+  peers = routes.find_peers(std::list<std::string>{sn_a});
+  ASSERT_EQ(3, peers[0].size());
+  ASSERT_EQ(3, peers[0][0].id);
+
+  // peers older than the previous announce are dropped
+  ASSERT_EQ(supernode_route_table::route_updated, routes.update(sn_a, make_peer(4), 12, 1, 1200));
+  peers = routes.find_peers(std::list<std::string>{sn_a});
+  ASSERT_EQ(2, peers[0].size());
+  ASSERT_EQ(4, peers[0][0].id);
+  ASSERT_EQ(3, peers[0][1].id);
+}
+
+TEST(supernode_route_table, failing_peers_ranked_last)
+{
+  supernode_route_table routes(120);
+  routes.update(sn_b, make_peer(1), 10, 1, 1000);
+  routes.update(sn_b, make_peer(2), 10, 2, 1000);
+  for (uint32_t i = 0; i < supernode_route_table::MAX_PEER_FAILURES; ++i)
+    routes.report(1, false);
+  auto peers = routes.find_peers(std::list<std::string>{sn_b});
+  ASSERT_EQ(2, peers[0][0].id);
+  ASSERT_EQ(1, peers[0][1].id);
+
+  routes.report(1, true);
+  peers = routes.find_peers(std::list<std::string>{sn_b});
+  ASSERT_EQ(1, peers[0][0].id);
+}
+
+TEST(supernode_route_table, snapshot_is_stable)
+{
+  supernode_route_table routes(120);
+  routes.update(sn_a, make_peer(1), 10, 1, 1000);
+  auto snapshot = routes.snapshot();
+  routes.update(sn_a, make_peer(2), 11, 1, 1100);
+  routes.update(sn_b, make_peer(2), 11, 1, 1100);
+  ASSERT_EQ(1, snapshot.size());
+  ASSERT_EQ(10, snapshot[0]->last_announce_height);
+  ASSERT_EQ(1, snapshot[0]->peers.size());
+  ASSERT_EQ(2, routes.snapshot().size());
+}
+
+TEST(supernode_route_table, bounded_peers)
+{
+  supernode_route_table routes(120);
+  for (nodetool::peerid_type id = 1; id <= 2 * supernode_route_table::MAX_ROUTE_PEERS; ++id)
+    routes.update(sn_a, make_peer(id), 10, id, 1000);
+  auto peers = routes.find_peers(std::list<std::string>{sn_a});
+  ASSERT_EQ(size_t(supernode_route_table::MAX_ROUTE_PEERS), peers[0].size());
+  ASSERT_EQ(1, peers[0][0].id);
+}